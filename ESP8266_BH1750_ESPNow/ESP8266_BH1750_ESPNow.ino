@@ -5,9 +5,14 @@
 #include <espnow.h>
 extern "C" {
   #include "user_interface.h" // wifi_set_channel, wifi_get_channel
+  #include "gpio.h"           // gpio_pin_wakeup_enable
 }
 #include <EEPROM.h>
 #include <BH1750.h>
+#include "lux_packet.h"
+#include "send_policy.h"
+#include "occupancy.h"
+#include "channel_scan.h"
 
 #ifndef D2
   #define I2C_SDA_PIN 4
@@ -33,11 +38,69 @@ static const int MAX_SEND_FAILS = 5;
 static const uint8_t CHANNEL_MIN = 1;
 static const uint8_t CHANNEL_MAX = 13;
 
+// Readings packed into one ESP-NOW frame (one every SEND_INTERVAL_MS / N)
+#ifndef SAMPLES_PER_FRAME
+#define SAMPLES_PER_FRAME 1
+#endif
+// Append a CRC-16 to every frame
+#ifndef FRAME_CRC
+#define FRAME_CRC 1
+#endif
+// Ask the lamp to ACK each frame and rescan channels 1-13 when the ACKs stop
+#ifndef CHANNEL_DISCOVERY
+#define CHANNEL_DISCOVERY 1
+#endif
+static const uint32_t PROBE_WAIT_MS = 40;
+
+// Low-power mode: send only when lux leaves the deadband or occupancy changes
+// (plus a slow heartbeat), light-sleep between samples, and keep the config
+// AP up only for SETUP_WINDOW_MS after boot (longer while a client is
+// connected). Power-cycle the node to get the AP back.
+#ifndef LOW_POWER
+#define LOW_POWER 1
+#endif
+#ifndef LP_SAMPLE_MS
+#define LP_SAMPLE_MS 1000       // wake, read BH1750 + PIR
+#endif
+#ifndef LP_DEADBAND_PCT
+#define LP_DEADBAND_PCT 0.10f   // relative lux change that triggers a send
+#endif
+#ifndef LP_DEADBAND_MIN_LUX
+#define LP_DEADBAND_MIN_LUX 2.0f
+#endif
+#ifndef LP_HEARTBEAT_MS
+#define LP_HEARTBEAT_MS 30000   // lamp times low-power nodes out after 75 s
+#endif
+#ifndef LP_HEARTBEAT_OCC_MS
+#define LP_HEARTBEAT_OCC_MS 10000  // refreshes the lamp's 35 s presence lease
+#endif
+#ifndef SETUP_WINDOW_MS
+#define SETUP_WINDOW_MS 300000UL
+#endif
+
+// Power estimate inputs (uA); sleep includes BH1750 + PIR, not USB-serial chips
+#ifndef CURRENT_AWAKE_UA
+#define CURRENT_AWAKE_UA 70000
+#endif
+#ifndef CURRENT_SLEEP_UA
+#define CURRENT_SLEEP_UA 1200
+#endif
+#ifndef CURRENT_TX_UA
+#define CURRENT_TX_UA 170000
+#endif
+#ifndef BATTERY_MAH
+#define BATTERY_MAH 2000
+#endif
+static const uint32_t POWER_LOG_MS = 60000;
+
+static_assert(SAMPLES_PER_FRAME >= 1 && SAMPLES_PER_FRAME <= LUXW_MAX_SAMPLES, "SAMPLES_PER_FRAME out of range");
+
 // How long to keep "occupied" true after last detected motion.
 // Tune this upward if you still get false "empty" while someone is present.
 static const uint32_t OCCUPANCY_HOLD_MS = 120000; // 2 minutes
+// PIR output must stay high this long to count (filters radio-induced glitches)
+static const uint32_t PIR_DEBOUNCE_MS = 30;
 
-struct LuxPacket { float lux; uint8_t motion; };
 struct Cfg {
   uint16_t magic;
   uint8_t  version;
@@ -57,6 +120,24 @@ uint8_t currentChannel = 1;
 volatile bool espnowReady = false;
 volatile int consecutiveSendFails = 0;
 unsigned long lastSendMs = 0;
+unsigned long lastSampleMs = 0;
+
+// v2 framing: node id, per-frame sequence number, readings not yet sent
+uint16_t g_nodeId = 0;
+uint16_t g_seq = 0;
+uint32_t g_framesSent = 0;
+LuxWire::Sample g_pending[SAMPLES_PER_FRAME];
+uint32_t g_pendingMs[SAMPLES_PER_FRAME];
+uint8_t g_pendingCount = 0;
+
+// Low-power state; time spent in forced light sleep is added to nodeMs()
+// because millis() does not advance while the CPU clock is stopped
+bool g_setupOpen = true;
+uint32_t g_sleptMs = 0;
+uint32_t g_meterMs = 0;
+uint8_t g_lastReason = SendPolicy::R_NONE;
+SendPolicy::Policy g_policy({ LP_DEADBAND_PCT, LP_DEADBAND_MIN_LUX, LP_HEARTBEAT_MS, LP_HEARTBEAT_OCC_MS });
+SendPolicy::PowerMeter g_power({ CURRENT_AWAKE_UA, CURRENT_SLEEP_UA, CURRENT_TX_UA });
 
 float g_lastLux = 0.0f;
 bool  g_lastSendOk = false;
@@ -64,9 +145,22 @@ bool  g_lastSendOk = false;
 // Raw PIR read (HIGH/LOW)
 bool  g_lastMotion = false;
 
-// Latched occupancy/presence + timer
+// Latched occupancy/presence
 bool     g_occupied = false;
-uint32_t g_occupiedUntilMs = 0;
+Occupancy g_occ(OCCUPANCY_HOLD_MS, PIR_DEBOUNCE_MS);
+uint32_t g_motionSends = 0;
+
+// PIR edges captured by the ISR, consumed by loop()
+volatile bool     g_pirEvent = false;
+volatile bool     g_pirLevel = false;
+volatile uint32_t g_pirEdgeMs = 0;
+volatile uint32_t g_pirEdges = 0;
+volatile bool     g_woke = false;
+
+// Channel discovery: ACKs/beacons from the lamp, posted by the receive callback
+ChannelScan::Scanner g_scan({ CHANNEL_MIN, CHANNEL_MAX, PROBE_WAIT_MS, 10000, 300000 });
+volatile bool    g_lampEvent = false;
+volatile uint8_t g_lampCh = 0;
 
 void loadConfig();
 void saveConfig();
@@ -77,18 +171,49 @@ void setupEspNow();
 bool ensurePeer();
 void reinitEspNow(const char* reason);
 void onDataSent(uint8_t* mac_addr, uint8_t sendStatus);
-void sendLuxReading();
-
-// Updates g_lastMotion (raw) and g_occupied (latched)
-static void updateOccupancyFromPir(bool motionRaw) {
-  g_lastMotion = motionRaw;
+void onDataRecv(uint8_t* mac, uint8_t* data, uint8_t len);
+void serviceDiscovery(uint32_t now);
+void takeReading();
+bool sendFrame();
+void closeSetupWindow();
+void lightSleep(uint32_t ms);
+
+static inline uint32_t nodeMs() { return millis() + g_sleptMs; }
+
+IRAM_ATTR void onPirEdge() {
+  g_pirLevel = digitalRead(PIR_PIN);
+  g_pirEdgeMs = millis() + g_sleptMs;
+  g_pirEdges++;
+  g_pirEvent = true;
+}
 
-  if (motionRaw) {
-    g_occupiedUntilMs = millis() + OCCUPANCY_HOLD_MS;
+// Updates g_lastMotion (raw) and g_occupied (latched) from the PIR edges;
+// returns true if occupancy changed
+static bool updateOccupancyFromPir(uint32_t now) {
+  bool changed = false;
+  if (g_pirEvent) {
+    noInterrupts();
+    bool level = g_pirLevel;
+    uint32_t at = g_pirEdgeMs;
+    g_pirEvent = false;
+    interrupts();
+    changed = g_occ.input(level, at);
   }
+  if (g_occ.tick(now)) changed = true;
+  g_lastMotion = g_occ.level();
+  g_occupied = g_occ.occupied();
+  return changed;
+}
 
-  // wrap-safe comparison: occupied if now < occupiedUntil
-  g_occupied = ((int32_t)(millis() - g_occupiedUntilMs) < 0);
+// Occupancy changed: send a fresh reading right away instead of on the next tick
+static void sendOccupancyNow(uint32_t now) {
+  Serial.printf("[PIR] occupancy -> %s\n", g_occupied ? "YES" : "NO");
+  takeReading();
+  if (sendFrame()) {
+    g_motionSends++;
+    g_lastReason = SendPolicy::R_OCCUPANCY;
+    g_policy.sent(g_lastLux, g_occupied, now);
+  }
 }
 
 const char INDEX_HTML[] PROGMEM = R"HTML(
@@ -125,7 +250,7 @@ const char INDEX_HTML[] PROGMEM = R"HTML(
         <input id="ch" type="number" min="1" max="13" step="1" autocomplete="off">
         <button id="btnSaveCh" class="btn">Save Channel</button>
       </div>
-      <div class="muted">Match the ESP32 router channel (STA mode) or use Broadcast (1) for ESP32 AP mode.</div>
+      <div class="muted">Found automatically with current lamp firmware (the node rescans when the lamp stops answering). Otherwise match the ESP32 router channel (STA mode) or use Broadcast (1) for ESP32 AP mode.</div>
     </div>
   </div>
 
@@ -142,6 +267,9 @@ const char INDEX_HTML[] PROGMEM = R"HTML(
       <div class="muted">Raw Motion</div><div id="st_pir_raw" class="kv"></div>
       <div class="muted">Occupied (Latched)</div><div id="st_occ" class="kv"></div>
       <div class="muted">Last Send</div><div id="st_send" class="kv"></div>
+      <div class="muted">Frames / Airtime</div><div id="st_air" class="kv"></div>
+      <div class="muted">Avg Current</div><div id="st_pwr" class="kv"></div>
+      <div class="muted">Setup AP</div><div id="st_setup" class="kv"></div>
     </div>
   </div>
 
@@ -179,7 +307,10 @@ async function refresh() {
     document.getElementById('st_pir_raw').textContent = st.last_motion ? 'Motion' : 'No motion';
     document.getElementById('st_occ').textContent = st.occupied ? 'Occupied' : 'Clear';
 
-    document.getElementById('st_send').textContent = st.last_send_ok ? 'OK' : '...';
+    document.getElementById('st_send').textContent = (st.last_send_ok ? 'OK' : '...') + ' (' + st.send_reason + ')';
+    document.getElementById('st_air').textContent = st.frames_sent + ' / ' + (st.airtime_us / 1000).toFixed(1) + ' ms (' + st.airtime_ppm + ' ppm)';
+    document.getElementById('st_pwr').textContent = (st.avg_ua / 1000).toFixed(2) + ' mA, ~' + st.battery_h + ' h battery';
+    document.getElementById('st_setup').textContent = st.low_power ? ('closes in ' + st.setup_left_s + ' s (stays open while connected)') : 'always on';
 
     const chInput = document.getElementById('ch');
     if (!channelEditing && !channelDirty) {
@@ -250,15 +381,17 @@ void applyChannel(uint8_t ch) {
 
   Serial.printf("[CFG] Applying channel %u\n", ch);
 
-  WiFi.softAPdisconnect(true);
-  delay(50);
-  wifi_set_channel(ch);
-  delay(10);
-  WiFi.softAP(AP_SSID, AP_PASS, ch, false, 1);
+  currentChannel = ch;
+  if (g_setupOpen) {
+    WiFi.softAPdisconnect(true);
+    delay(50);
+    wifi_set_channel(ch);
+    delay(10);
+    WiFi.softAP(AP_SSID, AP_PASS, ch, false, 1);
+  }
 
   reinitEspNow("channel change");
-
-  currentChannel = ch;
+  g_scan.begin(ch, nodeMs());
   saveConfig();
 }
 
@@ -273,15 +406,32 @@ void handleGet() {
 
   uint8_t rfCh = wifi_get_channel();
 
-  char buf[380];
+  uint32_t up = nodeMs();
+  uint32_t setupLeft = (LOW_POWER && up < SETUP_WINDOW_MS) ? (SETUP_WINDOW_MS - up) / 1000 : 0;
+
+  char buf[880];
   snprintf(buf, sizeof(buf),
     "{\"channel\":%u,\"rf_ch\":%u,\"ap_ssid\":\"%s\",\"ap_ip\":\"%s\",\"mac\":\"%s\","
-    "\"last_lux\":%.2f,\"last_motion\":%s,\"occupied\":%s,\"last_send_ok\":%s}",
+    "\"last_lux\":%.2f,\"last_motion\":%s,\"occupied\":%s,\"last_send_ok\":%s,"
+    "\"node_id\":%u,\"seq\":%u,\"frames_sent\":%lu,"
+    "\"low_power\":%s,\"setup_left_s\":%lu,\"send_reason\":\"%s\",\"airtime_us\":%lu,\"airtime_ppm\":%lu,"
+    "\"sleep_permille\":%lu,\"avg_ua\":%lu,\"battery_h\":%lu,"
+    "\"pir_edges\":%lu,\"pir_glitches\":%lu,\"pir_retriggers\":%lu,\"motion_sends\":%lu,"
+    "\"scan\":{\"acks\":%lu,\"misses\":%lu,\"scans\":%lu,\"failed\":%lu,\"last_ms\":%lu}}",
     currentChannel, rfCh, AP_SSID, ipbuf, macstr,
     g_lastLux,
     g_lastMotion ? "true":"false",
     g_occupied ? "true":"false",
-    g_lastSendOk ? "true":"false");
+    g_lastSendOk ? "true":"false",
+    g_nodeId, g_seq, (unsigned long)g_framesSent,
+    LOW_POWER ? "true":"false", (unsigned long)setupLeft, SendPolicy::reasonName(g_lastReason),
+    (unsigned long)g_power.airtimeUs(), (unsigned long)g_power.airtimePpm(),
+    (unsigned long)g_power.sleepPermille(), (unsigned long)g_power.avgUa(),
+    (unsigned long)g_power.batteryHours(BATTERY_MAH),
+    (unsigned long)g_pirEdges, (unsigned long)g_occ.glitches(), (unsigned long)g_occ.retriggers(),
+    (unsigned long)g_motionSends,
+    (unsigned long)g_scan.stats().acks, (unsigned long)g_scan.stats().misses, (unsigned long)g_scan.stats().scans,
+    (unsigned long)g_scan.stats().failedScans, (unsigned long)g_scan.stats().lastScanMs);
   server.send(200, "application/json", buf);
 }
 
@@ -330,8 +480,9 @@ void setupEspNow() {
   espnowReady = false;
 
   if (esp_now_init() != 0) { Serial.println(F("[ESP-NOW] Init failed")); return; }
-  esp_now_set_self_role(ESP_NOW_ROLE_CONTROLLER);
+  esp_now_set_self_role(ESP_NOW_ROLE_COMBO);  // sends, and receives lamp ACKs/beacons
   esp_now_register_send_cb(onDataSent);
+  esp_now_register_recv_cb(onDataRecv);
 
   if (!ensurePeer()) { Serial.println(F("[ESP-NOW] add peer failed")); return; }
 
@@ -369,6 +520,70 @@ void onDataSent(uint8_t* mac_addr, uint8_t sendStatus) {
   }
 }
 
+// Lamp ACK (for us) or channel beacon; handled in loop()
+void onDataRecv(uint8_t* mac, uint8_t* data, uint8_t len) {
+  LuxWire::Frame f;
+  if (LuxWire::decodeV2(data, len, f) != LuxWire::OK) return;
+  if ((f.type == LuxWire::T_ACK && f.nodeId == g_nodeId) || f.type == LuxWire::T_BEACON) {
+    g_lampCh = f.channel;
+    g_lampEvent = true;
+  }
+}
+
+static void tuneTo(uint8_t ch) {
+  wifi_set_channel(ch);
+  esp_now_set_peer_channel((uint8_t*)BROADCAST_MAC, ch);
+}
+
+static void sendProbe() {
+  LuxWire::Frame f;
+  f.type = LuxWire::T_PROBE;
+  f.flags = LuxWire::F_CRC;
+  f.nodeId = g_nodeId;
+  f.seq = g_seq;
+  f.legacy = false;
+  f.channel = g_scan.channel();
+  f.count = 0;
+  uint8_t buf[LuxWire::kHeaderLen + LuxWire::kControlLen + LuxWire::kCrcLen];
+  size_t len = LuxWire::encode(f, buf, sizeof(buf));
+  if (esp_now_send((uint8_t*)BROADCAST_MAC, buf, len) == 0) g_power.addFrame(len);
+}
+
+// Feed lamp ACKs/beacons and timeouts to the scanner and act on its decisions
+void serviceDiscovery(uint32_t now) {
+  ChannelScan::Action a = ChannelScan::A_NONE;
+  if (g_lampEvent) {
+    noInterrupts();
+    uint8_t ch = g_lampCh;
+    g_lampEvent = false;
+    interrupts();
+    a = g_scan.onLamp(ch, now);
+  }
+  if (a == ChannelScan::A_NONE) a = g_scan.poll(now);
+
+  switch (a) {
+    case ChannelScan::A_PROBE:
+      if (!g_scan.scanning()) Serial.println(F("[SCAN] No ACK, probing current channel"));
+      tuneTo(g_scan.channel());
+      sendProbe();
+      break;
+    case ChannelScan::A_LOCKED:
+      Serial.printf("[SCAN] Lamp on channel %u (scan took %lu ms)\n", g_scan.channel(), (unsigned long)g_scan.stats().lastScanMs);
+      if (g_scan.channel() != currentChannel) applyChannel(g_scan.channel());
+      else tuneTo(currentChannel);
+      // the frame that went unanswered is lost; send the current state now
+      takeReading();
+      if (sendFrame()) g_policy.sent(g_lastLux, g_occupied, now);
+      break;
+    case ChannelScan::A_GAVE_UP:
+      Serial.printf("[SCAN] Lamp not found, staying on channel %u\n", currentChannel);
+      tuneTo(currentChannel);
+      break;
+    default:
+      break;
+  }
+}
+
 void setupSensor() {
   Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
   delay(10);
@@ -386,44 +601,138 @@ void setupSensor() {
   Serial.println(sensorReady ? F("[BH1750] OK") : F("[BH1750] FAILED"));
 }
 
-void sendLuxReading() {
-  LuxPacket pkt;
+// Read lux + PIR into the pending frame
+void takeReading() {
   float lux = NAN;
 
   if (sensorReady) lux = lightMeter.readLightLevel();
 
   if (!sensorReady || isnan(lux) || lux < 0.0f || lux > 120000.0f) {
     Serial.printf("[BH1750] Read error (lux=%.2f)\n", lux);
-    pkt.lux = -1.0f;
-  } else {
-    pkt.lux = lux;
+    lux = -1.0f;  // sent as "no reading"
   }
 
-  // Read raw PIR and update latched occupancy
-  bool motionRaw = digitalRead(PIR_PIN);
-  updateOccupancyFromPir(motionRaw);
-
-  // Send "presence" (latched), not raw motion (reduces false negatives)
-  pkt.motion = (uint8_t)(g_occupied ? 1 : 0);
-
-  g_lastLux = pkt.lux;
+  g_lastLux = lux;
 
   Serial.printf("[PIR] raw=%s occupied=%s\n",
-    motionRaw ? "HIGH" : "LOW",
+    g_lastMotion ? "HIGH" : "LOW",
     g_occupied ? "YES" : "NO"
   );
 
+  if (g_pendingCount == SAMPLES_PER_FRAME) {
+    // last frame never went out: drop the oldest reading
+    memmove(g_pending, g_pending + 1, sizeof(g_pending[0]) * (SAMPLES_PER_FRAME - 1));
+    memmove(g_pendingMs, g_pendingMs + 1, sizeof(g_pendingMs[0]) * (SAMPLES_PER_FRAME - 1));
+    g_pendingCount--;
+  }
+  LuxWire::Sample& smp = g_pending[g_pendingCount];
+  smp.lux = lux;
+  // Send "presence" (latched), not raw motion (reduces false negatives)
+  smp.motion = (uint8_t)(LuxWire::M_VALID | (g_occupied ? LuxWire::M_MOTION : 0));
+  smp.ageMs = 0;
+  g_pendingMs[g_pendingCount] = nodeMs();
+  g_pendingCount++;
+}
+
+// Send the pending readings as one v2 frame
+bool sendFrame() {
+  if (!g_pendingCount) return false;
   if (!espnowReady) {
     Serial.println(F("[ESP-NOW] Not ready"));
-    return;
+    return false;
+  }
+  if (g_scan.scanning()) return false;  // readings stay pending until the lamp is found
+
+  LuxWire::Frame f;
+  f.type = LuxWire::T_SAMPLES;
+  f.flags = (uint8_t)((FRAME_CRC ? LuxWire::F_CRC : 0) | (LOW_POWER ? LuxWire::F_LOW_POWER : 0) |
+                      (CHANNEL_DISCOVERY ? LuxWire::F_ACK_REQ : 0));
+  f.nodeId = g_nodeId;
+  f.seq = g_seq;
+  f.legacy = false;
+  f.count = g_pendingCount;
+  uint32_t now = nodeMs();
+  for (uint8_t i = 0; i < g_pendingCount; ++i) {
+    uint32_t age = now - g_pendingMs[i];
+    f.samples[i] = g_pending[i];
+    f.samples[i].ageMs = (uint16_t)(age > 0xFFFF ? 0xFFFF : age);
   }
-  int rc = esp_now_send((uint8_t*)BROADCAST_MAC, (uint8_t*)&pkt, sizeof(pkt));
+
+  uint8_t buf[LuxWire::kMaxFrame];
+  size_t len = LuxWire::encode(f, buf, sizeof(buf));
+  const LuxWire::Sample& last = f.samples[f.count - 1];
+  unsigned presence = (last.motion & LuxWire::M_MOTION) ? 1 : 0;
+  int rc = esp_now_send((uint8_t*)BROADCAST_MAC, buf, len);
   if (rc == 0) {
-    Serial.printf("[SEND] lux=%.2f presence=%u -> queued OK (ch=%u)\n", pkt.lux, pkt.motion, currentChannel);
-  } else {
-    Serial.printf("[SEND] lux=%.2f presence=%u -> queue FAIL (rc=%d)\n", pkt.lux, pkt.motion, rc);
-    consecutiveSendFails++;
+    g_seq++;
+    g_framesSent++;
+    g_pendingCount = 0;
+    g_power.addFrame(len);
+    if (CHANNEL_DISCOVERY) g_scan.onSent(nodeMs());
+    Serial.printf("[SEND] seq=%u n=%u lux=%.2f presence=%u -> queued OK (ch=%u)\n", f.seq, f.count, last.lux, presence, currentChannel);
+    return true;
   }
+  Serial.printf("[SEND] seq=%u n=%u lux=%.2f presence=%u -> queue FAIL (rc=%d)\n", f.seq, f.count, last.lux, presence, rc);
+  consecutiveSendFails++;
+  return false;
+}
+
+// Low-power mode: AP and web server off, STA only (ESP-NOW keeps working)
+void closeSetupWindow() {
+  Serial.println(F("[AP] Setup window over: AP off, low-power mode (power-cycle to reconfigure)"));
+  server.stop();
+  WiFi.softAPdisconnect(true);
+  WiFi.mode(WIFI_STA);
+  g_setupOpen = false;
+  reinitEspNow("setup window closed");
+}
+
+static void onWake() { g_woke = true; }
+
+// Forced light sleep, woken by the timer or a rising PIR output; radio and
+// CPU clock are off meanwhile
+void lightSleep(uint32_t ms) {
+  if (ms < 10) { delay(ms); return; }
+  Serial.flush();
+  uint32_t cal = system_rtc_clock_cali_proc();  // us per RTC tick, Q12
+  uint32_t rtc0 = system_get_rtc_time();
+  uint32_t ms0 = millis();
+
+  wifi_set_opmode_current(NULL_MODE);
+  wifi_fpm_set_sleep_type(LIGHT_SLEEP_T);
+  wifi_fpm_open();
+  if (!digitalRead(PIR_PIN)) gpio_pin_wakeup_enable(GPIO_ID_PIN(PIR_PIN), GPIO_PIN_INTR_HILEVEL);
+  wifi_fpm_set_wakeup_cb(onWake);
+  g_woke = false;
+  wifi_fpm_do_sleep(ms * 1000);
+  // Sleep starts once the CPU idles in delay(); leave as soon as we are woken
+  for (uint32_t t0 = millis(); !g_woke && millis() - t0 <= ms; ) delay(1);
+  gpio_pin_wakeup_disable();
+  wifi_fpm_close();
+  wifi_set_opmode_current(STATION_MODE);
+  wifi_set_channel(currentChannel);
+
+  uint32_t slept = (uint32_t)(((uint64_t)(system_get_rtc_time() - rtc0) * cal >> 12) / 1000);
+  uint32_t counted = millis() - ms0;
+  if (slept > counted) g_sleptMs += slept - counted;
+  g_power.addSleep(slept);
+  g_meterMs += slept;  // not awake time
+
+  // The wake-up config replaced the edge interrupt; restore it and resync the level
+  attachInterrupt(digitalPinToInterrupt(PIR_PIN), onPirEdge, CHANGE);
+  noInterrupts();
+  g_pirLevel = digitalRead(PIR_PIN);
+  g_pirEdgeMs = nodeMs();
+  g_pirEvent = true;
+  interrupts();
+}
+
+static void logPower() {
+  Serial.printf("[PWR] frames=%lu airtime=%lu us (%lu ppm) sleep=%lu%% avg=%lu uA -> ~%lu h on %u mAh (last send: %s)\n",
+    (unsigned long)g_power.frames(), (unsigned long)g_power.airtimeUs(), (unsigned long)g_power.airtimePpm(),
+    (unsigned long)(g_power.sleepPermille() / 10), (unsigned long)g_power.avgUa(),
+    (unsigned long)g_power.batteryHours(BATTERY_MAH), (unsigned)BATTERY_MAH,
+    SendPolicy::reasonName(g_lastReason));
 }
 
 void loadConfig() {
@@ -454,10 +763,15 @@ void setup() {
   Serial.println(F("[BOOT] ESP8266 Lux Node + Web UI"));
 
   loadConfig();
+  g_scan.begin(currentChannel, 0);
+  g_nodeId = (uint16_t)ESP.getChipId();
+  g_seq = (uint16_t)ESP.random();  // so a reboot does not look like a replay to the lamp
 
   // Using INPUT is usually OK for AM312, but if your OUT line ever floats,
   // INPUT_PULLUP can help. If you try it, note that it inverts the idle level.
   pinMode(PIR_PIN, INPUT);
+  attachInterrupt(digitalPinToInterrupt(PIR_PIN), onPirEdge, CHANGE);
+  onPirEdge();  // initial level
 
   WiFi.persistent(false);
   WiFi.mode(WIFI_AP_STA);
@@ -470,29 +784,68 @@ void setup() {
   setupEspNow();
 
   lastSendMs = millis();
+  lastSampleMs = lastSendMs;
+  g_meterMs = lastSendMs;
 }
 
 void loop() {
-  server.handleClient();
+  uint32_t now = nodeMs();
+  g_power.addAwake(now - g_meterMs);
+  g_meterMs = now;
+
+  static uint32_t lastPowerLog = 0;
+  if (now - lastPowerLog >= POWER_LOG_MS) {
+    lastPowerLog = now;
+    logPower();
+  }
 
-  // Optional: update occupancy more frequently than send interval,
-  // so occupancy latches immediately when motion happens.
-  static uint32_t lastPirPoll = 0;
-  uint32_t now = millis();
-  if (now - lastPirPoll >= 50) { // 20Hz poll
-    lastPirPoll = now;
-    bool motionRaw = digitalRead(PIR_PIN);
-    updateOccupancyFromPir(motionRaw);
+  if (!espnowReady || consecutiveSendFails >= MAX_SEND_FAILS) {
+    reinitEspNow(!espnowReady ? "not ready" : "send fails");
   }
 
-  if (now - lastSendMs >= SEND_INTERVAL_MS) {
-    lastSendMs = now;
-    sendLuxReading();
+  if (updateOccupancyFromPir(now)) sendOccupancyNow(now);
+#if CHANNEL_DISCOVERY
+  serviceDiscovery(now);
+#endif
+
+#if LOW_POWER
+  if (g_setupOpen) {
+    server.handleClient();
+    if (now >= SETUP_WINDOW_MS && WiFi.softAPgetStationNum() == 0) closeSetupWindow();
   }
 
-  if (!espnowReady || consecutiveSendFails >= MAX_SEND_FAILS) {
-    reinitEspNow(!espnowReady ? "not ready" : "send fails");
+  // Sample, send only if something changed (or the heartbeat is due)
+  if (now - lastSampleMs >= LP_SAMPLE_MS) {
+    lastSampleMs = now;
+    takeReading();
+    uint8_t reason = g_policy.check(g_lastLux, g_occupied, now);
+    if (reason != SendPolicy::R_NONE && sendFrame()) {
+      g_lastReason = reason;
+      g_policy.sent(g_lastLux, g_occupied, now);
+    }
+  }
+
+  if (g_setupOpen) {
+    delay(2);
+  } else if (g_occ.pending() || g_scan.awaiting()) {
+    delay(1);  // confirm the PIR rise / wait for the lamp's ACK before sleeping again
+  } else {
+    uint32_t next = lastSampleMs + LP_SAMPLE_MS;
+    uint32_t t = nodeMs();
+    lightSleep((int32_t)(next - t) > 0 ? next - t : 0);
+  }
+#else
+  server.handleClient();
+
+  if (now - lastSampleMs >= SEND_INTERVAL_MS / SAMPLES_PER_FRAME) {
+    lastSampleMs = now;
+    takeReading();
+  }
+  if (now - lastSendMs >= SEND_INTERVAL_MS) {
+    lastSendMs = now;
+    if (sendFrame()) g_lastReason = SendPolicy::R_HEARTBEAT;
   }
 
   delay(2);
-}
\ No newline at end of file
+#endif
+}
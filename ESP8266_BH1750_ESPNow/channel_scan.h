@@ -0,0 +1,159 @@
+#pragma once
+// ESP-NOW channel discovery for the lux node (no Arduino deps, driven by any ms clock).
+// Locked on a channel, data frames ask the lamp for an ACK. A missing ACK
+// is retried once with a probe on the same channel; the next miss starts a
+// scan: probe each channel (the last good one first, then the usual router
+// channels 1/6/11, then the rest) and wait probeWaitMs for an ACK. The
+// first ACK or lamp beacon locks the node on that channel. A scan that
+// finds nothing returns to the home channel and backs off before trying
+// again, so an old lamp firmware without ACKs costs little.
+
+#include <stdint.h>
+
+namespace ChannelScan {
+
+enum Action : uint8_t {
+  A_NONE = 0,
+  A_PROBE,    // tune to channel() and send a probe
+  A_LOCKED,   // lamp found on channel(); persist it if it changed
+  A_GAVE_UP,  // nothing answered; back on channel() (home)
+};
+
+struct Config {
+  uint8_t chMin;
+  uint8_t chMax;
+  uint32_t probeWaitMs;   // ACK timeout per frame / probe
+  uint32_t backoffMinMs;  // after a failed scan, doubling...
+  uint32_t backoffMaxMs;  // ...up to this
+};
+
+struct Stats {
+  uint32_t acks;
+  uint32_t misses;
+  uint32_t scans;
+  uint32_t failedScans;
+  uint32_t probes;
+  uint32_t lastScanMs;  // duration of the last scan that locked
+};
+
+class Scanner {
+ public:
+  explicit Scanner(const Config& c) : cfg_(c) {}
+
+  void begin(uint8_t home, uint32_t nowMs) {
+    home_ = ch_ = clampCh(home);
+    scanning_ = awaiting_ = retry_ = false;
+    backoffMs_ = 0;
+    nextScanMs_ = nowMs;
+  }
+
+  // Radio should be on this channel
+  uint8_t channel() const { return ch_; }
+  bool scanning() const { return scanning_; }
+  // An ACK is due shortly (keep the radio awake)
+  bool awaiting() const { return awaiting_ || scanning_; }
+  const Stats& stats() const { return st_; }
+
+  // A data frame with F_ACK_REQ went out on channel()
+  void onSent(uint32_t nowMs) {
+    if (scanning_) return;
+    awaiting_ = true;
+    sentMs_ = nowMs;
+  }
+
+  // ACK or beacon from the lamp, heard while tuned to channel()
+  Action onLamp(uint8_t lampCh, uint32_t nowMs) {
+    st_.acks++;
+    awaiting_ = retry_ = false;
+    backoffMs_ = 0;
+    if (lampCh < cfg_.chMin || lampCh > cfg_.chMax) lampCh = ch_;
+    bool wasScanning = scanning_;
+    scanning_ = false;
+    if (wasScanning) st_.lastScanMs = nowMs - scanStartMs_;
+    if (wasScanning || lampCh != home_) {
+      home_ = ch_ = lampCh;
+      return A_LOCKED;
+    }
+    return A_NONE;
+  }
+
+  Action poll(uint32_t nowMs) {
+    if (scanning_) {
+      if (nowMs - probeMs_ < cfg_.probeWaitMs) return A_NONE;
+      if (++idx_ >= count_) {
+        scanning_ = false;
+        st_.failedScans++;
+        backoffMs_ = backoffMs_ ? backoffMs_ * 2 : cfg_.backoffMinMs;
+        if (backoffMs_ > cfg_.backoffMaxMs) backoffMs_ = cfg_.backoffMaxMs;
+        nextScanMs_ = nowMs + backoffMs_;
+        ch_ = home_;
+        return A_GAVE_UP;
+      }
+      return probe(order_[idx_], nowMs);
+    }
+    if (!awaiting_ || nowMs - sentMs_ < cfg_.probeWaitMs) return A_NONE;
+    awaiting_ = false;
+    st_.misses++;
+    if (!retry_) {
+      retry_ = true;  // one lost frame is not a channel change
+      awaiting_ = true;
+      sentMs_ = nowMs;
+      return probe(ch_, nowMs);
+    }
+    retry_ = false;
+    if ((int32_t)(nowMs - nextScanMs_) < 0) return A_NONE;  // backing off
+    startScan(nowMs);
+    return probe(order_[0], nowMs);
+  }
+
+ private:
+  Config cfg_;
+  Stats st_ = {};
+  uint8_t home_ = 1;
+  uint8_t ch_ = 1;
+  bool scanning_ = false;
+  bool awaiting_ = false;
+  bool retry_ = false;
+  uint32_t sentMs_ = 0;
+  uint32_t probeMs_ = 0;
+  uint32_t scanStartMs_ = 0;
+  uint32_t backoffMs_ = 0;
+  uint32_t nextScanMs_ = 0;
+  uint8_t order_[14];
+  uint8_t count_ = 0;
+  uint8_t idx_ = 0;
+
+  uint8_t clampCh(uint8_t c) const {
+    return c < cfg_.chMin ? cfg_.chMin : c > cfg_.chMax ? cfg_.chMax : c;
+  }
+
+  bool listed(uint8_t c) const {
+    for (uint8_t i = 0; i < count_; ++i) if (order_[i] == c) return true;
+    return false;
+  }
+
+  void add(uint8_t c) {
+    if (c >= cfg_.chMin && c <= cfg_.chMax && count_ < sizeof(order_) && !listed(c)) order_[count_++] = c;
+  }
+
+  void startScan(uint32_t nowMs) {
+    count_ = idx_ = 0;
+    add(home_);
+    add(1);
+    add(6);
+    add(11);
+    for (uint8_t c = cfg_.chMin; c <= cfg_.chMax; ++c) add(c);
+    scanning_ = true;
+    scanStartMs_ = nowMs;
+    st_.scans++;
+  }
+
+  Action probe(uint8_t c, uint32_t nowMs) {
+    ch_ = c;
+    probeMs_ = nowMs;
+    st_.probes++;
+    return A_PROBE;
+  }
+};
+
+}
@@ -0,0 +1,248 @@
+#pragma once
+// Lux node <-> lamp ESP-NOW wire format (no Arduino deps).
+// Keep the copies in SleepLamp_ESP32/ and ESP8266_BH1750_ESPNow/ identical.
+//
+// v2 frame, little-endian, byte-packed (no struct layout on the wire):
+//   0  u16 magic 'V','L'      6  u16 node id
+//   2  u8  version (2)        8  u16 sequence number (per node, wraps)
+//   3  u8  type               10 count x sample (6 bytes each)
+//   4  u8  flags              .. u16 CRC-16/CCITT-FALSE of all bytes before it (if F_CRC)
+//   5  u8  sample count
+// sample: u24 lux * 100 (0xFFFFFF = no reading), u8 motion flags, u16 age ms
+// (how long before the frame was sent the sample was taken). Samples go
+// oldest first, so the last one in a frame is the newest reading.
+//
+// Channel discovery frames have count 0 and a 2-byte body (u8 channel,
+// u8 reserved) in place of the samples:
+//   BEACON  lamp -> all   node id 0, own counter, lamp's current channel
+//   PROBE   node -> all   node id, node's frame seq, channel being probed
+//   ACK     lamp -> all   node id + seq being acked (PROBE or F_ACK_REQ frame), lamp channel
+//
+// Legacy payloads are still decoded: the raw 8-byte {float lux; uint8_t motion}
+// struct, a bare 4-byte float and short ASCII numbers.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifndef LUXW_MAX_SAMPLES
+#define LUXW_MAX_SAMPLES 16
+#endif
+
+namespace LuxWire {
+
+static const uint8_t kMagic0 = 'V';
+static const uint8_t kMagic1 = 'L';
+static const uint8_t kVersion = 2;
+static const size_t kHeaderLen = 10;
+static const size_t kSampleLen = 6;
+static const size_t kCrcLen = 2;
+static const size_t kControlLen = 2;
+static const size_t kMaxFrame = 250;  // ESP-NOW payload limit
+static const uint32_t kNoLux = 0xFFFFFF;
+
+static_assert(kHeaderLen + LUXW_MAX_SAMPLES * kSampleLen + kCrcLen <= kMaxFrame, "frame exceeds ESP-NOW payload");
+
+enum Type : uint8_t { T_SAMPLES = 1, T_BEACON = 2, T_PROBE = 3, T_ACK = 4 };
+enum Flags : uint8_t {
+  F_CRC = 1 << 0,
+  F_LOW_POWER = 1 << 1,  // sender only sends on change + slow heartbeat (expect long gaps)
+  F_ACK_REQ = 1 << 2,    // sender wants an ACK (it checks it is still on the lamp's channel)
+};
+enum MotionBits : uint8_t {
+  M_MOTION = 1 << 0,  // occupied
+  M_VALID = 1 << 1,   // node has a motion sensor (else ignore M_MOTION)
+};
+
+struct Sample {
+  float lux;       // < 0 = no reading
+  uint8_t motion;  // MotionBits
+  uint16_t ageMs;
+};
+
+struct Frame {
+  uint8_t type;
+  uint8_t flags;
+  uint16_t nodeId;
+  uint16_t seq;
+  bool legacy;  // decoded from an old format: no node id / sequence
+  uint8_t channel;  // control frames only
+  uint8_t count;
+  Sample samples[LUXW_MAX_SAMPLES];
+};
+
+enum Status : int8_t {
+  OK = 0,
+  E_SHORT = -1,
+  E_MAGIC = -2,
+  E_VERSION = -3,
+  E_TYPE = -4,
+  E_COUNT = -5,
+  E_CRC = -6,
+  E_LEGACY = -7,  // not v2 and not a recognizable legacy payload
+};
+
+inline uint16_t crc16(const uint8_t* p, size_t n) {
+  uint16_t c = 0xFFFF;
+  while (n--) {
+    c ^= (uint16_t)(*p++) << 8;
+    for (int k = 0; k < 8; ++k) c = (c & 0x8000) ? (uint16_t)((c << 1) ^ 0x1021) : (uint16_t)(c << 1);
+  }
+  return c;
+}
+
+inline void put16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+inline uint16_t get16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+inline uint32_t luxToCenti(float lux) {
+  if (!(lux >= 0.0f)) return kNoLux;  // also NaN
+  float c = lux * 100.0f + 0.5f;
+  return c >= (float)(kNoLux - 1) ? kNoLux - 1 : (uint32_t)c;
+}
+
+inline bool isControl(uint8_t type) { return type == T_BEACON || type == T_PROBE || type == T_ACK; }
+
+inline size_t frameLen(uint8_t type, uint8_t count, bool crc) {
+  size_t body = isControl(type) ? kControlLen : (size_t)count * kSampleLen;
+  return kHeaderLen + body + (crc ? kCrcLen : 0);
+}
+
+// Encode a frame; returns bytes written (0 = does not fit / bad type or count)
+inline size_t encode(const Frame& f, uint8_t* buf, size_t cap) {
+  bool crc = (f.flags & F_CRC) != 0;
+  bool control = isControl(f.type);
+  if (!control && (f.type != T_SAMPLES || f.count == 0 || f.count > LUXW_MAX_SAMPLES)) return 0;
+  uint8_t count = control ? 0 : f.count;
+  size_t len = frameLen(f.type, count, crc);
+  if (len > cap) return 0;
+
+  buf[0] = kMagic0;
+  buf[1] = kMagic1;
+  buf[2] = kVersion;
+  buf[3] = f.type;
+  buf[4] = f.flags;
+  buf[5] = count;
+  put16(buf + 6, f.nodeId);
+  put16(buf + 8, f.seq);
+  uint8_t* p = buf + kHeaderLen;
+  if (control) {
+    p[0] = f.channel;
+    p[1] = 0;
+    p += kControlLen;
+  }
+  for (uint8_t i = 0; i < count; ++i, p += kSampleLen) {
+    uint32_t c = luxToCenti(f.samples[i].lux);
+    p[0] = (uint8_t)c;
+    p[1] = (uint8_t)(c >> 8);
+    p[2] = (uint8_t)(c >> 16);
+    p[3] = f.samples[i].motion;
+    put16(p + 4, f.samples[i].ageMs);
+  }
+  if (crc) put16(p, crc16(buf, (size_t)(p - buf)));
+  return len;
+}
+
+inline bool isV2(const uint8_t* buf, size_t len) {
+  return len >= 2 && buf[0] == kMagic0 && buf[1] == kMagic1;
+}
+
+inline Status decodeV2(const uint8_t* buf, size_t len, Frame& f) {
+  if (len < kHeaderLen) return E_SHORT;
+  if (!isV2(buf, len)) return E_MAGIC;
+  if (buf[2] != kVersion) return E_VERSION;
+  f.type = buf[3];
+  f.flags = buf[4];
+  f.count = buf[5];
+  f.nodeId = get16(buf + 6);
+  f.seq = get16(buf + 8);
+  f.legacy = false;
+  f.channel = 0;
+  bool control = isControl(f.type);
+  if (!control && f.type != T_SAMPLES) return E_TYPE;
+  if (control ? f.count != 0 : (f.count == 0 || f.count > LUXW_MAX_SAMPLES)) return E_COUNT;
+  bool crc = (f.flags & F_CRC) != 0;
+  size_t need = frameLen(f.type, f.count, crc);
+  if (len < need) return E_SHORT;
+  if (crc && get16(buf + need - kCrcLen) != crc16(buf, need - kCrcLen)) return E_CRC;
+
+  const uint8_t* p = buf + kHeaderLen;
+  if (control) {
+    f.channel = p[0];
+    return OK;
+  }
+  for (uint8_t i = 0; i < f.count; ++i, p += kSampleLen) {
+    uint32_t c = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+    f.samples[i].lux = c == kNoLux ? -1.0f : (float)c / 100.0f;
+    f.samples[i].motion = p[3];
+    f.samples[i].ageMs = get16(p + 4);
+  }
+  return OK;
+}
+
+// Old node firmware: raw struct / bare float / ASCII number
+inline Status decodeLegacy(const uint8_t* buf, size_t len, Frame& f) {
+  memset(&f, 0, sizeof(f));
+  f.type = T_SAMPLES;
+  f.legacy = true;
+  f.count = 1;
+  Sample& s = f.samples[0];
+  if (len == 8) {
+    memcpy(&s.lux, buf, 4);  // both ends are little-endian IEEE754
+    s.motion = (uint8_t)(M_VALID | (buf[4] ? M_MOTION : 0));
+    return OK;
+  }
+  if (len == 4) {
+    memcpy(&s.lux, buf, 4);
+    return OK;
+  }
+  char tmp[16];
+  if (len == 0 || len >= sizeof(tmp)) return E_LEGACY;
+  for (size_t i = 0; i < len; ++i) {
+    char ch = (char)buf[i];
+    if (!((ch >= '0' && ch <= '9') || ch == '.' || ch == '-' || ch == '+' || ch == '\0')) return E_LEGACY;
+    tmp[i] = ch;
+  }
+  tmp[len] = '\0';
+  char* end;
+  s.lux = strtof(tmp, &end);
+  return end != tmp ? OK : E_LEGACY;
+}
+
+// Any supported payload
+inline Status decode(const uint8_t* buf, size_t len, Frame& f) {
+  if (isV2(buf, len)) return decodeV2(buf, len, f);
+  return decodeLegacy(buf, len, f);
+}
+
+// Sequence tracking for one sender: counts loss, duplicates and reordering
+struct SeqTracker {
+  bool have = false;
+  uint16_t last = 0;
+  uint32_t frames = 0;     // accepted
+  uint32_t lost = 0;       // gaps
+  uint32_t dups = 0;
+  uint32_t reordered = 0;  // late frames (dropped)
+  uint32_t resyncs = 0;    // big jumps, e.g. a node reboot
+
+  // false = duplicate or stale frame; caller drops it
+  bool accept(uint16_t seq) {
+    if (!have) { have = true; last = seq; frames++; return true; }
+    int16_t d = (int16_t)(uint16_t)(seq - last);
+    if (d == 0) { dups++; return false; }
+    if (d < 0 && d > -64) { reordered++; return false; }
+    if (d < 0 || d > 1024) { resyncs++; }
+    else lost += (uint32_t)(d - 1);
+    last = seq;
+    frames++;
+    return true;
+  }
+
+  // Lost frames per thousand sent (0 until the first gap)
+  uint32_t lossPermille() const {
+    uint32_t sent = frames + lost;
+    return sent ? (uint32_t)((uint64_t)lost * 1000u / sent) : 0;
+  }
+};
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+// Latched PIR occupancy (no Arduino deps, driven by any ms clock).
+// Fed with raw PIR levels (edges from the ISR, or polls) and ticked from
+// loop(). A rising level only counts as motion once it has stayed high for
+// the debounce time, so radio-induced glitches are ignored. Occupancy then
+// holds until holdMs after the PIR output last went low; new motion while
+// occupied (a retrigger) simply extends it.
+
+#include <stdint.h>
+
+class Occupancy {
+ public:
+  Occupancy(uint32_t holdMs, uint32_t debounceMs) : holdMs_(holdMs), debounceMs_(debounceMs) {}
+
+  // Raw PIR level at nowMs; returns true if occupied() changed
+  bool input(bool level, uint32_t nowMs) {
+    if (level && !level_) {
+      level_ = true;
+      pending_ = true;
+      riseMs_ = nowMs;
+    } else if (!level && level_) {
+      level_ = false;
+      if (pending_) {
+        pending_ = false;  // high for less than the debounce time
+        glitches_++;
+      } else if (active_) {
+        active_ = false;
+        lastMotionMs_ = nowMs;
+      }
+    }
+    return tick(nowMs);
+  }
+
+  // Confirms debounced rises and expires the hold; returns true if occupied() changed
+  bool tick(uint32_t nowMs) {
+    if (pending_ && nowMs - riseMs_ >= debounceMs_) {
+      pending_ = false;
+      active_ = true;
+      if (occupied_) retriggers_++;
+    }
+    if (active_) {
+      lastMotionMs_ = nowMs;
+      seen_ = true;
+    }
+    bool occ = active_ || (seen_ && nowMs - lastMotionMs_ < holdMs_);
+    if (occ == occupied_) return false;
+    occupied_ = occ;
+    return true;
+  }
+
+  bool occupied() const { return occupied_; }
+  bool level() const { return level_; }
+  // A rise is waiting for its debounce time (keep ticking, do not sleep)
+  bool pending() const { return pending_; }
+  uint32_t glitches() const { return glitches_; }
+  uint32_t retriggers() const { return retriggers_; }
+
+ private:
+  uint32_t holdMs_;
+  uint32_t debounceMs_;
+  bool level_ = false;
+  bool pending_ = false;
+  bool active_ = false;  // debounced high
+  bool seen_ = false;
+  bool occupied_ = false;
+  uint32_t riseMs_ = 0;
+  uint32_t lastMotionMs_ = 0;
+  uint32_t glitches_ = 0;
+  uint32_t retriggers_ = 0;
+};
@@ -0,0 +1,134 @@
+#pragma once
+// Send-on-change policy and power/airtime estimate for the lux node (no Arduino deps).
+// A frame goes out when lux leaves a relative deadband around the last sent
+// value, when occupancy flips, or when the heartbeat runs out (shorter while
+// occupied so the lamp's presence lease keeps getting refreshed).
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace SendPolicy {
+
+enum Reason : uint8_t { R_NONE = 0, R_FIRST, R_LUX, R_OCCUPANCY, R_HEARTBEAT };
+
+inline const char* reasonName(uint8_t r) {
+  switch (r) {
+    case R_FIRST: return "first";
+    case R_LUX: return "lux";
+    case R_OCCUPANCY: return "occupancy";
+    case R_HEARTBEAT: return "heartbeat";
+    default: return "none";
+  }
+}
+
+struct Config {
+  float deadbandPct;        // relative change that triggers a send (0.10 = 10 %)
+  float deadbandMinLux;     // absolute floor, so noise near 0 lux does not trigger
+  uint32_t heartbeatMs;     // max silence while the room is clear
+  uint32_t heartbeatOccMs;  // max silence while occupied
+};
+
+class Policy {
+ public:
+  explicit Policy(const Config& c) : cfg_(c) {}
+
+  // Should the reading just taken be sent now? lux < 0 = no reading
+  Reason check(float lux, bool occupied, uint32_t nowMs) const {
+    if (!have_) return R_FIRST;
+    if (occupied != sentOcc_) return R_OCCUPANCY;
+    if ((lux < 0.0f) != (sentLux_ < 0.0f)) return R_LUX;
+    if (lux >= 0.0f) {
+      float band = sentLux_ * cfg_.deadbandPct;
+      if (band < cfg_.deadbandMinLux) band = cfg_.deadbandMinLux;
+      float d = lux - sentLux_;
+      if (d > band || d < -band) return R_LUX;
+    }
+    uint32_t hb = occupied ? cfg_.heartbeatOccMs : cfg_.heartbeatMs;
+    if (nowMs - sentMs_ >= hb) return R_HEARTBEAT;
+    return R_NONE;
+  }
+
+  void sent(float lux, bool occupied, uint32_t nowMs) {
+    have_ = true;
+    sentLux_ = lux;
+    sentOcc_ = occupied;
+    sentMs_ = nowMs;
+  }
+
+  const Config& config() const { return cfg_; }
+
+ private:
+  Config cfg_;
+  bool have_ = false;
+  float sentLux_ = 0.0f;
+  bool sentOcc_ = false;
+  uint32_t sentMs_ = 0;
+};
+
+// ESP-NOW vendor action frame around the payload: MAC header 24, category 1,
+// OUI 3, random 4, vendor IE 7, FCS 4
+static const uint32_t kFrameOverhead = 43;
+// 802.11b 1 Mbps, long preamble: 192 us PLCP + 8 us per byte; broadcast has no ACK
+inline uint32_t airtimeUs(size_t payload) {
+  return 192u + (uint32_t)(kFrameOverhead + payload) * 8u;
+}
+
+// Supply currents in uA (ESP8266EX datasheet ballpark; override per board)
+struct Currents {
+  uint32_t awakeUa;  // CPU + radio listening (AP up / STA not sleeping)
+  uint32_t sleepUa;  // light/modem sleep between samples
+  uint32_t txUa;     // transmitting
+};
+
+// Time spent per state, as measured by the sketch, turned into an average current
+class PowerMeter {
+ public:
+  explicit PowerMeter(const Currents& c) : cur_(c) {}
+
+  void addAwake(uint32_t ms) { awakeMs_ += ms; }
+  void addSleep(uint32_t ms) { sleepMs_ += ms; }
+  void addFrame(size_t payload) {
+    frames_++;
+    airUs_ += SendPolicy::airtimeUs(payload);
+  }
+
+  uint32_t frames() const { return frames_; }
+  uint64_t airtimeUs() const { return airUs_; }
+  uint64_t totalMs() const { return awakeMs_ + sleepMs_; }
+
+  // Share of time on air, in parts per million
+  uint32_t airtimePpm() const {
+    uint64_t t = totalMs();
+    return t ? (uint32_t)(airUs_ * 1000u / t) : 0;
+  }
+
+  // Share of time spent asleep, in permille
+  uint32_t sleepPermille() const {
+    uint64_t t = totalMs();
+    return t ? (uint32_t)(sleepMs_ * 1000u / t) : 0;
+  }
+
+  uint32_t avgUa() const {
+    uint64_t t = totalMs();
+    if (!t) return cur_.awakeUa;
+    uint64_t awakeUs = awakeMs_ * 1000u;
+    awakeUs = awakeUs > airUs_ ? awakeUs - airUs_ : 0;
+    uint64_t uaUs = awakeUs * cur_.awakeUa + sleepMs_ * 1000u * cur_.sleepUa + airUs_ * cur_.txUa;
+    return (uint32_t)(uaUs / (t * 1000u));
+  }
+
+  // Runtime on a battery of the given capacity at the average current so far
+  uint32_t batteryHours(uint32_t mAh) const {
+    uint32_t ua = avgUa();
+    return ua ? (uint32_t)((uint64_t)mAh * 1000u / ua) : 0;
+  }
+
+ private:
+  Currents cur_;
+  uint64_t awakeMs_ = 0;
+  uint64_t sleepMs_ = 0;
+  uint64_t airUs_ = 0;
+  uint32_t frames_ = 0;
+};
+
+}
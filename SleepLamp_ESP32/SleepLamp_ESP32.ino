@@ -10,9 +10,15 @@
 // better than shoving everything into this main ino, innit?
 #include "fs_select.h"
 #include "wifi_manager.h"
+#include "wifi_sm.h"
+#include "spsc_ring.h"
 #include "config.h"
 #include "mimir_tuning.h"
+#include "persist.h"
 #include "led_control.h"
+#include "lux_input.h"
+#include "render_task.h"
+#include "metrics.h"
 #include "web_server.h"
 
 /// Globals
@@ -34,22 +40,19 @@ volatile bool g_presenceEnabled = false;
 volatile bool g_buttonPressed = false;
 volatile uint32_t g_lastButtonISR = 0;
 
-// Default preferences for amimir mode
-#ifndef PREF_KEY_MIMIR_MIN
-#define PREF_KEY_MIMIR_MIN "mimir_min"
-#endif
-#ifndef PREF_KEY_MIMIR_MAX
-#define PREF_KEY_MIMIR_MAX "mimir_max"
-#endif
-
 // Forward declarations for web_server.h to call
 void wifiStartAP();
 bool wifiStartSTA(const String& ssid, const String& pass);
 String wifiModeString();
+const char* wifiModeName();
 void reinitEspNow();
+void savePreferenceWiFiMode(const String& mode);
+void savePreferenceSTA(const String& ssid, const String& pass);
 void savePreferenceMimirRange(uint8_t minB, uint8_t maxB);
+void savePreferenceMimirCurve(const MimirCurve::Point* pts, uint8_t n);
 void savePreferencePresence(bool p);
 int getStaChannel();
+uint8_t espNowChannel();
 
 // ISR
 void IRAM_ATTR isrButton() {
@@ -61,44 +64,25 @@ void IRAM_ATTR isrButton() {
 }
 
 /// ESPNOW
-struct LuxPacket { float lux; uint8_t motion; };
-
+// Wi-Fi task: hand the payload to LuxInput (decode + enqueue, drained by the render task)
 #if (ESP_IDF_VERSION_MAJOR >= 5)
 void onEspNowRecv(const esp_now_recv_info_t* info, const uint8_t* incomingData, int len) {
+  Metrics::Timer timer(Metrics::H_ESPNOW);
+  Metrics::count(Metrics::C_ESPNOW_BYTES, len > 0 ? len : 0);
+  int8_t rssi = info->rx_ctrl ? (int8_t)info->rx_ctrl->rssi : 0;
+  LuxInput::onReceive(info->src_addr, rssi, incomingData, len);
+}
 #else
 void onEspNowRecv(const uint8_t* mac, const uint8_t* incomingData, int len) {
-#endif
-  float luxValue = 0.0f;
-  if (len >= (int)sizeof(LuxPacket)) {
-    LuxPacket pkt;
-    memcpy(&pkt, incomingData, sizeof(LuxPacket));
-    luxValue = pkt.lux;
-    g_lastMotion = (bool)pkt.motion;
-  } else if (len == (int)sizeof(float)) {
-    memcpy((void*)&luxValue, incomingData, sizeof(float));
-  } else {
-    char buf[32];
-    int n = min(len, (int)sizeof(buf) - 1);
-    memcpy(buf, incomingData, n);
-    buf[n] = '\0';
-    luxValue = atof(buf);
-  }
-  g_lastLux = luxValue;
-  g_lastLuxMillis = millis();
-  LedControl::updateLux(luxValue);
+  Metrics::Timer timer(Metrics::H_ESPNOW);
+  Metrics::count(Metrics::C_ESPNOW_BYTES, len > 0 ? len : 0);
+  LuxInput::onReceive(mac, 0, incomingData, len);
 }
+#endif
 
 void reinitEspNow() {
   esp_now_deinit();
 
-  if (g_wifiMode == WIFI_MODE_STA) {
-    WiFi.mode(WIFI_STA);
-  } else if (g_wifiMode == WIFI_MODE_AP) {
-    WiFi.mode(WIFI_AP);
-  } else {
-    WiFi.mode(WIFI_AP_STA);
-  }
-
   esp_err_t err = esp_now_init();
   if (err != ESP_OK) {
     Serial.printf("[ESP-NOW] Init failed: %d\n", (int)err);
@@ -111,6 +95,7 @@ void reinitEspNow() {
   uint8_t bcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };  // Broadcast
   memcpy(peerInfo.peer_addr, bcast, 6);
   peerInfo.channel = 0;
+  peerInfo.ifidx = (WiFi.getMode() & WIFI_MODE_STA) ? WIFI_IF_STA : WIFI_IF_AP;
   peerInfo.encrypt = false;
   err = esp_now_add_peer(&peerInfo);
   if (err != ESP_OK && err != ESP_ERR_ESPNOW_EXIST) {
@@ -118,195 +103,309 @@ void reinitEspNow() {
   }
 
   Serial.println("[ESP-NOW] Initialized");
+  LuxInput::announce(espNowChannel(), millis(), true);
 }
 
-String wifiModeString() {
+const char* wifiModeName() {
   if (g_wifiMode == WIFI_MODE_STA) return "STA";
   if (g_wifiMode == WIFI_MODE_AP) return "AP";
   if (g_wifiMode == WIFI_MODE_APSTA) return "AP_STA";
   return "UNKNOWN";
 }
 
+String wifiModeString() {
+  return wifiModeName();
+}
+
 int getStaChannel() {
-  if (WiFi.getMode() == WIFI_MODE_STA && WiFi.status() == WL_CONNECTED) {
+  if ((WiFi.getMode() & WIFI_MODE_STA) && WiFi.status() == WL_CONNECTED) {
     return WiFi.channel();
   }
   return -1;
 }
 
-// Access Point - Wi‑Fi (old behavior, no args) + mDNS
-void wifiStartAP() {
-  Serial.println("[WiFi] wifiStartAP()");
+// Channel ESP-NOW runs on: the router's while STA is connected, else the radio's (AP)
+uint8_t espNowChannel() {
+  int ch = getStaChannel();
+  return ch > 0 ? (uint8_t)ch : (uint8_t)WiFi.channel();
+}
 
-  // track mode
-  g_wifiMode = WIFI_MODE_AP;
+// ---- Wi-Fi connection manager ----
+// WifiSm decides, this glue performs: requests from the web handlers and
+// driver events from WiFi.onEvent are queued and applied in loop(), so no
+// caller ever waits for a connection.
+enum WifiReqKind : uint8_t { WREQ_NONE = 0, WREQ_AP, WREQ_STA };
+enum WifiEvtKind : uint8_t { WEVT_GOT_IP = 1, WEVT_DISCONNECTED };
+
+struct WifiRequest {
+  uint8_t kind;
+  uint32_t atMs;  // apply no earlier than this (lets the HTTP answer go out first)
+  char ssid[33];
+  char pass[65];
+};
+
+struct WifiEvt {
+  uint8_t kind;
+  uint8_t reason;
+};
+
+// What /wifiStatus reports (written by loop(), read by the AsyncTCP task)
+struct WifiSnapshot {
+  uint8_t state;
+  uint8_t result;
+  uint8_t reason;
+  bool ap;
+  uint16_t attempts;
+  uint32_t retryInMs;
+  char ssid[33];
+};
+
+static WifiSm::Machine s_wifi(WifiSm::Config{ WIFI_CONNECT_TIMEOUT_MS, WIFI_BACKOFF_MIN_MS, WIFI_BACKOFF_MAX_MS,
+                                              WIFI_FALLBACK_AP_MS, WIFI_AP_LINGER_MS });
+static SpscRing<WifiEvt, 8> s_wifiEvents;  // event task -> loop
+static portMUX_TYPE s_wifiMux = portMUX_INITIALIZER_UNLOCKED;
+static WifiRequest s_wifiReq = {};
+static WifiSnapshot s_wifiSnap = {};
+static volatile uint32_t s_wifiEventDrops = 0;
+
+// Wi-Fi event task: queue only, the loop does the work
+static void onWifiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
+  WifiEvt e = {};
+  if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+    e.kind = WEVT_GOT_IP;
+  } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+    e.kind = WEVT_DISCONNECTED;
+    e.reason = info.wifi_sta_disconnected.reason;
+  } else {
+    return;
+  }
+  if (!s_wifiEvents.push(e)) s_wifiEventDrops++;
+}
 
-  // Tear down STA + mDNS
+static void wifiStartMdns() {
+  const char* host = s_wifi.state() == WifiSm::S_CONNECTED ? HOSTNAME_STA : HOSTNAME_AP;
   MDNS.end();
-  WiFi.softAPdisconnect(true);
-  WiFi.disconnect(true, true);
-  WiFi.mode(WIFI_OFF);
-  delay(50);
+  if (MDNS.begin(host)) {
+    MDNS.addService("http", "tcp", 80);
+    Serial.printf("[mDNS] %s.local\n", host);
+  } else {
+    Serial.printf("[mDNS] begin(%s) failed\n", host);
+  }
+}
 
-  WiFi.mode(WIFI_AP);
-  WiFi.setHostname(HOSTNAME_AP);
+// Carry out WifiSm actions; the radio mode follows what the machine wants
+static void wifiApply(uint8_t act) {
+  if (act & WifiSm::A_STA_STOP) WiFi.disconnect(false, false);
 
-  const uint8_t channel = 1; // default AP channel
-  if (!WiFi.softAP(AP_SSID, AP_PASS, channel)) {
-    Serial.println("[WiFi] softAP failed");
-    return;
+  wifi_mode_t want = s_wifi.staWanted() ? (s_wifi.apUp() ? WIFI_AP_STA : WIFI_STA) : WIFI_AP;
+  bool modeChanged = WiFi.getMode() != want;
+  if (modeChanged) {
+    Serial.printf("[WiFi] mode %d -> %d\n", (int)WiFi.getMode(), (int)want);
+    WiFi.mode(want);
   }
+  g_wifiMode = want;
 
-  delay(100);  // allow AP interface up
+  if (act & WifiSm::A_AP_UP) {
+    if (WiFi.softAP(AP_SSID, AP_PASS, WIFI_AP_CHANNEL)) {
+      Serial.printf("[WiFi] AP SSID=%s PASS=%s IP=%s\n", AP_SSID, AP_PASS, WiFi.softAPIP().toString().c_str());
+    } else {
+      Serial.println("[WiFi] softAP failed");
+    }
+  }
+  if (act & WifiSm::A_STA_BEGIN) {
+    Serial.printf("[WiFi] STA connecting to '%s' (attempt %u)\n", g_staSsid.c_str(), (unsigned)s_wifi.attempts());
+    WiFi.begin(g_staSsid.c_str(), g_staPass.c_str());
+  }
+  if (act & WifiSm::A_SAVE) {
+    if (s_wifi.staWanted()) {
+      savePreferenceWiFiMode("STA");
+      savePreferenceSTA(g_staSsid, g_staPass);
+    } else {
+      savePreferenceWiFiMode("AP");
+    }
+  }
+  if (act & WifiSm::A_MDNS) {
+    if (s_wifi.state() == WifiSm::S_CONNECTED) {
+      Serial.printf("[WiFi] STA (%s) IP=%s CH=%d\n", HOSTNAME_STA, WiFi.localIP().toString().c_str(), getStaChannel());
+    }
+    wifiStartMdns();
+  }
+  // The broadcast peer is bound to an interface; re-create it for the new mode
+  if (modeChanged) reinitEspNow();
+}
 
-  IPAddress ip = WiFi.softAPIP();
-  Serial.printf("[WiFi] AP SSID=%s PASS=%s CH=%u IP=%s\n",
-                AP_SSID, AP_PASS, channel, ip.toString().c_str());
+static void wifiRequest(uint8_t kind, const String& ssid, const String& pass) {
+  portENTER_CRITICAL(&s_wifiMux);
+  s_wifiReq.kind = kind;
+  s_wifiReq.atMs = millis() + WIFI_SWITCH_DELAY_MS;
+  strlcpy(s_wifiReq.ssid, ssid.c_str(), sizeof(s_wifiReq.ssid));
+  strlcpy(s_wifiReq.pass, pass.c_str(), sizeof(s_wifiReq.pass));
+  s_wifiSnap.result = WifiSm::R_PENDING;  // a poll right after the 202 must not see the old result
+  portEXIT_CRITICAL(&s_wifiMux);
+}
 
-  if (MDNS.begin(HOSTNAME_AP)) {
-    MDNS.addService("http", "tcp", 80);
-    Serial.printf("[mDNS] %s.local -> %s\n",
-                  HOSTNAME_AP, ip.toString().c_str());
-  } else {
-    Serial.println("[mDNS] begin(AP) failed");
-  }
+// Queue a switch to AP (applied by wifiService)
+void wifiStartAP() {
+  wifiRequest(WREQ_AP, "", "");
 }
 
-// Sta Mode
+// Queue a switch to STA; false = unusable credentials. Saved once it connects.
 bool wifiStartSTA(const String& ssid, const String& pass) {
-  Serial.printf("[WiFi] wifiStartSTA('%s')\n", ssid.c_str());
-  g_wifiMode = WIFI_MODE_STA;
-
-  MDNS.end();
-  WiFi.softAPdisconnect(true);
-  WiFi.disconnect(true, true);
-  WiFi.mode(WIFI_OFF);
-  delay(50);
+  if (!ssid.length() || ssid.length() > 32 || pass.length() > 64) return false;
+  wifiRequest(WREQ_STA, ssid, pass);
+  return true;
+}
 
-  WiFi.mode(WIFI_STA);
+// Boot: saved STA config is retried in the background (AP joins it after WIFI_FALLBACK_AP_MS)
+void wifiBegin(bool sta) {
+  WiFi.persistent(false);        // credentials live in Persist, not in the driver's NVS
+  WiFi.setAutoReconnect(false);  // WifiSm owns retries and backoff
   WiFi.setHostname(HOSTNAME_STA);
-  WiFi.begin(ssid.c_str(), pass.c_str());
+  WiFi.onEvent(onWifiEvent);
+  uint32_t now = millis();
+  wifiApply(sta ? s_wifi.startSta(now, true) : s_wifi.startAp(now, false));
+}
 
-  uint32_t start = millis();
-  while (WiFi.status() != WL_CONNECTED && millis() - start < WIFI_CONNECT_TIMEOUT_MS) {
-    delay(200);
-    Serial.print(".");
-  }
-  Serial.println();
+void wifiService(uint32_t now) {
+  uint8_t act = 0;
 
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("[WiFi] STA connect failed, reverting to AP...");
-    wifiStartAP();  
-    return false;
+  WifiRequest req;
+  req.kind = WREQ_NONE;
+  portENTER_CRITICAL(&s_wifiMux);
+  if (s_wifiReq.kind != WREQ_NONE && (int32_t)(now - s_wifiReq.atMs) >= 0) {
+    req = s_wifiReq;
+    s_wifiReq.kind = WREQ_NONE;
+  }
+  portEXIT_CRITICAL(&s_wifiMux);
+  if (req.kind == WREQ_AP) {
+    Serial.println("[WiFi] switch to AP");
+    act |= s_wifi.startAp(now, true);
+  } else if (req.kind == WREQ_STA) {
+    Serial.printf("[WiFi] switch to STA '%s'\n", req.ssid);
+    g_staSsid = req.ssid;
+    g_staPass = req.pass;
+    act |= s_wifi.startSta(now, false);
   }
 
-  IPAddress ip = WiFi.localIP();
-  Serial.printf("[WiFi] STA (%s) IP=%s\n", HOSTNAME_STA, ip.toString().c_str());
-
-  if (MDNS.begin(HOSTNAME_STA)) {
-    MDNS.addService("http", "tcp", 80);
-    Serial.printf("[mDNS] %s.local -> %s\n",
-                  HOSTNAME_STA, ip.toString().c_str());
-  } else {
-    Serial.println("[mDNS] begin(STA) failed");
+  WifiEvt e;
+  while (s_wifiEvents.pop(e)) {
+    if (e.kind == WEVT_GOT_IP) {
+      act |= s_wifi.onGotIp(now);
+    } else {
+      Serial.printf("[WiFi] STA disconnected, reason %u\n", (unsigned)e.reason);
+      act |= s_wifi.onDisconnected(now, e.reason);
+    }
   }
 
-  return true;
+  act |= s_wifi.tick(now, s_wifi.apUp() ? WiFi.softAPgetStationNum() : 0);
+  if (act) wifiApply(act);
+
+  portENTER_CRITICAL(&s_wifiMux);
+  s_wifiSnap.state = s_wifi.state();
+  if (s_wifiReq.kind == WREQ_NONE) s_wifiSnap.result = s_wifi.result();
+  s_wifiSnap.reason = s_wifi.lastReason();
+  s_wifiSnap.ap = s_wifi.apUp();
+  s_wifiSnap.attempts = s_wifi.attempts();
+  s_wifiSnap.retryInMs = s_wifi.retryInMs(now);
+  if (act) strlcpy(s_wifiSnap.ssid, g_staSsid.c_str(), sizeof(s_wifiSnap.ssid));
+  portEXIT_CRITICAL(&s_wifiMux);
 }
 
-// Load previous LED states from preferences
-void loadPreferences() {
-  preferences.begin(PREF_NAMESPACE, true);
-
-  // LED settings
-  uint32_t color = preferences.getUInt(PREF_KEY_COLOR, DEFAULT_COLOR_HEX);
-  uint8_t brightness = preferences.getUChar(PREF_KEY_BRIGHTNESS, DEFAULT_BRIGHTNESS);
-  uint16_t effectId = preferences.getUShort(PREF_KEY_EFFECT, DEFAULT_EFFECT_ID);
-  bool isOn = preferences.getBool(PREF_KEY_ON, DEFAULT_ON);
-  bool mimir = preferences.getBool(PREF_KEY_MIMIR, DEFAULT_MIMIR);
-  bool presence = preferences.getBool(PREF_KEY_PRESENCE, false);
+// GET /wifiStatus: progress of the last mode switch / reconnects
+String wifiStatusJson() {
+  portENTER_CRITICAL(&s_wifiMux);
+  WifiSnapshot s = s_wifiSnap;
+  portEXIT_CRITICAL(&s_wifiMux);
+
+  IPAddress ip = s.state == WifiSm::S_CONNECTED ? WiFi.localIP() : WiFi.softAPIP();
+  char buf[320];
+  snprintf(buf, sizeof(buf),
+    "{\"state\":\"%s\",\"result\":\"%s\",\"mode\":\"%s\",\"ssid\":\"%s\",\"ap\":%s,"
+    "\"attempts\":%u,\"retry_in_ms\":%lu,\"reason\":%u,\"ip\":\"%u.%u.%u.%u\",\"event_drops\":%lu}",
+    WifiSm::stateName(s.state), WifiSm::resultName(s.result), wifiModeName(), s.ssid, s.ap ? "true" : "false",
+    (unsigned)s.attempts, (unsigned long)s.retryInMs, (unsigned)s.reason,
+    ip[0], ip[1], ip[2], ip[3], (unsigned long)s_wifiEventDrops);
+  return String(buf);
+}
 
-  // Mimir range
-  uint8_t mimirMin = preferences.getUChar(PREF_KEY_MIMIR_MIN, MIMIR_BRIGHT_MIN);
-  uint8_t mimirMax = preferences.getUChar(PREF_KEY_MIMIR_MAX, MIMIR_BRIGHT_MAX);
+// Load previous LED states from preferences (one blob read, see persist.h)
+void loadPreferences() {
+  Persist::begin(preferences);
+  const Persist::State& st = Persist::state();
+
+  uint32_t color = st.color;
+  uint8_t brightness = st.brightness;
+  uint16_t effectId = st.effect;
+  bool isOn = st.on;
+  bool mimir = st.mimir;
+  bool presence = st.presence;
+  uint8_t mimirMin = st.mimirMin;
+  uint8_t mimirMax = st.mimirMax;
+  uint8_t curveN = st.curveCount;
 
   // Wi‑Fi settings
-  String savedMode = preferences.getString(PREF_KEY_WIFI_MODE, "AP");
-  g_staSsid = preferences.getString(PREF_KEY_STA_SSID, "");
-  g_staPass = preferences.getString(PREF_KEY_STA_PASS, "");
-
-  preferences.end();
+  bool staMode = st.wifiMode == Persist::WIFI_PREF_STA;
+  g_staSsid = st.staSsid;
+  g_staPass = st.staPass;
 
   g_presenceEnabled = presence;
   LedControl::init();
-  LedControl::setColor(color);
+  LedControl::setColor(color, 0);
   LedControl::setEffect(effectId);
   LedControl::setOn(isOn);
   LedControl::setMimir(mimir);
   LedControl::setMimirRange(mimirMin, mimirMax);
+  if (curveN && !LedControl::setMimirCurve(st.curve, curveN)) curveN = 0;
   LedControl::setTargetBrightness(brightness);
 
-  // Wi‑Fi mode from pref
-  if (savedMode == "STA" && g_staSsid.length() > 0) {
-    wifiStartSTA(g_staSsid, g_staPass);
-  } else {
-    wifiStartAP();
-  }
+  // Wi‑Fi mode from pref (connects in the background, ESP-NOW follows the mode)
+  wifiBegin(staMode && g_staSsid.length() > 0);
 
-  reinitEspNow();
-
-  Serial.printf("[Prefs] on=%s, color=%06X, target_brightness=%u, effect=%u, mimir=%s, range=[%u,%u], presence=%s, wifi=%s\n",
+  Serial.printf("[Prefs] on=%s, color=%06X, target_brightness=%u, effect=%u, mimir=%s, range=[%u,%u], curve=%s, presence=%s, wifi=%s\n",
                 isOn ? "true" : "false", color, brightness, effectId, mimir ? "true" : "false",
-                mimirMin, mimirMax, presence ? "true" : "false", wifiModeString().c_str());
+                mimirMin, mimirMax, curveN ? "points" : "gamma", presence ? "true" : "false", wifiModeString().c_str());
 }
 
-// GET A LOAD OF THESE FUNCTIONS
+// Settings savers: RAM + dirty mask only, Persist::service() writes NVS later (calls counted in /metrics)
 void savePreferenceColor(uint32_t color) {
-  preferences.begin(PREF_NAMESPACE, false);
-  preferences.putUInt(PREF_KEY_COLOR, color);
-  preferences.end();
+  Metrics::count(Metrics::C_SAVE_COLOR);
+  Persist::setColor(color);
 }
 void savePreferenceBrightness(uint8_t b) {
-  preferences.begin(PREF_NAMESPACE, false);
-  preferences.putUChar(PREF_KEY_BRIGHTNESS, b);
-  preferences.end();
+  Metrics::count(Metrics::C_SAVE_BRIGHTNESS);
+  Persist::setBrightness(b);
 }
 void savePreferenceEffect(uint16_t e) {
-  preferences.begin(PREF_NAMESPACE, false);
-  preferences.putUShort(PREF_KEY_EFFECT, e);
-  preferences.end();
+  Metrics::count(Metrics::C_SAVE_EFFECT);
+  Persist::setEffect(e);
 }
 void savePreferenceOn(bool on) {
-  preferences.begin(PREF_NAMESPACE, false);
-  preferences.putBool(PREF_KEY_ON, on);
-  preferences.end();
+  Metrics::count(Metrics::C_SAVE_ON);
+  Persist::setOn(on);
 }
 void savePreferenceMimir(bool m) {
-  preferences.begin(PREF_NAMESPACE, false);
-  preferences.putBool(PREF_KEY_MIMIR, m);
-  preferences.end();
+  Metrics::count(Metrics::C_SAVE_MIMIR);
+  Persist::setMimir(m);
 }
 void savePreferenceWiFiMode(const String& mode) {
-  preferences.begin(PREF_NAMESPACE, false);
-  preferences.putString(PREF_KEY_WIFI_MODE, mode);
-  preferences.end();
+  Metrics::count(Metrics::C_SAVE_WIFI_MODE);
+  Persist::setWifiMode(mode);
 }
 void savePreferenceSTA(const String& ssid, const String& pass) {
-  preferences.begin(PREF_NAMESPACE, false);
-  preferences.putString(PREF_KEY_STA_SSID, ssid);
-  preferences.putString(PREF_KEY_STA_PASS, pass);
-  preferences.end();
+  Metrics::count(Metrics::C_SAVE_STA);
+  Persist::setSta(ssid, pass);
 }
 void savePreferenceMimirRange(uint8_t minB, uint8_t maxB) {
-  preferences.begin(PREF_NAMESPACE, false);
-  preferences.putUChar(PREF_KEY_MIMIR_MIN, minB);
-  preferences.putUChar(PREF_KEY_MIMIR_MAX, maxB);
-  preferences.end();
+  Metrics::count(Metrics::C_SAVE_MIMIR_RANGE);
+  Persist::setMimirRange(minB, maxB);
+}
+void savePreferenceMimirCurve(const MimirCurve::Point* pts, uint8_t n) {
+  Metrics::count(Metrics::C_SAVE_MIMIR_CURVE);
+  Persist::setMimirCurve(pts, n);
 }
 void savePreferencePresence(bool p) {
-  preferences.begin(PREF_NAMESPACE, false);
-  preferences.putBool(PREF_KEY_PRESENCE, p);
-  preferences.end();
+  Metrics::count(Metrics::C_SAVE_PRESENCE);
+  Persist::setPresence(p);
 }
 
 // Setup
@@ -328,18 +427,25 @@ void setup() {
   // test
   LedControl::selfTestRGB(40);
 
+  // LED frames from here on are rendered by the render task
+  RenderTask::begin();
+
+  AiWorker::begin();
+
   // Start webserver
   WebServerWrap::begin(server);
 }
 
 void loop() {
+  uint32_t loopStartUs = micros();
   if (g_buttonPressed) {
     g_buttonPressed = false;
     bool on = LedControl::toggle();
     savePreferenceOn(on);
   }
 
-  if (g_presenceEnabled) {
+  // Only with a fresh motion report; dead sensors must not switch the lamp
+  if (g_presenceEnabled && LuxInput::presenceKnown()) {
     bool motion = (bool)g_lastMotion;
     if (motion != LedControl::getOn()) {
       LedControl::setOn(motion);
@@ -347,5 +453,22 @@ void loop() {
     }
   }
 
-  LedControl::tick();
+  uint32_t now = millis();
+
+  // Router channel hops show up here; nodes rescan when their ACKs stop
+  static uint32_t lastChannelCheck = 0;
+  if (now - lastChannelCheck >= 1000) {
+    lastChannelCheck = now;
+    LuxInput::announce(espNowChannel(), now);
+  }
+
+  wifiService(now);
+  AiTransport::service(now);
+  StatePush::service(now);
+  Persist::service(now);
+  PresetStore::service(now);
+  AiCache::service(now);
+  Metrics::service(now);
+  Metrics::record(Metrics::H_LOOP, micros() - loopStartUs);
+  delay(1);
 }
\ No newline at end of file
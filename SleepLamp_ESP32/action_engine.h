@@ -0,0 +1,264 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+#include "led_control.h"
+#include "effect_names.h"
+
+/*
+  action_engine.h
+  One interpreter for the {"actions":[...]} schema used by /applyPreset,
+  the AI path and presets. JSON is compiled into a compact typed Batch
+  (validated up front, effect names resolved), then applied in one go
+  under the LedControl lock so observers only ever see the final state.
+*/
+
+#ifndef ACTION_BATCH_MAX
+#define ACTION_BATCH_MAX 16
+#endif
+
+// Upper bound for the parse document (heap, sized from the input)
+#ifndef ACTION_DOC_MAX
+#define ACTION_DOC_MAX 8192
+#endif
+
+// Preference savers (RAM + dirty mask, see persist.h)
+extern void savePreferenceColor(uint32_t color);
+extern void savePreferenceBrightness(uint8_t b);
+extern void savePreferenceEffect(uint16_t e);
+extern void savePreferenceOn(bool on);
+extern void savePreferenceMimir(bool m);
+extern void savePreferenceMimirRange(uint8_t minB, uint8_t maxB);
+
+namespace Actions {
+
+enum CmdType : uint8_t {
+  CMD_NONE = 0,
+  CMD_BRIGHTNESS,   // a = value, fade
+  CMD_COLOR,        // value = 0xRRGGBB, fade
+  CMD_EFFECT,       // value = mode id
+  CMD_MIMIR,        // a = on
+  CMD_POWER,        // a = on
+  CMD_MIMIR_RANGE,  // a = min, b = max
+};
+
+struct Command {
+  uint8_t type;
+  uint8_t a;
+  uint8_t b;
+  uint8_t fade;  // transition_ms: 0 = default (also in older stored batches), else 1 + ms / 100
+  uint32_t value;
+};
+
+static const uint32_t kFadeStepMs = 100;
+static const uint32_t kFadeMaxMs = 254 * kFadeStepMs;
+
+// transition_ms -> Command::fade (rounded to kFadeStepMs, capped at kFadeMaxMs)
+static uint8_t encodeFade(uint32_t ms) {
+  if (ms > kFadeMaxMs) ms = kFadeMaxMs;
+  return (uint8_t)(1 + (ms + kFadeStepMs / 2) / kFadeStepMs);
+}
+
+// Fade length for a command, dflt if the action did not give one
+static uint32_t fadeMs(const Command& c, uint32_t dflt) {
+  return c.fade ? (c.fade - 1) * kFadeStepMs : dflt;
+}
+
+struct Batch {
+  uint8_t count = 0;
+  uint8_t skipped = 0;  // entries that failed validation
+  Command cmds[ACTION_BATCH_MAX];
+};
+
+static bool parseHex6(const char* hex, uint32_t& out) {
+  if (!hex || hex[0] != '#' || strlen(hex) != 7) return false;
+  for (int i = 1; i < 7; ++i) {
+    if (!isxdigit((unsigned char)hex[i])) return false;
+  }
+  out = (uint32_t)strtoul(hex + 1, nullptr, 16);
+  return true;
+}
+
+// Validate one action object into a Command (false = invalid/unknown).
+// fadeDflt is the batch's transition_ms (-1 = none) for actions without their own.
+static bool compileOne(JsonObjectConst obj, Command& c, long fadeDflt = -1) {
+  const char* type = obj["type"] | "";
+  memset(&c, 0, sizeof(c));
+  long fade = obj["transition_ms"] | fadeDflt;
+  if (fade >= 0) c.fade = encodeFade(fade > (long)kFadeMaxMs ? kFadeMaxMs : (uint32_t)fade);  // cap before narrowing
+
+  if (strcmp(type, "set_brightness") == 0) {
+    int v = obj["value"] | -1;
+    if (v < 0 || v > 255) return false;
+    c.type = CMD_BRIGHTNESS;
+    c.a = (uint8_t)v;
+  } else if (strcmp(type, "set_color") == 0) {
+    if (!parseHex6(obj["hex"] | "", c.value)) return false;
+    c.type = CMD_COLOR;
+  } else if (strcmp(type, "set_effect") == 0) {
+    int id = obj["id"] | -1;
+    if (id < 0) {
+      const char* name = obj["name"] | "";
+      if (!*name) name = obj["label"] | "";
+      if (!*name) name = obj["effect"] | "";
+      if (*name) id = effectIdFromName(name);
+    }
+    if (id < 0 || id > 255) return false;
+    c.type = CMD_EFFECT;
+    c.value = (uint32_t)id;
+  } else if (strcmp(type, "set_mimir") == 0) {
+    c.type = CMD_MIMIR;
+    c.a = (obj["on"] | false) ? 1 : 0;
+  } else if (strcmp(type, "set_power") == 0) {
+    c.type = CMD_POWER;
+    c.a = (obj["on"] | false) ? 1 : 0;
+  } else if (strcmp(type, "set_mimir_range") == 0) {
+    int minB = obj["min"] | -1;
+    int maxB = obj["max"] | -1;
+    if (minB < 0 || maxB < 0 || minB > 255 || maxB > 255) return false;
+    if (minB > maxB) { int t = minB; minB = maxB; maxB = t; }
+    c.type = CMD_MIMIR_RANGE;
+    c.a = (uint8_t)minB;
+    c.b = (uint8_t)maxB;
+  } else {
+    return false;
+  }
+  if (c.type != CMD_BRIGHTNESS && c.type != CMD_COLOR) c.fade = 0;
+  return true;
+}
+
+// Compile an actions array. Invalid entries are skipped (and counted);
+// a batch with nothing valid is an error.
+bool compile(JsonArrayConst actions, Batch& out, String& err, long fadeDflt = -1) {
+  out.count = 0;
+  out.skipped = 0;
+  if (actions.isNull()) { err = "Missing actions array"; return false; }
+  for (JsonObjectConst obj : actions) {
+    if (out.count >= ACTION_BATCH_MAX) { err = "Too many actions (max " + String(ACTION_BATCH_MAX) + ")"; return false; }
+    if (compileOne(obj, out.cmds[out.count], fadeDflt)) out.count++;
+    else out.skipped++;
+  }
+  if (!out.count) { err = "No valid actions applied"; return false; }
+  return true;
+}
+
+// Inverse of compileOne (effects come back as ids)
+void toJson(const Command& c, JsonObject o) {
+  switch (c.type) {
+    case CMD_BRIGHTNESS:
+      o["type"] = "set_brightness";
+      o["value"] = c.a;
+      break;
+    case CMD_COLOR: {
+      char hex[8];
+      snprintf(hex, sizeof(hex), "#%06lX", (unsigned long)(c.value & 0xFFFFFF));
+      o["type"] = "set_color";
+      o["hex"] = hex;  // copied by the document
+      break;
+    }
+    case CMD_EFFECT:
+      o["type"] = "set_effect";
+      o["id"] = c.value;
+      break;
+    case CMD_MIMIR:
+      o["type"] = "set_mimir";
+      o["on"] = (bool)c.a;
+      break;
+    case CMD_POWER:
+      o["type"] = "set_power";
+      o["on"] = (bool)c.a;
+      break;
+    case CMD_MIMIR_RANGE:
+      o["type"] = "set_mimir_range";
+      o["min"] = c.a;
+      o["max"] = c.b;
+      break;
+    default:
+      break;
+  }
+  if (c.fade) o["transition_ms"] = fadeMs(c, 0);
+}
+
+// Keep only what the schema uses, so stray fields cost no document memory
+void addSchemaFilter(JsonDocument& filter) {
+  filter["transition_ms"] = true;
+  JsonObject a = filter["actions"].createNestedObject();
+  static const char* const kKeys[] = { "type", "value", "hex", "id", "name", "label", "effect", "on", "min", "max", "transition_ms" };
+  for (const char* k : kKeys) a[k] = true;
+}
+
+size_t docCapacityFor(size_t len) {
+  size_t cap = len * 2 + 512;
+  return cap > ACTION_DOC_MAX ? ACTION_DOC_MAX : cap;
+}
+
+// Parse {"actions":[...]} text and compile it
+bool compileText(const char* json, size_t len, Batch& out, String& err) {
+  StaticJsonDocument<384> filter;
+  addSchemaFilter(filter);
+  DynamicJsonDocument doc(docCapacityFor(len));
+  DeserializationError derr = deserializeJson(doc, json, len, DeserializationOption::Filter(filter));
+  if (derr) { err = String("JSON parse error: ") + derr.c_str(); return false; }
+  return compile(doc["actions"].as<JsonArrayConst>(), out, err, doc["transition_ms"] | -1L);
+}
+
+bool compileText(const String& json, Batch& out, String& err) {
+  return compileText(json.c_str(), json.length(), out, err);
+}
+
+// Apply a compiled batch atomically; appends the usual "k=v; " log
+void apply(const Batch& b, String& appliedLog) {
+  LedControl::Guard g;
+  for (uint8_t i = 0; i < b.count; ++i) {
+    const Command& c = b.cmds[i];
+    switch (c.type) {
+      case CMD_BRIGHTNESS:
+        LedControl::setTargetBrightness(c.a, fadeMs(c, 0));
+        savePreferenceBrightness(c.a);
+        if (!LedControl::fadingOff()) LedControl::setOn(c.a != 0);
+        savePreferenceOn(c.a != 0);
+        appliedLog += "brightness=" + String(c.a) + "; ";
+        break;
+      case CMD_COLOR: {
+        LedControl::setColor(c.value, fadeMs(c, COLOR_FADE_MS));
+        savePreferenceColor(c.value);
+        char hex[8];
+        snprintf(hex, sizeof(hex), "#%06lX", (unsigned long)(c.value & 0xFFFFFF));
+        appliedLog += String("color=") + hex + "; ";
+        break;
+      }
+      case CMD_EFFECT:
+        LedControl::setEffect((uint16_t)c.value);
+        savePreferenceEffect((uint16_t)c.value);
+        appliedLog += "effect=" + String(c.value) + "; ";
+        break;
+      case CMD_MIMIR:
+        LedControl::setMimir(c.a);
+        savePreferenceMimir(c.a);
+        appliedLog += String("mimir=") + (c.a ? "on" : "off") + "; ";
+        break;
+      case CMD_POWER:
+        LedControl::setOn(c.a);
+        savePreferenceOn(c.a);
+        appliedLog += String("power=") + (c.a ? "on" : "off") + "; ";
+        break;
+      case CMD_MIMIR_RANGE:
+        LedControl::setMimirRange(c.a, c.b);
+        savePreferenceMimirRange(c.a, c.b);
+        appliedLog += "mimir_range=[" + String(c.a) + "," + String(c.b) + "]; ";
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+// Compile + apply in one call (the old applyActionsFromJsonText contract)
+bool run(const String& jsonText, String& appliedLog, String& err) {
+  Batch b;
+  if (!compileText(jsonText, b, err)) return false;
+  apply(b, appliedLog);
+  return true;
+}
+
+}
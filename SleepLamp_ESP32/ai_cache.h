@@ -0,0 +1,335 @@
+#pragma once
+#include <Arduino.h>
+#include "fs_select.h"
+#include "action_engine.h"
+#include "persist.h"
+
+/*
+  ai_cache.h
+  Answers to recent AI prompts: normalized prompt -> compiled action batch.
+  A repeated prompt ("cozy", "bedtime") is applied from here without a
+  Gemini round trip or the AI_MIN_INTERVAL_MS wait. Least recently used
+  entries are evicted when full; entries older than AI_CACHE_TTL_S are
+  dropped. There is no wall clock (no NTP), so age is counted in uptime
+  and carried across reboots; time the lamp spends unpowered does not count.
+  Saved to LittleFS write-behind, like preset_store.h.
+*/
+
+#ifndef AI_CACHE_MAX
+#define AI_CACHE_MAX 16
+#endif
+
+// Normalized prompt incl. NUL; longer prompts are not cached
+#ifndef AI_CACHE_KEY_LEN
+#define AI_CACHE_KEY_LEN 64
+#endif
+
+#ifndef AI_CACHE_TTL_S
+#define AI_CACHE_TTL_S 604800UL  // 7 days; 0 = never expire
+#endif
+
+// Hits reorder the LRU too, so saves are batched more than presets
+#ifndef AI_CACHE_SAVE_DEBOUNCE_MS
+#define AI_CACHE_SAVE_DEBOUNCE_MS 30000UL
+#endif
+
+#define AI_CACHE_FILE "/aicache.bin"
+#define AI_CACHE_FILE_TMP "/aicache.tmp"
+
+namespace AiCache {
+
+static const uint32_t kMagic = 0x43414956;  // "VIAC"
+static const uint8_t kVersion = 1;
+
+static_assert(AI_CACHE_MAX <= 255, "entry count must fit in a byte");
+static_assert(AI_CACHE_KEY_LEN % 4 == 0, "key keeps the record fields aligned");
+
+struct Record {
+  char key[AI_CACHE_KEY_LEN];
+  uint32_t hash;
+  uint32_t ageS;     // on flash: age when saved; in RAM: unused
+  uint32_t lastUse;  // LRU tick
+  uint16_t hits;
+  uint8_t count;
+  uint8_t reserved;
+  Actions::Command cmds[ACTION_BATCH_MAX];
+};
+
+static const size_t kRecHead = offsetof(Record, cmds);
+
+struct FileHeader {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t count;
+  uint16_t reserved;
+  uint32_t tick;
+};
+
+struct Stats {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t stores;
+  uint32_t evictions;
+  uint32_t expired;
+};
+
+static Record s_recs[AI_CACHE_MAX];
+static int32_t s_bornS[AI_CACHE_MAX];  // uptime (s) the entry was stored at; < 0 for older boots
+static uint8_t s_count = 0;
+static uint32_t s_tick = 0;
+static Stats s_stats = {};
+
+static uint32_t s_gen = 0;       // bumped by every change
+static uint32_t s_savedGen = 0;  // generation that is on flash
+static uint32_t s_dirtyMs = 0;
+static SemaphoreHandle_t s_lock = nullptr;
+
+struct Guard {
+  Guard() { if (s_lock) xSemaphoreTake(s_lock, portMAX_DELAY); }
+  ~Guard() { if (s_lock) xSemaphoreGive(s_lock); }
+};
+
+// 64-bit timer, so ages survive the 49-day millis() wrap
+static int32_t uptimeS() { return (int32_t)(esp_timer_get_time() / 1000000LL); }
+
+// Lowercase, punctuation and runs of spaces folded to one space, trimmed:
+// "Cozy!", "  cozy " and "COZY." share an entry. Bytes >= 0x80 (UTF-8) are kept.
+// False if nothing is left or the result does not fit.
+static bool normalize(const char* in, size_t n, char* out, size_t cap) {
+  size_t len = 0;
+  bool gap = false;
+  for (size_t i = 0; i < n; ++i) {
+    uint8_t c = (uint8_t)in[i];
+    if (c >= 'A' && c <= 'Z') c = (uint8_t)(c - 'A' + 'a');
+    bool word = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80;
+    if (!word) { gap = len > 0; continue; }
+    if (gap) {
+      if (len + 1 >= cap) return false;
+      out[len++] = ' ';
+      gap = false;
+    }
+    if (len + 1 >= cap) return false;
+    out[len++] = (char)c;
+  }
+  out[len] = '\0';
+  return len > 0;
+}
+
+static uint32_t fnv1a(const char* s) {
+  uint32_t h = 2166136261u;
+  while (*s) { h ^= (uint8_t)*s++; h *= 16777619u; }
+  return h;
+}
+
+// Caller holds the lock
+static void removeAt(uint8_t i) {
+  s_count--;
+  if (i != s_count) {
+    s_recs[i] = s_recs[s_count];
+    s_bornS[i] = s_bornS[s_count];
+  }
+}
+
+static bool expired(uint8_t i, int32_t now) {
+  return AI_CACHE_TTL_S && (uint32_t)(now - s_bornS[i]) >= AI_CACHE_TTL_S;
+}
+
+static int find(const char* key, uint32_t hash) {
+  for (uint8_t i = 0; i < s_count; ++i) {
+    if (s_recs[i].hash == hash && strcmp(s_recs[i].key, key) == 0) return i;
+  }
+  return -1;
+}
+
+// ---- flash format: header, records, CRC32 ----
+
+static size_t maxFileSize() {
+  return sizeof(FileHeader) + AI_CACHE_MAX * sizeof(Record) + 4;
+}
+
+// Caller holds the lock
+static size_t encode(uint8_t* buf) {
+  FileHeader h = {};
+  h.magic = kMagic;
+  h.version = kVersion;
+  h.count = s_count;
+  h.tick = s_tick;
+  memcpy(buf, &h, sizeof(h));
+  size_t n = sizeof(h);
+
+  int32_t now = uptimeS();
+  for (uint8_t i = 0; i < s_count; ++i) {
+    Record& rec = s_recs[i];
+    rec.ageS = (uint32_t)(now - s_bornS[i]);
+    size_t len = kRecHead + rec.count * sizeof(Actions::Command);
+    memcpy(buf + n, &rec, len);
+    n += len;
+  }
+  uint32_t crc = Persist::crc32(buf, n);
+  memcpy(buf + n, &crc, 4);
+  return n + 4;
+}
+
+static bool decode(const uint8_t* buf, size_t len) {
+  if (len < sizeof(FileHeader) + 4) return false;
+  uint32_t crc;
+  memcpy(&crc, buf + len - 4, 4);
+  len -= 4;
+  if (crc != Persist::crc32(buf, len)) return false;
+
+  FileHeader h;
+  memcpy(&h, buf, sizeof(h));
+  if (h.magic != kMagic || h.version != kVersion || h.count > AI_CACHE_MAX) return false;
+
+  s_count = 0;
+  size_t n = sizeof(h);
+  int32_t now = uptimeS();
+  for (uint8_t i = 0; i < h.count; ++i) {
+    if (n + kRecHead > len) { s_count = 0; return false; }
+    Record& rec = s_recs[s_count];
+    memset(&rec, 0, sizeof(rec));
+    memcpy(&rec, buf + n, kRecHead);
+    n += kRecHead;
+    size_t clen = rec.count * sizeof(Actions::Command);
+    if (rec.count > ACTION_BATCH_MAX || n + clen > len) { s_count = 0; return false; }
+    memcpy(rec.cmds, buf + n, clen);
+    n += clen;
+    rec.key[AI_CACHE_KEY_LEN - 1] = '\0';
+    if (!rec.key[0] || rec.hash != fnv1a(rec.key)) continue;
+    if (AI_CACHE_TTL_S && rec.ageS >= AI_CACHE_TTL_S) { s_stats.expired++; continue; }
+    s_bornS[s_count] = now - (int32_t)rec.ageS;
+    s_count++;
+  }
+  s_tick = h.tick;
+  return true;
+}
+
+static bool save() {
+  uint8_t* buf = (uint8_t*)malloc(maxFileSize());
+  if (!buf) return false;
+  size_t len;
+  uint32_t gen;
+  {
+    Guard g;
+    len = encode(buf);
+    gen = s_gen;
+  }
+
+  bool ok = false;
+  File f = FSYS.open(AI_CACHE_FILE_TMP, "w");
+  if (f) {
+    ok = f.write(buf, len) == len;
+    f.close();
+    if (ok) {
+      FSYS.remove(AI_CACHE_FILE);
+      ok = FSYS.rename(AI_CACHE_FILE_TMP, AI_CACHE_FILE);
+    }
+  }
+  free(buf);
+
+  Guard g;
+  if (ok) {
+    s_savedGen = gen;  // changes made during the write stay dirty
+  } else {
+    s_dirtyMs = millis();
+    Serial.println("[AICache] Save failed");
+  }
+  return ok;
+}
+
+// Caller holds the lock
+static void markDirty() {
+  s_gen++;
+  s_dirtyMs = millis();
+}
+
+// Load the saved entries (FS must be mounted)
+void begin() {
+  if (!s_lock) s_lock = xSemaphoreCreateMutex();
+  Guard g;
+  s_count = 0;
+
+  File f = FSYS.open(AI_CACHE_FILE, "r");
+  if (!f) return;
+  size_t len = f.size();
+  uint8_t* buf = len <= maxFileSize() ? (uint8_t*)malloc(len) : nullptr;
+  bool ok = buf && f.read(buf, len) == len && decode(buf, len);
+  f.close();
+  free(buf);
+  if (ok) Serial.printf("[AICache] Loaded %u entries\n", s_count);
+  else Serial.printf("[AICache] Ignoring unreadable %s (%u bytes)\n", AI_CACHE_FILE, (unsigned)len);
+}
+
+// Copy the cached batch for a prompt; counts a hit or a miss
+bool lookup(const String& prompt, Actions::Batch& out) {
+  char key[AI_CACHE_KEY_LEN];
+  bool keyed = normalize(prompt.c_str(), prompt.length(), key, sizeof(key));
+  Guard g;
+  int i = keyed ? find(key, fnv1a(key)) : -1;
+  if (i >= 0 && expired((uint8_t)i, uptimeS())) {
+    removeAt((uint8_t)i);
+    s_stats.expired++;
+    markDirty();
+    i = -1;
+  }
+  if (i < 0) { s_stats.misses++; return false; }
+
+  Record& rec = s_recs[i];
+  rec.lastUse = ++s_tick;
+  if (rec.hits < 0xFFFF) rec.hits++;
+  out.count = rec.count;
+  out.skipped = 0;
+  memcpy(out.cmds, rec.cmds, rec.count * sizeof(Actions::Command));
+  s_stats.hits++;
+  markDirty();
+  return true;
+}
+
+// Remember a validated answer (replaces an older one for the same prompt)
+void put(const String& prompt, const Actions::Batch& batch) {
+  char key[AI_CACHE_KEY_LEN];
+  if (!batch.count || !normalize(prompt.c_str(), prompt.length(), key, sizeof(key))) return;
+  uint32_t hash = fnv1a(key);
+  Guard g;
+  int i = find(key, hash);
+  if (i < 0 && s_count == AI_CACHE_MAX) {
+    // evict the least recently used (expired entries first)
+    int32_t now = uptimeS();
+    uint8_t victim = 0;
+    for (uint8_t k = 0; k < s_count; ++k) {
+      if (expired(k, now)) { victim = k; break; }
+      if (s_recs[k].lastUse < s_recs[victim].lastUse) victim = k;
+    }
+    if (expired(victim, now)) s_stats.expired++;
+    else s_stats.evictions++;
+    removeAt(victim);
+  }
+  if (i < 0) i = s_count++;
+
+  Record& rec = s_recs[i];
+  memset(&rec, 0, kRecHead);
+  strcpy(rec.key, key);
+  rec.hash = hash;
+  rec.lastUse = ++s_tick;
+  rec.count = batch.count;
+  memcpy(rec.cmds, batch.cmds, batch.count * sizeof(Actions::Command));
+  s_bornS[i] = uptimeS();
+  s_stats.stores++;
+  markDirty();
+}
+
+uint8_t size() { return s_count; }
+const Stats& stats() { return s_stats; }
+
+// Call from loop(): saves once changes have settled. The AI worker may
+// stamp s_dirtyMs after loop() read nowMs, hence the signed elapsed time.
+void service(uint32_t nowMs) {
+  bool due;
+  {
+    Guard g;
+    due = s_gen != s_savedGen && (int32_t)(nowMs - s_dirtyMs) >= (int32_t)AI_CACHE_SAVE_DEBOUNCE_MS;
+  }
+  if (due) save();
+}
+
+}
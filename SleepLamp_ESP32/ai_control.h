@@ -8,6 +8,8 @@
 #include "ai_state.h"
 #include "config.h"
 #include "led_control.h"
+#include "action_engine.h"
+#include "gemini_stream.h"
 
 #if __has_include("secrets.h")
   #include "secrets.h"
@@ -22,53 +24,11 @@
 #ifndef GEMINI_HOST
   #define GEMINI_HOST "generativelanguage.googleapis.com"
 #endif
+#ifndef GEMINI_PORT
+  #define GEMINI_PORT 443
+#endif
 
-// Preference savers
-extern void savePreferenceColor(uint32_t color);
-extern void savePreferenceBrightness(uint8_t b);
-extern void savePreferenceEffect(uint16_t e);
-extern void savePreferenceOn(bool on);
-extern void savePreferenceMimir(bool m);
-extern void savePreferenceMimirRange(uint8_t minB, uint8_t maxB);
-
-/* ===================== Effect mapping ===================== */
-struct EffKV { const char* key; uint16_t id; };
-static String normKey(const String& s) {
-  String o; o.reserve(s.length());
-  for (char c : s) {
-    if (c >= 'A' && c <= 'Z') c = c - 'A' + 'a';
-    if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) o += c;
-  }
-  // normalize "theatre" -> "theater" (oi it's chewsday innit)
-  o.replace("theatre","theater");
-  return o;
-}
-static const EffKV EFFECT_KV[] PROGMEM = {
-  {"static",0},{"blink",1},{"breath",2},{"colorwipe",3},{"colorwipeinv",4},{"colorwiperev",5},{"colorwiperevinv",6},
-  {"colorwiperandom",7},{"randomcolor",8},{"singledynamic",9},{"multidynamic",10},{"rainbow",11},{"rainbowcycle",12},
-  {"scan",13},{"dualscan",14},{"fade",15},{"theaterchase",16},{"theaterchaserainbow",17},{"runninglights",18},
-  {"twinkle",19},{"twinklerandom",20},{"twinklefade",21},{"twinklefaderandom",22},{"sparkle",23},{"flashsparkle",24},
-  {"hypersparkle",25},{"strobe",26},{"stroberainbow",27},{"multistrobe",28},{"blinkrainbow",29},{"chasewhite",30},
-  {"chasecolor",31},{"chaserandom",32},{"chaserainbow",33},{"chaseflash",34},{"chaseflashrandom",35},
-  {"chaserainbowwhite",36},{"chaseblackout",37},{"chaseblackoutrainbow",38},{"colorsweeprandom",39},
-  {"runningcolor",40},{"runningredblue",41},{"runningrandom",42},{"larsonscanner",43},{"comet",44},{"fireworks",45},
-  {"fireworksrandom",46},{"merrychristmas",47},{"fireflicker",48},{"fireflickersoft",49},{"fireflickerintense",50},
-  {"circuscombustus",51},{"halloween",52},{"bicolorchase",53},{"tricolorchase",54},{"icu",55},
-  // common synonyms
-  {"rainbowwheel",12},{"wheel",12},{"cycle",12},{"scanner",43},{"knightrider",43},{"cylon",43},{"police",41}
-};
-static int effectIdFromName(const String& name) {
-  String k = normKey(name);
-  for (size_t i=0; i<sizeof(EFFECT_KV)/sizeof(EFFECT_KV[0]); ++i) {
-    if (k == FPSTR(EFFECT_KV[i].key)) return EFFECT_KV[i].id;
-  }
-  // Fallback linear compare
-  for (size_t i=0; i<sizeof(EFFECT_KV)/sizeof(EFFECT_KV[0]); ++i) {
-    String kk = String(EFFECT_KV[i].key);
-    if (k == kk) return EFFECT_KV[i].id;
-  }
-  return -1;
-}
+#include "ai_transport.h"
 
 /* ===================== Model instructions ===================== */
 static const char* kSystemInstruction =
@@ -82,6 +42,7 @@ static const char* kSystemInstruction =
   "{\"type\":\"set_power\",\"on\":true|false},"
   "{\"type\":\"set_mimir_range\",\"min\":0..255,\"max\":0..255}"
   "]}. "
+  "set_brightness and set_color may add \"transition_ms\":0..25400 to fade slowly (e.g. falling asleep, waking up). "
   "WS2812FX Effects (ID : Name): "
   "0:Static,1:Blink,2:Breath,3:Color Wipe,4:Color Wipe Inv,5:Color Wipe Rev,6:Color Wipe Rev Inv,7:Color Wipe Random,"
   "8:Random Color,9:Single Dynamic,10:Multi Dynamic,11:Rainbow,12:Rainbow Cycle,13:Scan,14:Dual Scan,15:Fade,"
@@ -94,122 +55,14 @@ static const char* kSystemInstruction =
   "54:Tricolor Chase,55:ICU. "
   "If the user names an effect, prefer set_effect with \"name\"; otherwise use \"id\". No markdown, no code fences.";
 
-/* ===================== Snippet cleanup, extraction (same as hardened) ===================== */
-static String sanitizeModelSnippet(const String& raw) {
-  int i=0; while (i<(int)raw.length() && isdigit((unsigned char)raw[i])) i++;
-  if (i<(int)raw.length() && (raw[i]=='\n' || raw[i]=='\r')) i++;
-  String s = raw.substring(i);
-  const size_t MAX = AI_MODEL_SNIPPET_MAX;
-  if (s.length() > MAX) s = s.substring(0, MAX);
+/* ===================== Snippet for /aiStatus debugging ===================== */
+static String sanitizeModelSnippet(const char* p, size_t n) {
+  String s;
+  if (n > AI_MODEL_SNIPPET_MAX) n = AI_MODEL_SNIPPET_MAX;
+  s.reserve(n);
+  for (size_t i = 0; i < n; ++i) s += p[i];
   return s;
 }
-static String stripCodeFences(const String& in) {
-  String s=in; s.trim();
-  if (s.startsWith("```")) {
-    int firstNL = s.indexOf('\n'); if (firstNL<0) return s;
-    int close = s.lastIndexOf("```"); if (close>firstNL) s = s.substring(firstNL+1, close);
-    s.trim();
-  }
-  return s;
-}
-static String extractFirstJSONObject(const String& in) {
-  int n=in.length(), start=-1, depth=0; bool inStr=false, esc=false;
-  for (int i=0;i<n;++i){ char c=in[i];
-    if (inStr){ if(esc){esc=false;continue;} if(c=='\\'){esc=true;continue;} if(c=='"'){inStr=false;continue;} continue; }
-    if (c=='"'){ inStr=true; continue; }
-    if (c=='{'){ if(depth==0) start=i; depth++; }
-    else if (c=='}'){ if(depth>0) depth--; if(depth==0 && start>=0) return in.substring(start,i+1); }
-  }
-  return String();
-}
-static bool extractGeminiTextJSON(const String& body, String& out) {
-  DynamicJsonDocument doc(16384);
-  if (!deserializeJson(doc, body)) {
-    JsonVariant v = doc["candidates"][0]["content"]["parts"][0]["text"];
-    if (!v.isNull()) { out = v.as<const char*>(); if (out.length()) return true; }
-  }
-  int idx = body.indexOf("\"text\"");
-  if (idx >= 0) {
-    idx = body.indexOf(':', idx);
-    int q = body.indexOf('"', idx);
-    if (q >= 0) { q++; String acc; bool esc=false;
-      for (int i=q;i<(int)body.length();++i){ char c=body[i];
-        if (esc){ if(c=='n') acc+='\n'; else acc+=c; esc=false; continue; }
-        if (c=='\\'){ esc=true; continue; }
-        if (c=='"'){ out=acc; return out.length()>0; }
-        acc+=c;
-      }
-    }
-  }
-  return false;
-}
-
-/* ===================== Apply actions ===================== */
-static uint32_t parseHexColor(const String& hex) {
-  if (hex.length()!=7 || hex[0]!='#') return LedControl::getColor();
-  return (uint32_t)strtoul(hex.substring(1).c_str(), nullptr, 16);
-}
-static void applyOneAction(const JsonObject& obj, String& logAccum) {
-  const char* type = obj["type"] | "";
-  if (!*type) return;
-
-  if (strcmp(type,"set_brightness")==0) {
-    int v = obj["value"] | -1;
-    if (v>=0 && v<=255) {
-      LedControl::setTargetBrightness((uint8_t)v);
-      savePreferenceBrightness((uint8_t)v);
-      if (v==0){ LedControl::setOn(false); savePreferenceOn(false);} else { LedControl::setOn(true); savePreferenceOn(true); }
-      logAccum += "brightness=" + String(v) + "; ";
-    }
-  } else if (strcmp(type,"set_color")==0) {
-    String hex = obj["hex"] | "";
-    if (hex.length()==7 && hex[0]=='#') {
-      uint32_t c = parseHexColor(hex);
-      LedControl::setColor(c);
-      savePreferenceColor(c);
-      logAccum += "color=" + hex + "; ";
-    }
-  } else if (strcmp(type,"set_effect")==0) {
-    int id = obj["id"] | -1;
-    if (id < 0) {
-      String name = obj["name"] | obj["label"] | obj["effect"] | "";
-      if (name.length()) id = effectIdFromName(name);
-    }
-    if (id >= 0 && id <= 255) {
-      LedControl::setEffect((uint16_t)id);
-      savePreferenceEffect((uint16_t)id);
-      logAccum += "effect=" + String(id) + "; ";
-    }
-  } else if (strcmp(type,"set_mimir")==0) {
-    bool on = obj["on"] | false;
-    LedControl::setMimir(on);
-    savePreferenceMimir(on);
-    logAccum += String("mimir=") + (on?"on":"off") + "; ";
-  } else if (strcmp(type,"set_power")==0) {
-    bool on = obj["on"] | false;
-    LedControl::setOn(on);
-    savePreferenceOn(on);
-    logAccum += String("power=") + (on?"on":"off") + "; ";
-  } else if (strcmp(type,"set_mimir_range")==0) {
-    int minB = obj["min"] | -1, maxB = obj["max"] | -1;
-    if (minB>=0 && maxB>=0 && minB<=255 && maxB<=255) {
-      if (minB>maxB){ int t=minB; minB=maxB; maxB=t; }
-      LedControl::setMimirRange((uint8_t)minB,(uint8_t)maxB);
-      savePreferenceMimirRange((uint8_t)minB,(uint8_t)maxB);
-      logAccum += "mimir_range=[" + String(minB) + "," + String(maxB) + "]; ";
-    }
-  }
-}
-static bool parseAndApplyActions(const String& jsonText, String& appliedLog, String& err) {
-  StaticJsonDocument<8192> doc;
-  DeserializationError derr = deserializeJson(doc, jsonText);
-  if (derr) { err = String("JSON parse error: ") + derr.c_str(); return false; }
-  JsonArray actions = doc["actions"].as<JsonArray>();
-  if (actions.isNull()) { err = "Missing actions array"; return false; }
-  for (JsonObject a : actions) applyOneAction(a, appliedLog);
-  if (appliedLog.length()==0){ err="No valid actions applied"; return false; }
-  return true;
-}
 
 /* Gemini */
 static void buildRequestBody(const String& prompt, String& outJson) {
@@ -222,79 +75,178 @@ static void buildRequestBody(const String& prompt, String& outJson) {
   outJson.clear(); serializeJson(req, outJson);
 }
 
-static void runGeminiJob(const String& prompt) {
-  g_aiJob.startedMs = millis(); g_aiJob.ok=false; g_aiJob.done=false; g_aiJob.canceled=false;
-  g_aiJob.appliedSummary=""; g_aiJob.modelJsonSnippet=""; g_aiJob.error="";
-
-#ifdef GEMINI_DISABLED
-  g_aiJob.error="Gemini disabled"; g_aiJob.done=true; return;
-#endif
-  if (WiFi.status()!=WL_CONNECTED){ g_aiJob.error="WiFi not connected"; g_aiJob.done=true; return; }
-  if (String(GEMINI_API_KEY).length()<8){ g_aiJob.error="Missing GEMINI_API_KEY"; g_aiJob.done=true; return; }
+// Model text (the actions JSON) and the first bytes of the body, for errors.
+// Only the AI worker runs jobs, so both live here instead of on its stack.
+static char s_aiText[AI_TEXT_MAX + 1];
+static char s_aiHead[AI_MODEL_SNIPPET_MAX + 1];
+
+// Set by a cancel from the web task; every wait on the socket polls it and
+// the job then closes the connection
+static volatile bool s_aiAbort = false;
+
+struct GeminiBody {
+  bool chunked = false;
+  long contentLength = -1;
+  bool close = false;   // server sends "Connection: close"
+  bool ended = false;   // read up to the end of the body (connection reusable)
+  size_t headLen = 0;
+  bool timedOut = false;
+};
 
-  String reqBody; buildRequestBody(prompt, reqBody);
-  WiFiClientSecure client; client.setTimeout(15000); client.setInsecure();
-  const String path = String("/v1beta/models/")+GEMINI_MODEL+":generateContent?key="+GEMINI_API_KEY;
-  if (!client.connect(GEMINI_HOST,443)){ g_aiJob.error="TLS connect failed"; g_aiJob.done=true; return; }
+// Read the body as it arrives: de-chunk in place, keep the first bytes in
+// s_aiHead and hand everything to ext (if any) until its JSON root closes.
+// Reads on to the end of the body so a kept connection starts clean; stops
+// early on abort or after AI_JOB_TIMEOUT_MS.
+static void streamGeminiBody(Client& client, GeminiBody& b, GeminiStream::TextExtractor* ext) {
+  uint8_t buf[AI_READ_CHUNK];
+  GeminiStream::ChunkedDecoder dec;
+  size_t raw = 0;
+  uint32_t start = millis();
+  b.headLen = 0;
+  s_aiHead[0] = '\0';
+  if (!b.chunked && b.contentLength == 0) { b.ended = true; return; }
+  while (!s_aiAbort) {
+    int avail = client.available();
+    if (avail <= 0) {
+      if (!client.connected()) break;
+      if (millis() - start >= AI_JOB_TIMEOUT_MS) { b.timedOut = true; break; }
+      delay(2);
+      continue;
+    }
+    int n = client.read(buf, avail < (int)sizeof(buf) ? avail : (int)sizeof(buf));
+    if (n <= 0) continue;
+    raw += (size_t)n;
+    size_t m = b.chunked ? dec.feed(buf, (size_t)n) : (size_t)n;
+    size_t k = m < AI_MODEL_SNIPPET_MAX - b.headLen ? m : AI_MODEL_SNIPPET_MAX - b.headLen;
+    memcpy(s_aiHead + b.headLen, buf, k);
+    b.headLen += k;
+    s_aiHead[b.headLen] = '\0';
+    if (ext && !ext->complete() && !ext->failed()) ext->feed(buf, m);
+    if (b.chunked ? (dec.done() || dec.failed()) : (b.contentLength >= 0 && (long)raw >= b.contentLength)) {
+      b.ended = b.chunked ? dec.done() : (long)raw == b.contentLength;
+      break;
+    }
+  }
+}
 
+static bool sendGeminiRequest(Client& client, const String& path, const String& reqBody) {
   client.printf("POST %s HTTP/1.1\r\n", path.c_str());
   client.printf("Host: %s\r\n", GEMINI_HOST);
-  client.println("Content-Type: application/json");
+  client.print("Content-Type: application/json\r\n");
+  client.print("Accept-Encoding: identity\r\n");
   client.printf("Content-Length: %u\r\n", (unsigned)reqBody.length());
-  client.println("Connection: close"); client.println(); client.print(reqBody);
+  client.print(AI_KEEPALIVE_MS ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+  return client.print(reqBody) == reqBody.length();
+}
+
+// Wait for the first byte of the answer; false on abort, timeout or close
+static bool waitGeminiAnswer(Client& client) {
+  uint32_t start = millis();
+  while (!client.available()) {
+    if (s_aiAbort || !client.connected() || millis() - start >= AI_JOB_TIMEOUT_MS) return false;
+    delay(2);
+  }
+  return true;
+}
 
+// Status line + headers; returns the status line ("" = no answer)
+static String readGeminiHeaders(Client& client, GeminiBody& body) {
+  if (!waitGeminiAnswer(client)) return String();
   String statusLine = client.readStringUntil('\n');
-  if (!statusLine.startsWith("HTTP/1.1 200")) {
-    String errBody; while (client.connected() || client.available()) { errBody += client.readString(); yield(); }
-    g_aiJob.error = "HTTP error: " + statusLine;
-    g_aiJob.modelJsonSnippet = sanitizeModelSnippet(errBody);
-    g_aiJob.done = true; return;
+  if (!statusLine.length()) return statusLine;
+  while (true) {
+    String h = client.readStringUntil('\n');
+    if (h=="\r"||!h.length()) break;
+    h.trim();
+    int colon = h.indexOf(':');
+    if (colon > 0) {
+      String name = h.substring(0, colon); name.toLowerCase();
+      String value = h.substring(colon + 1); value.trim(); value.toLowerCase();
+      if (name == "transfer-encoding" && value.indexOf("chunked") >= 0) body.chunked = true;
+      else if (name == "content-length") body.contentLength = value.toInt();
+      else if (name == "connection" && value.indexOf("close") >= 0) body.close = true;
+    }
+    yield();
   }
-  while (true){ String h=client.readStringUntil('\n'); if (h=="\r"||!h.length()) break; yield(); }
+  statusLine.trim();
+  return statusLine;
+}
 
-  String body; while (client.connected() || client.available()) { body += client.readString(); yield(); }
+// Ask Gemini and compile its answer into batch (applied by the caller).
+// Fills job's error, snippet and timings; false = no usable answer.
+static bool runGeminiJob(const char* prompt, AIJob& job, Actions::Batch& batch) {
+  AITimings& t = job.timing;
+  t = AITimings();
+  uint32_t jobStart = millis();
 
-  if (g_aiJob.canceled){ g_aiJob.error="Canceled"; g_aiJob.done=true; return; }
+#ifdef GEMINI_DISABLED
+  job.error="Gemini disabled"; return false;
+#endif
+  if (WiFi.status()!=WL_CONNECTED){ job.error="WiFi not connected"; return false; }
+  if (String(GEMINI_API_KEY).length()<8){ job.error="Missing GEMINI_API_KEY"; return false; }
+
+  String reqBody; buildRequestBody(prompt, reqBody);
+  const String path = String("/v1beta/models/")+GEMINI_MODEL+":generateContent?key="+GEMINI_API_KEY;
 
-  String modelText;
-  if (!extractGeminiTextJSON(body, modelText)) {
-    g_aiJob.error="No model text";
-    g_aiJob.modelJsonSnippet=sanitizeModelSnippet(body);
-    g_aiJob.done=true; return;
+  AiTransport::Guard lease(AI_JOB_TIMEOUT_MS);
+  if (!lease.ok()) { job.error="AI connection busy"; return false; }
+
+  String statusLine;
+  GeminiBody body;
+  for (uint8_t attempt = 0; ; ++attempt) {
+    String err;
+    if (!AiTransport::ensure(t, err)) { job.error=err; t.totalMs = millis() - jobStart; return false; }
+    Client& client = AiTransport::client();
+    uint32_t t0 = millis();
+    bool sent = sendGeminiRequest(client, path, reqBody);
+    t.sendMs = millis() - t0;
+    t0 = millis();
+    body = GeminiBody();
+    if (sent) statusLine = readGeminiHeaders(client, body);
+    t.firstByteMs = millis() - t0;
+    if (statusLine.length() || !t.reused || attempt || s_aiAbort) break;
+    // the server closed the kept connection while it idled: once more on a fresh one
+    AiTransport::drop();
+    AiTransport::s_stats.staleRetries++;
+    t.retries++;
   }
+  reqBody = String();  // not needed while the answer streams in
+  Client& client = AiTransport::client();
 
-  String normalized = stripCodeFences(modelText); normalized.trim();
-  if (!normalized.startsWith("{")) { String obj = extractFirstJSONObject(normalized); if (obj.length()) normalized=obj; }
-  g_aiJob.modelJsonSnippet = sanitizeModelSnippet(normalized);
+  if (!statusLine.length()) {
+    AiTransport::drop();
+    job.error = s_aiAbort ? "Canceled" : "No response"; t.totalMs = millis() - jobStart; return false;
+  }
 
-  String appliedLog, parseErr;
-  if (!parseAndApplyActions(normalized, appliedLog, parseErr)) {
-    String obj = extractFirstJSONObject(body);
-    if (obj.length()) {
-      String applied2, err2;
-      if (parseAndApplyActions(obj, applied2, err2)) {
-        g_aiJob.ok=true; g_aiJob.appliedSummary=applied2; g_aiJob.done=true; return;
-      } else { parseErr += " | Fallback parse failed: " + err2; }
-    }
-    g_aiJob.error=parseErr; g_aiJob.appliedSummary=""; g_aiJob.done=true; return;
+  uint32_t bodyStart = millis();
+  if (!statusLine.startsWith("HTTP/1.1 200")) {
+    streamGeminiBody(client, body, nullptr);
+    AiTransport::release(body.ended && !body.close);
+    t.bodyMs = millis() - bodyStart; t.totalMs = millis() - jobStart;
+    job.error = "HTTP error: " + statusLine;
+    job.modelJsonSnippet = sanitizeModelSnippet(s_aiHead, body.headLen);
+    return false;
   }
 
-  g_aiJob.ok=true; g_aiJob.appliedSummary=appliedLog; g_aiJob.done=true;
-}
+  GeminiStream::TextExtractor ext(s_aiText, sizeof(s_aiText));
+  streamGeminiBody(client, body, &ext);
+  AiTransport::release(body.ended && !body.close && !s_aiAbort);  // an aborted answer closes the socket
+  t.bodyMs = millis() - bodyStart;
 
-/* ===================== Public API ===================== */
-inline bool canStartAIJob() {
-  if (g_aiJob.running) return false;
-  unsigned long now=millis(); if (g_aiJob.startedMs && (now-g_aiJob.startedMs)<AI_MIN_INTERVAL_MS) return false;
-  return true;
-}
-inline bool startAIJob(const String& prompt) {
-  if (!canStartAIJob()) return false;
-  g_aiJob.running=true; g_aiJob.done=false; g_aiJob.ok=false; g_aiJob.canceled=false;
-  g_aiJob.prompt=prompt; g_aiJob.appliedSummary=""; g_aiJob.modelJsonSnippet=""; g_aiJob.error=""; g_aiJob.startedMs=millis();
-  const uint32_t stack=16384;
-  BaseType_t rc = xTaskCreatePinnedToCore([](void*){ runGeminiJob(g_aiJob.prompt); g_aiJob.running=false; vTaskDelete(nullptr); }, "AIJobTask", stack, nullptr, 1, nullptr, APP_CPU_NUM);
-  if (rc!=pdPASS){ g_aiJob.running=false; g_aiJob.done=true; g_aiJob.error="Task create failed"; return false; }
-  return true;
+  if (s_aiAbort){ job.error="Canceled"; t.totalMs = millis() - jobStart; return false; }
+
+  size_t off = 0, len = 0;
+  if (!ext.length() || !GeminiStream::objectSpan(s_aiText, ext.length(), off, len)) {
+    job.error = body.timedOut ? "Timed out reading response" : ext.truncated() ? "Model text too long" : "No model text";
+    job.modelJsonSnippet = ext.length() ? sanitizeModelSnippet(s_aiText, ext.length()) : sanitizeModelSnippet(s_aiHead, body.headLen);
+    t.totalMs = millis() - jobStart;
+    return false;
+  }
+  job.modelJsonSnippet = sanitizeModelSnippet(s_aiText + off, len);
+
+  String parseErr;
+  bool ok = Actions::compileText(s_aiText + off, len, batch, parseErr);
+  if (!ok) job.error = parseErr;
+  t.totalMs = millis() - jobStart;
+  return ok;
 }
-inline bool cancelAIJob(){ if(!g_aiJob.running) return false; g_aiJob.canceled=true; return true; }
\ No newline at end of file
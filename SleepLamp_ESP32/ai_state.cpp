@@ -1,2 +0,0 @@
-#include "ai_state.h"
-AIJob g_aiJob;
\ No newline at end of file
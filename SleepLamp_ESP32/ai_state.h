@@ -3,19 +3,58 @@
 
 /*
   ai_state.h
-  Shared AI job state for asynchronous Gemini requests.
-  All boolean flags marked volatile since they are read by both
-  the AI task and the web server (different contexts).
+  Shared AI job state: per-job records for the AI worker (ai_worker.h),
+  request timings and the limits of the Gemini path.
 */
 
+// Where the time of the last AI request went (ms; 0 = phase skipped)
+struct AITimings {
+  uint32_t dnsMs = 0;
+  uint32_t connectMs = 0;    // TCP (plus TLS on cores that cannot split them)
+  uint32_t tlsMs = 0;
+  uint32_t sendMs = 0;
+  uint32_t firstByteMs = 0;  // request sent -> status line
+  uint32_t bodyMs = 0;
+  uint32_t totalMs = 0;
+  bool reused = false;       // kept-alive connection, no handshake
+  uint8_t retries = 0;       // kept connection had been closed by the server
+};
+
+enum AIJobState : uint8_t {
+  AI_JOB_QUEUED = 0,
+  AI_JOB_RUNNING,
+  AI_JOB_DONE,        // ok tells success from failure
+  AI_JOB_CANCELED,
+  AI_JOB_SUPERSEDED,  // a newer prompt replaced it while queued, or applied first
+};
+
+inline const char* aiJobStateName(uint8_t s) {
+  switch (s) {
+    case AI_JOB_QUEUED: return "queued";
+    case AI_JOB_RUNNING: return "running";
+    case AI_JOB_DONE: return "done";
+    case AI_JOB_CANCELED: return "canceled";
+    case AI_JOB_SUPERSEDED: return "superseded";
+    default: return "?";
+  }
+}
+
+// Longest prompt accepted (bytes)
+#ifndef AI_PROMPT_MAX
+#define AI_PROMPT_MAX 256
+#endif
+
+// One prompt and its outcome. Records live in AiWorker's history and are
+// only read or written under its lock.
 struct AIJob {
-  volatile bool running = false;
-  volatile bool done    = false;
-  volatile bool ok      = false;
-  volatile bool canceled = false;
+  uint32_t id = 0;  // 0 = free record
+  uint8_t state = AI_JOB_QUEUED;
+  bool ok = false;
+  bool cached = false;  // answered from AiCache, no request made
+  bool local = false;   // answered by the on-device intent parser
+  uint32_t supersededBy = 0;
 
-  // Prompt requested by user
-  String prompt;
+  char prompt[AI_PROMPT_MAX + 1] = "";
 
   // Applied actions summary OR raw model JSON (truncated) if error
   String appliedSummary;
@@ -24,17 +63,27 @@ struct AIJob {
   // Error message (empty if ok)
   String error;
 
-  // Timestamp (millis) when job started; used for rate limiting
-  unsigned long startedMs = 0;
+  uint32_t queuedMs = 0;
+  uint32_t startedMs = 0;
+  uint32_t finishedMs = 0;
+
+  AITimings timing;
 };
 
-extern AIJob g_aiJob;
+// Burst and refill of the Gemini token bucket (one token per AI_MIN_INTERVAL_MS)
+#ifndef AI_RATE_BURST
+#define AI_RATE_BURST 3
+#endif
 
-// Rate limiting config (milliseconds between job starts)
 #ifndef AI_MIN_INTERVAL_MS
 #define AI_MIN_INTERVAL_MS 4000UL
 #endif
 
+// Finished jobs kept for /aiStatus?id=
+#ifndef AI_JOB_HISTORY
+#define AI_JOB_HISTORY 6
+#endif
+
 // Timeout for a single AI job (safety, ms)
 #ifndef AI_JOB_TIMEOUT_MS
 #define AI_JOB_TIMEOUT_MS 30000UL
@@ -45,6 +94,16 @@ extern AIJob g_aiJob;
 #define AI_MODEL_SNIPPET_MAX 512
 #endif
 
+// Model text kept from a response (the actions JSON; longer answers fail)
+#ifndef AI_TEXT_MAX
+#define AI_TEXT_MAX 2048
+#endif
+
+// Bytes read from the socket at a time while streaming the response
+#ifndef AI_READ_CHUNK
+#define AI_READ_CHUNK 512
+#endif
+
 // Log helper (centralized enable)
 #ifndef AI_DEBUG_LOG
 #define AI_DEBUG_LOG 1
@@ -0,0 +1,170 @@
+#pragma once
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <esp_arduino_version.h>
+#include "ai_state.h"
+
+/*
+  ai_transport.h
+  One long-lived connection to GEMINI_HOST shared by all AI requests.
+  After an answer whose end was read cleanly it stays open (HTTP keep-alive)
+  for AI_KEEPALIVE_MS, so the next prompt skips DNS, TCP and the TLS
+  handshake. For /aiWarm the AI worker opens it ahead of time, when the
+  UI shows the AI panel.
+  A kept connection that the server closed in the meantime only shows up
+  as a missing answer; the caller then retries once on a fresh connection.
+  The TLS session itself is not resumed: the Arduino WiFiClientSecure API
+  does not expose mbedTLS session tickets, so reuse is what saves the handshake.
+  Phase timings go into AITimings for /aiStatus.
+  Include after GEMINI_HOST / GEMINI_PORT are defined (ai_control.h).
+*/
+
+// Idle time after which a kept connection is closed (0 = close after every request)
+#ifndef AI_KEEPALIVE_MS
+#define AI_KEEPALIVE_MS 60000UL
+#endif
+
+namespace AiTransport {
+
+#ifdef GEMINI_PLAIN_HTTP
+typedef WiFiClient ClientT;  // tools/gemini_standin.py without --tls
+#else
+typedef WiFiClientSecure ClientT;
+#endif
+
+struct Stats {
+  uint32_t connects;
+  uint32_t reuses;
+  uint32_t staleRetries;  // kept connection found closed by the server
+  uint32_t idleCloses;
+  uint32_t warmups;
+};
+
+static SemaphoreHandle_t s_lock = nullptr;
+static ClientT* s_client = nullptr;
+static uint32_t s_lastUseMs = 0;
+static Stats s_stats = {};
+static volatile bool s_warming = false;
+static volatile bool s_open = false;  // for status readers that must not touch the socket
+
+inline void begin() {
+  if (!s_lock) s_lock = xSemaphoreCreateMutex();
+}
+
+// Held by whoever uses the connection (AI job, warm-up, idle close)
+class Guard {
+ public:
+  explicit Guard(uint32_t waitMs) : ok_(s_lock && xSemaphoreTake(s_lock, pdMS_TO_TICKS(waitMs)) == pdTRUE) {}
+  ~Guard() { if (ok_) xSemaphoreGive(s_lock); }
+  bool ok() const { return ok_; }
+ private:
+  bool ok_;
+};
+
+inline Client& client() { return *s_client; }
+
+inline bool isOpen() { return s_client && s_client->connected(); }
+
+// Lock held: close the connection (TLS buffers are freed)
+inline void drop() {
+  if (s_client) s_client->stop();
+  s_open = false;
+}
+
+// Lock held: reuse the kept connection or open a new one; false = err set
+inline bool ensure(AITimings& t, String& err) {
+  uint32_t now = millis();
+  if (isOpen() && AI_KEEPALIVE_MS && now - s_lastUseMs < AI_KEEPALIVE_MS) {
+    t.reused = true;
+    s_stats.reuses++;
+    return true;
+  }
+  t.reused = false;
+  if (!s_client) {
+    s_client = new ClientT();
+#ifndef GEMINI_PLAIN_HTTP
+    s_client->setInsecure();
+#endif
+  }
+  s_client->stop();
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+  s_client->setTimeout(15000);  // ms
+#else
+  s_client->setTimeout(15);     // seconds on 2.x
+#endif
+
+  // Resolve first so DNS shows up on its own; connect() then hits the lwIP cache
+  uint32_t t0 = millis();
+  IPAddress ip;
+  if (!WiFi.hostByName(GEMINI_HOST, ip)) { err = "DNS lookup failed"; return false; }
+  t.dnsMs = millis() - t0;
+
+#if !defined(GEMINI_PLAIN_HTTP) && ESP_ARDUINO_VERSION_MAJOR >= 3
+  // TCP first, then the handshake, so both can be timed
+  s_client->setPlainStart();
+  t0 = millis();
+  if (!s_client->connect(GEMINI_HOST, GEMINI_PORT)) { err = "TCP connect failed"; return false; }
+  t.connectMs = millis() - t0;
+  t0 = millis();
+  if (!s_client->startTLS()) { err = "TLS handshake failed"; drop(); return false; }
+  t.tlsMs = millis() - t0;
+#else
+  // 2.x does TCP + TLS in one call: connect_ms includes the handshake
+  t0 = millis();
+  if (!s_client->connect(GEMINI_HOST, GEMINI_PORT)) { err = "TLS connect failed"; return false; }
+  t.connectMs = millis() - t0;
+#endif
+  s_stats.connects++;
+  s_lastUseMs = millis();
+  s_open = true;
+  return true;
+}
+
+// Lock held: request done; keep the connection only if its answer ended cleanly
+inline void release(bool keep) {
+  if (keep && AI_KEEPALIVE_MS) s_lastUseMs = millis();
+  else drop();
+}
+
+// loop(): close a connection that idled out (frees ~40 KB of TLS buffers)
+inline void service(uint32_t now) {
+  if (!s_open || s_warming) return;
+  bool link = WiFi.status() == WL_CONNECTED;
+  if (link && (int32_t)(now - s_lastUseMs) < (int32_t)AI_KEEPALIVE_MS) return;
+  Guard g(0);
+  if (!g.ok()) return;
+  // the worker may have released it after `now` was read: decide on a fresh clock
+  if (!s_open || (link && (int32_t)(millis() - s_lastUseMs) < (int32_t)AI_KEEPALIVE_MS)) return;
+  if (isOpen()) s_stats.idleCloses++;
+  drop();
+}
+
+// Open the connection ahead of a prompt (runs on the AI worker); false = not needed or failed
+inline bool warm() {
+  if (!AI_KEEPALIVE_MS || WiFi.status() != WL_CONNECTED) return false;
+  s_warming = true;
+  bool ok = false;
+  {
+    Guard g(0);
+    AITimings t;
+    String err;
+    if (!g.ok() || (isOpen() && millis() - s_lastUseMs < AI_KEEPALIVE_MS)) {
+      // in use or already warm
+    } else if (ensure(t, err)) {
+      s_stats.warmups++;
+      aiLog("WARM", String("connected in ") + (t.dnsMs + t.connectMs + t.tlsMs) + " ms");
+      ok = true;
+    } else {
+      aiLog("WARM", err);
+    }
+  }
+  s_warming = false;
+  return ok;
+}
+
+inline bool open() { return s_open; }
+inline uint32_t idleMs() { return s_open ? millis() - s_lastUseMs : 0; }
+inline const Stats& stats() { return s_stats; }
+
+}
@@ -0,0 +1,305 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "ai_state.h"
+#include "ai_control.h"
+#include "ai_cache.h"
+#include "intent_parser.h"
+#include "token_bucket.h"
+#include "metrics.h"
+
+/*
+  ai_worker.h
+  One long-lived task runs every Gemini request, so no task is created (and
+  no 16 KB stack allocated) per prompt. Prompts become jobs with ids:
+  - the worker's mailbox holds one queued job; a newer prompt replaces it
+    (newest wins), and an answer is applied only if no newer prompt has
+    applied one in the meantime
+  - requests spend tokens from a bucket (AI_RATE_BURST, one back every
+    AI_MIN_INTERVAL_MS); a job waits for its token instead of being refused
+  - cancel aborts the request on the socket (checked every few ms while
+    waiting for the answer); a TLS handshake in progress still runs out
+  - the last AI_JOB_HISTORY jobs answer /aiStatus?id=
+  Prompts the intent parser or AiCache can answer are applied right away
+  by the web handler and only recorded here.
+*/
+
+#ifndef AI_WORKER_STACK
+#define AI_WORKER_STACK 16384
+#endif
+
+namespace AiWorker {
+
+static const uint32_t kNotifyJob = 1;
+static const uint32_t kNotifyWarm = 2;
+
+struct Stats {
+  uint32_t submitted;
+  uint32_t instant;     // answered by the intent parser or the cache
+  uint32_t superseded;
+  uint32_t canceled;
+  uint32_t rateWaits;   // jobs that had to wait for a token
+};
+
+static AIJob s_jobs[AI_JOB_HISTORY];  // by id % AI_JOB_HISTORY
+static uint32_t s_nextId = 1;
+static uint32_t s_pendingId = 0;  // mailbox: the one queued job
+static uint32_t s_runningId = 0;
+static uint32_t s_appliedId = 0;  // newest job whose actions are on the lamp
+static uint32_t s_waitedId = 0;   // last job counted in rateWaits
+static TokenBucket s_bucket(AI_RATE_BURST, AI_MIN_INTERVAL_MS);
+static Stats s_stats = {};
+static SemaphoreHandle_t s_lock = nullptr;
+static TaskHandle_t s_task = nullptr;
+
+struct Guard {
+  Guard() { if (s_lock) xSemaphoreTake(s_lock, portMAX_DELAY); }
+  ~Guard() { if (s_lock) xSemaphoreGive(s_lock); }
+};
+
+// Caller holds the lock; nullptr once the record has been reused
+static AIJob* find(uint32_t id) {
+  if (!id) return nullptr;
+  AIJob& j = s_jobs[id % AI_JOB_HISTORY];
+  return j.id == id ? &j : nullptr;
+}
+
+static AIJob& newJob(const String& prompt) {
+  uint32_t id = s_nextId++;
+  AIJob& j = s_jobs[id % AI_JOB_HISTORY];
+  j = AIJob();
+  j.id = id;
+  strlcpy(j.prompt, prompt.c_str(), sizeof(j.prompt));
+  j.queuedMs = millis();
+  return j;
+}
+
+static void finish(AIJob& j, uint8_t state) {
+  j.state = state;
+  j.finishedMs = millis();
+}
+
+// Caller holds the lock: the queued job (if any) gives way to job `by`
+static void supersedePending(uint32_t by) {
+  if (AIJob* p = find(s_pendingId)) {
+    p->supersededBy = by;
+    finish(*p, AI_JOB_SUPERSEDED);
+    s_stats.superseded++;
+  }
+  s_pendingId = 0;
+}
+
+// Apply a compiled answer unless a newer job already has; caller holds the lock
+static bool applyIfNewest(uint32_t id, const Actions::Batch& batch, String& appliedLog) {
+  if (id < s_appliedId) return false;
+  Actions::apply(batch, appliedLog);
+  s_appliedId = id;
+  return true;
+}
+
+// Answer from the intent parser or AiCache, applied at once; job id or 0 (ask Gemini)
+uint32_t answerNow(const String& prompt, bool& local) {
+  uint32_t t0 = millis();
+  Actions::Batch batch;
+  local = Intent::parse(prompt, batch);
+  if (!local && !AiCache::lookup(prompt, batch)) return 0;
+
+  Guard g;
+  AIJob& j = newJob(prompt);
+  supersedePending(j.id);
+  j.startedMs = t0;
+  applyIfNewest(j.id, batch, j.appliedSummary);
+  j.local = local;
+  j.cached = !local;
+  j.ok = true;
+  j.timing.totalMs = millis() - t0;
+  finish(j, AI_JOB_DONE);
+  s_stats.instant++;
+  aiLog(local ? "LOCAL" : "CACHE", prompt);
+  return j.id;
+}
+
+// Queue a prompt for Gemini (replacing a queued one); job id, 0 if the worker is not running
+uint32_t submit(const String& prompt) {
+  if (!s_task) return 0;
+  uint32_t id;
+  {
+    Guard g;
+    AIJob& j = newJob(prompt);
+    id = j.id;
+    supersedePending(id);
+    s_pendingId = id;
+    s_stats.submitted++;
+  }
+  xTaskNotify(s_task, kNotifyJob, eSetBits);
+  return id;
+}
+
+// Cancel a queued or running job (0 = the newest of them); false if there is none
+bool cancel(uint32_t id) {
+  Guard g;
+  if (!id) id = s_pendingId ? s_pendingId : s_runningId;
+  AIJob* j = find(id);
+  if (!j) return false;
+  if (j->state == AI_JOB_QUEUED) {
+    j->error = "Canceled";
+    finish(*j, AI_JOB_CANCELED);
+    if (s_pendingId == id) s_pendingId = 0;
+    s_stats.canceled++;
+    return true;
+  }
+  if (j->state == AI_JOB_RUNNING && id == s_runningId) {
+    s_aiAbort = true;  // the worker closes the socket and finishes the record
+    return true;
+  }
+  return false;
+}
+
+// Have the worker open the Gemini connection while it is idle
+bool warm() {
+  if (!s_task) return false;
+  xTaskNotify(s_task, kNotifyWarm, eSetBits);
+  return true;
+}
+
+// Run (or keep waiting for a token for) the queued job; false = nothing queued
+static bool runPending() {
+  uint32_t id, wait;
+  char prompt[AI_PROMPT_MAX + 1];
+  {
+    Guard g;
+    id = s_pendingId;
+    if (!id) return false;
+    AIJob* j = find(id);
+    if (!j) { s_pendingId = 0; return true; }
+    wait = s_bucket.waitMs(millis());
+    if (wait) {
+      if (s_waitedId != id) s_stats.rateWaits++;
+      s_waitedId = id;
+    } else {
+      s_bucket.take(millis());
+      s_pendingId = 0;
+      s_runningId = id;
+      s_aiAbort = false;
+      j->state = AI_JOB_RUNNING;
+      j->startedMs = millis();
+      memcpy(prompt, j->prompt, sizeof(prompt));
+    }
+  }
+  if (wait) {
+    // a newer prompt or a cancel wakes us early; either way look again
+    xTaskNotifyWait(0, 0, nullptr, pdMS_TO_TICKS(wait));
+    return true;
+  }
+
+  aiLog("JOB", String("#") + id + " " + prompt);
+  AIJob r;
+  Actions::Batch batch;
+  uint32_t t0 = micros();
+  bool ok = runGeminiJob(prompt, r, batch);
+  Metrics::record(Metrics::H_GEMINI, micros() - t0);
+  Metrics::count(ok ? Metrics::C_GEMINI_OK : Metrics::C_GEMINI_ERROR);
+  if (ok) AiCache::put(prompt, batch);
+
+  Guard g;
+  bool aborted = s_aiAbort;
+  s_aiAbort = false;
+  s_runningId = 0;
+  uint8_t state = AI_JOB_DONE;
+  if (aborted) {
+    ok = false;
+    state = AI_JOB_CANCELED;
+    s_stats.canceled++;
+  } else if (ok && !applyIfNewest(id, batch, r.appliedSummary)) {
+    state = AI_JOB_SUPERSEDED;  // answered, but a newer prompt is already on the lamp
+    s_stats.superseded++;
+  }
+  aiLog("JOB", String("#") + id + " " + aiJobStateName(state) + (r.error.length() ? ": " + r.error : String()));
+  AIJob* j = find(id);
+  if (!j) return true;  // record reused by newer jobs meanwhile
+  j->ok = ok && state == AI_JOB_DONE;
+  j->appliedSummary = r.appliedSummary;
+  j->modelJsonSnippet = r.modelJsonSnippet;
+  j->error = aborted ? String("Canceled") : r.error;
+  j->timing = r.timing;
+  if (state == AI_JOB_SUPERSEDED) j->supersededBy = s_appliedId;
+  finish(*j, state);
+  return true;
+}
+
+static void workerTask(void*) {
+  for (;;) {
+    uint32_t bits = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+    while (runPending()) {}
+    if (bits & kNotifyWarm) AiTransport::warm();
+  }
+}
+
+void begin() {
+  if (s_task) return;
+  AiTransport::begin();
+  s_lock = xSemaphoreCreateMutex();
+  if (xTaskCreatePinnedToCore(workerTask, "AIWorker", AI_WORKER_STACK, nullptr, 1, &s_task, APP_CPU_NUM) != pdPASS) {
+    s_task = nullptr;
+    Serial.println("[AI] Worker task create failed");
+  }
+}
+
+// Job `id` (0 = newest) into doc; false if unknown
+bool writeStatus(JsonDocument& doc, uint32_t id) {
+  Guard g;
+  uint32_t now = millis();
+  bool newest = !id;
+  if (newest) id = s_nextId - 1;
+  AIJob* j = find(id);
+  if (j) {
+    bool finished = j->state >= AI_JOB_DONE;
+    doc["id"] = j->id;
+    doc["state"] = aiJobStateName(j->state);
+    doc["prompt"] = String(j->prompt);  // copied: the record may change after the lock
+    if (!finished) {
+      doc["running"] = true;  // queued counts as running for pollers
+      doc["queued_ms"] = now - j->queuedMs;
+      if (j->state == AI_JOB_QUEUED) doc["rate_wait_ms"] = s_bucket.waitMs(now);
+    } else {
+      doc["done"] = true;
+      doc["ok"] = j->ok;
+      doc["applied"] = j->appliedSummary;
+      doc["error"] = j->error;
+      doc["model_snippet"] = j->modelJsonSnippet;
+      doc["canceled"] = j->state == AI_JOB_CANCELED;
+      doc["cached"] = j->cached;
+      doc["local"] = j->local;
+      if (j->supersededBy) doc["superseded_by"] = j->supersededBy;
+      doc["duration_ms"] = j->finishedMs - j->queuedMs;
+      const AITimings& t = j->timing;
+      JsonObject tm = doc.createNestedObject("timing");
+      tm["dns_ms"] = t.dnsMs;
+      tm["connect_ms"] = t.connectMs;
+      tm["tls_ms"] = t.tlsMs;
+      tm["send_ms"] = t.sendMs;
+      tm["first_byte_ms"] = t.firstByteMs;
+      tm["body_ms"] = t.bodyMs;
+      tm["total_ms"] = t.totalMs;
+      tm["reused"] = t.reused;
+      tm["retries"] = t.retries;
+    }
+  } else if (s_nextId == 1) {
+    doc["idle"] = true;
+  }
+
+  JsonObject w = doc.createNestedObject("worker");
+  w["pending"] = s_pendingId;
+  w["running"] = s_runningId;
+  w["tokens"] = s_bucket.tokens(now);
+  w["burst"] = s_bucket.burst();
+  w["submitted"] = s_stats.submitted;
+  w["instant"] = s_stats.instant;
+  w["superseded"] = s_stats.superseded;
+  w["canceled"] = s_stats.canceled;
+  w["rate_waits"] = s_stats.rateWaits;
+  return j || newest;
+}
+
+}
@@ -0,0 +1,237 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <ArduinoJson.h>
+#include "led_control.h"
+#include "status_cache.h"
+#include "action_engine.h"
+#include "effect_names.h"
+#include "intent_parser.h"
+#include "gemini_stream.h"
+#include "lux_packet.h"
+#include "ai_state.h"
+
+/*
+  bench.h
+  On-device microbenchmarks of the per-request and per-frame paths, served
+  at GET /bench when built with ENABLE_BENCH. Each case reports ns/op and
+  the heap it keeps (net bytes and blocks per op, from the 8-bit heap's
+  counters). With BENCH_ALLOC_HOOKS every allocation is also counted,
+  including the transient ones freed within the op: on the lamp that needs
+  an IDF built with CONFIG_HEAP_USE_HOOKS; the host bench (host/bench)
+  interposes malloc instead and also gets the peak heap of a case.
+  Other tasks keep running, so take the best of a few runs.
+  tools/bench.py fetches the results and keeps or compares a JSON baseline.
+*/
+
+#ifndef ENABLE_BENCH
+#define ENABLE_BENCH 0
+#endif
+
+// Per case: stop after this many iterations or this much time
+#ifndef BENCH_ITERS_MAX
+#define BENCH_ITERS_MAX 5000
+#endif
+#ifndef BENCH_CASE_US
+#define BENCH_CASE_US 200000
+#endif
+
+// Count every allocation through the heap hooks (see above)
+#ifndef BENCH_ALLOC_HOOKS
+#ifdef CONFIG_HEAP_USE_HOOKS
+#define BENCH_ALLOC_HOOKS 1
+#else
+#define BENCH_ALLOC_HOOKS 0
+#endif
+#endif
+
+namespace Bench {
+
+struct Result {
+  const char* name;
+  uint32_t iters;
+  uint32_t nsPerOp;
+  int32_t heapBytes;   // net, whole run
+  int32_t heapBlocks;
+  int32_t allocs;      // allocations, whole run (-1: no hooks)
+  int32_t peakBytes;   // most heap above the start at any point (-1: unknown)
+};
+
+// Fed by the allocator hooks. Frees only move the live count where the hook
+// knows their size (s_sizedFrees); the IDF free hook does not.
+static std::atomic<uint32_t> s_allocs{ 0 };
+static std::atomic<int32_t> s_liveBytes{ 0 };
+static std::atomic<int32_t> s_peakBytes{ 0 };
+static bool s_sizedFrees = false;
+
+void noteAlloc(size_t size) {
+  s_allocs.fetch_add(1, std::memory_order_relaxed);
+  int32_t live = s_liveBytes.fetch_add((int32_t)size, std::memory_order_relaxed) + (int32_t)size;
+  if (live > s_peakBytes.load(std::memory_order_relaxed)) s_peakBytes.store(live, std::memory_order_relaxed);
+}
+
+void noteFree(size_t size) {
+  s_liveBytes.fetch_sub((int32_t)size, std::memory_order_relaxed);
+}
+
+static void heapNow(size_t& bytes, size_t& blocks) {
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+  bytes = info.total_allocated_bytes;
+  blocks = info.allocated_blocks;
+}
+
+template <typename F>
+Result run(const char* name, uint32_t iters, F fn) {
+  fn();  // first call outside the numbers (lazy init, caches)
+  size_t b0, k0, b1, k1;
+  heapNow(b0, k0);
+  uint32_t a0 = s_allocs.load(std::memory_order_relaxed);
+  int32_t live0 = s_liveBytes.load(std::memory_order_relaxed);
+  s_peakBytes.store(live0, std::memory_order_relaxed);
+  int64_t t0 = esp_timer_get_time();
+  uint32_t n = 0;
+  while (n < iters) {
+    fn();
+    ++n;
+    if ((n & 15) == 0 && esp_timer_get_time() - t0 >= BENCH_CASE_US) break;
+  }
+  int64_t us = esp_timer_get_time() - t0;
+  heapNow(b1, k1);
+  Result r;
+  r.name = name;
+  r.iters = n;
+  r.nsPerOp = (uint32_t)(us * 1000 / n);
+  r.heapBytes = (int32_t)(b1 - b0);
+  r.heapBlocks = (int32_t)(k1 - k0);
+  r.allocs = BENCH_ALLOC_HOOKS ? (int32_t)(s_allocs.load(std::memory_order_relaxed) - a0) : -1;
+  r.peakBytes = BENCH_ALLOC_HOOKS && s_sizedFrees ? s_peakBytes.load(std::memory_order_relaxed) - live0 : -1;
+  return r;
+}
+
+// Sample inputs, built once
+static const char kActions[] =
+  "{\"actions\":[{\"type\":\"set_color\",\"hex\":\"#FF8800\"},"
+  "{\"type\":\"set_effect\",\"name\":\"Fire Flicker (Soft)\"},{\"type\":\"set_brightness\",\"value\":96}]}";
+static const char kGemini[] =
+  "{\"candidates\":[{\"content\":{\"parts\":[{\"text\":\"{\\\"actions\\\":[{\\\"type\\\":\\\"set_color\\\","
+  "\\\"hex\\\":\\\"#FF8800\\\"},{\\\"type\\\":\\\"set_brightness\\\",\\\"value\\\":96}]}\"}],\"role\":\"model\"},"
+  "\"finishReason\":\"STOP\",\"index\":0}],\"usageMetadata\":{\"promptTokenCount\":812,\"totalTokenCount\":853}}";
+
+// Run the cases whose name contains `filter` ("" = all); returns the count written
+size_t runAll(const char* filter, uint32_t iters, Result* out, size_t cap) {
+  if (!iters || iters > BENCH_ITERS_MAX) iters = BENCH_ITERS_MAX;
+  size_t n = 0;
+  auto want = [&](const char* name) { return n < cap && strstr(name, filter) != nullptr; };
+  volatile uint32_t sink = 0;  // keeps results alive
+
+  if (want("led_tick")) out[n++] = run("led_tick", iters, [] { LedControl::tick(16667); });
+  if (want("status_render")) {
+    static char buf[STATUS_JSON_MAX];
+    out[n++] = run("status_render", iters, [&] { sink += LedControl::formatStatus(buf, sizeof(buf), "STA"); });
+  }
+  if (want("status_hit")) {
+    // what /status costs while nothing changes: a pinned cache hit
+    out[n++] = run("status_hit", iters, [&] {
+      StatusCache::Pin pin;
+      sink += pin->len;
+    });
+  }
+  if (want("hex_to_color")) {
+    String hex("#FF8800");
+    out[n++] = run("hex_to_color", iters, [&] { sink += LedControl::hexToColor(hex); });
+  }
+  if (want("actions_compile")) {
+    // compile only: apply would write the settings to flash
+    out[n++] = run("actions_compile", iters, [&] {
+      Actions::Batch b;
+      String err;
+      sink += Actions::compileText(kActions, sizeof(kActions) - 1, b, err);
+    });
+  }
+  if (want("actions_compile_max")) {
+    // a full batch, plus as much ignored payload again: throughput and the
+    // document's peak at the size limit
+    static char big[ACTION_DOC_MAX / 2];
+    static size_t len = 0;
+    if (!len) {
+      len = snprintf(big, sizeof(big), "{\"transition_ms\":400,\"actions\":[");
+      for (int i = 0; i < ACTION_BATCH_MAX; ++i) {
+        len += snprintf(big + len, sizeof(big) - len,
+                        i % 2 ? "%s{\"type\":\"set_effect\",\"name\":\"Fire Flicker (Soft)\"}"
+                              : "%s{\"type\":\"set_color\",\"hex\":\"#FF8800\",\"transition_ms\":1500}",
+                        i ? "," : "");
+      }
+      len += snprintf(big + len, sizeof(big) - len, "],\"note\":\"");
+      while (len + 3 < sizeof(big)) big[len++] = 'x';
+      len += snprintf(big + len, sizeof(big) - len, "\"}");
+    }
+    out[n++] = run("actions_compile_max", iters, [&] {
+      Actions::Batch b;
+      String err;
+      sink += Actions::compileText(big, len, b, err) ? b.count : 0;
+    });
+  }
+  if (want("gemini_extract")) {
+    static char text[AI_TEXT_MAX + 1];
+    out[n++] = run("gemini_extract", iters, [&] {
+      GeminiStream::TextExtractor ext(text, sizeof(text));
+      ext.feed((const uint8_t*)kGemini, sizeof(kGemini) - 1);
+      sink += ext.length();
+    });
+  }
+  if (want("effect_lookup")) out[n++] = run("effect_lookup", iters, [&] { sink += effectIdFromName("Fire Flicker (Soft)"); });
+  if (want("intent_parse")) {
+    out[n++] = run("intent_parse", iters, [&] {
+      Actions::Batch b;
+      sink += Intent::parse("make it warm white at 30%", 25, b);
+    });
+  }
+  if (want("lux_decode")) {
+    LuxWire::Frame f = {};
+    f.type = LuxWire::T_SAMPLES;
+    f.flags = LuxWire::F_CRC;
+    f.nodeId = 7;
+    f.count = 3;
+    for (uint8_t i = 0; i < f.count; ++i) f.samples[i] = { 120.5f + i, LuxWire::M_VALID, (uint16_t)(i * 500) };
+    static uint8_t frame[LuxWire::kMaxFrame];
+    size_t len = LuxWire::encode(f, frame, sizeof(frame));
+    out[n++] = run("lux_decode", iters, [&] {
+      LuxWire::Frame d;
+      sink += LuxWire::decode(frame, len, d) == LuxWire::OK ? d.count : 0;
+    });
+  }
+  (void)sink;
+  return n;
+}
+
+// The /bench document (tools/bench.py reads it); per-op figures are averages
+void toJson(const Result* res, size_t n, JsonDocument& doc) {
+  doc["cpu_mhz"] = getCpuFrequencyMhz();
+  JsonArray a = doc.createNestedArray("results");
+  for (size_t i = 0; i < n; ++i) {
+    JsonObject o = a.createNestedObject();
+    o["name"] = res[i].name;
+    o["iters"] = res[i].iters;
+    o["ns_per_op"] = res[i].nsPerOp;
+    o["heap_bytes_per_op"] = (float)res[i].heapBytes / res[i].iters;
+    o["blocks_per_op"] = (float)res[i].heapBlocks / res[i].iters;
+    if (res[i].allocs >= 0) o["allocs_per_op"] = (float)res[i].allocs / res[i].iters;
+    if (res[i].peakBytes >= 0) o["peak_bytes"] = res[i].peakBytes;
+  }
+}
+
+}
+
+#if BENCH_ALLOC_HOOKS && defined(ESP_PLATFORM)
+// IDF heap hooks (CONFIG_HEAP_USE_HOOKS); they run inside every malloc/free
+extern "C" IRAM_ATTR void esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) {
+  (void)caps;
+  if (ptr) Bench::noteAlloc(size);
+}
+extern "C" IRAM_ATTR void esp_heap_trace_free_hook(void* ptr) {
+  (void)ptr;
+}
+#endif
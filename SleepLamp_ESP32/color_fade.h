@@ -0,0 +1,95 @@
+#pragma once
+// Timed color/brightness crossfades in fixed point (no Arduino deps).
+// LED duty is linear light, so fading it linearly looks fast at the dark end
+// and flat at the bright end. Values are mixed in CIE L* instead: two tables
+// baked at compile time map duty (0..255) to lightness (Q12) and back, and a
+// frame costs a table read, a multiply and a shift per channel.
+
+#include <stdint.h>
+#include "ct_math.h"
+
+namespace ColorFade {
+
+static const uint16_t kLMax = 4095;  // lightness 100 in Q12
+static const uint16_t kBins = 256;   // inverse table: 16 lightness steps per bin
+
+// CIE L* (0..1) of linear light y (0..1), and back
+constexpr double lightness(double y) {
+  return y > 216.0 / 24389.0 ? (116.0 * CtMath::pow(y, 1.0 / 3.0) - 16.0) / 100.0 : y * (24389.0 / 27.0) / 100.0;
+}
+constexpr double cubed(double f) { return f * f * f; }
+constexpr double linear(double l) {
+  return l > 0.08 ? cubed((l * 100.0 + 16.0) / 116.0) : l * 100.0 * (27.0 / 24389.0);
+}
+
+struct ToL { uint16_t q12[256]; };
+struct FromL { uint16_t q8[kBins + 1]; };  // duty * 256
+
+constexpr uint16_t toLQ12(uint16_t v) {
+  return (uint16_t)(lightness(v / 255.0) * kLMax + 0.5);
+}
+constexpr uint16_t fromLQ8(uint16_t i) {
+  return (uint16_t)(linear(i / (double)kBins) * 255.0 * 256.0 + 0.5);
+}
+template <uint16_t... I>
+constexpr ToL makeToL(CtMath::Seq<I...>) {
+  return ToL{ { toLQ12(I)... } };
+}
+template <uint16_t... I>
+constexpr FromL makeFromL(CtMath::Seq<I...>) {
+  return FromL{ { fromLQ8(I)... } };
+}
+
+static constexpr ToL kToL = makeToL(CtMath::MakeSeq<256>::type());
+static constexpr FromL kFromL = makeFromL(CtMath::MakeSeq<kBins + 1>::type());
+
+static_assert(kToL.q12[0] == 0 && kToL.q12[255] == kLMax, "lightness table endpoints");
+static_assert(kFromL.q8[0] == 0 && kFromL.q8[kBins] == 255 * 256, "inverse table endpoints");
+
+inline uint16_t toL(uint8_t v) { return kToL.q12[v]; }
+
+// Lightness (Q12, clamped) back to duty; linear between table entries
+inline uint8_t fromL(uint16_t l) {
+  if (l >= kLMax) return 255;
+  uint32_t pos = (uint32_t)l * kBins;  // bin index in the high 12 bits
+  uint16_t i = (uint16_t)(pos / kLMax);
+  uint32_t frac = (pos % kLMax) * 256u / kLMax;
+  uint32_t a = kFromL.q8[i];
+  uint32_t b = kFromL.q8[i + 1];
+  return (uint8_t)((a * 256u + (b - a) * frac + 32768u) >> 16);
+}
+
+// One channel at progress t (0..65536)
+inline uint8_t mix(uint8_t a, uint8_t b, uint32_t t) {
+  if (t >= 65536u) return b;
+  int32_t la = toL(a);
+  int32_t lb = toL(b);
+  return fromL((uint16_t)(la + (((lb - la) * (int32_t)t) >> 16)));
+}
+
+inline uint32_t mixRgb(uint32_t a, uint32_t b, uint32_t t) {
+  return ((uint32_t)mix((uint8_t)(a >> 16), (uint8_t)(b >> 16), t) << 16) |
+         ((uint32_t)mix((uint8_t)(a >> 8), (uint8_t)(b >> 8), t) << 8) |
+         mix((uint8_t)a, (uint8_t)b, t);
+}
+
+// Progress of one fade, advanced by frame time (durations up to 65 s)
+struct Ramp {
+  uint16_t durMs = 0;  // 0 = idle
+  uint32_t elapsedUs = 0;
+
+  bool active() const { return durMs != 0; }
+  void start(uint16_t ms) { durMs = ms; elapsedUs = 0; }
+  void stop() { durMs = 0; }
+
+  // Progress after dtUs more, 0..65536; reaching 65536 ends the ramp
+  uint32_t advance(uint32_t dtUs) {
+    if (!durMs) return 65536u;
+    elapsedUs += dtUs;
+    uint32_t ms = elapsedUs / 1000;
+    if (ms >= durMs) { durMs = 0; return 65536u; }
+    return (ms << 16) / durMs;
+  }
+};
+
+}
@@ -26,17 +26,34 @@
 #define PREF_KEY_ON "on"
 #define PREF_KEY_MIMIR "mimir"
 #define PREF_KEY_PRESENCE "presence"
+#define PREF_KEY_MIMIR_MIN "mimir_min"
+#define PREF_KEY_MIMIR_MAX "mimir_max"
+#define PREF_KEY_MIMIR_CURVE "mimir_curve"  // packed MimirCurve::Point[]
 #define PREF_KEY_WIFI_MODE "wifiMode"  // "AP" or "STA"
 #define PREF_KEY_STA_SSID "staSsid"
 #define PREF_KEY_STA_PASS "staPass"
+#define PREF_KEY_STATE "state"  // versioned settings blob (persist.h); keys above are legacy
 
 // Brightness smoothing
-#define SMOOTHING_ALPHA 0.15f  // smoothing factor (0..1)
+#define SMOOTHING_TAU_MS 120.0f  // time constant (ms): ~63% of the way per tau
 #define BRIGHTNESS_MIN 0
 #define BRIGHTNESS_MAX 255
 
+// Color crossfade (color_fade.h); actions can set their own with transition_ms
+#define COLOR_FADE_MS 400       // setColor default; 0 = switch at once
+#define COLOR_FADE_MAX_MS 60000
+
 // Mimir mapping parameters
 #define LUX_MIN 0.0f
 #define LUX_MAX 400.0f
 #define MIMIR_BRIGHT_MIN 6    // dim minimum for sleep
-#define MIMIR_BRIGHT_MAX 180  // cap brightness
\ No newline at end of file
+#define MIMIR_BRIGHT_MAX 180  // cap brightness
+
+// Render task (LED frames run here, not in loop())
+#define RENDER_FPS 60
+#define RENDER_TASK_CORE 1      // APP_CPU; Wi-Fi/AsyncTCP live on core 0
+#define RENDER_TASK_PRIO 2      // above loopTask (1)
+#define RENDER_TASK_STACK 4096
+
+// Diagnostics
+#define ENABLE_BENCH 0  // 1 = GET /bench microbenchmarks (tools/bench.py); off in normal builds
@@ -0,0 +1,41 @@
+#pragma once
+// Compile-time math helpers (constexpr, C++11-safe) for baking lookup tables.
+// Only meant for constant expressions; runtime code should use the tables.
+
+#include <stdint.h>
+
+namespace CtMath {
+
+static constexpr double kLn2 = 0.69314718055994530942;
+
+// ln(m) for m in [1,2): 2*atanh(z), z=(m-1)/(m+1) <= 1/3, 24 odd terms
+constexpr double lnSeries(double z2, double term, int k) {
+  return k > 47 ? 0.0 : term / k + lnSeries(z2, term * z2, k + 2);
+}
+constexpr double lnReduced(double m) {
+  return 2.0 * lnSeries(((m - 1.0) / (m + 1.0)) * ((m - 1.0) / (m + 1.0)), (m - 1.0) / (m + 1.0), 1);
+}
+constexpr double lnScale(double x, int k) {
+  return x < 1.0 ? lnScale(x * 2.0, k - 1) : (x >= 2.0 ? lnScale(x * 0.5, k + 1) : k * kLn2 + lnReduced(x));
+}
+constexpr double ln(double x) { return lnScale(x, 0); }
+
+// e^y via Taylor series; fine for |y| < ~8 which covers every table we bake
+constexpr double expSeries(double y, double term, int n) {
+  return n > 48 ? term : term + expSeries(y, term * y / n, n + 1);
+}
+constexpr double exp(double y) { return expSeries(y, 1.0, 1); }
+
+// x^p for x > 0 (0 -> 0)
+constexpr double pow(double x, double p) { return x <= 0.0 ? 0.0 : exp(p * ln(x)); }
+
+constexpr uint16_t toQ16(double v) {
+  return v <= 0.0 ? 0 : (v >= 1.0 ? 65535 : (uint16_t)(v * 65535.0 + 0.5));
+}
+
+// Index pack for building constexpr arrays without C++14 std::index_sequence
+template <uint16_t... I> struct Seq {};
+template <uint16_t N, uint16_t... I> struct MakeSeq : MakeSeq<N - 1, N - 1, I...> {};
+template <uint16_t... I> struct MakeSeq<0, I...> { typedef Seq<I...> type; };
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+// Effect name -> WS2812FX mode id (names normalized: lowercase alnum only).
+// Looked up through a compile-time perfect hash (name_hash.h): no scans, no heap.
+
+#include "name_hash.h"
+
+static constexpr NameHash::Entry EFFECT_KV[] = {
+  {"static",0},{"blink",1},{"breath",2},{"colorwipe",3},{"colorwipeinv",4},{"colorwiperev",5},{"colorwiperevinv",6},
+  {"colorwiperandom",7},{"randomcolor",8},{"singledynamic",9},{"multidynamic",10},{"rainbow",11},{"rainbowcycle",12},
+  {"scan",13},{"dualscan",14},{"fade",15},{"theaterchase",16},{"theaterchaserainbow",17},{"runninglights",18},
+  {"twinkle",19},{"twinklerandom",20},{"twinklefade",21},{"twinklefaderandom",22},{"sparkle",23},{"flashsparkle",24},
+  {"hypersparkle",25},{"strobe",26},{"stroberainbow",27},{"multistrobe",28},{"blinkrainbow",29},{"chasewhite",30},
+  {"chasecolor",31},{"chaserandom",32},{"chaserainbow",33},{"chaseflash",34},{"chaseflashrandom",35},
+  {"chaserainbowwhite",36},{"chaseblackout",37},{"chaseblackoutrainbow",38},{"colorsweeprandom",39},
+  {"runningcolor",40},{"runningredblue",41},{"runningrandom",42},{"larsonscanner",43},{"comet",44},{"fireworks",45},
+  {"fireworksrandom",46},{"merrychristmas",47},{"fireflicker",48},{"fireflickersoft",49},{"fireflickerintense",50},
+  {"circuscombustus",51},{"halloween",52},{"bicolorchase",53},{"tricolorchase",54},{"icu",55},
+  // common synonyms
+  {"rainbowwheel",12},{"wheel",12},{"cycle",12},{"scanner",43},{"knightrider",43},{"cylon",43},{"police",41},
+  {"fire",48},{"candle",49}
+};
+
+static const uint8_t kEffectNames = sizeof(EFFECT_KV) / sizeof(EFFECT_KV[0]);
+static const uint16_t kEffectSlots = 256;
+static const uint32_t kEffectSeed = 0x811CAE05;
+
+static_assert(kEffectNames < NameHash::kEmpty, "effect index must fit in a byte");
+
+static constexpr NameHash::Slots<kEffectSlots> EFFECT_SLOTS =
+  NameHash::makeSlots<kEffectSlots>(EFFECT_KV, kEffectNames, kEffectSeed, CtMath::MakeSeq<kEffectSlots>::type());
+
+static_assert(NameHash::perfect(EFFECT_KV, kEffectNames, kEffectSeed, EFFECT_SLOTS),
+              "effect names must be normalized and unique; if they are, change kEffectSeed");
+
+// Id for an already normalized name, -1 if unknown
+static int effectIdFromKey(char* key) {
+  // "theatre" -> "theater" (oi it's chewsday innit)
+  char* t = strstr(key, "theatre");
+  if (t) { t[5] = 'e'; t[6] = 'r'; }
+  int i = NameHash::find(EFFECT_KV, EFFECT_SLOTS, kEffectSeed, key);
+  return i < 0 ? -1 : (int)EFFECT_KV[i].value;
+}
+
+static int effectIdFromName(const char* name) {
+  char key[32];
+  if (!NameHash::normalize(name, strlen(name), key, sizeof(key))) return -1;
+  return effectIdFromKey(key);
+}
@@ -0,0 +1,95 @@
+#pragma once
+// Fixed-rate frame scheduler (no Arduino deps, driven by any microsecond clock).
+// Tracks the ideal deadline of each frame so dt, jitter and overruns can be
+// measured; the render task feeds it micros(), a simulation can feed a fake clock.
+// TickPacer turns the frame period into RTOS tick increments for vTaskDelayUntil.
+
+#include <stdint.h>
+
+struct FrameStats {
+  uint32_t frames = 0;
+  uint32_t overruns = 0;      // frames whose work ran past the next deadline
+  uint32_t lastDtUs = 0;      // time between the last two frame starts
+  uint32_t lastJitterUs = 0;  // |actual start - deadline| of the last frame
+  uint32_t avgJitterUs = 0;   // EWMA (1/16)
+  uint32_t maxJitterUs = 0;
+  uint32_t lastWorkUs = 0;
+  uint32_t avgWorkUs = 0;     // EWMA (1/16)
+  uint32_t maxWorkUs = 0;
+};
+
+struct FrameScheduler {
+  uint32_t periodUs = 16667;
+  uint32_t deadlineUs = 0;  // scheduled start of the current/next frame
+  uint32_t startUs = 0;     // actual start of the current frame
+  bool started = false;
+  FrameStats stats;
+
+  void begin(uint32_t nowUs, uint16_t fps) {
+    periodUs = 1000000UL / (fps ? fps : 1);
+    deadlineUs = nowUs;
+    startUs = nowUs;
+    started = false;
+    stats = FrameStats();
+  }
+
+  // Call at the start of a frame; returns dt (us) since the previous frame
+  uint32_t frameStart(uint32_t nowUs) {
+    uint32_t dt = started ? (uint32_t)(nowUs - startUs) : periodUs;
+    int32_t late = (int32_t)(nowUs - deadlineUs);
+    uint32_t jitter = (uint32_t)(late < 0 ? -late : late);
+
+    started = true;
+    startUs = nowUs;
+    stats.frames++;
+    stats.lastDtUs = dt;
+    stats.lastJitterUs = jitter;
+    stats.avgJitterUs += ((int32_t)jitter - (int32_t)stats.avgJitterUs) / 16;
+    if (jitter > stats.maxJitterUs) stats.maxJitterUs = jitter;
+    return dt;
+  }
+
+  // Call when the frame's work is done; returns how long to sleep (us).
+  // On overrun the schedule is re-anchored to now instead of bursting frames.
+  uint32_t frameEnd(uint32_t nowUs) {
+    uint32_t work = (uint32_t)(nowUs - startUs);
+    stats.lastWorkUs = work;
+    stats.avgWorkUs += ((int32_t)work - (int32_t)stats.avgWorkUs) / 16;
+    if (work > stats.maxWorkUs) stats.maxWorkUs = work;
+
+    deadlineUs += periodUs;
+    int32_t remaining = (int32_t)(deadlineUs - nowUs);
+    if (remaining <= 0) {
+      stats.overruns++;
+      deadlineUs = nowUs;
+      return 0;
+    }
+    return (uint32_t)remaining;
+  }
+
+  // Start the schedule over at nowUs (the caller slept past an overrun)
+  void restart(uint32_t nowUs) { deadlineUs = nowUs; }
+
+  void resetMax() {
+    stats.maxJitterUs = 0;
+    stats.maxWorkUs = 0;
+  }
+};
+
+// Whole-tick sleeps for a period that is not a multiple of the RTOS tick.
+// The remainder is carried, so 16666 us on a 1 ms tick gives 16, 17, 17, ...
+// and a delay-until loop keeps the exact average rate instead of drifting.
+struct TickPacer {
+  uint32_t tickUs = 1000;
+  uint32_t carryUs = 0;
+
+  // Ticks until the next frame
+  uint32_t next(uint32_t periodUs) {
+    carryUs += periodUs;
+    uint32_t n = carryUs / tickUs;
+    carryUs -= n * tickUs;
+    return n;
+  }
+
+  void reset() { carryUs = 0; }
+};
@@ -0,0 +1,401 @@
+#pragma once
+// Streaming Gemini response handling (no Arduino deps).
+// ChunkedDecoder undoes HTTP/1.1 chunked transfer encoding in place, and
+// TextExtractor scans the JSON body a byte at a time. It copies only the
+// string values at candidates[0].content.parts[*].text, unescaped to UTF-8,
+// into a caller-owned buffer. The body is never held in memory: the cost is
+// the output buffer plus a few dozen bytes of state, whatever the response size.
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace GeminiStream {
+
+class ChunkedDecoder {
+ public:
+  // Decode n bytes in place (payload is never longer than its encoding);
+  // returns how many payload bytes are now at the start of buf
+  size_t feed(uint8_t* buf, size_t n) {
+    size_t out = 0;
+    for (size_t i = 0; i < n && st_ != DONE && st_ != FAIL; ++i) {
+      uint8_t c = buf[i];
+      switch (st_) {
+        case SIZE: {
+          int d = hexVal(c);
+          if (d >= 0) {
+            if (size_ > 0x0FFFFFFFu) { st_ = FAIL; break; }
+            size_ = size_ * 16 + (uint32_t)d;
+            digits_++;
+          } else if (c == ';' || c == ' ' || c == '\t') {
+            st_ = EXT;
+          } else if (c == '\r') {
+            st_ = SIZE_LF;
+          } else if (c == '\n') {
+            endSizeLine();
+          } else {
+            st_ = FAIL;
+          }
+          break;
+        }
+        case EXT:
+          if (c == '\r') st_ = SIZE_LF;
+          else if (c == '\n') endSizeLine();
+          break;
+        case SIZE_LF:
+          if (c == '\n') endSizeLine();
+          else st_ = FAIL;
+          break;
+        case DATA: {
+          size_t k = n - i;
+          if (k > left_) k = left_;
+          for (size_t j = 0; j < k; ++j) buf[out++] = buf[i + j];
+          left_ -= (uint32_t)k;
+          i += k - 1;
+          if (!left_) st_ = DATA_CR;
+          break;
+        }
+        case DATA_CR:
+          if (c == '\r') st_ = DATA_LF;
+          else if (c == '\n') nextChunk();
+          else st_ = FAIL;
+          break;
+        case DATA_LF:
+          if (c == '\n') nextChunk();
+          else st_ = FAIL;
+          break;
+        case TRAILER_START:
+          if (c == '\r') st_ = FINAL_LF;
+          else if (c == '\n') st_ = DONE;
+          else st_ = TRAILER_LINE;
+          break;
+        case TRAILER_LINE:
+          if (c == '\n') st_ = TRAILER_START;
+          break;
+        case FINAL_LF:
+          st_ = c == '\n' ? DONE : FAIL;
+          break;
+        default:
+          break;
+      }
+    }
+    payload_ += out;
+    return out;
+  }
+
+  bool done() const { return st_ == DONE; }
+  bool failed() const { return st_ == FAIL; }
+  uint32_t payloadBytes() const { return payload_; }
+
+ private:
+  enum State : uint8_t { SIZE, EXT, SIZE_LF, DATA, DATA_CR, DATA_LF, TRAILER_START, TRAILER_LINE, FINAL_LF, DONE, FAIL };
+  State st_ = SIZE;
+  uint32_t size_ = 0;
+  uint32_t left_ = 0;
+  uint32_t payload_ = 0;
+  uint8_t digits_ = 0;
+
+  static int hexVal(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+
+  void endSizeLine() {
+    if (!digits_) { st_ = FAIL; return; }
+    if (!size_) { st_ = TRAILER_START; return; }
+    left_ = size_;
+    st_ = DATA;
+  }
+
+  void nextChunk() {
+    size_ = 0;
+    digits_ = 0;
+    st_ = SIZE;
+  }
+};
+
+// Path of the wanted strings: candidates[0].content.parts[*].text
+class TextExtractor {
+ public:
+  // out holds cap bytes including the terminating NUL
+  TextExtractor(char* out, size_t cap) : out_(out), cap_(cap) {
+    if (cap_) out_[0] = '\0';
+  }
+
+  void feed(const uint8_t* p, size_t n) {
+    for (size_t i = 0; i < n && st_ != DONE && st_ != FAIL; ++i) step(p[i]);
+  }
+
+  size_t length() const { return len_; }
+  bool truncated() const { return truncated_; }
+  // Root object closed: the rest of the body cannot add text
+  bool complete() const { return st_ == DONE; }
+  bool failed() const { return st_ == FAIL; }
+  uint16_t parts() const { return parts_; }
+
+ private:
+  static const uint8_t kMaxDepth = 16;
+  static const uint8_t kPathLen = 6;
+
+  enum State : uint8_t { VALUE, KEY_OR_END, KEY, KEY_ESC, COLON, AFTER, STR, STR_ESC, STR_HEX, LITERAL, DONE, FAIL };
+
+  struct Frame {
+    bool array;
+    bool ok;  // this container and all above it are on the wanted path
+    uint16_t index;
+  };
+
+  char* out_;
+  size_t cap_;
+  size_t len_ = 0;
+  bool truncated_ = false;
+  uint16_t parts_ = 0;
+  State st_ = VALUE;
+  Frame stack_[kMaxDepth];
+  uint8_t depth_ = 0;
+  bool capture_ = false;
+  // key being read, matched against the path as it arrives
+  uint8_t keyPos_ = 0;
+  bool keyMatch_ = false;
+  // \uXXXX
+  uint8_t hexCount_ = 0;
+  uint16_t hex_ = 0;
+  uint16_t high_ = 0;  // pending high surrogate
+
+  static const char* pathKey(uint8_t level) {
+    switch (level) {
+      case 0: return "candidates";
+      case 2: return "content";
+      case 3: return "parts";
+      case 5: return "text";
+      default: return nullptr;  // 1 and 4 are arrays
+    }
+  }
+
+  bool parentOk() const { return depth_ < 2 || stack_[depth_ - 2].ok; }
+
+  // Re-evaluate the top frame after its key or index changed
+  void updateTop(bool keyOk) {
+    Frame& f = stack_[depth_ - 1];
+    uint8_t level = depth_ - 1;
+    if (level >= kPathLen || !parentOk()) {
+      f.ok = false;
+    } else if (f.array) {
+      f.ok = pathKey(level) == nullptr && (level == 4 || f.index == 0);
+    } else {
+      f.ok = pathKey(level) != nullptr && keyOk;
+    }
+  }
+
+  void push(bool array) {
+    if (depth_ >= kMaxDepth) { st_ = FAIL; return; }
+    Frame& f = stack_[depth_++];
+    f.array = array;
+    f.index = 0;
+    f.ok = false;
+    if (array) updateTop(false);
+    st_ = array ? VALUE : KEY_OR_END;
+  }
+
+  void pop() {
+    depth_--;
+    st_ = depth_ ? AFTER : DONE;
+  }
+
+  void emit(char c) {
+    if (len_ + 1 < cap_) {
+      out_[len_++] = c;
+      out_[len_] = '\0';
+    } else {
+      truncated_ = true;
+    }
+  }
+
+  void emitCodepoint(uint32_t cp) {
+    if (cp < 0x80) {
+      emit((char)cp);
+    } else if (cp < 0x800) {
+      emit((char)(0xC0 | (cp >> 6)));
+      emit((char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+      emit((char)(0xE0 | (cp >> 12)));
+      emit((char)(0x80 | ((cp >> 6) & 0x3F)));
+      emit((char)(0x80 | (cp & 0x3F)));
+    } else {
+      emit((char)(0xF0 | (cp >> 18)));
+      emit((char)(0x80 | ((cp >> 12) & 0x3F)));
+      emit((char)(0x80 | ((cp >> 6) & 0x3F)));
+      emit((char)(0x80 | (cp & 0x3F)));
+    }
+  }
+
+  void out(uint8_t c) {
+    if (!capture_) return;
+    if (high_) {  // high surrogate without its low half
+      emitCodepoint(0xFFFD);
+      high_ = 0;
+    }
+    emit((char)c);
+  }
+
+  void unicode(uint16_t u) {
+    if (!capture_) return;
+    if (u >= 0xD800 && u <= 0xDBFF) {
+      if (high_) emitCodepoint(0xFFFD);
+      high_ = u;
+      return;
+    }
+    if (u >= 0xDC00 && u <= 0xDFFF) {
+      if (high_) emitCodepoint(0x10000 + (((uint32_t)high_ - 0xD800) << 10) + (u - 0xDC00));
+      else emitCodepoint(0xFFFD);
+      high_ = 0;
+      return;
+    }
+    if (high_) emitCodepoint(0xFFFD);
+    high_ = 0;
+    emitCodepoint(u);
+  }
+
+  static bool isSpace(uint8_t c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+  static bool isLiteral(uint8_t c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '+' || c == '.';
+  }
+
+  void step(uint8_t c) {
+    switch (st_) {
+      case VALUE:
+        if (isSpace(c)) break;
+        if (c == '{') push(false);
+        else if (c == '[') push(true);
+        else if (c == '"' && depth_) {
+          capture_ = depth_ == kPathLen && stack_[kPathLen - 1].ok;
+          if (capture_) parts_++;
+          st_ = STR;
+        } else if (c == ']' && depth_ && stack_[depth_ - 1].array) pop();  // empty array
+        else if (isLiteral(c) && depth_) st_ = LITERAL;
+        else st_ = FAIL;
+        break;
+      case KEY_OR_END:
+        if (isSpace(c)) break;
+        if (c == '"') {
+          keyPos_ = 0;
+          keyMatch_ = depth_ <= kPathLen && pathKey(depth_ - 1) != nullptr;
+          st_ = KEY;
+        } else if (c == '}') {
+          pop();
+        } else {
+          st_ = FAIL;
+        }
+        break;
+      case KEY:
+        if (c == '"') {
+          const char* want = keyMatch_ ? pathKey(depth_ - 1) : nullptr;
+          updateTop(want && want[keyPos_] == '\0');
+          st_ = COLON;
+        } else if (c == '\\') {
+          keyMatch_ = false;  // the path keys never need escapes
+          st_ = KEY_ESC;
+        } else if (keyMatch_) {
+          const char* want = pathKey(depth_ - 1);
+          if (want[keyPos_] == (char)c) keyPos_++;
+          else keyMatch_ = false;
+        }
+        break;
+      case KEY_ESC:
+        st_ = KEY;  // \uXXXX digits are plain key characters from here on
+        break;
+      case COLON:
+        if (isSpace(c)) break;
+        st_ = c == ':' ? VALUE : FAIL;
+        break;
+      case AFTER:
+        if (isSpace(c)) break;
+        if (c == ',') {
+          Frame& f = stack_[depth_ - 1];
+          if (f.array) {
+            f.index++;
+            updateTop(false);
+            st_ = VALUE;
+          } else {
+            st_ = KEY_OR_END;
+          }
+        } else if ((c == '}' && !stack_[depth_ - 1].array) || (c == ']' && stack_[depth_ - 1].array)) {
+          pop();
+        } else {
+          st_ = FAIL;
+        }
+        break;
+      case STR:
+        if (c == '"') {
+          if (high_ && capture_) emitCodepoint(0xFFFD);
+          high_ = 0;
+          capture_ = false;
+          st_ = AFTER;
+        } else if (c == '\\') {
+          st_ = STR_ESC;
+        } else {
+          out(c);
+        }
+        break;
+      case STR_ESC:
+        st_ = STR;
+        switch (c) {
+          case 'n': out('\n'); break;
+          case 't': out('\t'); break;
+          case 'r': out('\r'); break;
+          case 'b': out('\b'); break;
+          case 'f': out('\f'); break;
+          case 'u': hexCount_ = 0; hex_ = 0; st_ = STR_HEX; break;
+          default: out(c); break;  // \" \\ \/
+        }
+        break;
+      case STR_HEX: {
+        int d = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if (d < 0) { st_ = FAIL; break; }
+        hex_ = (uint16_t)(hex_ * 16 + d);
+        if (++hexCount_ == 4) {
+          unicode(hex_);
+          st_ = STR;
+        }
+        break;
+      }
+      case LITERAL:
+        if (isLiteral(c)) break;
+        st_ = AFTER;
+        step(c);
+        break;
+      default:
+        break;
+    }
+  }
+};
+
+// First balanced {...} in s (skips code fences or prose around it); false = none
+inline bool objectSpan(const char* s, size_t n, size_t& start, size_t& len) {
+  int depth = 0;
+  bool inStr = false, esc = false;
+  for (size_t i = 0; i < n; ++i) {
+    char c = s[i];
+    if (inStr) {
+      if (esc) esc = false;
+      else if (c == '\\') esc = true;
+      else if (c == '"') inStr = false;
+      continue;
+    }
+    if (c == '"' && depth) {
+      inStr = true;
+    } else if (c == '{') {
+      if (!depth) start = i;
+      depth++;
+    } else if (c == '}' && depth) {
+      if (--depth == 0) {
+        len = i + 1 - start;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+}
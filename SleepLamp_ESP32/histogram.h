@@ -0,0 +1,50 @@
+#pragma once
+// Fixed-bucket latency histogram (no Arduino deps, no allocation).
+// Bucket bounds grow 4x from 4 us: 4, 16, 64 us ... 67 s, then +Inf, so one
+// layout covers an ESP-NOW callback and a Gemini round trip alike. Recording
+// is a count-leading-zeros and three adds; callers that record from several
+// tasks serialize it themselves.
+
+#include <stdint.h>
+
+struct Histogram {
+  static const uint8_t kBounds = 13;
+  static const uint8_t kBuckets = kBounds + 1;  // last one is +Inf
+
+  uint32_t counts[kBuckets] = {};  // per bucket, not cumulative
+  uint32_t count = 0;
+  uint32_t maxUs = 0;
+  uint64_t sumUs = 0;
+
+  // Inclusive upper bound of bucket i < kBounds
+  static uint32_t boundUs(uint8_t i) { return 4UL << (2 * i); }
+
+  static uint8_t bucketOf(uint32_t us) {
+    if (us <= 4) return 0;
+    uint8_t bits = (uint8_t)(32 - __builtin_clz(us - 1));  // us <= 2^bits
+    uint8_t i = (uint8_t)((bits - 1) / 2);
+    return i < kBounds ? i : kBounds;
+  }
+
+  void record(uint32_t us) {
+    counts[bucketOf(us)]++;
+    count++;
+    sumUs += us;
+    if (us > maxUs) maxUs = us;
+  }
+
+  // Upper bound of the bucket holding quantile q (0..1), capped at the max seen
+  uint32_t quantileUs(float q) const {
+    if (!count) return 0;
+    uint32_t want = (uint32_t)(q * count + 0.999f);
+    if (!want) want = 1;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < kBounds; ++i) {
+      seen += counts[i];
+      if (seen >= want) return boundUs(i) < maxUs ? boundUs(i) : maxUs;
+    }
+    return maxUs;
+  }
+
+  uint32_t avgUs() const { return count ? (uint32_t)(sumUs / count) : 0; }
+};
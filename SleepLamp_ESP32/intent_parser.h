@@ -0,0 +1,228 @@
+#pragma once
+#include <Arduino.h>
+#include "action_engine.h"
+#include "effect_names.h"
+#include "name_hash.h"
+
+/*
+  intent_parser.h
+  On-device answers for simple prompts ("brightness 30%", "make it red",
+  "rainbow", "turn off", "mimir on"), tried before the Gemini path.
+  The prompt is split into words; every word has to be understood (a
+  command, a value or a filler like "make it"), otherwise the parser is
+  not confident and the prompt goes to Gemini. Effect and color names go
+  through compile-time perfect-hash tables, up to INTENT_SPAN_MAX words
+  per name ("fire flicker soft", "warm white").
+*/
+
+#ifndef INTENT_TEXT_MAX
+#define INTENT_TEXT_MAX 96
+#endif
+
+#ifndef INTENT_WORDS_MAX
+#define INTENT_WORDS_MAX 16
+#endif
+
+#ifndef INTENT_SPAN_MAX
+#define INTENT_SPAN_MAX 4
+#endif
+
+namespace Intent {
+
+static constexpr NameHash::Entry COLOR_KV[] = {
+  {"red",0xFF0000},{"green",0x00FF00},{"blue",0x0000FF},{"white",0xFFFFFF},{"warmwhite",0xFFB46B},
+  {"coolwhite",0xD6E6FF},{"coldwhite",0xD6E6FF},{"yellow",0xFFFF00},{"orange",0xFF8000},{"amber",0xFFBF00},
+  {"purple",0x8000FF},{"violet",0x8F00FF},{"magenta",0xFF00FF},{"pink",0xFF69B4},{"cyan",0x00FFFF},
+  {"aqua",0x00FFFF},{"teal",0x008080},{"turquoise",0x40E0D0},{"lime",0xBFFF00},{"gold",0xFFD700},
+  {"indigo",0x4B0082},{"lavender",0xB57EDC},{"crimson",0xDC143C},{"peach",0xFFB07C},{"coral",0xFF7F50},
+  {"salmon",0xFA8072}
+};
+
+static const uint8_t kColorNames = sizeof(COLOR_KV) / sizeof(COLOR_KV[0]);
+static const uint16_t kColorSlots = 64;
+static const uint32_t kColorSeed = 0x811CA048;
+
+static_assert(kColorNames < NameHash::kEmpty, "color index must fit in a byte");
+
+static constexpr NameHash::Slots<kColorSlots> COLOR_SLOTS =
+  NameHash::makeSlots<kColorSlots>(COLOR_KV, kColorNames, kColorSeed, CtMath::MakeSeq<kColorSlots>::type());
+
+static_assert(NameHash::perfect(COLOR_KV, kColorNames, kColorSeed, COLOR_SLOTS),
+              "color names must be normalized and unique; if they are, change kColorSeed");
+
+// Words that carry no command of their own
+static const char* const kFillers[] = {
+  "a", "and", "at", "be", "can", "color", "colour", "effect", "i", "it", "lamp", "light", "lights",
+  "make", "mode", "now", "please", "power", "set", "shut", "switch", "the", "to", "turn", "want", "you"
+};
+
+struct Word {
+  const char* s;
+  uint8_t len;
+};
+
+static bool isWord(const Word& w, const char* s) {
+  return strlen(s) == w.len && memcmp(w.s, s, w.len) == 0;
+}
+
+static bool isFiller(const Word& w) {
+  for (const char* f : kFillers) {
+    if (isWord(w, f)) return true;
+  }
+  return false;
+}
+
+static bool isMimirWord(const Word& w) {
+  return isWord(w, "mimir") || isWord(w, "adaptive") || isWord(w, "auto") || isWord(w, "ambient");
+}
+
+// Only meaningful with a value ("dim to 20%")
+static bool isBrightnessWord(const Word& w) {
+  return isWord(w, "brightness") || isWord(w, "dim");
+}
+
+// 0..999, -1 if not all digits
+static int number(const Word& w) {
+  if (w.len > 3) return -1;
+  int v = 0;
+  for (uint8_t i = 0; i < w.len; ++i) {
+    if (w.s[i] < '0' || w.s[i] > '9') return -1;
+    v = v * 10 + (w.s[i] - '0');
+  }
+  return v;
+}
+
+static bool hexColor(const Word& w, uint32_t& out) {
+  if (w.len != 7 || w.s[0] != '#') return false;
+  out = 0;
+  for (uint8_t i = 1; i < 7; ++i) {
+    char c = w.s[i];
+    uint8_t d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : 0xFF;
+    if (d == 0xFF) return false;
+    out = (out << 4) | d;
+  }
+  return true;
+}
+
+// Lowercase words: runs of a-z0-9 (a leading '#' kept for hex colors), '%' on its own
+static uint8_t split(char* s, Word* words) {
+  uint8_t n = 0;
+  for (char* p = s; *p;) {
+    char c = *p;
+    bool alnum = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+    if (!alnum && c != '#' && c != '%') { ++p; continue; }
+    if (n == INTENT_WORDS_MAX) return 0xFF;
+    char* start = p++;
+    if (c != '%') {
+      while ((*p >= 'a' && *p <= 'z') || (*p >= '0' && *p <= '9')) ++p;
+    }
+    words[n].s = start;
+    words[n].len = (uint8_t)(p - start);
+    n++;
+  }
+  return n;
+}
+
+// Longest run of words at i naming an effect or a color; words used, 0 if none
+static uint8_t matchName(const Word* words, uint8_t n, uint8_t i, int& effect, int& color) {
+  uint8_t maxSpan = n - i < INTENT_SPAN_MAX ? n - i : INTENT_SPAN_MAX;
+  for (uint8_t span = maxSpan; span > 0; --span) {
+    char key[32];
+    size_t len = 0;
+    bool fits = true;
+    for (uint8_t k = i; k < i + span && fits; ++k) {
+      fits = words[k].s[0] != '#' && words[k].s[0] != '%' && len + words[k].len < sizeof(key);
+      if (fits) { memcpy(key + len, words[k].s, words[k].len); len += words[k].len; }
+    }
+    if (!fits) continue;
+    key[len] = '\0';
+    int e = effectIdFromKey(key);
+    if (e >= 0) { effect = e; return span; }
+    int c = NameHash::find(COLOR_KV, COLOR_SLOTS, kColorSeed, key);
+    if (c >= 0) { color = (int)COLOR_KV[c].value; return span; }
+  }
+  return 0;
+}
+
+// Compile a simple prompt into a batch; false = not confident (ask Gemini)
+bool parse(const char* text, size_t len, Actions::Batch& out) {
+  out.count = 0;
+  out.skipped = 0;
+  if (len > INTENT_TEXT_MAX) return false;
+  char buf[INTENT_TEXT_MAX + 1];
+  for (size_t i = 0; i < len; ++i) {
+    char c = text[i];
+    if (!c) return false;  // split() would stop there and drop the rest
+    buf[i] = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+  }
+  buf[len] = '\0';
+
+  Word words[INTENT_WORDS_MAX];
+  uint8_t n = split(buf, words);
+  if (!n || n == 0xFF) return false;
+
+  int mimirAt = -1;
+  bool brightnessWord = false;
+  for (uint8_t i = 0; i < n; ++i) {
+    if (isMimirWord(words[i])) mimirAt = mimirAt < 0 ? i : -2;
+    if (isBrightnessWord(words[i])) brightnessWord = true;
+  }
+  if (mimirAt == -2) return false;
+
+  int power = -1, mimir = -1, bright = -1, effect = -1;
+  int32_t color = -1;
+  for (uint8_t i = 0; i < n;) {
+    const Word& w = words[i];
+    int v = number(w);
+    uint32_t hex;
+    int e = -1, c = -1;
+    uint8_t used;
+    if (v >= 0) {
+      // "30%", "30 percent", "brightness 30": percent of full scale
+      bool pct = i + 1 < n && (isWord(words[i + 1], "%") || isWord(words[i + 1], "percent"));
+      if (v > 100 || bright >= 0 || (!pct && !brightnessWord)) return false;
+      bright = (v * 255 + 50) / 100;
+      i += pct ? 2 : 1;
+    } else if (hexColor(w, hex)) {
+      if (color >= 0) return false;
+      color = (int32_t)hex;
+      i++;
+    } else if (isWord(w, "on") || isWord(w, "off")) {
+      int& target = (mimirAt >= 0 && (mimirAt == i - 1 || mimirAt == i + 1)) ? mimir : power;
+      if (target >= 0) return false;
+      target = isWord(w, "on") ? 1 : 0;
+      i++;
+    } else if (isWord(w, "max") || isWord(w, "full") || isWord(w, "maximum")) {
+      if (!brightnessWord || bright >= 0) return false;
+      bright = 255;
+      i++;
+    } else if ((used = matchName(words, n, i, e, c)) != 0) {  // before fillers: "color wipe"
+      if ((e >= 0 && effect >= 0) || (c >= 0 && color >= 0)) return false;
+      if (e >= 0) effect = e;
+      if (c >= 0) color = c;
+      i += used;
+    } else if (i == mimirAt || isBrightnessWord(w) || isFiller(w)) {
+      i++;
+    } else {
+      return false;  // a word we do not understand
+    }
+  }
+  if (mimirAt >= 0 && mimir < 0) mimir = 1;  // "mimir", "auto mode"
+  if (brightnessWord && bright < 0) return false;  // "brightness up", "dim" and friends
+  if ((color >= 0 || effect >= 0) && power < 0 && bright < 0) power = 1;
+
+  Actions::Command* cmd = out.cmds;
+  if (mimir >= 0) { memset(cmd, 0, sizeof(*cmd)); cmd->type = Actions::CMD_MIMIR; cmd->a = (uint8_t)mimir; cmd++; }
+  if (color >= 0) { memset(cmd, 0, sizeof(*cmd)); cmd->type = Actions::CMD_COLOR; cmd->value = (uint32_t)color; cmd++; }
+  if (effect >= 0) { memset(cmd, 0, sizeof(*cmd)); cmd->type = Actions::CMD_EFFECT; cmd->value = (uint32_t)effect; cmd++; }
+  if (bright >= 0) { memset(cmd, 0, sizeof(*cmd)); cmd->type = Actions::CMD_BRIGHTNESS; cmd->a = (uint8_t)bright; cmd++; }
+  if (power >= 0) { memset(cmd, 0, sizeof(*cmd)); cmd->type = Actions::CMD_POWER; cmd->a = (uint8_t)power; cmd++; }
+  out.count = (uint8_t)(cmd - out.cmds);
+  return out.count > 0;
+}
+
+inline bool parse(const String& prompt, Actions::Batch& out) {
+  return parse(prompt.c_str(), prompt.length(), out);
+}
+
+}
@@ -4,6 +4,8 @@
 #include <WS2812FX.h>
 #include "config.h"
 #include "mimir_tuning.h"
+#include "mimir_curve.h"
+#include "color_fade.h"
 
 namespace LedControl {
 
@@ -19,11 +21,37 @@ static uint16_t s_effectId = DEFAULT_EFFECT_ID;
 static bool s_isOn = DEFAULT_ON;
 static bool s_mimir = DEFAULT_MIMIR;
 static float s_lastLux = 0.0f;
+static uint8_t s_mimirMapped = MIMIR_BRIGHT_MIN;  // curve output for s_lastLux
+static float s_levelF = DEFAULT_BRIGHTNESS;       // unrounded smoothing state
+
+// Timed fades (color_fade.h); s_color / s_targetBrightness are where they end
+static uint32_t s_shownColor = DEFAULT_COLOR_HEX;  // on the LEDs now
+static uint32_t s_fadeFromColor = DEFAULT_COLOR_HEX;
+static uint8_t s_fadeFromBrightness = 0;
+static ColorFade::Ramp s_colorRamp;
+static ColorFade::Ramp s_brightnessRamp;  // idle = exponential smoothing
+static bool s_offAfterFade = false;       // fading to 0: power off at the end
 
 // Mimir range
 static uint8_t s_mimirMin = MIMIR_BRIGHT_MIN;
 static uint8_t s_mimirMax = MIMIR_BRIGHT_MAX;
 
+// Recursive lock: state is touched by the render task, web handlers and loop()
+static SemaphoreHandle_t s_lock = nullptr;
+struct Guard {
+  Guard() { if (s_lock) xSemaphoreTakeRecursive(s_lock, portMAX_DELAY); }
+  ~Guard() { if (s_lock) xSemaphoreGiveRecursive(s_lock); }
+};
+
+// Bumped by every state change; keys the cached /status JSON
+static volatile uint32_t s_version = 1;
+static inline void touch() {
+  s_version = s_version + 1;
+}
+uint32_t version() {
+  return s_version;
+}
+
 static inline uint8_t clampU8(int v) {
   if (v < 0) return 0;
   if (v > 255) return 255;
@@ -43,11 +71,18 @@ void applyColorToFX(uint32_t color) {
 }
 
 void init() {
+  if (!s_lock) s_lock = xSemaphoreCreateRecursiveMutex();
+  Guard g;
   pinMode(LED_PIN, OUTPUT);
 
+  MimirCurve::rebuild(s_mimirMin, s_mimirMax);
+  s_mimirMapped = MimirCurve::map(s_lastLux);
+
   ws.init();
+  s_levelF = s_currentBrightness;
   ws.setBrightness(s_currentBrightness);  // native brightness
   ws.setMode(s_effectId);
+  s_shownColor = s_color;
   applyColorToFX(s_color);
 
   if (s_isOn) {
@@ -59,49 +94,95 @@ void init() {
   }
 }
 
-// Brightness smoothing
-void smoothBrightness() {
+// Brightness smoothing: exponential approach with a real time constant,
+// alpha = 1 - e^(-dt/tau), so fade speed no longer depends on the call rate
+void smoothBrightness(uint32_t dtUs) {
   // If off, force target to 0 (stay off)
   if (!s_isOn) {
     s_targetBrightness = 0;
   }
 
-  // Faster alpha when on mimir mode
-  float alpha = s_mimir ? MIMIR_ALPHA : SMOOTHING_ALPHA;
-  float y = (float)s_currentBrightness + alpha * ((float)s_targetBrightness - (float)s_currentBrightness);
-  uint8_t newB = clampU8((int)roundf(y));
+  // Shorter time constant when on mimir mode
+  float tauUs = (s_mimir ? MIMIR_TAU_MS : SMOOTHING_TAU_MS) * 1000.0f;
+  float alpha = tauUs > 0.0f ? 1.0f - expf(-(float)dtUs / tauUs) : 1.0f;
+  s_levelF += alpha * ((float)s_targetBrightness - s_levelF);
+  uint8_t newB = clampU8((int)roundf(s_levelF));
   if (newB != s_currentBrightness) {
     s_currentBrightness = newB;
     ws.setBrightness(s_currentBrightness);
+    touch();
   }
 }
 
-void tick() {
-  // In Mimir mode, update target using gamma curve and min step threshold
-  if (s_mimir) {
-    float lux = s_lastLux;
-    float cl = constrain(lux, LUX_MIN, LUX_MAX);
-    float t = (cl - LUX_MIN) / (float)(LUX_MAX - LUX_MIN);  // 0..1
-    t = powf(t, MIMIR_GAMMA);                               // gamma curve
+void setOn(bool on);
+
+static void stopBrightnessFade() {
+  s_brightnessRamp.stop();
+  s_offAfterFade = false;
+}
 
-    // Use dynamic UI-adjustable range
-    int mapped = (int)roundf((float)s_mimirMin + t * (float)(s_mimirMax - s_mimirMin));
-    mapped = clampU8(mapped);
+// Timed brightness fade: same lightness mixing as colors, ends on the target
+static void fadeBrightness(uint32_t dtUs) {
+  uint8_t newB = ColorFade::mix(s_fadeFromBrightness, s_targetBrightness, s_brightnessRamp.advance(dtUs));
+  s_levelF = newB;  // smoothing carries on from here
+  if (newB != s_currentBrightness) {
+    s_currentBrightness = newB;
+    ws.setBrightness(s_currentBrightness);
+    touch();
+  }
+  if (!s_brightnessRamp.active() && s_offAfterFade) setOn(false);
+}
 
+// One render frame; dtUs = time since the previous frame
+void tick(uint32_t dtUs) {
+  Guard g;
+  // In Mimir mode, follow the precomputed curve output with a min step threshold
+  if (s_mimir) {
+    int mapped = s_mimirMapped;
     if (abs(mapped - (int)s_targetBrightness) >= MIMIR_MIN_STEP) {
       s_targetBrightness = (uint8_t)mapped;
+      stopBrightnessFade();  // the sensor takes over
+      touch();
     }
   }
 
-  smoothBrightness();
+  if (s_colorRamp.active()) {
+    uint32_t c = ColorFade::mixRgb(s_fadeFromColor, s_color, s_colorRamp.advance(dtUs));
+    if (c != s_shownColor) {
+      s_shownColor = c;
+      applyColorToFX(c);
+    }
+  }
+
+  if (s_brightnessRamp.active() && s_isOn) fadeBrightness(dtUs);
+  else smoothBrightness(dtUs);
   ws.service();
 }
 
-// Set target brightness only (does not auto power on)
-void setTargetBrightness(uint8_t b) {
+static uint16_t clampFadeMs(uint32_t ms) {
+  return ms > COLOR_FADE_MAX_MS ? COLOR_FADE_MAX_MS : (uint16_t)ms;
+}
+
+// Set target brightness only (does not auto power on). fadeMs > 0 fades
+// linearly in lightness over that time instead of the exponential smoothing;
+// a fade to 0 powers off when it ends (see fadingOff()).
+void setTargetBrightness(uint8_t b, uint32_t fadeMs = 0) {
+  Guard g;
   s_targetBrightness = b;
   // Save nonzero brightness for later restore
   if (b > 0) s_savedBrightness = b;
+  stopBrightnessFade();
+  if (fadeMs && s_isOn) {
+    s_fadeFromBrightness = s_currentBrightness;
+    s_brightnessRamp.start(clampFadeMs(fadeMs));
+    s_offAfterFade = b == 0;
+  }
+  touch();
+}
+
+// A fade to 0 is running; callers leave the power-off to it
+bool fadingOff() {
+  return s_offAfterFade;
 }
 
 uint8_t getTargetBrightness() {
@@ -114,9 +195,20 @@ uint8_t getSavedBrightness() {
   return s_savedBrightness;
 }
 
-void setColor(uint32_t color) {
+// Crossfade to color over fadeMs (0 = switch at once); a fade in progress
+// continues from the color it has reached
+void setColor(uint32_t color, uint32_t fadeMs = COLOR_FADE_MS) {
+  Guard g;
   s_color = color;
-  applyColorToFX(s_color);
+  if (fadeMs && s_isOn && color != s_shownColor) {
+    s_fadeFromColor = s_shownColor;
+    s_colorRamp.start(clampFadeMs(fadeMs));
+  } else {
+    s_colorRamp.stop();
+    s_shownColor = color;
+    applyColorToFX(color);
+  }
+  touch();
 }
 
 uint32_t getColor() {
@@ -124,10 +216,12 @@ uint32_t getColor() {
 }
 
 void setEffect(uint16_t effectId) {
+  Guard g;
   s_effectId = effectId;
   ws.setMode(s_effectId);
-  applyColorToFX(s_color);
+  applyColorToFX(s_shownColor);
   if (s_isOn) ws.start();
+  touch();
 }
 
 uint16_t getEffect() {
@@ -135,14 +229,21 @@ uint16_t getEffect() {
 }
 
 void setMimir(bool m) {
+  Guard g;
   s_mimir = m;
+  touch();
 }
 bool getMimir() {
   return s_mimir;
 }
 
+// Curve mapping runs here, once per sample, not in tick()
 void updateLux(float lux) {
+  Guard g;
+  if (lux == s_lastLux) return;
   s_lastLux = lux;
+  s_mimirMapped = MimirCurve::map(lux);
+  touch();
 }
 float getLux() {
   return s_lastLux;
@@ -150,7 +251,10 @@ float getLux() {
 
 // Power control
 void setOn(bool on) {
+  Guard g;
   if (on == s_isOn) return;
+  touch();
+  stopBrightnessFade();
 
   if (on) {
     // Restore last nonzero brightness
@@ -160,10 +264,16 @@ void setOn(bool on) {
     ws.start();
     // Apply
     s_currentBrightness = s_targetBrightness;
+    s_levelF = s_currentBrightness;
     ws.setBrightness(s_currentBrightness);
   } else {
-    // Save current target if nonzero, then turn off
+    // Save current target if nonzero, then turn off (fades end where they were going)
     if (s_targetBrightness > 0) s_savedBrightness = s_targetBrightness;
+    if (s_colorRamp.active()) {
+      s_colorRamp.stop();
+      s_shownColor = s_color;
+      applyColorToFX(s_color);
+    }
     s_isOn = false;
     s_targetBrightness = 0;
     ws.setBrightness(0);
@@ -177,12 +287,14 @@ bool getOn() {
 }
 
 bool toggle() {
+  Guard g;
   setOn(!s_isOn);
   return s_isOn;
 }
 
 // Mimir range getters/setters
 void setMimirRange(uint8_t minB, uint8_t maxB) {
+  Guard g;
   if (minB > maxB) {
     uint8_t tmp = minB;
     minB = maxB;
@@ -190,11 +302,14 @@ void setMimirRange(uint8_t minB, uint8_t maxB) {
   }
   s_mimirMin = minB;
   s_mimirMax = maxB;
+  MimirCurve::rebuild(s_mimirMin, s_mimirMax);
+  s_mimirMapped = MimirCurve::map(s_lastLux);
   // Clamp current/target within range if Mimir active
   if (s_mimir) {
     if (s_targetBrightness < s_mimirMin) s_targetBrightness = s_mimirMin;
     if (s_targetBrightness > s_mimirMax) s_targetBrightness = s_mimirMax;
   }
+  touch();
 }
 uint8_t getMimirMin() {
   return s_mimirMin;
@@ -203,24 +318,35 @@ uint8_t getMimirMax() {
   return s_mimirMax;
 }
 
-String getEffectName(uint16_t id) {
+// User piecewise curve (nullptr/0 restores the built-in gamma curve)
+bool setMimirCurve(const MimirCurve::Point* pts, uint8_t n) {
+  Guard g;
+  if (n == 0) {
+    MimirCurve::clearPoints();
+  } else if (!MimirCurve::setPoints(pts, n)) {
+    return false;
+  }
+  MimirCurve::rebuild(s_mimirMin, s_mimirMax);
+  s_mimirMapped = MimirCurve::map(s_lastLux);
+  touch();
+  return true;
+}
+
+// Mode names live in flash, which the ESP32 maps for direct reads
+const char* getEffectName(uint16_t id) {
   const __FlashStringHelper* nm = ws.getModeName(id);
-  String s;
-  if (nm) s = String(nm);
-  else s = "Unknown";
-  return s;
+  return nm ? (const char*)nm : "Unknown";
 }
 
-String jsonStatus(const String& wifiMode, bool motion = false, bool presenceEnabled = false) {
-  char buf[560];
+// Status JSON into a caller buffer (no heap); returns the length written
+size_t formatStatus(char* buf, size_t cap, const char* wifiMode, bool motion = false, bool presenceEnabled = false) {
+  Guard lock;
   uint32_t col = getColor();
   uint8_t r = (col >> 16) & 0xFF;
   uint8_t g = (col >> 8) & 0xFF;
   uint8_t b = (col)&0xFF;
 
-  String effectName = getEffectName(getEffect());
-
-  snprintf(buf, sizeof(buf),
+  int n = snprintf(buf, cap,
            "{\"color\":\"%02X%02X%02X\",\"brightness\":%u,\"current_brightness\":%u,"
            "\"saved_brightness\":%u,"
            "\"effect_id\":%u,\"effect_name\":\"%s\",\"on\":%s,\"mimir\":%s,"
@@ -231,19 +357,21 @@ String jsonStatus(const String& wifiMode, bool motion = false, bool presenceEnab
            getCurrentBrightness(),
            getSavedBrightness(),
            getEffect(),
-           effectName.c_str(),
+           getEffectName(getEffect()),
            getOn() ? "true" : "false",
            getMimir() ? "true" : "false",
            getLux(),
-           wifiMode.c_str(),
+           wifiMode,
            getMimirMin(), getMimirMax(),
            motion ? "true" : "false",
            presenceEnabled ? "true" : "false");
-  return String(buf);
+  if (n < 0 || !cap) return 0;
+  return (size_t)n < cap ? (size_t)n : cap - 1;
 }
 
 // ---------- Diagnostics ----------
 void testFillHex(uint32_t color, uint8_t brightness) {
+  Guard g;
   bool wasOn = s_isOn;
   ws.stop();
   ws.setMode(FX_MODE_STATIC);
@@ -263,6 +391,7 @@ void testFillHex(uint32_t color, uint8_t brightness) {
 }
 
 void selfTestRGB(uint8_t brightness) {
+  Guard g;
   bool wasOn = s_isOn;
   uint16_t prevMode = s_effectId;
   uint8_t prevB = s_currentBrightness;
@@ -0,0 +1,241 @@
+#pragma once
+// Multi-node lux/presence fusion (no Arduino deps, driven by any ms clock).
+// One slot per sender MAC. Lux from the fresh nodes is fused by median,
+// freshness-weighted mean or max; occupancy is the OR of the nodes' presence
+// leases (a motion report holds for a lease, so a node that dies while
+// "occupied" cannot keep the room occupied forever). Nodes silent for longer
+// than the timeout (longer for low-power senders) are stale and ignored; with no fresh node at all the
+// result falls back as configured instead of freezing on the last value.
+
+#include <stdint.h>
+#include <string.h>
+#include "lux_packet.h"
+
+#ifndef LUX_NODES_MAX
+#define LUX_NODES_MAX 8
+#endif
+
+// A node that has not been heard from for this long is stale (3+ missed packets)
+#ifndef LUX_NODE_TIMEOUT_MS
+#define LUX_NODE_TIMEOUT_MS 10000UL
+#endif
+
+// Stale nodes are forgotten after this, freeing their slot
+#ifndef LUX_NODE_FORGET_MS
+#define LUX_NODE_FORGET_MS 600000UL
+#endif
+
+// How long a motion report keeps the room occupied without a refresh
+#ifndef PRESENCE_LEASE_MS
+#define PRESENCE_LEASE_MS 15000UL
+#endif
+
+// Same for nodes flagged F_LOW_POWER (30 s heartbeat, 10 s while occupied)
+#ifndef LUX_LP_NODE_TIMEOUT_MS
+#define LUX_LP_NODE_TIMEOUT_MS 75000UL
+#endif
+#ifndef LUX_LP_PRESENCE_LEASE_MS
+#define LUX_LP_PRESENCE_LEASE_MS 35000UL
+#endif
+
+// Lux used by the FALLBACK_FIXED policy
+#ifndef LUX_FALLBACK_LUX
+#define LUX_FALLBACK_LUX 50.0f
+#endif
+
+namespace LuxFusion {
+
+enum Mode : uint8_t { FUSE_MEDIAN = 0, FUSE_WEIGHTED, FUSE_MAX };
+enum Fallback : uint8_t {
+  FALLBACK_HOLD = 0,  // keep the last fused lux (old behavior)
+  FALLBACK_FIXED,     // use LUX_FALLBACK_LUX
+};
+
+#ifndef LUX_FUSION_MODE
+#define LUX_FUSION_MODE LuxFusion::FUSE_MEDIAN
+#endif
+
+#ifndef LUX_STALE_FALLBACK
+#define LUX_STALE_FALLBACK LuxFusion::FALLBACK_FIXED
+#endif
+
+static const uint8_t kNoMotion = 0xFF;
+
+struct Node {
+  uint8_t mac[6];
+  bool used;
+  uint8_t motion;  // last report (0/1, kNoMotion if the node has no PIR)
+  float lux;
+  int8_t rssi;
+  uint16_t nodeId;    // from v2 frames (0 = legacy sender)
+  bool lowPower;      // sends on change only: longer timeout + lease
+  uint32_t lastMs;    // any sample
+  uint32_t luxMs;     // last sample with a lux reading
+  bool hasLux;
+  uint32_t motionMs;  // last motion=1 report
+  uint32_t samples;
+  LuxWire::SeqTracker seq;
+};
+
+struct Result {
+  float lux;
+  bool luxFresh;       // false = fallback value
+  bool occupied;
+  bool presenceKnown;  // at least one fresh node reports motion
+  uint8_t fresh;       // nodes with a lux reading within the timeout
+  uint8_t total;
+};
+
+inline const char* modeName(uint8_t m) {
+  return m == FUSE_WEIGHTED ? "weighted" : m == FUSE_MAX ? "max" : "median";
+}
+
+inline int modeFromName(const char* s) {
+  if (!strcmp(s, "median")) return FUSE_MEDIAN;
+  if (!strcmp(s, "weighted")) return FUSE_WEIGHTED;
+  if (!strcmp(s, "max")) return FUSE_MAX;
+  return -1;
+}
+
+class Table {
+ public:
+  uint8_t mode = LUX_FUSION_MODE;
+  uint8_t fallback = LUX_STALE_FALLBACK;
+
+  // Sequence check for a v2 frame; false = duplicate/late frame (drop its samples)
+  bool acceptSeq(const uint8_t mac[6], uint16_t nodeId, uint16_t seq, bool lowPower, uint32_t nowMs) {
+    Node* n = find(mac);
+    if (!n) n = claim(mac, nowMs);
+    if (!n) return true;  // table full: update() will drop it anyway
+    n->nodeId = nodeId;
+    n->lowPower = lowPower;
+    bool ok = n->seq.accept(seq);
+    changes_++;
+    return ok;
+  }
+
+  // Record one sample (lux < 0 = no reading); returns false if the table is full of live nodes
+  bool update(const uint8_t mac[6], float lux, uint8_t motion, int8_t rssi, uint32_t nowMs) {
+    Node* n = find(mac);
+    if (!n) n = claim(mac, nowMs);
+    if (!n) return false;
+    if (lux >= 0.0f) {
+      n->lux = lux;
+      n->luxMs = nowMs;
+      n->hasLux = true;
+    }
+    n->rssi = rssi;
+    n->lastMs = nowMs;
+    n->samples++;
+    if (motion != kNoMotion) {
+      n->motion = motion;
+      if (motion) n->motionMs = nowMs;
+    }
+    changes_++;
+    return true;
+  }
+
+  // Fuse the fresh nodes; also notices nodes going stale (bumps changes())
+  Result fuse(uint32_t nowMs) {
+    Result r = {};
+    float vals[LUX_NODES_MAX];
+    float wsum = 0.0f, wlux = 0.0f;
+    uint8_t staleMask = 0;
+
+    for (uint8_t i = 0; i < LUX_NODES_MAX; ++i) {
+      Node& n = nodes_[i];
+      if (!n.used) continue;
+      uint32_t age = nowMs - n.lastMs;
+      if (age >= LUX_NODE_FORGET_MS) { n.used = false; changes_++; continue; }
+      r.total++;
+      uint32_t timeout = timeoutOf(n);
+      if (age >= timeout) { staleMask |= (uint8_t)(1u << i); continue; }
+
+      uint32_t luxAge = nowMs - n.luxMs;
+      if (n.hasLux && luxAge < timeout) {
+        vals[r.fresh++] = n.lux;
+        float w = 1.0f - (float)luxAge / (float)timeout;  // newer readings count more
+        wsum += w;
+        wlux += w * n.lux;
+      }
+      if (n.motion != kNoMotion) {
+        r.presenceKnown = true;
+        uint32_t lease = n.lowPower ? LUX_LP_PRESENCE_LEASE_MS : PRESENCE_LEASE_MS;
+        if (n.motion && nowMs - n.motionMs < lease) r.occupied = true;
+      }
+    }
+    if (staleMask != staleMask_) { staleMask_ = staleMask; changes_++; }
+
+    if (r.fresh) {
+      r.luxFresh = true;
+      if (mode == FUSE_MAX) r.lux = maxOf(vals, r.fresh);
+      else if (mode == FUSE_WEIGHTED) r.lux = wsum > 0.0f ? wlux / wsum : vals[0];
+      else r.lux = median(vals, r.fresh);
+      lastLux_ = r.lux;
+    } else {
+      r.lux = fallback == FALLBACK_FIXED ? LUX_FALLBACK_LUX : lastLux_;
+    }
+    return r;
+  }
+
+  bool isStale(uint8_t i, uint32_t nowMs) const {
+    return nowMs - nodes_[i].lastMs >= timeoutOf(nodes_[i]);
+  }
+  const Node& node(uint8_t i) const { return nodes_[i]; }
+  static constexpr uint8_t capacity() { return LUX_NODES_MAX; }
+  // Bumped by samples, joins/forgets and stale transitions
+  uint32_t changes() const { return changes_; }
+
+ private:
+  Node nodes_[LUX_NODES_MAX] = {};
+  float lastLux_ = LUX_FALLBACK_LUX;
+  uint8_t staleMask_ = 0;
+  uint32_t changes_ = 0;
+
+  static_assert(LUX_NODES_MAX <= 8, "stale mask is 8 bits");
+
+  static uint32_t timeoutOf(const Node& n) {
+    return n.lowPower ? LUX_LP_NODE_TIMEOUT_MS : LUX_NODE_TIMEOUT_MS;
+  }
+
+  Node* find(const uint8_t mac[6]) {
+    for (uint8_t i = 0; i < LUX_NODES_MAX; ++i) {
+      if (nodes_[i].used && memcmp(nodes_[i].mac, mac, 6) == 0) return &nodes_[i];
+    }
+    return nullptr;
+  }
+
+  // Free slot, else the longest-silent stale node
+  Node* claim(const uint8_t mac[6], uint32_t nowMs) {
+    Node* pick = nullptr;
+    for (uint8_t i = 0; i < LUX_NODES_MAX; ++i) {
+      Node& n = nodes_[i];
+      if (!n.used) { pick = &n; break; }
+      if (nowMs - n.lastMs >= timeoutOf(n) && (!pick || n.lastMs - pick->lastMs > 0x80000000UL)) pick = &n;
+    }
+    if (!pick) return nullptr;
+    *pick = Node();
+    memcpy(pick->mac, mac, 6);
+    pick->used = true;
+    pick->motion = kNoMotion;
+    return pick;
+  }
+
+  static float maxOf(const float* v, uint8_t n) {
+    float m = v[0];
+    for (uint8_t i = 1; i < n; ++i) if (v[i] > m) m = v[i];
+    return m;
+  }
+
+  static float median(float* v, uint8_t n) {
+    for (uint8_t i = 1; i < n; ++i) {  // insertion sort, n <= LUX_NODES_MAX
+      float x = v[i];
+      uint8_t j = i;
+      while (j > 0 && v[j - 1] > x) { v[j] = v[j - 1]; --j; }
+      v[j] = x;
+    }
+    return (n & 1) ? v[n / 2] : 0.5f * (v[n / 2 - 1] + v[n / 2]);
+  }
+};
+
+}
@@ -0,0 +1,340 @@
+#pragma once
+#include <Arduino.h>
+#include <math.h>
+#include <esp_now.h>
+#include "config.h"
+#include "spsc_ring.h"
+#include "lux_packet.h"
+#include "lux_fusion.h"
+#include "led_control.h"
+
+/*
+  lux_input.h
+  ESP-NOW samples from the Wi-Fi task to the render task. The receive
+  callback only decodes the payload (LuxWire v2 frames or the legacy
+  formats) and pushes timestamped samples into a lock-free SPSC ring; the
+  render task drains it in batches before each frame and is the only
+  writer of the lux/motion globals. Drops, malformed packets and
+  inter-arrival jitter are counted along the way.
+  Samples feed a per-node LuxFusion table; the lamp follows its fused
+  result, which also times out dead nodes (see lux_fusion.h).
+  Channel discovery: the lamp beacons its ESP-NOW channel whenever it
+  changes, and ACKs node probes / F_ACK_REQ frames straight from the
+  receive callback so a node can tell it lost the lamp and rescan.
+*/
+
+#ifndef LUX_RING_SIZE
+#define LUX_RING_SIZE 32  // power of two; ~1 min of one node at 2 s
+#endif
+
+#ifndef LUX_DRAIN_BATCH
+#define LUX_DRAIN_BATCH 8
+#endif
+
+// Channel beacon period when the channel has not changed
+#ifndef LUX_BEACON_MS
+#define LUX_BEACON_MS 30000UL
+#endif
+
+// Re-fuse at least this often without samples (staleness/lease expiry)
+#ifndef LUX_FUSE_INTERVAL_MS
+#define LUX_FUSE_INTERVAL_MS 250UL
+#endif
+
+extern volatile float g_lastLux;
+extern volatile uint32_t g_lastLuxMillis;
+extern volatile bool g_lastMotion;
+
+namespace LuxInput {
+
+struct Sample {
+  uint32_t arrivalMs;
+  float lux;           // < 0 = no reading
+  uint8_t mac[6];
+  int8_t rssi;      // 0 = unknown (IDF < 5 has no rx info)
+  uint8_t motion;   // 0/1, or kNoMotion for payloads without a motion field
+  uint16_t nodeId;
+  uint16_t seq;
+  uint16_t ageMs;   // taken this long before the frame was sent
+  uint8_t flags;    // S_*
+};
+
+enum SampleFlags : uint8_t {
+  S_FRAME_START = 1 << 0,  // first sample of a frame (carries the sequence check)
+  S_HAS_SEQ = 1 << 1,      // v2 frame
+  S_LOW_POWER = 1 << 2,    // sender flagged F_LOW_POWER
+};
+
+static const uint8_t kNoMotion = LuxFusion::kNoMotion;
+
+struct Stats {
+  uint32_t received = 0;   // pushed into the ring
+  uint32_t dropped = 0;    // ring full
+  uint32_t malformed = 0;  // undecodable payloads
+  uint32_t crcErrors = 0;
+  uint32_t v2Frames = 0;
+  uint32_t legacyFrames = 0;
+  uint32_t dupFrames = 0;   // duplicate or late v2 frames (dropped)
+  uint32_t lostFrames = 0;  // sequence gaps, summed over nodes
+  uint32_t probes = 0;      // channel discovery
+  uint32_t acksSent = 0;
+  uint32_t beacons = 0;
+  uint32_t drained = 0;
+  uint16_t maxBatch = 0;
+  uint16_t maxDepth = 0;
+  uint32_t lastIntervalMs = 0;
+  uint32_t avgIntervalMs = 0;  // EWMA (1/8)
+  uint32_t jitterMs = 0;       // EWMA (1/8) of |interval - avg|
+  uint32_t maxJitterMs = 0;
+};
+
+static SpscRing<Sample, LUX_RING_SIZE> s_ring;
+
+// Producer-side counters (Wi-Fi task only)
+static std::atomic<uint32_t> s_received{ 0 };
+static std::atomic<uint32_t> s_dropped{ 0 };
+static std::atomic<uint32_t> s_malformed{ 0 };
+static std::atomic<uint32_t> s_crcErrors{ 0 };
+static std::atomic<uint32_t> s_v2Frames{ 0 };
+static std::atomic<uint32_t> s_legacyFrames{ 0 };
+static std::atomic<uint32_t> s_probes{ 0 };
+static std::atomic<uint32_t> s_acksSent{ 0 };
+static std::atomic<uint32_t> s_beacons{ 0 };
+
+// Announced ESP-NOW channel (loop task writes, Wi-Fi task reads for ACKs)
+static volatile uint8_t s_channel = 0;
+static uint16_t s_beaconSeq = 0;
+static uint32_t s_lastBeaconMs = 0;
+
+static bool sendControl(uint8_t type, uint16_t nodeId, uint16_t seq) {
+  static const uint8_t bcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+  LuxWire::Frame f;
+  f.type = type;
+  f.flags = LuxWire::F_CRC;
+  f.nodeId = nodeId;
+  f.seq = seq;
+  f.legacy = false;
+  f.channel = s_channel;
+  f.count = 0;
+  uint8_t buf[LuxWire::kHeaderLen + LuxWire::kControlLen + LuxWire::kCrcLen];
+  size_t n = LuxWire::encode(f, buf, sizeof(buf));
+  return n && esp_now_send(bcast, buf, n) == ESP_OK;
+}
+
+// Consumer-side state (render task only; copied out under s_statsMux)
+static Stats s_cons;
+static uint32_t s_prevArrivalMs = 0;
+static bool s_havePrev = false;
+static portMUX_TYPE s_statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Fusion table (written by the render task, read by handlers; both under s_statsMux)
+static LuxFusion::Table s_table;
+static LuxFusion::Result s_fused = {};
+static uint32_t s_lastFuseMs = 0;
+static bool s_skipFrame = false;  // rest of a duplicate frame (frames can span drains)
+
+// Wi-Fi task: decode + enqueue only
+void onReceive(const uint8_t* mac, int8_t rssi, const uint8_t* data, int len) {
+  if (len <= 0) { s_malformed.fetch_add(1, std::memory_order_relaxed); return; }
+  LuxWire::Frame f;
+  LuxWire::Status st = LuxWire::decode(data, (size_t)len, f);
+  if (st != LuxWire::OK) {
+    (st == LuxWire::E_CRC ? s_crcErrors : s_malformed).fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if (LuxWire::isControl(f.type)) {
+    // probes get an ACK; beacons/ACKs from other lamps are ignored
+    if (f.type == LuxWire::T_PROBE) {
+      s_probes.fetch_add(1, std::memory_order_relaxed);
+      if (sendControl(LuxWire::T_ACK, f.nodeId, f.seq)) s_acksSent.fetch_add(1, std::memory_order_relaxed);
+    }
+    return;
+  }
+  if ((f.flags & LuxWire::F_ACK_REQ) && sendControl(LuxWire::T_ACK, f.nodeId, f.seq)) {
+    s_acksSent.fetch_add(1, std::memory_order_relaxed);
+  }
+  (f.legacy ? s_legacyFrames : s_v2Frames).fetch_add(1, std::memory_order_relaxed);
+
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < f.count; ++i) {
+    const LuxWire::Sample& ws = f.samples[i];
+    Sample s;
+    s.arrivalMs = now;
+    s.ageMs = ws.ageMs;
+    s.lux = ws.lux;
+    if (isnan(s.lux) || s.lux > 200000.0f) s.lux = -1.0f;
+    if (mac) memcpy(s.mac, mac, 6);
+    else memset(s.mac, 0, 6);
+    s.rssi = rssi;
+    s.motion = (ws.motion & LuxWire::M_VALID) ? ((ws.motion & LuxWire::M_MOTION) ? 1 : 0) : kNoMotion;
+    s.nodeId = f.nodeId;
+    s.seq = f.seq;
+    s.flags = (uint8_t)((i == 0 ? S_FRAME_START : 0) | (f.legacy ? 0 : S_HAS_SEQ) |
+                        ((f.flags & LuxWire::F_LOW_POWER) ? S_LOW_POWER : 0));
+
+    if (s_ring.push(s)) s_received.fetch_add(1, std::memory_order_relaxed);
+    else s_dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// Loop task: beacon the channel right away when it changed (or force), else every LUX_BEACON_MS
+void announce(uint8_t channel, uint32_t nowMs, bool force = false) {
+  bool changed = channel != s_channel;
+  if (!changed && !force && nowMs - s_lastBeaconMs < LUX_BEACON_MS) return;
+  s_channel = channel;
+  s_lastBeaconMs = nowMs;
+  if (sendControl(LuxWire::T_BEACON, 0, ++s_beaconSeq)) s_beacons.fetch_add(1, std::memory_order_relaxed);
+  if (changed) Serial.printf("[ESP-NOW] Announcing channel %u\n", channel);
+}
+
+static void noteArrival(uint32_t arrivalMs) {
+  if (s_havePrev) {
+    uint32_t iv = arrivalMs - s_prevArrivalMs;
+    if (!s_cons.avgIntervalMs) s_cons.avgIntervalMs = iv;
+    s_cons.avgIntervalMs += ((int32_t)iv - (int32_t)s_cons.avgIntervalMs) / 8;
+    uint32_t j = (uint32_t)abs((int32_t)iv - (int32_t)s_cons.avgIntervalMs);
+    s_cons.jitterMs += ((int32_t)j - (int32_t)s_cons.jitterMs) / 8;
+    if (j > s_cons.maxJitterMs) s_cons.maxJitterMs = j;
+    s_cons.lastIntervalMs = iv;
+  }
+  s_prevArrivalMs = arrivalMs;
+  s_havePrev = true;
+}
+
+// Render task: apply everything that arrived since the last frame
+void drain() {
+  Sample batch[LUX_DRAIN_BATCH];
+  uint16_t depth = s_ring.size();
+  size_t n = s_ring.popBatch(batch, LUX_DRAIN_BATCH);
+  uint32_t now = millis();
+  if (!n && now - s_lastFuseMs < LUX_FUSE_INTERVAL_MS) return;
+
+  portENTER_CRITICAL(&s_statsMux);
+  for (size_t i = 0; i < n; ++i) {
+    const Sample& sm = batch[i];
+    if (sm.flags & S_FRAME_START) {
+      s_skipFrame = (sm.flags & S_HAS_SEQ) && !s_table.acceptSeq(sm.mac, sm.nodeId, sm.seq, (sm.flags & S_LOW_POWER) != 0, sm.arrivalMs);
+      if (s_skipFrame) s_cons.dupFrames++;
+      else noteArrival(sm.arrivalMs);
+    }
+    if (s_skipFrame) continue;
+    s_table.update(sm.mac, sm.lux, sm.motion, sm.rssi, sm.arrivalMs - sm.ageMs);
+  }
+  if (n) {
+    s_cons.drained += n;
+    if (n > s_cons.maxBatch) s_cons.maxBatch = (uint16_t)n;
+    if (depth > s_cons.maxDepth) s_cons.maxDepth = depth;
+  }
+  LuxFusion::Result r = s_table.fuse(now);
+  s_fused = r;
+  portEXIT_CRITICAL(&s_statsMux);
+  s_lastFuseMs = now;
+
+  if (r.presenceKnown) g_lastMotion = r.occupied;
+  if (n) g_lastLuxMillis = batch[n - 1].arrivalMs;
+  g_lastLux = r.lux;
+  LedControl::updateLux(r.lux);  // no-op unless the fused value moved
+}
+
+// Presence control only acts while some fresh node reports motion
+bool presenceKnown() {
+  return s_fused.presenceKnown;
+}
+
+// Bumped whenever the node table changes (keys the /status cache)
+uint32_t tableVersion() {
+  portENTER_CRITICAL(&s_statsMux);
+  uint32_t v = s_table.changes();
+  portEXIT_CRITICAL(&s_statsMux);
+  return v;
+}
+
+bool setFusion(int mode, int fallback) {
+  if (mode > LuxFusion::FUSE_MAX || fallback > LuxFusion::FALLBACK_FIXED) return false;
+  portENTER_CRITICAL(&s_statsMux);
+  if (mode >= 0) s_table.mode = (uint8_t)mode;
+  if (fallback >= 0) s_table.fallback = (uint8_t)fallback;
+  s_lastFuseMs -= LUX_FUSE_INTERVAL_MS;  // re-fuse on the next frame
+  portEXIT_CRITICAL(&s_statsMux);
+  return true;
+}
+
+// ,"fusion":...,"sensors":{...},"nodes":[...]  (appended to /status)
+size_t formatNodes(char* buf, size_t cap) {
+  LuxFusion::Table t;
+  LuxFusion::Result r;
+  portENTER_CRITICAL(&s_statsMux);
+  t = s_table;
+  r = s_fused;
+  portEXIT_CRITICAL(&s_statsMux);
+  uint32_t now = millis();
+
+  int n = snprintf(buf, cap, ",\"fusion\":\"%s\",\"fallback\":\"%s\",\"sensors\":{\"fresh\":%u,\"total\":%u,\"lux_ok\":%s},\"nodes\":[",
+                   LuxFusion::modeName(t.mode), t.fallback == LuxFusion::FALLBACK_FIXED ? "fixed" : "hold",
+                   r.fresh, r.total, r.luxFresh ? "true" : "false");
+  const char* sep = "";
+  for (uint8_t i = 0; i < t.capacity() && n > 0 && (size_t)n < cap; ++i) {
+    const LuxFusion::Node& nd = t.node(i);
+    if (!nd.used) continue;
+    const char* motion = nd.motion == LuxFusion::kNoMotion ? "null" : nd.motion ? "true" : "false";
+    n += snprintf(buf + n, cap - n,
+                  "%s{\"mac\":\"%02X:%02X:%02X:%02X:%02X:%02X\",\"id\":%u,\"lux\":%.2f,\"motion\":%s,\"rssi\":%d,"
+                  "\"stale\":%s,\"low_power\":%s,\"loss_permille\":%lu}",
+                  sep, nd.mac[0], nd.mac[1], nd.mac[2], nd.mac[3], nd.mac[4], nd.mac[5],
+                  nd.nodeId, nd.lux, motion, nd.rssi, t.isStale(i, now) ? "true" : "false", nd.lowPower ? "true" : "false",
+                  (unsigned long)nd.seq.lossPermille());
+    sep = ",";
+  }
+  if (n > 0 && (size_t)n < cap) n += snprintf(buf + n, cap - n, "]");
+  if (n < 0 || !cap) return 0;
+  return (size_t)n < cap ? (size_t)n : cap - 1;
+}
+
+Stats stats(bool resetMax = false) {
+  portENTER_CRITICAL(&s_statsMux);
+  Stats st = s_cons;
+  if (resetMax) {
+    s_cons.maxBatch = 0;
+    s_cons.maxDepth = 0;
+    s_cons.maxJitterMs = 0;
+  }
+  portEXIT_CRITICAL(&s_statsMux);
+  st.received = s_received.load(std::memory_order_relaxed);
+  st.dropped = s_dropped.load(std::memory_order_relaxed);
+  st.malformed = s_malformed.load(std::memory_order_relaxed);
+  st.crcErrors = s_crcErrors.load(std::memory_order_relaxed);
+  st.v2Frames = s_v2Frames.load(std::memory_order_relaxed);
+  st.legacyFrames = s_legacyFrames.load(std::memory_order_relaxed);
+  st.probes = s_probes.load(std::memory_order_relaxed);
+  st.acksSent = s_acksSent.load(std::memory_order_relaxed);
+  st.beacons = s_beacons.load(std::memory_order_relaxed);
+  st.lostFrames = 0;
+  portENTER_CRITICAL(&s_statsMux);
+  for (uint8_t i = 0; i < s_table.capacity(); ++i) {
+    if (s_table.node(i).used) st.lostFrames += s_table.node(i).seq.lost;
+  }
+  portEXIT_CRITICAL(&s_statsMux);
+  return st;
+}
+
+String jsonStats(bool resetMax = false) {
+  Stats st = stats(resetMax);
+  char buf[600];
+  snprintf(buf, sizeof(buf),
+           "{\"ring_size\":%u,\"depth\":%u,\"received\":%lu,\"dropped\":%lu,\"malformed\":%lu,"
+           "\"crc_errors\":%lu,\"v2_frames\":%lu,\"legacy_frames\":%lu,\"dup_frames\":%lu,\"lost_frames\":%lu,"
+           "\"drained\":%lu,\"max_batch\":%u,\"max_depth\":%u,\"interval_ms\":%lu,"
+           "\"avg_interval_ms\":%lu,\"jitter_ms\":%lu,\"max_jitter_ms\":%lu,"
+           "\"channel\":%u,\"probes\":%lu,\"acks_sent\":%lu,\"beacons\":%lu}",
+           (unsigned)LUX_RING_SIZE, (unsigned)s_ring.size(),
+           (unsigned long)st.received, (unsigned long)st.dropped, (unsigned long)st.malformed,
+           (unsigned long)st.crcErrors, (unsigned long)st.v2Frames, (unsigned long)st.legacyFrames,
+           (unsigned long)st.dupFrames, (unsigned long)st.lostFrames,
+           (unsigned long)st.drained, st.maxBatch, st.maxDepth,
+           (unsigned long)st.lastIntervalMs, (unsigned long)st.avgIntervalMs,
+           (unsigned long)st.jitterMs, (unsigned long)st.maxJitterMs,
+           (unsigned)s_channel, (unsigned long)st.probes, (unsigned long)st.acksSent, (unsigned long)st.beacons);
+  return String(buf);
+}
+
+}
@@ -0,0 +1,326 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
+#include "histogram.h"
+#include "persist.h"
+
+/*
+  metrics.h
+  Counters and latency histograms for the hot paths, in static storage:
+  recording takes a spinlock for a few adds and never allocates.
+  - histograms (histogram.h): loop() iteration, LED tick, ESP-NOW receive
+    callback, Gemini request, and one per HTTP route (timed() wraps the
+    handler registered with server.on)
+  - counters: settings saves per setting, ESP-NOW bytes, Gemini results
+  - gauges read on demand: heap, largest free block, loop rate, ESP-NOW
+    packet rate, open HTTP requests, NVS blob writes (Persist)
+  GET /metrics is Prometheus text, streamed in chunks from a cursor so a
+  scrape needs no buffer for the whole body; /metrics?format=json is the
+  compact view. AsyncTCP keeps its event queue private, so requests whose
+  connection is still open stand in for its backlog.
+*/
+
+#ifndef METRICS_ROUTES_MAX
+#define METRICS_ROUTES_MAX 40
+#endif
+
+namespace Metrics {
+
+enum Hist : uint8_t { H_LOOP, H_TICK, H_ESPNOW, H_GEMINI, H_FIXED };
+
+enum Counter : uint8_t {
+  C_SAVE_COLOR, C_SAVE_BRIGHTNESS, C_SAVE_EFFECT, C_SAVE_ON, C_SAVE_MIMIR,
+  C_SAVE_WIFI_MODE, C_SAVE_STA, C_SAVE_MIMIR_RANGE, C_SAVE_MIMIR_CURVE, C_SAVE_PRESENCE,
+  C_ESPNOW_BYTES, C_GEMINI_OK, C_GEMINI_ERROR,
+  C_COUNT
+};
+
+static const char* const kSettingNames[] = {
+  "color", "brightness", "effect", "on", "mimir", "wifi_mode", "sta", "mimir_range", "mimir_curve", "presence"
+};
+static const uint8_t kSettings = sizeof(kSettingNames) / sizeof(kSettingNames[0]);
+static_assert(kSettings == C_ESPNOW_BYTES, "one name per settings counter");
+
+static Histogram s_hist[H_FIXED + METRICS_ROUTES_MAX];
+static const char* s_routes[METRICS_ROUTES_MAX];
+static uint8_t s_routeCount = 0;
+static std::atomic<uint32_t> s_counters[C_COUNT];
+static std::atomic<int32_t> s_httpOpen{ 0 };
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Rates over the last full second (loop task)
+static uint32_t s_rateMs = 0;
+static uint32_t s_rateLoops = 0;
+static uint32_t s_rateEspNow = 0;
+static uint16_t s_loopHz = 0;
+static uint16_t s_espNowPps = 0;
+
+void record(uint8_t h, uint32_t us) {
+  portENTER_CRITICAL(&s_mux);
+  s_hist[h].record(us);
+  portEXIT_CRITICAL(&s_mux);
+}
+
+inline void count(Counter c, uint32_t n = 1) {
+  s_counters[c].fetch_add(n, std::memory_order_relaxed);
+}
+
+// Times its scope into histogram h
+struct Timer {
+  uint8_t h;
+  uint32_t t0;
+  explicit Timer(uint8_t hist) : h(hist), t0(micros()) {}
+  ~Timer() { record(h, micros() - t0); }
+};
+
+static Histogram snapshot(uint8_t h) {
+  portENTER_CRITICAL(&s_mux);
+  Histogram s = s_hist[h];
+  portEXIT_CRITICAL(&s_mux);
+  return s;
+}
+
+// Histogram slot of a route (routes sharing a path share it); -1 if the table is full
+static int route(const char* path) {
+  for (uint8_t i = 0; i < s_routeCount; ++i) {
+    if (strcmp(s_routes[i], path) == 0) return H_FIXED + i;
+  }
+  if (s_routeCount == METRICS_ROUTES_MAX) return -1;
+  s_routes[s_routeCount] = path;
+  return H_FIXED + s_routeCount++;
+}
+
+// Handler that records its run time under `path` (a string that outlives the server)
+ArRequestHandlerFunction timed(const char* path, ArRequestHandlerFunction fn) {
+  int h = route(path);
+  if (h < 0) {
+    Serial.printf("[Metrics] METRICS_ROUTES_MAX reached, %s not timed\n", path);
+    return fn;
+  }
+  return [fn, h](AsyncWebServerRequest* r) {
+    s_httpOpen.fetch_add(1, std::memory_order_relaxed);
+    r->onDisconnect([]() { s_httpOpen.fetch_sub(1, std::memory_order_relaxed); });
+    uint32_t t0 = micros();
+    fn(r);
+    record((uint8_t)h, micros() - t0);
+  };
+}
+
+// Call from loop(): refreshes the per-second rates
+void service(uint32_t now) {
+  if (now - s_rateMs < 1000) return;
+  portENTER_CRITICAL(&s_mux);
+  uint32_t loops = s_hist[H_LOOP].count;
+  uint32_t packets = s_hist[H_ESPNOW].count;
+  portEXIT_CRITICAL(&s_mux);
+  uint32_t dt = now - s_rateMs;
+  if (s_rateMs) {
+    s_loopHz = (uint16_t)((uint64_t)(loops - s_rateLoops) * 1000 / dt);
+    s_espNowPps = (uint16_t)((uint64_t)(packets - s_rateEspNow) * 1000 / dt);
+  }
+  s_rateMs = now;
+  s_rateLoops = loops;
+  s_rateEspNow = packets;
+}
+
+// ---- Prometheus text ----
+
+enum Source : uint8_t {
+  V_UPTIME, V_HEAP_FREE, V_HEAP_MIN, V_HEAP_LARGEST, V_LOOP_HZ, V_ESPNOW_PPS, V_HTTP_OPEN,
+  V_NVS_WRITES, V_NVS_FAILED, V_SETTING_MARKS,
+  V_COUNTER  // + Counter
+};
+
+struct Scalar {
+  const char* family;
+  const char* type;
+  const char* help;
+  const char* label;  // `key="value"` or nullptr
+  uint8_t source;
+};
+
+static const Scalar kScalars[] = {
+  { "sleeplamp_uptime_seconds", "gauge", "Time since boot", nullptr, V_UPTIME },
+  { "sleeplamp_heap_free_bytes", "gauge", "Free 8-bit heap", nullptr, V_HEAP_FREE },
+  { "sleeplamp_heap_min_free_bytes", "gauge", "Lowest free heap since boot", nullptr, V_HEAP_MIN },
+  { "sleeplamp_heap_largest_free_block_bytes", "gauge", "Largest allocatable block", nullptr, V_HEAP_LARGEST },
+  { "sleeplamp_loop_hz", "gauge", "loop() iterations in the last second", nullptr, V_LOOP_HZ },
+  { "sleeplamp_espnow_packets_per_second", "gauge", "ESP-NOW packets in the last second", nullptr, V_ESPNOW_PPS },
+  { "sleeplamp_espnow_bytes_total", "counter", "ESP-NOW payload bytes received", nullptr, V_COUNTER + C_ESPNOW_BYTES },
+  { "sleeplamp_http_requests_open", "gauge", "Handled requests whose connection is still open", nullptr, V_HTTP_OPEN },
+  { "sleeplamp_nvs_writes_total", "counter", "Settings blob writes to NVS", nullptr, V_NVS_WRITES },
+  { "sleeplamp_nvs_write_failures_total", "counter", "Failed settings blob writes", nullptr, V_NVS_FAILED },
+  { "sleeplamp_setting_changes_total", "counter", "Saves that changed a setting", nullptr, V_SETTING_MARKS },
+  { "sleeplamp_setting_saves_total", "counter", "savePreference calls", "setting=\"color\"", V_COUNTER + C_SAVE_COLOR },
+  { "sleeplamp_setting_saves_total", "counter", nullptr, "setting=\"brightness\"", V_COUNTER + C_SAVE_BRIGHTNESS },
+  { "sleeplamp_setting_saves_total", "counter", nullptr, "setting=\"effect\"", V_COUNTER + C_SAVE_EFFECT },
+  { "sleeplamp_setting_saves_total", "counter", nullptr, "setting=\"on\"", V_COUNTER + C_SAVE_ON },
+  { "sleeplamp_setting_saves_total", "counter", nullptr, "setting=\"mimir\"", V_COUNTER + C_SAVE_MIMIR },
+  { "sleeplamp_setting_saves_total", "counter", nullptr, "setting=\"wifi_mode\"", V_COUNTER + C_SAVE_WIFI_MODE },
+  { "sleeplamp_setting_saves_total", "counter", nullptr, "setting=\"sta\"", V_COUNTER + C_SAVE_STA },
+  { "sleeplamp_setting_saves_total", "counter", nullptr, "setting=\"mimir_range\"", V_COUNTER + C_SAVE_MIMIR_RANGE },
+  { "sleeplamp_setting_saves_total", "counter", nullptr, "setting=\"mimir_curve\"", V_COUNTER + C_SAVE_MIMIR_CURVE },
+  { "sleeplamp_setting_saves_total", "counter", nullptr, "setting=\"presence\"", V_COUNTER + C_SAVE_PRESENCE },
+  { "sleeplamp_gemini_requests_total", "counter", "Gemini requests by outcome", "result=\"ok\"", V_COUNTER + C_GEMINI_OK },
+  { "sleeplamp_gemini_requests_total", "counter", nullptr, "result=\"error\"", V_COUNTER + C_GEMINI_ERROR },
+};
+static const uint8_t kScalarCount = sizeof(kScalars) / sizeof(kScalars[0]);
+
+struct HistFamily {
+  const char* family;
+  const char* help;
+};
+
+static const HistFamily kHistFamilies[H_FIXED + 1] = {
+  { "sleeplamp_loop_seconds", "loop() iteration time, without its 1 ms delay" },
+  { "sleeplamp_led_tick_seconds", "LedControl::tick time per frame" },
+  { "sleeplamp_espnow_recv_seconds", "ESP-NOW receive callback time (decode and enqueue)" },
+  { "sleeplamp_gemini_request_seconds", "Gemini request time, connect to compiled answer" },
+  { "sleeplamp_http_handler_seconds", "HTTP handler time, until the response is queued" },  // all routes
+};
+
+static uint32_t scalarValue(uint8_t source) {
+  switch (source) {
+    case V_UPTIME: return (uint32_t)(esp_timer_get_time() / 1000000);
+    case V_HEAP_FREE: return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    case V_HEAP_MIN: return heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    case V_HEAP_LARGEST: return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    case V_LOOP_HZ: return s_loopHz;
+    case V_ESPNOW_PPS: return s_espNowPps;
+    case V_HTTP_OPEN: { int32_t n = s_httpOpen.load(std::memory_order_relaxed); return n > 0 ? (uint32_t)n : 0; }
+    case V_NVS_WRITES: return Persist::stats().writes;
+    case V_NVS_FAILED: return Persist::stats().failed;
+    case V_SETTING_MARKS: return Persist::stats().marks;
+    default: return s_counters[source - V_COUNTER].load(std::memory_order_relaxed);
+  }
+}
+
+// Where a scrape is; one piece of text (a metric, or one histogram line) at a time
+struct PromCursor {
+  uint16_t item = 0;  // scalars, then histograms
+  uint8_t line = 0;   // within a histogram
+  uint16_t len = 0;
+  uint16_t off = 0;
+  char text[256];
+  Histogram snap;  // histograms are copied once, so buckets and count agree
+};
+
+static int header(char* buf, size_t cap, const char* family, const char* type, const char* help) {
+  return snprintf(buf, cap, "# HELP %s %s\n# TYPE %s %s\n", family, help, family, type);
+}
+
+// Seconds with microsecond precision
+static int seconds(char* buf, size_t cap, uint64_t us) {
+  return snprintf(buf, cap, "%lu.%06lu", (unsigned long)(us / 1000000), (unsigned long)(us % 1000000));
+}
+
+static uint8_t histFamily(uint16_t h) {
+  return h < H_FIXED ? (uint8_t)h : (uint8_t)H_FIXED;
+}
+
+// Next piece of text into c.text; false when the scrape is complete
+static bool nextText(PromCursor& c) {
+  char* b = c.text;
+  const size_t cap = sizeof(c.text);
+  int n = 0;
+  if (c.item < kScalarCount) {
+    const Scalar& s = kScalars[c.item];
+    if (s.help) n = header(b, cap, s.family, s.type, s.help);
+    n += snprintf(b + n, cap - n, s.label ? "%s{%s} %lu\n" : "%s%s %lu\n", s.family, s.label ? s.label : "",
+                  (unsigned long)scalarValue(s.source));
+    c.item++;
+  } else {
+    uint16_t h = c.item - kScalarCount;
+    if (h >= H_FIXED + s_routeCount) return false;
+    const HistFamily& f = kHistFamilies[histFamily(h)];
+    char label[64] = "";
+    if (h >= H_FIXED) snprintf(label, sizeof(label), "path=\"%s\",", s_routes[h - H_FIXED]);
+    if (c.line == 0) {
+      c.snap = snapshot((uint8_t)h);
+      if (h <= H_FIXED) n = header(b, cap, f.family, "histogram", f.help);
+      c.line = 1;
+    } else if (c.line <= Histogram::kBuckets) {
+      uint8_t i = c.line - 1;
+      uint32_t cum = 0;
+      for (uint8_t k = 0; k <= i; ++k) cum += c.snap.counts[k];
+      n = snprintf(b, cap, "%s_bucket{%sle=\"", f.family, label);
+      if (i < Histogram::kBounds) n += seconds(b + n, cap - n, Histogram::boundUs(i));
+      else n += snprintf(b + n, cap - n, "+Inf");
+      n += snprintf(b + n, cap - n, "\"} %lu\n", (unsigned long)cum);
+      c.line++;
+    } else {
+      size_t ll = strlen(label);
+      if (ll) label[ll - 1] = '\0';  // drop the trailing comma
+      const char* open = ll ? "{" : "";
+      const char* close = ll ? "}" : "";
+      n = snprintf(b, cap, "%s_sum%s%s%s ", f.family, open, label, close);
+      n += seconds(b + n, cap - n, c.snap.sumUs);
+      n += snprintf(b + n, cap - n, "\n%s_count%s%s%s %lu\n", f.family, open, label, close, (unsigned long)c.snap.count);
+      c.item++;
+      c.line = 0;
+    }
+  }
+  c.len = n < (int)cap ? (uint16_t)n : (uint16_t)(cap - 1);
+  c.off = 0;
+  return true;
+}
+
+// Chunked-response filler: up to maxLen bytes of the scrape, 0 at the end
+size_t promChunk(PromCursor& c, uint8_t* buf, size_t maxLen) {
+  size_t out = 0;
+  while (out < maxLen) {
+    if (c.off == c.len && !nextText(c)) break;
+    size_t k = c.len - c.off;
+    if (k > maxLen - out) k = maxLen - out;
+    memcpy(buf + out, c.text + c.off, k);
+    c.off += k;
+    out += k;
+  }
+  return out;
+}
+
+// ---- JSON view ----
+
+static void histJson(JsonObject o, const Histogram& h) {
+  o["n"] = h.count;
+  o["avg_us"] = h.avgUs();
+  o["p50_us"] = h.quantileUs(0.5f);
+  o["p99_us"] = h.quantileUs(0.99f);
+  o["max_us"] = h.maxUs;
+}
+
+// Gauges, counters and per-histogram n/avg/p50/p99/max (quantiles are bucket bounds)
+void writeJson(JsonDocument& doc) {
+  doc["uptime_s"] = scalarValue(V_UPTIME);
+  JsonObject heap = doc.createNestedObject("heap");
+  heap["free"] = scalarValue(V_HEAP_FREE);
+  heap["min_free"] = scalarValue(V_HEAP_MIN);
+  heap["largest_block"] = scalarValue(V_HEAP_LARGEST);
+  doc["loop_hz"] = s_loopHz;
+  doc["espnow_pps"] = s_espNowPps;
+  doc["espnow_bytes"] = scalarValue(V_COUNTER + C_ESPNOW_BYTES);
+  doc["http_open"] = scalarValue(V_HTTP_OPEN);
+  JsonObject nvs = doc.createNestedObject("nvs");
+  nvs["writes"] = scalarValue(V_NVS_WRITES);
+  nvs["failed"] = scalarValue(V_NVS_FAILED);
+  nvs["changes"] = scalarValue(V_SETTING_MARKS);
+  JsonObject saves = nvs.createNestedObject("saves");
+  for (uint8_t i = 0; i < kSettings; ++i) saves[kSettingNames[i]] = scalarValue(V_COUNTER + i);
+  JsonObject gem = doc.createNestedObject("gemini");
+  gem["ok"] = scalarValue(V_COUNTER + C_GEMINI_OK);
+  gem["error"] = scalarValue(V_COUNTER + C_GEMINI_ERROR);
+
+  static const char* const kHistKeys[H_FIXED] = { "loop", "led_tick", "espnow_recv", "gemini" };
+  for (uint8_t h = 0; h < H_FIXED; ++h) histJson(doc.createNestedObject(kHistKeys[h]), snapshot(h));
+  JsonObject routes = doc.createNestedObject("http");
+  for (uint8_t i = 0; i < s_routeCount; ++i) {
+    Histogram h = snapshot(H_FIXED + i);
+    if (h.count) histJson(routes.createNestedObject(s_routes[i]), h);
+  }
+}
+
+}
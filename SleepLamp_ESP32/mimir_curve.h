@@ -0,0 +1,126 @@
+#pragma once
+// Lux -> brightness curve engine for Mimir mode.
+// The default gamma shape is baked at compile time; the brightness LUT for the
+// active range is rebuilt only when the range or a user curve changes, so a
+// lux sample maps with one scale + integer interpolation.
+
+#include <stdint.h>
+#include "config.h"
+#include "mimir_tuning.h"
+#include "ct_math.h"
+
+// Lux bins across [LUX_MIN, LUX_MAX] (2^bits)
+#ifndef MIMIR_CURVE_BITS
+#define MIMIR_CURVE_BITS 8
+#endif
+
+// Max control points of a user piecewise curve
+#ifndef MIMIR_CURVE_MAX_POINTS
+#define MIMIR_CURVE_MAX_POINTS 8
+#endif
+
+namespace MimirCurve {
+
+static const uint16_t kBins = 1u << MIMIR_CURVE_BITS;
+
+// Piecewise point: absolute lux -> level (0..255, scaled into the Mimir range)
+struct Point {
+  uint16_t lux;
+  uint8_t level;
+};
+
+// (i / kBins)^MIMIR_GAMMA in Q16
+struct GammaTable { uint16_t q16[kBins + 1]; };
+
+constexpr uint16_t gammaQ16(uint16_t i) {
+  return CtMath::toQ16(CtMath::pow((double)i / (double)kBins, (double)MIMIR_GAMMA));
+}
+template <uint16_t... I>
+constexpr GammaTable makeGammaTable(CtMath::Seq<I...>) {
+  return GammaTable{ { gammaQ16(I)... } };
+}
+static constexpr GammaTable kGamma = makeGammaTable(CtMath::MakeSeq<kBins + 1>::type());
+
+static_assert(kGamma.q16[0] == 0 && kGamma.q16[kBins] == 65535, "gamma table endpoints");
+
+// Runtime state: brightness in Q8 per lux bin for the active range/curve
+static uint16_t s_lutQ8[kBins + 1];
+static Point s_points[MIMIR_CURVE_MAX_POINTS];
+static uint8_t s_pointCount = 0;  // 0 = built-in gamma curve
+
+// Level (Q16) of the user curve at a given lux; flat beyond the end points
+static uint32_t pointsLevelQ16(float lux) {
+  if (lux <= (float)s_points[0].lux) return (uint32_t)s_points[0].level * 257u;
+  for (uint8_t i = 1; i < s_pointCount; ++i) {
+    const Point& a = s_points[i - 1];
+    const Point& b = s_points[i];
+    if (lux <= (float)b.lux) {
+      float f = (lux - (float)a.lux) / (float)(b.lux - a.lux);
+      float lv = (float)a.level + f * ((float)b.level - (float)a.level);
+      return (uint32_t)(lv * 257.0f + 0.5f);
+    }
+  }
+  return (uint32_t)s_points[s_pointCount - 1].level * 257u;
+}
+
+// Rebuild the LUT for a brightness range (call on range/curve change only)
+void rebuild(uint8_t minB, uint8_t maxB) {
+  uint32_t span = (uint32_t)(maxB - minB);
+  for (uint16_t i = 0; i <= kBins; ++i) {
+    uint32_t lvl;
+    if (s_pointCount) {
+      float lux = LUX_MIN + (float)i * ((float)(LUX_MAX - LUX_MIN) / (float)kBins);
+      lvl = pointsLevelQ16(lux);
+    } else {
+      lvl = kGamma.q16[i];
+    }
+    s_lutQ8[i] = (uint16_t)(((uint32_t)minB << 8) + ((span * lvl + 128u) >> 8));
+  }
+}
+
+// Map a lux sample to brightness (within one step of the old float formula)
+uint8_t map(float lux) {
+  static const float kScale = (float)kBins * 256.0f / (float)(LUX_MAX - LUX_MIN);
+  uint32_t pos;
+  if (!(lux > LUX_MIN)) pos = 0;  // also catches NaN
+  else if (lux >= LUX_MAX) pos = (uint32_t)kBins << 8;
+  else pos = (uint32_t)((lux - LUX_MIN) * kScale);
+
+  uint32_t idx = pos >> 8;
+  if (idx >= kBins) return (uint8_t)((s_lutQ8[kBins] + 128u) >> 8);
+  int32_t a = s_lutQ8[idx];
+  int32_t b = s_lutQ8[idx + 1];
+  int32_t q8 = a + (((b - a) * (int32_t)(pos & 0xFF) + 128) >> 8);
+  return (uint8_t)((q8 + 128) >> 8);
+}
+
+// Install a user curve (>= 2 points, any order; duplicate lux rejected)
+bool setPoints(const Point* pts, uint8_t n) {
+  if (!pts || n < 2 || n > MIMIR_CURVE_MAX_POINTS) return false;
+  Point tmp[MIMIR_CURVE_MAX_POINTS];
+  for (uint8_t i = 0; i < n; ++i) {
+    // insertion sort by lux
+    uint8_t j = i;
+    while (j > 0 && tmp[j - 1].lux > pts[i].lux) { tmp[j] = tmp[j - 1]; --j; }
+    tmp[j] = pts[i];
+  }
+  for (uint8_t i = 1; i < n; ++i) {
+    if (tmp[i].lux == tmp[i - 1].lux) return false;
+  }
+  for (uint8_t i = 0; i < n; ++i) s_points[i] = tmp[i];
+  s_pointCount = n;
+  return true;
+}
+
+void clearPoints() {
+  s_pointCount = 0;
+}
+
+uint8_t pointCount() {
+  return s_pointCount;
+}
+const Point* points() {
+  return s_points;
+}
+
+}
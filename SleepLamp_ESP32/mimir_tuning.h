@@ -20,7 +20,7 @@
 #define MIMIR_MIN_STEP 3
 #endif
 
-// Smoothing speed while Mimir is ON (0..1). Higher = faster.
-#ifndef MIMIR_ALPHA
-#define MIMIR_ALPHA 0.25f
+// Smoothing time constant while Mimir is ON (ms). Lower = faster.
+#ifndef MIMIR_TAU_MS
+#define MIMIR_TAU_MS 80.0f
 #endif
\ No newline at end of file
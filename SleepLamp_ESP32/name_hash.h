@@ -0,0 +1,77 @@
+#pragma once
+// Compile-time perfect hash over a fixed name table (C++11 constexpr).
+// Names are stored normalized (lowercase a-z0-9). The compiler builds the
+// slot table that maps hash(name) to the entry index, and perfect() proves
+// in a static_assert that every name owns its slot, so a lookup is one hash,
+// one slot read and one strcmp. If an added name trips the assert, change
+// that table's seed until it passes.
+
+#include <stdint.h>
+#include <string.h>
+#include "ct_math.h"
+
+namespace NameHash {
+
+struct Entry {
+  const char* key;
+  uint32_t value;
+};
+
+static const uint8_t kEmpty = 0xFF;
+
+// FNV-1a with the seed as offset basis, high bits folded into the slot
+constexpr uint32_t fnv(const char* s, uint32_t h) {
+  return *s ? fnv(s + 1, (h ^ (uint8_t)*s) * 16777619u) : h;
+}
+constexpr uint16_t fold(uint32_t h, uint16_t mask) { return (uint16_t)((h ^ (h >> 15)) & mask); }
+constexpr uint16_t slotOf(const char* s, uint32_t seed, uint16_t mask) { return fold(fnv(s, seed), mask); }
+
+template <uint16_t N> struct Slots { uint8_t idx[N]; };
+
+// First entry whose name lands on slot s (kEmpty if none)
+constexpr uint8_t entryFor(const Entry* kv, uint8_t n, uint32_t seed, uint16_t mask, uint16_t s, uint8_t k) {
+  return k >= n ? kEmpty : slotOf(kv[k].key, seed, mask) == s ? k : entryFor(kv, n, seed, mask, s, (uint8_t)(k + 1));
+}
+
+// N must be a power of two, n < kEmpty
+template <uint16_t N, uint16_t... I>
+constexpr Slots<N> makeSlots(const Entry* kv, uint8_t n, uint32_t seed, CtMath::Seq<I...>) {
+  return Slots<N>{ { entryFor(kv, n, seed, N - 1, I, 0)... } };
+}
+
+constexpr bool isNormalized(const char* s) {
+  return !*s || (((*s >= 'a' && *s <= 'z') || (*s >= '0' && *s <= '9')) && isNormalized(s + 1));
+}
+
+// Every name normalized and found at its own slot (no collisions, no duplicates)
+template <uint16_t N>
+constexpr bool perfect(const Entry* kv, uint8_t n, uint32_t seed, const Slots<N>& t, uint8_t k = 0) {
+  return k >= n || (kv[k].key[0] && isNormalized(kv[k].key) &&
+                    t.idx[slotOf(kv[k].key, seed, N - 1)] == k && perfect(kv, n, seed, t, (uint8_t)(k + 1)));
+}
+
+// Runtime lookup of a normalized name; entry index or -1
+template <uint16_t N>
+inline int find(const Entry* kv, const Slots<N>& t, uint32_t seed, const char* key) {
+  uint32_t h = seed;
+  for (const char* p = key; *p; ++p) h = (h ^ (uint8_t)*p) * 16777619u;
+  uint8_t i = t.idx[fold(h, N - 1)];
+  return i != kEmpty && strcmp(kv[i].key, key) == 0 ? i : -1;
+}
+
+// Lowercase a-z0-9 only ("Fire Flicker (Soft)" -> "fireflickersoft");
+// length, or 0 if nothing is left or it does not fit
+inline size_t normalize(const char* in, size_t n, char* out, size_t cap) {
+  size_t len = 0;
+  for (size_t i = 0; i < n && in[i]; ++i) {
+    char c = in[i];
+    if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+    if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'))) continue;
+    if (len + 1 >= cap) return 0;
+    out[len++] = c;
+  }
+  out[len] = '\0';
+  return len;
+}
+
+}
@@ -0,0 +1,302 @@
+#pragma once
+#include <Arduino.h>
+#include <stddef.h>
+#include <Preferences.h>
+#include <esp_system.h>
+#include "config.h"
+#include "mimir_tuning.h"
+#include "mimir_curve.h"
+
+/*
+  persist.h
+  Write-behind persistence. All settings live in one versioned, CRC-protected
+  blob; setters only update RAM and a dirty mask, and service() writes the blob
+  once the changes settle (PERSIST_DEBOUNCE_MS) or have been pending too long
+  (PERSIST_MAX_DELAY_MS). A slider drag therefore costs one NVS write, not dozens.
+  Pending changes are also flushed from the esp_restart() shutdown hook; a hard
+  power cut loses at most the debounce window.
+  Legacy per-setting keys are read only when no blob exists at all, and erased
+  once the migrated blob is on flash; a blob that fails its CRC means defaults.
+*/
+
+#ifndef PERSIST_DEBOUNCE_MS
+#define PERSIST_DEBOUNCE_MS 1500UL
+#endif
+
+#ifndef PERSIST_MAX_DELAY_MS
+#define PERSIST_MAX_DELAY_MS 10000UL
+#endif
+
+namespace Persist {
+
+static const uint16_t kMagic = 0x5653;  // "VS"
+static const uint8_t kVersion = 1;
+
+enum WifiModePref : uint8_t { WIFI_PREF_AP = 0, WIFI_PREF_STA = 1 };
+
+enum DirtyBit : uint16_t {
+  D_COLOR = 1 << 0,
+  D_BRIGHTNESS = 1 << 1,
+  D_EFFECT = 1 << 2,
+  D_ON = 1 << 3,
+  D_MIMIR = 1 << 4,
+  D_RANGE = 1 << 5,
+  D_CURVE = 1 << 6,
+  D_PRESENCE = 1 << 7,
+  D_WIFI = 1 << 8,
+  D_ALL = 0x1FF,
+};
+
+struct State {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t wifiMode;
+  uint32_t color;
+  uint16_t effect;
+  uint8_t brightness;
+  uint8_t on;
+  uint8_t mimir;
+  uint8_t mimirMin;
+  uint8_t mimirMax;
+  uint8_t presence;
+  uint8_t curveCount;
+  uint8_t reserved[3];
+  MimirCurve::Point curve[MIMIR_CURVE_MAX_POINTS];
+  char staSsid[33];
+  char staPass[65];
+  uint32_t crc;  // CRC32 of everything above
+};
+
+struct Stats {
+  uint32_t marks = 0;   // setter calls that changed a value
+  uint32_t writes = 0;  // blob writes to NVS
+  uint32_t failed = 0;
+};
+
+static Preferences* s_prefs = nullptr;
+static State s_state;
+static uint16_t s_dirty = 0;
+static uint32_t s_firstDirtyMs = 0;
+static uint32_t s_lastDirtyMs = 0;
+static Stats s_stats;
+static bool s_legacyKeys = false;  // migrated, old keys still to be erased
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t crc32(const uint8_t* data, size_t len) {
+  uint32_t c = 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; ++i) {
+    c ^= data[i];
+    for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1u)));
+  }
+  return ~c;
+}
+
+static uint32_t stateCrc(const State& st) {
+  return crc32((const uint8_t*)&st, offsetof(State, crc));
+}
+
+static void setDefaults(State& st) {
+  memset(&st, 0, sizeof(st));
+  st.magic = kMagic;
+  st.version = kVersion;
+  st.wifiMode = WIFI_PREF_AP;
+  st.color = DEFAULT_COLOR_HEX;
+  st.effect = DEFAULT_EFFECT_ID;
+  st.brightness = DEFAULT_BRIGHTNESS;
+  st.on = DEFAULT_ON;
+  st.mimir = DEFAULT_MIMIR;
+  st.mimirMin = MIMIR_BRIGHT_MIN;
+  st.mimirMax = MIMIR_BRIGHT_MAX;
+}
+
+static const char* const kLegacyKeys[] = {
+  PREF_KEY_COLOR, PREF_KEY_BRIGHTNESS, PREF_KEY_EFFECT, PREF_KEY_ON, PREF_KEY_MIMIR, PREF_KEY_PRESENCE,
+  PREF_KEY_MIMIR_MIN, PREF_KEY_MIMIR_MAX, PREF_KEY_MIMIR_CURVE, PREF_KEY_WIFI_MODE, PREF_KEY_STA_SSID,
+  PREF_KEY_STA_PASS,
+};
+
+// Pre-blob firmware stored one NVS key per setting; read them once
+static void loadLegacyKeys(Preferences& p, State& st) {
+  st.color = p.getUInt(PREF_KEY_COLOR, DEFAULT_COLOR_HEX);
+  st.brightness = p.getUChar(PREF_KEY_BRIGHTNESS, DEFAULT_BRIGHTNESS);
+  st.effect = p.getUShort(PREF_KEY_EFFECT, DEFAULT_EFFECT_ID);
+  st.on = p.getBool(PREF_KEY_ON, DEFAULT_ON);
+  st.mimir = p.getBool(PREF_KEY_MIMIR, DEFAULT_MIMIR);
+  st.presence = p.getBool(PREF_KEY_PRESENCE, false);
+  st.mimirMin = p.getUChar(PREF_KEY_MIMIR_MIN, MIMIR_BRIGHT_MIN);
+  st.mimirMax = p.getUChar(PREF_KEY_MIMIR_MAX, MIMIR_BRIGHT_MAX);
+
+  size_t curveBytes = p.getBytesLength(PREF_KEY_MIMIR_CURVE);
+  if (curveBytes && curveBytes <= sizeof(st.curve) && curveBytes % sizeof(MimirCurve::Point) == 0) {
+    p.getBytes(PREF_KEY_MIMIR_CURVE, st.curve, curveBytes);
+    st.curveCount = (uint8_t)(curveBytes / sizeof(MimirCurve::Point));
+  }
+
+  st.wifiMode = p.getString(PREF_KEY_WIFI_MODE, "AP") == "STA" ? WIFI_PREF_STA : WIFI_PREF_AP;
+  p.getString(PREF_KEY_STA_SSID, st.staSsid, sizeof(st.staSsid));
+  p.getString(PREF_KEY_STA_PASS, st.staPass, sizeof(st.staPass));
+}
+
+// Write the blob now (no-op if nothing is dirty)
+bool flush() {
+  if (!s_prefs) return false;
+
+  State snap;
+  uint16_t dirty;
+  portENTER_CRITICAL(&s_mux);
+  dirty = s_dirty;
+  s_dirty = 0;
+  snap = s_state;
+  portEXIT_CRITICAL(&s_mux);
+  if (!dirty) return true;
+
+  snap.crc = stateCrc(snap);
+  s_prefs->begin(PREF_NAMESPACE, false);
+  size_t n = s_prefs->putBytes(PREF_KEY_STATE, &snap, sizeof(snap));
+  if (n == sizeof(snap) && s_legacyKeys) {
+    // the blob is committed, so the old keys can never be read again
+    for (const char* key : kLegacyKeys) {
+      if (s_prefs->isKey(key)) s_prefs->remove(key);
+    }
+    s_legacyKeys = false;
+  }
+  s_prefs->end();
+
+  if (n != sizeof(snap)) {
+    portENTER_CRITICAL(&s_mux);
+    s_firstDirtyMs = s_lastDirtyMs = millis();
+    s_dirty |= dirty;  // retry after another debounce window
+    s_stats.failed++;
+    portEXIT_CRITICAL(&s_mux);
+    Serial.printf("[Prefs] Blob write failed (dirty=0x%03X)\n", dirty);
+    return false;
+  }
+  s_stats.writes++;
+  return true;
+}
+
+static void onShutdown() {
+  flush();
+}
+
+// Load the blob (one read); without one, migrates the legacy keys
+void begin(Preferences& prefs) {
+  s_prefs = &prefs;
+  setDefaults(s_state);
+
+  State st;
+  prefs.begin(PREF_NAMESPACE, true);
+  size_t len = prefs.getBytesLength(PREF_KEY_STATE);
+  size_t n = len == sizeof(st) ? prefs.getBytes(PREF_KEY_STATE, &st, sizeof(st)) : 0;
+  bool valid = n == sizeof(st) && st.magic == kMagic && st.version == kVersion && st.crc == stateCrc(st);
+  if (valid) {
+    s_state = st;
+  } else if (!len) {
+    loadLegacyKeys(prefs, s_state);
+    s_legacyKeys = true;
+  }
+  prefs.end();
+
+  s_state.staSsid[sizeof(s_state.staSsid) - 1] = '\0';
+  s_state.staPass[sizeof(s_state.staPass) - 1] = '\0';
+  if (s_state.curveCount > MIMIR_CURVE_MAX_POINTS) s_state.curveCount = 0;
+
+  if (!valid) {
+    if (len) Serial.printf("[Prefs] State blob invalid (%u bytes), using defaults\n", (unsigned)len);
+    else Serial.println("[Prefs] No state blob, migrated legacy keys");
+    s_dirty = D_ALL;
+    flush();
+  }
+
+  esp_register_shutdown_handler(onShutdown);
+}
+
+const State& state() {
+  return s_state;
+}
+
+Stats stats() {
+  return s_stats;
+}
+
+bool pending() {
+  return s_dirty != 0;
+}
+
+// Call from loop(): writes once changes settled or waited too long.
+// A setter on another task can stamp a time after nowMs; signed elapsed
+// time reads that as "just now" instead of wrapping to ~49 days.
+void service(uint32_t nowMs) {
+  portENTER_CRITICAL(&s_mux);
+  bool dirty = s_dirty != 0;
+  int32_t sinceLast = (int32_t)(nowMs - s_lastDirtyMs);
+  int32_t sinceFirst = (int32_t)(nowMs - s_firstDirtyMs);
+  portEXIT_CRITICAL(&s_mux);
+  if (!dirty) return;
+  if (sinceLast >= (int32_t)PERSIST_DEBOUNCE_MS || sinceFirst >= (int32_t)PERSIST_MAX_DELAY_MS) {
+    flush();
+  }
+}
+
+// Caller holds s_mux
+static void markLocked(uint16_t bit) {
+  uint32_t now = millis();
+  if (!s_dirty) s_firstDirtyMs = now;
+  s_lastDirtyMs = now;
+  s_dirty |= bit;
+  s_stats.marks++;
+}
+
+// Field update helper: only a real change marks dirty
+template <typename T>
+static void update(T& field, const T& value, uint16_t bit) {
+  portENTER_CRITICAL(&s_mux);
+  if (!(field == value)) {
+    field = value;
+    markLocked(bit);
+  }
+  portEXIT_CRITICAL(&s_mux);
+}
+
+void setColor(uint32_t c) { update(s_state.color, c, D_COLOR); }
+void setBrightness(uint8_t b) { update(s_state.brightness, b, D_BRIGHTNESS); }
+void setEffect(uint16_t e) { update(s_state.effect, e, D_EFFECT); }
+void setOn(bool on) { update(s_state.on, (uint8_t)on, D_ON); }
+void setMimir(bool m) { update(s_state.mimir, (uint8_t)m, D_MIMIR); }
+void setPresence(bool p) { update(s_state.presence, (uint8_t)p, D_PRESENCE); }
+
+void setMimirRange(uint8_t minB, uint8_t maxB) {
+  update(s_state.mimirMin, minB, D_RANGE);
+  update(s_state.mimirMax, maxB, D_RANGE);
+}
+
+void setMimirCurve(const MimirCurve::Point* pts, uint8_t n) {
+  if (n > MIMIR_CURVE_MAX_POINTS) return;
+  portENTER_CRITICAL(&s_mux);
+  bool same = n == s_state.curveCount;
+  for (uint8_t i = 0; same && i < n; ++i) {
+    same = pts[i].lux == s_state.curve[i].lux && pts[i].level == s_state.curve[i].level;
+  }
+  if (!same) {
+    for (uint8_t i = 0; i < n; ++i) s_state.curve[i] = pts[i];
+    s_state.curveCount = n;
+    markLocked(D_CURVE);
+  }
+  portEXIT_CRITICAL(&s_mux);
+}
+
+void setWifiMode(const String& mode) {
+  update(s_state.wifiMode, (uint8_t)(mode == "STA" ? WIFI_PREF_STA : WIFI_PREF_AP), D_WIFI);
+}
+
+void setSta(const String& ssid, const String& pass) {
+  portENTER_CRITICAL(&s_mux);
+  if (strcmp(ssid.c_str(), s_state.staSsid) != 0 || strcmp(pass.c_str(), s_state.staPass) != 0) {
+    strlcpy(s_state.staSsid, ssid.c_str(), sizeof(s_state.staSsid));
+    strlcpy(s_state.staPass, pass.c_str(), sizeof(s_state.staPass));
+    markLocked(D_WIFI);
+  }
+  portEXIT_CRITICAL(&s_mux);
+}
+
+}
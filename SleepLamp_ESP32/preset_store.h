@@ -0,0 +1,326 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "fs_select.h"
+#include "config.h"
+#include "action_engine.h"
+#include "persist.h"
+
+/*
+  preset_store.h
+  Recent presets as packed binary records: the compiled action batch, the
+  timestamp and interned source/note strings, each with a stable id. The ring
+  is saved to LittleFS (write-behind, like persist.h) and reloaded on boot.
+  Ids only ever grow, so the newest id doubles as the ETag for /presets.
+*/
+
+#ifndef PRESET_CACHE_MAX
+#define PRESET_CACHE_MAX 24
+#endif
+
+// Interned source/note strings (two per record at most, usually far fewer)
+#ifndef PRESET_STR_MAX
+#define PRESET_STR_MAX 32
+#endif
+
+#ifndef PRESET_STR_LEN
+#define PRESET_STR_LEN 64  // incl. NUL; longer notes are truncated
+#endif
+
+#ifndef PRESET_SAVE_DEBOUNCE_MS
+#define PRESET_SAVE_DEBOUNCE_MS 5000UL
+#endif
+
+#define PRESET_FILE "/presets.bin"
+#define PRESET_FILE_TMP "/presets.tmp"
+
+namespace PresetStore {
+
+static const uint32_t kMagic = 0x50535356;  // "VSSP"
+static const uint8_t kVersion = 1;
+static const uint8_t kNoStr = 0xFF;
+
+static_assert(PRESET_STR_MAX < kNoStr, "string index must fit in a byte");
+static_assert(PRESET_CACHE_MAX <= 255, "record count must fit in a byte");
+
+struct Record {
+  uint32_t id;
+  uint32_t ts;
+  uint8_t source;  // string index or kNoStr
+  uint8_t note;
+  uint8_t count;
+  uint8_t reserved;
+  Actions::Command cmds[ACTION_BATCH_MAX];
+};
+
+// On flash a record stops after its used commands
+static const size_t kRecHead = offsetof(Record, cmds);
+
+struct FileHeader {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t recCount;
+  uint8_t strCount;
+  uint8_t reserved;
+  uint32_t nextId;
+};
+
+static Record s_recs[PRESET_CACHE_MAX];
+static uint8_t s_count = 0;
+static uint8_t s_head = 0;  // next insert index
+static uint32_t s_nextId = 1;
+
+static char s_str[PRESET_STR_MAX][PRESET_STR_LEN];
+static uint8_t s_refs[PRESET_STR_MAX];
+
+static bool s_dirty = false;
+static uint32_t s_dirtyMs = 0;
+static SemaphoreHandle_t s_lock = nullptr;
+
+struct Guard {
+  Guard() { if (s_lock) xSemaphoreTake(s_lock, portMAX_DELAY); }
+  ~Guard() { if (s_lock) xSemaphoreGive(s_lock); }
+};
+
+static uint8_t intern(const char* s) {
+  if (!s || !*s) return kNoStr;
+  size_t n = strnlen(s, PRESET_STR_LEN - 1);
+  for (uint8_t i = 0; i < PRESET_STR_MAX; ++i) {
+    if (s_refs[i] && strncmp(s_str[i], s, n) == 0 && s_str[i][n] == '\0') return i;
+  }
+  for (uint8_t i = 0; i < PRESET_STR_MAX; ++i) {
+    if (!s_refs[i]) {
+      memcpy(s_str[i], s, n);
+      s_str[i][n] = '\0';
+      return i;
+    }
+  }
+  return kNoStr;  // pool full: record keeps no string
+}
+
+static void ref(uint8_t i) { if (i != kNoStr) s_refs[i]++; }
+static void unref(uint8_t i) { if (i != kNoStr && s_refs[i]) s_refs[i]--; }
+static const char* str(uint8_t i) { return i == kNoStr ? "" : s_str[i]; }
+
+// i = 0 is the newest record
+static Record& at(uint8_t i) {
+  int idx = (int)s_head - 1 - (int)i;
+  while (idx < 0) idx += PRESET_CACHE_MAX;
+  return s_recs[idx];
+}
+
+static void clearAll() {
+  s_count = 0;
+  s_head = 0;
+  memset(s_refs, 0, sizeof(s_refs));
+}
+
+// ---- flash format: header, strings (idx, len, bytes), records, CRC32 ----
+
+static size_t maxFileSize() {
+  return sizeof(FileHeader) + PRESET_STR_MAX * (2 + PRESET_STR_LEN) + PRESET_CACHE_MAX * sizeof(Record) + 4;
+}
+
+// Caller holds the lock
+static size_t encode(uint8_t* buf) {
+  FileHeader h = {};
+  h.magic = kMagic;
+  h.version = kVersion;
+  h.recCount = s_count;
+  h.nextId = s_nextId;
+  size_t n = sizeof(h);
+
+  for (uint8_t i = 0; i < PRESET_STR_MAX; ++i) {
+    if (!s_refs[i]) continue;
+    uint8_t len = (uint8_t)strlen(s_str[i]);
+    buf[n++] = i;
+    buf[n++] = len;
+    memcpy(buf + n, s_str[i], len);
+    n += len;
+    h.strCount++;
+  }
+  // oldest first, so a reload rebuilds the ring in order
+  for (int i = (int)s_count - 1; i >= 0; --i) {
+    const Record& rec = at((uint8_t)i);
+    size_t len = kRecHead + rec.count * sizeof(Actions::Command);
+    memcpy(buf + n, &rec, len);
+    n += len;
+  }
+  memcpy(buf, &h, sizeof(h));
+  uint32_t crc = Persist::crc32(buf, n);
+  memcpy(buf + n, &crc, 4);
+  return n + 4;
+}
+
+static bool decode(const uint8_t* buf, size_t len) {
+  if (len < sizeof(FileHeader) + 4) return false;
+  uint32_t crc;
+  memcpy(&crc, buf + len - 4, 4);
+  len -= 4;
+  if (crc != Persist::crc32(buf, len)) return false;
+
+  FileHeader h;
+  memcpy(&h, buf, sizeof(h));
+  if (h.magic != kMagic || h.version != kVersion || h.recCount > PRESET_CACHE_MAX) return false;
+
+  clearAll();
+  size_t n = sizeof(h);
+  bool have[PRESET_STR_MAX] = {};
+  for (uint8_t i = 0; i < h.strCount; ++i) {
+    if (n + 2 > len) return false;
+    uint8_t idx = buf[n], slen = buf[n + 1];
+    n += 2;
+    if (idx >= PRESET_STR_MAX || slen >= PRESET_STR_LEN || n + slen > len) return false;
+    memcpy(s_str[idx], buf + n, slen);
+    s_str[idx][slen] = '\0';
+    have[idx] = true;
+    n += slen;
+  }
+  for (uint8_t i = 0; i < h.recCount; ++i) {
+    if (n + kRecHead > len) { clearAll(); return false; }
+    Record& rec = s_recs[s_head];
+    memset(&rec, 0, sizeof(rec));
+    memcpy(&rec, buf + n, kRecHead);
+    n += kRecHead;
+    size_t clen = rec.count * sizeof(Actions::Command);
+    if (rec.count > ACTION_BATCH_MAX || n + clen > len) { clearAll(); return false; }
+    memcpy(rec.cmds, buf + n, clen);
+    n += clen;
+    if (rec.source != kNoStr && (rec.source >= PRESET_STR_MAX || !have[rec.source])) rec.source = kNoStr;
+    if (rec.note != kNoStr && (rec.note >= PRESET_STR_MAX || !have[rec.note])) rec.note = kNoStr;
+    ref(rec.source);
+    ref(rec.note);
+    s_head = (uint8_t)((s_head + 1) % PRESET_CACHE_MAX);
+    s_count++;
+  }
+  s_nextId = h.nextId ? h.nextId : 1;
+  return true;
+}
+
+static bool save() {
+  uint8_t* buf = (uint8_t*)malloc(maxFileSize());
+  if (!buf) return false;
+  size_t len;
+  {
+    Guard g;
+    len = encode(buf);
+    s_dirty = false;
+  }
+
+  bool ok = false;
+  File f = FSYS.open(PRESET_FILE_TMP, "w");
+  if (f) {
+    ok = f.write(buf, len) == len;
+    f.close();
+    if (ok) {
+      FSYS.remove(PRESET_FILE);
+      ok = FSYS.rename(PRESET_FILE_TMP, PRESET_FILE);
+    }
+  }
+  free(buf);
+
+  if (!ok) {
+    Guard g;
+    s_dirty = true;  // retry after another debounce window
+    s_dirtyMs = millis();
+    Serial.println("[Presets] Save failed");
+  }
+  return ok;
+}
+
+// Load the saved ring (FS must be mounted)
+void begin() {
+  if (!s_lock) s_lock = xSemaphoreCreateMutex();
+  Guard g;
+  clearAll();
+
+  File f = FSYS.open(PRESET_FILE, "r");
+  if (!f) return;
+  size_t len = f.size();
+  uint8_t* buf = len <= maxFileSize() ? (uint8_t*)malloc(len) : nullptr;
+  bool ok = buf && f.read(buf, len) == len && decode(buf, len);
+  f.close();
+  free(buf);
+  if (ok) Serial.printf("[Presets] Loaded %u presets (next id %lu)\n", s_count, (unsigned long)s_nextId);
+  else Serial.printf("[Presets] Ignoring unreadable %s (%u bytes)\n", PRESET_FILE, (unsigned)len);
+}
+
+// Store a compiled batch; returns its id
+uint32_t add(uint32_t ts, const char* source, const char* note, const Actions::Batch& batch) {
+  Guard g;
+  Record& rec = s_recs[s_head];
+  if (s_count == PRESET_CACHE_MAX) {
+    unref(rec.source);  // evict the oldest
+    unref(rec.note);
+  } else {
+    s_count++;
+  }
+
+  rec.id = s_nextId++;
+  rec.ts = ts;
+  rec.source = intern(source);
+  ref(rec.source);
+  rec.note = intern(note);
+  ref(rec.note);
+  rec.count = batch.count;
+  rec.reserved = 0;
+  memcpy(rec.cmds, batch.cmds, batch.count * sizeof(Actions::Command));
+  s_head = (uint8_t)((s_head + 1) % PRESET_CACHE_MAX);
+
+  s_dirty = true;
+  s_dirtyMs = millis();
+  return rec.id;
+}
+
+// Copy a preset's batch by id (false = unknown or evicted)
+bool get(uint32_t id, Actions::Batch& out) {
+  Guard g;
+  for (uint8_t i = 0; i < s_count; ++i) {
+    const Record& rec = at(i);
+    if (rec.id != id) continue;
+    out.count = rec.count;
+    out.skipped = 0;
+    memcpy(out.cmds, rec.cmds, rec.count * sizeof(Actions::Command));
+    return true;
+  }
+  return false;
+}
+
+// Changes whenever the list does (ids are never reused)
+uint32_t version() {
+  Guard g;
+  return s_nextId;
+}
+
+// {"ok":true,"presets":[...]} newest first
+void writeJson(Print& out) {
+  DynamicJsonDocument doc(JSON_OBJECT_SIZE(6) + JSON_ARRAY_SIZE(ACTION_BATCH_MAX) + ACTION_BATCH_MAX * (JSON_OBJECT_SIZE(3) + 8));
+  Guard g;
+  out.print("{\"ok\":true,\"presets\":[");
+  for (uint8_t i = 0; i < s_count; ++i) {
+    const Record& rec = at(i);
+    doc.clear();
+    doc["id"] = rec.id;
+    doc["ts"] = rec.ts;
+    doc["source"] = str(rec.source);  // pool strings outlive the document
+    doc["note"] = str(rec.note);
+    JsonArray arr = doc.createNestedArray("actions");
+    for (uint8_t k = 0; k < rec.count; ++k) Actions::toJson(rec.cmds[k], arr.createNestedObject());
+    if (i) out.print(',');
+    serializeJson(doc, out);
+  }
+  out.print("]}");
+}
+
+// Call from loop(): saves once adds have settled. A web handler may stamp
+// s_dirtyMs after loop() read nowMs, hence the signed elapsed time.
+void service(uint32_t nowMs) {
+  bool due;
+  {
+    Guard g;
+    due = s_dirty && (int32_t)(nowMs - s_dirtyMs) >= (int32_t)PRESET_SAVE_DEBOUNCE_MS;
+  }
+  if (due) save();
+}
+
+}
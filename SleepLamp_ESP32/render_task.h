@@ -0,0 +1,103 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+#include "frame_scheduler.h"
+#include "led_control.h"
+#include "lux_input.h"
+#include "metrics.h"
+
+/*
+  render_task.h
+  Dedicated FreeRTOS task that renders LED frames at a fixed rate
+  (RENDER_FPS), so fades no longer slow down when loop() or the web
+  server stall. Frame timing/jitter stats come from FrameScheduler; the
+  task sleeps with vTaskDelayUntil on the frame grid (TickPacer), so the
+  rate does not drift with tick rounding or frame work.
+  ESP-NOW samples queued by the Wi-Fi task are applied at the top of each frame.
+*/
+
+namespace RenderTask {
+
+static FrameScheduler s_sched;
+static TaskHandle_t s_task = nullptr;
+static portMUX_TYPE s_statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void taskMain(void*) {
+  // Start on a tick edge, so the tick grid and the scheduler's deadlines line up
+  vTaskDelay(1);
+  TickType_t lastWake = xTaskGetTickCount();
+  TickPacer pacer;
+  pacer.tickUs = portTICK_PERIOD_MS * 1000UL;
+  portENTER_CRITICAL(&s_statsMux);
+  s_sched.begin(micros(), RENDER_FPS);
+  portEXIT_CRITICAL(&s_statsMux);
+
+  for (;;) {
+    portENTER_CRITICAL(&s_statsMux);
+    uint32_t dt = s_sched.frameStart(micros());
+    portEXIT_CRITICAL(&s_statsMux);
+
+    LuxInput::drain();  // sensor samples that arrived since the last frame
+    {
+      Metrics::Timer timer(Metrics::H_TICK);
+      LedControl::tick(dt);
+    }
+
+    portENTER_CRITICAL(&s_statsMux);
+    uint32_t waitUs = s_sched.frameEnd(micros());
+    portEXIT_CRITICAL(&s_statsMux);
+
+    if (waitUs) {
+      // Wake on the frame grid (absolute), so sleep rounding and the
+      // frame's own work do not add up to drift
+      vTaskDelayUntil(&lastWake, (TickType_t)pacer.next(s_sched.periodUs));
+    } else {
+      // Overran: still let lower-priority tasks run, then restart both
+      // grids from here
+      vTaskDelay(1);
+      lastWake = xTaskGetTickCount();
+      pacer.reset();
+      portENTER_CRITICAL(&s_statsMux);
+      s_sched.restart(micros());
+      portEXIT_CRITICAL(&s_statsMux);
+    }
+  }
+}
+
+bool begin() {
+  if (s_task) return true;
+  BaseType_t rc = xTaskCreatePinnedToCore(taskMain, "RenderTask", RENDER_TASK_STACK, nullptr,
+                                          RENDER_TASK_PRIO, &s_task, RENDER_TASK_CORE);
+  if (rc != pdPASS) {
+    s_task = nullptr;
+    Serial.println("[Render] Task create failed");
+    return false;
+  }
+  Serial.printf("[Render] %u fps on core %d\n", (unsigned)RENDER_FPS, RENDER_TASK_CORE);
+  return true;
+}
+
+FrameStats stats(bool resetMax = false) {
+  portENTER_CRITICAL(&s_statsMux);
+  FrameStats st = s_sched.stats;
+  if (resetMax) s_sched.resetMax();
+  portEXIT_CRITICAL(&s_statsMux);
+  return st;
+}
+
+String jsonStats(bool resetMax = false) {
+  FrameStats st = stats(resetMax);
+  char buf[288];
+  snprintf(buf, sizeof(buf),
+           "{\"fps\":%u,\"period_us\":%lu,\"frames\":%lu,\"overruns\":%lu,"
+           "\"last_dt_us\":%lu,\"jitter_us\":%lu,\"avg_jitter_us\":%lu,\"max_jitter_us\":%lu,"
+           "\"work_us\":%lu,\"avg_work_us\":%lu,\"max_work_us\":%lu}",
+           (unsigned)RENDER_FPS, (unsigned long)(1000000UL / RENDER_FPS),
+           (unsigned long)st.frames, (unsigned long)st.overruns,
+           (unsigned long)st.lastDtUs, (unsigned long)st.lastJitterUs,
+           (unsigned long)st.avgJitterUs, (unsigned long)st.maxJitterUs,
+           (unsigned long)st.lastWorkUs, (unsigned long)st.avgWorkUs, (unsigned long)st.maxWorkUs);
+  return String(buf);
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+// Single-producer/single-consumer lock-free ring (no Arduino deps).
+// One context may push() and one other may pop(); indices are free-running
+// and published with release/acquire, so neither side ever blocks or locks.
+// N must be a power of two. A full ring rejects the push (caller counts drops).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+template <typename T, uint16_t N>
+class SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+ public:
+  // Producer side
+  bool push(const T& v) {
+    uint16_t head = head_.load(std::memory_order_relaxed);
+    uint16_t tail = tail_.load(std::memory_order_acquire);
+    if ((uint16_t)(head - tail) >= N) return false;
+    buf_[head & (N - 1)] = v;
+    head_.store((uint16_t)(head + 1), std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side
+  bool pop(T& out) {
+    uint16_t tail = tail_.load(std::memory_order_relaxed);
+    uint16_t head = head_.load(std::memory_order_acquire);
+    if (head == tail) return false;
+    out = buf_[tail & (N - 1)];
+    tail_.store((uint16_t)(tail + 1), std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side: pop up to max items in one go; returns the count
+  size_t popBatch(T* out, size_t max) {
+    uint16_t tail = tail_.load(std::memory_order_relaxed);
+    uint16_t head = head_.load(std::memory_order_acquire);
+    size_t n = (uint16_t)(head - tail);
+    if (n > max) n = max;
+    for (size_t i = 0; i < n; ++i) out[i] = buf_[(uint16_t)(tail + i) & (N - 1)];
+    tail_.store((uint16_t)(tail + n), std::memory_order_release);
+    return n;
+  }
+
+  // Either side; only a snapshot
+  uint16_t size() const {
+    return (uint16_t)(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+  }
+  static constexpr uint16_t capacity() { return N; }
+
+ private:
+  T buf_[N];
+  std::atomic<uint16_t> head_{ 0 };  // written by the producer only
+  std::atomic<uint16_t> tail_{ 0 };  // written by the consumer only
+};
@@ -0,0 +1,247 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <WiFi.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+#include "led_control.h"
+#include "status_cache.h"
+
+/*
+  state_push.h
+  Server-Sent Events on /events. A client gets the full /status snapshot
+  (and Wi-Fi info) on connect, then compact "delta" events holding only the
+  fields that changed. Changes are coalesced and sent at most every
+  PUSH_MIN_INTERVAL_MS, so a fade or a burst of lux packets costs one event
+  per window per client instead of one poll per client every 2 s.
+  Pacing is per client: each one has its own last-sent snapshot and send
+  time, and a client whose queue is backed up (PUSH_MAX_QUEUED) is skipped
+  and catches up with one wider delta, without holding back the others.
+  Needs the mathieucarbou/ESP32Async library, whose AsyncEventSource
+  reports disconnects.
+*/
+
+#ifndef PUSH_MIN_INTERVAL_MS
+#define PUSH_MIN_INTERVAL_MS 150UL
+#endif
+
+// Clients tracked on /events; more are turned away
+#ifndef PUSH_MAX_CLIENTS
+#define PUSH_MAX_CLIENTS 4
+#endif
+
+// Messages waiting in a client's queue before its deltas are held back
+#ifndef PUSH_MAX_QUEUED
+#define PUSH_MAX_QUEUED 4
+#endif
+
+// How often loop() looks at the Wi-Fi link for changes
+#ifndef PUSH_WIFI_CHECK_MS
+#define PUSH_WIFI_CHECK_MS 1000UL
+#endif
+
+extern volatile bool g_lastMotion;
+extern volatile bool g_presenceEnabled;
+String wifiModeString();
+String wifiInfoJson();  // web_server.h
+
+namespace StatePush {
+
+static AsyncEventSource s_events("/events");
+
+struct Snapshot {
+  uint32_t color;
+  uint8_t brightness;
+  uint8_t current;
+  uint8_t saved;
+  uint16_t effect;
+  bool on;
+  bool mimir;
+  int32_t luxCenti;  // lux * 100, matches the 2-decimal /status field
+  uint8_t mimirMin;
+  uint8_t mimirMax;
+  bool motion;
+  bool presence;
+};
+
+enum Field : uint16_t {
+  F_COLOR = 1 << 0,
+  F_BRIGHTNESS = 1 << 1,
+  F_CURRENT = 1 << 2,
+  F_SAVED = 1 << 3,
+  F_EFFECT = 1 << 4,
+  F_ON = 1 << 5,
+  F_MIMIR = 1 << 6,
+  F_LUX = 1 << 7,
+  F_RANGE = 1 << 8,
+  F_MOTION = 1 << 9,
+  F_PRESENCE = 1 << 10,
+};
+
+// What one client has been sent
+struct Client {
+  AsyncEventSourceClient* c;  // nullptr = free slot
+  Snapshot sent;
+  uint32_t lastSendMs;
+};
+
+static Client s_clients[PUSH_MAX_CLIENTS];
+static SemaphoreHandle_t s_lock = nullptr;  // slots vs. connect/disconnect on the async_tcp task
+static uint32_t s_lastWifiCheckMs = 0;
+static String s_wifiKey;
+static volatile bool s_presetsChanged = false;
+static std::atomic<uint32_t> s_eventId{ 0 };  // connects come from the async_tcp task
+
+struct Guard {
+  Guard() { if (s_lock) xSemaphoreTake(s_lock, portMAX_DELAY); }
+  ~Guard() { if (s_lock) xSemaphoreGive(s_lock); }
+};
+
+static Snapshot capture() {
+  LedControl::Guard g;  // batches apply under this lock, so never half-seen
+  Snapshot s;
+  s.color = LedControl::getColor();
+  s.brightness = LedControl::getTargetBrightness();
+  s.current = LedControl::getCurrentBrightness();
+  s.saved = LedControl::getSavedBrightness();
+  s.effect = LedControl::getEffect();
+  s.on = LedControl::getOn();
+  s.mimir = LedControl::getMimir();
+  s.luxCenti = (int32_t)lroundf(LedControl::getLux() * 100.0f);
+  s.mimirMin = LedControl::getMimirMin();
+  s.mimirMax = LedControl::getMimirMax();
+  s.motion = (bool)g_lastMotion;
+  s.presence = (bool)g_presenceEnabled;
+  return s;
+}
+
+static uint16_t diff(const Snapshot& a, const Snapshot& b) {
+  uint16_t m = 0;
+  if (a.color != b.color) m |= F_COLOR;
+  if (a.brightness != b.brightness) m |= F_BRIGHTNESS;
+  if (a.current != b.current) m |= F_CURRENT;
+  if (a.saved != b.saved) m |= F_SAVED;
+  if (a.effect != b.effect) m |= F_EFFECT;
+  if (a.on != b.on) m |= F_ON;
+  if (a.mimir != b.mimir) m |= F_MIMIR;
+  if (a.luxCenti != b.luxCenti) m |= F_LUX;
+  if (a.mimirMin != b.mimirMin || a.mimirMax != b.mimirMax) m |= F_RANGE;
+  if (a.motion != b.motion) m |= F_MOTION;
+  if (a.presence != b.presence) m |= F_PRESENCE;
+  return m;
+}
+
+// Compact JSON with only the changed fields (same keys as /status)
+static void formatDelta(const Snapshot& s, uint16_t m, char* buf, size_t cap) {
+  int n = snprintf(buf, cap, "{");
+#define PUSH_APPEND(...) n += snprintf(buf + n, n < (int)cap ? cap - n : 0, __VA_ARGS__)
+  const char* sep = "";
+  if (m & F_COLOR) { PUSH_APPEND("%s\"color\":\"%06lX\"", sep, (unsigned long)(s.color & 0xFFFFFF)); sep = ","; }
+  if (m & F_BRIGHTNESS) { PUSH_APPEND("%s\"brightness\":%u", sep, s.brightness); sep = ","; }
+  if (m & F_CURRENT) { PUSH_APPEND("%s\"current_brightness\":%u", sep, s.current); sep = ","; }
+  if (m & F_SAVED) { PUSH_APPEND("%s\"saved_brightness\":%u", sep, s.saved); sep = ","; }
+  if (m & F_EFFECT) {
+    const __FlashStringHelper* nm = LedControl::ws.getModeName(s.effect);
+    PUSH_APPEND("%s\"effect_id\":%u,\"effect_name\":\"%s\"", sep, s.effect, nm ? (const char*)nm : "Unknown");
+    sep = ",";
+  }
+  if (m & F_ON) { PUSH_APPEND("%s\"on\":%s", sep, s.on ? "true" : "false"); sep = ","; }
+  if (m & F_MIMIR) { PUSH_APPEND("%s\"mimir\":%s", sep, s.mimir ? "true" : "false"); sep = ","; }
+  if (m & F_LUX) { PUSH_APPEND("%s\"lux\":%.2f", sep, s.luxCenti / 100.0f); sep = ","; }
+  if (m & F_RANGE) { PUSH_APPEND("%s\"mimir_min\":%u,\"mimir_max\":%u", sep, s.mimirMin, s.mimirMax); sep = ","; }
+  if (m & F_MOTION) { PUSH_APPEND("%s\"motion\":%s", sep, s.motion ? "true" : "false"); sep = ","; }
+  if (m & F_PRESENCE) { PUSH_APPEND("%s\"presence_ctrl\":%s", sep, s.presence ? "true" : "false"); sep = ","; }
+  PUSH_APPEND("}");
+#undef PUSH_APPEND
+}
+
+static String wifiKey() {
+  String k = wifiModeString();
+  if (WiFi.status() == WL_CONNECTED) {
+    k += WiFi.localIP().toString();
+    k += ':';
+    k += WiFi.channel();
+  }
+  return k;
+}
+
+void begin(AsyncWebServer& server) {
+  s_lock = xSemaphoreCreateMutex();
+  s_events.onConnect([](AsyncEventSourceClient* client) {
+    Guard g;
+    Client* slot = nullptr;
+    for (Client& c : s_clients) {
+      if (!c.c) { slot = &c; break; }
+    }
+    if (!slot) {
+      client->close();
+      return;
+    }
+    // Full snapshot first; later events are deltas against it
+    slot->c = client;
+    slot->sent = capture();
+    slot->lastSendMs = millis();
+    StatusCache::Pin status;  // send() queues a copy; the pin covers the call
+    client->send(status->json, "status", ++s_eventId, 1000);
+    client->send(wifiInfoJson().c_str(), "wifi", ++s_eventId);
+  });
+  s_events.onDisconnect([](AsyncEventSourceClient* client) {
+    Guard g;
+    for (Client& c : s_clients) {
+      if (c.c == client) c.c = nullptr;
+    }
+  });
+  server.addHandler(&s_events);
+}
+
+// Presets were added/applied (UI refreshes its list on this)
+void notifyPresets() {
+  s_presetsChanged = true;
+}
+
+// Call from loop(): per-client diff + rate limit, then the broadcasts (sent
+// outside the lock; the library takes its client list lock for those)
+void service(uint32_t nowMs) {
+  if (s_events.count() == 0) return;
+
+  {
+    Guard g;
+    Snapshot cur;
+    bool captured = false;
+    char buf[320];
+    uint16_t bufMask = 0;  // mask buf was formatted for; clients in step share it
+    for (Client& c : s_clients) {
+      if (!c.c || nowMs - c.lastSendMs < PUSH_MIN_INTERVAL_MS) continue;
+      if (c.c->packetsWaiting() >= PUSH_MAX_QUEUED) continue;
+      if (!captured) {
+        cur = capture();
+        captured = true;
+      }
+      uint16_t m = diff(cur, c.sent);
+      if (!m) continue;
+      if (m != bufMask) {
+        formatDelta(cur, m, buf, sizeof(buf));
+        bufMask = m;
+      }
+      c.c->send(buf, "delta", ++s_eventId);
+      c.sent = cur;
+      c.lastSendMs = nowMs;
+    }
+  }
+
+  if (nowMs - s_lastWifiCheckMs >= PUSH_WIFI_CHECK_MS) {
+    s_lastWifiCheckMs = nowMs;
+    String k = wifiKey();
+    if (k != s_wifiKey) {
+      s_wifiKey = k;
+      s_events.send(wifiInfoJson().c_str(), "wifi", ++s_eventId);
+    }
+  }
+
+  if (s_presetsChanged) {
+    s_presetsChanged = false;
+    s_events.send("{}", "preset", ++s_eventId);
+  }
+}
+
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <Arduino.h>
+#include <WiFi.h>
+#include "config.h"
+#include "led_control.h"
+#include "lux_input.h"
+
+/*
+  status_cache.h
+  The /status JSON, rendered at most once per state version. The key is
+  LedControl::version() (bumped by every setter, lux sample and fade step),
+  the sensor node table version and the few fields owned by the sketch
+  (motion, presence, Wi-Fi mode).
+  Every client in between is served the same buffer with no heap use.
+
+  Rendering rotates through STATUS_CACHE_SLOTS buffers. A response that is
+  sent from a slot after the handler returns holds a Pin on it until the
+  response is done, and rotation skips pinned slots; with every slot pinned
+  the render goes to a spare buffer and a Pin gets its own heap copy.
+  get() alone is only good until the next get() from any task.
+*/
+
+#ifndef STATUS_CACHE_SLOTS
+#define STATUS_CACHE_SLOTS 4
+#endif
+
+#ifndef STATUS_JSON_MAX
+#define STATUS_JSON_MAX 1664  // base status + LUX_NODES_MAX node entries
+#endif
+
+extern volatile bool g_lastMotion;
+extern volatile bool g_presenceEnabled;
+extern volatile WiFiMode_t g_wifiMode;
+const char* wifiModeName();
+
+namespace StatusCache {
+
+struct Entry {
+  uint8_t pins;  // Pins holding this slot (under the LedControl lock)
+  uint32_t version;
+  uint32_t nodes;  // LuxInput::tableVersion()
+  uint8_t flags;  // motion | presence << 1 | wifi mode << 2
+  uint16_t len;
+  char etag[28];
+  char json[STATUS_JSON_MAX];
+};
+
+struct Stats {
+  uint32_t hits = 0;
+  uint32_t renders = 0;
+  uint32_t spares = 0;  // renders that found every slot pinned
+};
+
+static Entry s_slots[STATUS_CACHE_SLOTS];
+static Entry s_spare;  // never pinned; see Pin
+static Entry* s_cur = nullptr;
+static Stats s_stats;
+
+static uint8_t currentFlags() {
+  return (uint8_t)((g_lastMotion ? 1 : 0) | (g_presenceEnabled ? 2 : 0) | ((uint8_t)g_wifiMode << 2));
+}
+
+// The slot after the current one that nobody is sending from
+static Entry& nextSlot() {
+  int start = s_cur && s_cur != &s_spare ? (int)(s_cur - s_slots) + 1 : 0;
+  for (int i = 0; i < STATUS_CACHE_SLOTS; ++i) {
+    Entry& e = s_slots[(start + i) % STATUS_CACHE_SLOTS];
+    if (!e.pins) return e;
+  }
+  s_stats.spares++;
+  return s_spare;
+}
+
+// Current status JSON; re-rendered only if the state moved on
+static Entry& current() {
+  LedControl::Guard g;  // also serializes callers (handlers, SSE connect)
+  uint32_t v = LedControl::version();
+  uint32_t nv = LuxInput::tableVersion();
+  uint8_t f = currentFlags();
+  if (s_cur && s_cur->version == v && s_cur->nodes == nv && s_cur->flags == f) {
+    s_stats.hits++;
+    return *s_cur;
+  }
+
+  Entry& e = nextSlot();
+  s_cur = &e;
+  e.version = v;
+  e.nodes = nv;
+  e.flags = f;
+  size_t len = LedControl::formatStatus(e.json, sizeof(e.json), wifiModeName(), f & 1, f & 2);
+  if (len && e.json[len - 1] == '}') {
+    // splice the sensor table in before the closing brace; a table that
+    // does not fit is left out rather than cut off mid-object
+    size_t at = len - 1;
+    size_t room = sizeof(e.json) - len;  // table + NUL; the '}' takes the last byte
+    size_t n = room > 1 ? LuxInput::formatNodes(e.json + at, room) : 0;
+    len = at + (n + 1 < room ? n : 0);
+    e.json[len++] = '}';
+    e.json[len] = '\0';
+  }
+  e.len = (uint16_t)len;
+  snprintf(e.etag, sizeof(e.etag), "\"s%lx-%lx-%x\"", (unsigned long)v, (unsigned long)nv, f);
+  s_stats.renders++;
+  return e;
+}
+
+// Valid until the next get() from any task; a response that outlives the
+// handler holds a Pin instead
+const Entry& get() {
+  return current();
+}
+
+// The current entry, kept intact for as long as the Pin lives (e.g. until
+// an async response has been sent). Movable, not copyable.
+class Pin {
+ public:
+  Pin() : owned_(false) {
+    LedControl::Guard g;
+    Entry& e = current();
+    if (&e == &s_spare) {
+      e_ = new Entry(e);  // the spare is rewritten by the next get()
+      owned_ = true;
+    } else {
+      e.pins++;
+      e_ = &e;
+    }
+  }
+  Pin(Pin&& o) : e_(o.e_), owned_(o.owned_) { o.e_ = nullptr; }
+  ~Pin() {
+    if (!e_) return;
+    if (owned_) {
+      delete e_;
+    } else {
+      LedControl::Guard g;
+      e_->pins--;
+    }
+  }
+  Pin(const Pin&) = delete;
+  Pin& operator=(const Pin&) = delete;
+
+  const Entry& operator*() const { return *e_; }
+  const Entry* operator->() const { return e_; }
+
+ private:
+  Entry* e_;
+  bool owned_;
+};
+
+Stats stats() {
+  return s_stats;
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+// Token bucket for outgoing requests (no Arduino deps).
+// Holds up to `burst` tokens and earns one back every `intervalMs`, so a
+// few prompts in a row go out at once while the long-run rate stays at one
+// per interval. Refilled lazily from the caller's clock; millis() wrap safe.
+
+#include <stdint.h>
+
+class TokenBucket {
+ public:
+  TokenBucket(uint8_t burst, uint32_t intervalMs)
+    : burst_(burst ? burst : 1), interval_(intervalMs ? intervalMs : 1), tokens_(burst_) {}
+
+  bool take(uint32_t nowMs) {
+    refill(nowMs);
+    if (!tokens_) return false;
+    tokens_--;
+    return true;
+  }
+
+  // Time until take() can succeed (0 = now)
+  uint32_t waitMs(uint32_t nowMs) {
+    refill(nowMs);
+    return tokens_ ? 0 : interval_ - (nowMs - last_);
+  }
+
+  uint8_t tokens(uint32_t nowMs) {
+    refill(nowMs);
+    return tokens_;
+  }
+
+  uint8_t burst() const { return burst_; }
+
+ private:
+  void refill(uint32_t nowMs) {
+    if (tokens_ >= burst_) { last_ = nowMs; return; }  // earning starts at the first take
+    uint32_t n = (nowMs - last_) / interval_;
+    if (!n) return;
+    if (n >= (uint32_t)(burst_ - tokens_)) {
+      tokens_ = burst_;
+      last_ = nowMs;
+    } else {
+      tokens_ = (uint8_t)(tokens_ + n);
+      last_ += n * interval_;
+    }
+  }
+
+  uint8_t burst_;
+  uint32_t interval_;
+  uint8_t tokens_;
+  uint32_t last_ = 0;
+};
@@ -0,0 +1,142 @@
+"""
+Run the lamp's microbenchmarks (GET /bench) and track a baseline.
+
+The firmware has to be built with ENABLE_BENCH 1 (config.h). Each case
+reports ns/op, the heap it keeps per op and, where the allocator can be
+hooked, allocations per op and its peak heap; other tasks keep running on
+the lamp, so every case is run --runs times and the fastest run is kept.
+--exe runs the same cases on the host instead (host/bench/lamp_bench).
+
+Usage (from SleepLamp_ESP32/):
+  python3 tools/bench.py 192.168.4.1                     # print the table
+  python3 tools/bench.py 192.168.4.1 --save bench.json   # record a baseline
+  python3 tools/bench.py 192.168.4.1 --baseline bench.json --tolerance 0.15
+  python3 tools/bench.py --exe ../build/host/bench/lamp_bench --baseline ../host/bench/baseline.json --allocs-only
+A baseline comparison exits with 1 if a case got slower by more than the
+tolerance, started keeping heap, allocates more per op or peaks higher
+than before. --allocs-only skips the timing check (host timings depend on
+the machine).
+"""
+
+import argparse
+import json
+import subprocess
+import sys
+import urllib.parse
+import urllib.request
+
+
+def fetch(host, name, iters, timeout):
+    q = {}
+    if name:
+        q["name"] = name
+    if iters:
+        q["iters"] = iters
+    url = f"http://{host}/bench"
+    if q:
+        url += "?" + urllib.parse.urlencode(q)
+    with urllib.request.urlopen(url, timeout=timeout) as r:
+        return json.load(r)
+
+
+def run_exe(exe, name, iters, timeout):
+    cmd = [exe]
+    if name:
+        cmd += ["--name", name]
+    if iters:
+        cmd += ["--iters", str(iters)]
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True, timeout=timeout)
+    return json.loads(out.stdout)
+
+
+def best_of(source, name, iters, runs, timeout):
+    best = {}
+    cpu = None
+    for _ in range(runs):
+        doc = source(name, iters, timeout)
+        cpu = doc.get("cpu_mhz", cpu)
+        for res in doc["results"]:
+            old = best.get(res["name"])
+            if old is None or res["ns_per_op"] < old["ns_per_op"]:
+                best[res["name"]] = res
+    return {"cpu_mhz": cpu, "results": list(best.values())}
+
+
+def grew(r, b, key, slack):
+    """True if r[key] is above b[key] (both present) by more than slack"""
+    return key in r and key in b and r[key] > b[key] + slack
+
+
+def compare(current, baseline, tolerance, allocs_only):
+    base = {r["name"]: r for r in baseline["results"]}
+    failed = []
+    if baseline.get("cpu_mhz") != current.get("cpu_mhz"):
+        print(f"note: baseline ran at {baseline.get('cpu_mhz')} MHz, this run at {current.get('cpu_mhz')} MHz")
+    for r in current["results"]:
+        b = base.get(r["name"])
+        if b is None:
+            print(f"{r['name']:<20} new case, no baseline")
+            continue
+        ratio = r["ns_per_op"] / b["ns_per_op"] if b["ns_per_op"] else 1.0
+        verdict = "ok"
+        if ratio > 1.0 + tolerance and not allocs_only:
+            verdict = "SLOWER"
+        elif r["heap_bytes_per_op"] > 0 and b["heap_bytes_per_op"] <= 0:
+            verdict = "KEEPS HEAP"
+        elif grew(r, b, "allocs_per_op", 0.01):
+            verdict = "MORE ALLOCS"
+        elif grew(r, b, "peak_bytes", 0):
+            verdict = "HIGHER PEAK"
+        if verdict != "ok":
+            failed.append(r["name"])
+        print(f"{r['name']:<20} {b['ns_per_op']:>9} -> {r['ns_per_op']:>9} ns/op  {ratio - 1.0:+7.1%}  "
+              f"{b.get('allocs_per_op', '-'):>6} -> {r.get('allocs_per_op', '-'):>6} allocs/op  {verdict}")
+    return failed
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("host", nargs="?", help="lamp address, e.g. 192.168.4.1")
+    ap.add_argument("--exe", help="run this host bench binary instead of asking a lamp")
+    ap.add_argument("--name", default="", help="only cases whose name contains this")
+    ap.add_argument("--iters", type=int, default=0, help="iterations per case (firmware caps it)")
+    ap.add_argument("--runs", type=int, default=3, help="keep the fastest of this many runs")
+    ap.add_argument("--timeout", type=float, default=15.0)
+    ap.add_argument("--save", metavar="FILE", help="write the results as a baseline")
+    ap.add_argument("--baseline", metavar="FILE", help="compare against a saved baseline")
+    ap.add_argument("--tolerance", type=float, default=0.15, help="allowed slowdown (0.15 = 15%%)")
+    ap.add_argument("--allocs-only", action="store_true", help="compare allocations and heap, not timings")
+    args = ap.parse_args()
+    if bool(args.host) == bool(args.exe):
+        ap.error("give a lamp address or --exe")
+
+    if args.exe:
+        source = lambda name, iters, timeout: run_exe(args.exe, name, iters, timeout)
+    else:
+        source = lambda name, iters, timeout: fetch(args.host, name, iters, timeout)
+    cur = best_of(source, args.name, args.iters, max(1, args.runs), args.timeout)
+
+    print(f"cpu {cur['cpu_mhz']} MHz")
+    print(f"{'case':<20} {'iters':>6} {'ns/op':>9} {'heap B/op':>10} {'blocks/op':>10} {'allocs/op':>10} {'peak B':>7}")
+    for r in cur["results"]:
+        print(f"{r['name']:<20} {r['iters']:>6} {r['ns_per_op']:>9} "
+              f"{r['heap_bytes_per_op']:>10.2f} {r['blocks_per_op']:>10.3f} "
+              f"{r.get('allocs_per_op', '-'):>10} {r.get('peak_bytes', '-'):>7}")
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(cur, f, indent=2)
+        print(f"saved {args.save}")
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            base = json.load(f)
+        print()
+        failed = compare(cur, base, args.tolerance, args.allocs_only)
+        if failed:
+            print("regressed: " + ", ".join(failed))
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,103 @@
+"""
+Build the LittleFS image contents (data/) from the web UI sources (web/).
+
+Every asset is gzipped; everything except index.html also gets a content
+hash in its file name (script.js -> script.1a2b3c4d.js.gz) and index.html is
+rewritten to reference the hashed names. The firmware reads data/assets.txt
+to map URLs to files, so hashed assets can be cached as immutable and
+index.html revalidated cheaply with its ETag.
+
+Usage (from SleepLamp_ESP32/):
+  python3 tools/build_data.py
+then Tools -> ESP32 Sketch Data Upload as before.
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import re
+import shutil
+
+MIME = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+}
+
+INDEX = "index.html"
+HASH_LEN = 8
+
+
+def content_hash(data: bytes) -> str:
+    return hashlib.sha256(data).hexdigest()[:HASH_LEN]
+
+
+def gzip_bytes(data: bytes) -> bytes:
+    # mtime=0 keeps the output (and so the image) reproducible
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def hashed_name(name: str, h: str) -> str:
+    stem, ext = os.path.splitext(name)
+    return f"{stem}.{h}{ext}"
+
+
+def main() -> None:
+    here = os.path.dirname(os.path.abspath(__file__))
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--src", default=os.path.join(here, "..", "web"))
+    ap.add_argument("--out", default=os.path.join(here, "..", "data"))
+    args = ap.parse_args()
+
+    src = os.path.normpath(args.src)
+    out = os.path.normpath(args.out)
+    names = sorted(n for n in os.listdir(src) if os.path.isfile(os.path.join(src, n)))
+    if INDEX not in names:
+        raise SystemExit(f"{INDEX} not found in {src}")
+
+    if os.path.isdir(out):
+        shutil.rmtree(out)
+    os.makedirs(out)
+
+    manifest = []  # (url, file, mime, etag, immutable)
+    renames = {}
+    for name in names:
+        if name == INDEX:
+            continue
+        with open(os.path.join(src, name), "rb") as f:
+            data = f.read()
+        h = content_hash(data)
+        url_name = hashed_name(name, h)
+        renames[name] = url_name
+        with open(os.path.join(out, url_name + ".gz"), "wb") as f:
+            f.write(gzip_bytes(data))
+        mime = MIME.get(os.path.splitext(name)[1], "application/octet-stream")
+        manifest.append(("/" + url_name, "/" + url_name + ".gz", mime, h, 1))
+        print(f"{name:28s} -> {url_name}.gz ({len(data)} -> {os.path.getsize(os.path.join(out, url_name + '.gz'))} bytes)")
+
+    with open(os.path.join(src, INDEX), "r", encoding="utf-8") as f:
+        html = f.read()
+    for name, url_name in renames.items():
+        html = re.sub(r'((?:src|href)=")(?:\./|/)?' + re.escape(name) + '"', r"\g<1>" + url_name + '"', html)
+    data = html.encode("utf-8")
+    h = content_hash(data)
+    with open(os.path.join(out, INDEX + ".gz"), "wb") as f:
+        f.write(gzip_bytes(data))
+    manifest.insert(0, ("/", "/" + INDEX + ".gz", MIME[".html"], h, 0))
+    manifest.insert(1, ("/" + INDEX, "/" + INDEX + ".gz", MIME[".html"], h, 0))
+    print(f"{INDEX:28s} -> {INDEX}.gz ({len(data)} -> {os.path.getsize(os.path.join(out, INDEX + '.gz'))} bytes)")
+
+    # url file mime etag immutable  (one asset per line, read by web_assets.h)
+    with open(os.path.join(out, "assets.txt"), "w", encoding="ascii", newline="\n") as f:
+        for row in manifest:
+            f.write(" ".join(str(x) for x in row) + "\n")
+    print(f"wrote {len(manifest)} entries to {os.path.join(out, 'assets.txt')}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,167 @@
+"""
+Local stand-in for the Gemini generateContent endpoint.
+
+Replays a recorded response (a built-in sample, or --file) so the lamp's
+streaming response parser can be exercised without the real API. The body
+can be sent chunked and dribbled out in small, delayed writes, which is the
+worst case for a streaming parser: escapes, UTF-8 sequences and chunk-size
+lines get split across reads.
+
+With --tls it serves HTTPS using a throwaway self-signed certificate (the
+firmware does not verify it), so the keep-alive transport, its handshake
+timings and the retry of a connection the server closed while idle
+(--idle-timeout) can be tried against the same code path as the real API.
+
+Usage (from SleepLamp_ESP32/):
+  python3 tools/gemini_standin.py --port 8080 --chunked --split 7 --delay-ms 5
+  python3 tools/gemini_standin.py --port 8443 --tls --idle-timeout 20
+then build the firmware with, e.g. in secrets.h:
+  #define GEMINI_HOST "192.168.1.50"
+  #define GEMINI_PORT 8080         // or 8443 with --tls
+  #define GEMINI_PLAIN_HTTP        // only without --tls
+  #define GEMINI_API_KEY "standin-key"
+"""
+
+import argparse
+import http.server
+import json
+import os
+import socketserver
+import ssl
+import subprocess
+import tempfile
+import time
+
+# generateContent answer as the API returns it: the model's JSON arrives as an
+# escaped string, split over two parts, with a non-ASCII character in it
+SAMPLE = {
+    "candidates": [
+        {
+            "content": {
+                "parts": [
+                    {"text": "{\"actions\":[{\"type\":\"set_color\",\"hex\":\"#FF8800\"},"},
+                    {"text": "{\"type\":\"set_effect\",\"name\":\"Fire Flicker (Soft)\"},"
+                             "{\"type\":\"set_brightness\",\"value\":96}],\"note\":\"cozy – warm\"}"},
+                ],
+                "role": "model",
+            },
+            "finishReason": "STOP",
+            "index": 0,
+        },
+        {"content": {"parts": [{"text": "{\"actions\":[]}"}]}},
+    ],
+    "usageMetadata": {"promptTokenCount": 812, "candidatesTokenCount": 41, "totalTokenCount": 853},
+    "modelVersion": "standin",
+}
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_POST(self):
+        n = int(self.headers.get("Content-Length", "0"))
+        req = self.rfile.read(n)
+        try:
+            prompt = json.loads(req)["contents"][-1]["parts"][0]["text"]
+        except (ValueError, KeyError, IndexError):
+            prompt = "?"
+        keep = self.headers.get("Connection", "").lower() != "close"
+        self.server.requests += 1
+        print(f"{self.command} {self.path.split('?')[0]} ({n} bytes) prompt={prompt!r} "
+              f"conn#{self.conn_id} req#{self.server.requests} {'keep-alive' if keep else 'close'}")
+
+        cfg = self.server.cfg
+        body = cfg.body
+        self.send_response(cfg.status)
+        self.send_header("Content-Type", "application/json; charset=UTF-8")
+        if cfg.chunked:
+            self.send_header("Transfer-Encoding", "chunked")
+        else:
+            self.send_header("Content-Length", str(len(body)))
+        self.send_header("Connection", "keep-alive" if keep else "close")
+        self.end_headers()
+
+        wire = bytearray()
+        if cfg.chunked:
+            step = max(1, cfg.chunk)
+            for i in range(0, len(body), step):
+                part = body[i:i + step]
+                wire += b"%x\r\n" % len(part) + part + b"\r\n"
+            wire += b"0\r\n\r\n"
+        else:
+            wire += body
+        for i in range(0, len(wire), cfg.split):
+            self.wfile.write(wire[i:i + cfg.split])
+            self.wfile.flush()
+            if cfg.delay:
+                time.sleep(cfg.delay)
+        self.close_connection = not keep
+
+    def setup(self):
+        self.timeout = self.server.cfg.idle_timeout or None  # idle keep-alive connections get closed
+        super().setup()
+        self.server.connections += 1
+        self.conn_id = self.server.connections
+        print(f"conn#{self.conn_id} from {self.client_address[0]}")
+
+    def finish(self):
+        super().finish()
+        print(f"conn#{self.conn_id} closed")
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+def self_signed(tmp: str):
+    cert, key = os.path.join(tmp, "cert.pem"), os.path.join(tmp, "key.pem")
+    subprocess.run(["openssl", "req", "-x509", "-newkey", "rsa:2048", "-nodes", "-days", "30",
+                    "-subj", "/CN=gemini-standin", "-keyout", key, "-out", cert],
+                   check=True, capture_output=True)
+    return cert, key
+
+
+class Server(socketserver.ThreadingMixIn, socketserver.TCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+    requests = 0
+    connections = 0
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--port", type=int, default=8080)
+    ap.add_argument("--file", help="recorded response body to replay (default: built-in sample)")
+    ap.add_argument("--status", type=int, default=200)
+    ap.add_argument("--chunked", action="store_true", help="Transfer-Encoding: chunked")
+    ap.add_argument("--chunk", type=int, default=100, help="payload bytes per chunk")
+    ap.add_argument("--split", type=int, default=1460, help="bytes per socket write")
+    ap.add_argument("--delay-ms", type=float, default=0.0, help="pause between writes")
+    ap.add_argument("--tls", action="store_true", help="serve HTTPS (self-signed unless --cert/--key)")
+    ap.add_argument("--cert")
+    ap.add_argument("--key")
+    ap.add_argument("--idle-timeout", type=float, default=0.0, help="close idle keep-alive connections after s")
+    args = ap.parse_args()
+
+    if args.file:
+        with open(args.file, "rb") as f:
+            body = f.read()
+    else:
+        body = json.dumps(SAMPLE, indent=2).encode("utf-8")
+    args.body = body
+    args.split = max(1, args.split)
+    args.delay = args.delay_ms / 1000.0
+
+    with tempfile.TemporaryDirectory() as tmp, Server(("", args.port), Handler) as srv:
+        srv.cfg = args
+        if args.tls:
+            cert, key = (args.cert, args.key) if args.cert else self_signed(tmp)
+            ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+            ctx.load_cert_chain(cert, key)
+            srv.socket = ctx.wrap_socket(srv.socket, server_side=True)
+        print(f"Gemini stand-in on {'https' if args.tls else 'http'}://:{args.port} ({len(body)} byte body, "
+              f"{'chunked' if args.chunked else 'content-length'}, {args.split} bytes/write)")
+        srv.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
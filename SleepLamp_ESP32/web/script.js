@@ -269,7 +269,13 @@ function updateRangeUI(min, max) {
   els.mimirRangeBar.style.width = `${pct(max - min, 255)}%`;
 }
 
-// ---------------------- Status polling ----------------------
+// ---------------------- Status (push + polling fallback) ----------------------
+const STATUS_POLL_MS = 2000;
+const WIFI_POLL_MS = 5000;
+const PRESETS_POLL_MS = 15000;
+
+let liveStatus = null; // last full status, deltas from /events are merged in
+let fallbackTimers = [];
 function updateUIStatus(status) {
   els.color.value = `#${status.color}`;
   els.colorSwatch.style.background = `#${status.color}`;
@@ -308,6 +314,7 @@ function updateUIStatus(status) {
 async function pollStatus() {
   try {
     const st = await api("/status");
+    liveStatus = st;
     updateUIStatus(st);
   } catch (e) {
     console.warn("Status poll error", e);
@@ -319,7 +326,7 @@ function updateWifiInfoUI(info) {
   const mode = (info.mode || "AP").toUpperCase();
   els.wifiModeLabel.textContent = mode;
 
-  if (mode === "STA") {
+  if (info.ip) {
     els.staInfo.style.display = "block";
     els.apInfo.style.display = "none";
     els.staInfoSsid.textContent = info.ssid || "";
@@ -344,6 +351,49 @@ async function pollWifiInfo() {
   }
 }
 
+// Polling only runs while the /events stream is down
+function setFallbackPolling(on) {
+  if (on && fallbackTimers.length === 0) {
+    fallbackTimers = [
+      setInterval(pollStatus, STATUS_POLL_MS),
+      setInterval(pollWifiInfo, WIFI_POLL_MS),
+    ];
+  } else if (!on) {
+    fallbackTimers.forEach(clearInterval);
+    fallbackTimers = [];
+  }
+}
+
+function startLiveUpdates() {
+  if (!window.EventSource) {
+    setFallbackPolling(true);
+    return;
+  }
+  const es = new EventSource("/events");
+  es.addEventListener("open", () => {
+    setFallbackPolling(false);
+  });
+  es.addEventListener("error", () => {
+    // EventSource reconnects by itself; poll until it does
+    setFallbackPolling(true);
+  });
+  es.addEventListener("status", (e) => {
+    liveStatus = JSON.parse(e.data);
+    updateUIStatus(liveStatus);
+  });
+  es.addEventListener("delta", (e) => {
+    if (!liveStatus) return;
+    Object.assign(liveStatus, JSON.parse(e.data));
+    updateUIStatus(liveStatus);
+  });
+  es.addEventListener("wifi", (e) => {
+    updateWifiInfoUI(JSON.parse(e.data));
+  });
+  es.addEventListener("preset", () => {
+    pollPresets();
+  });
+}
+
 // ---------------------- Direct control wrappers ----------------------
 async function applyColor(hex) {
   await api("/setColor", { hex });
@@ -379,6 +429,19 @@ async function setWiFiModeSTA() {
   return api("/wifi", { mode: "STA", ssid, pass });
 }
 
+// The lamp switches in the background (202); follow it on /wifiStatus
+async function waitWifiSwitch(timeoutMs = 45000) {
+  const end = Date.now() + timeoutMs;
+  while (Date.now() < end) {
+    await new Promise((r) => setTimeout(r, 1000));
+    try {
+      const st = await api("/wifiStatus");
+      if (st.result !== "pending") return st;
+    } catch {} // radio busy switching; keep trying
+  }
+  return null;
+}
+
 // ---------------------- Training + auto-suggest ----------------------
 async function getStatusSnapshot() {
   return api("/status");
@@ -748,6 +811,7 @@ async function manualSuggest() {
 
 // ---------------------- AI Control (unchanged behavior) ----------------------
 let aiPolling = false;
+let aiJobId = 0; // job being followed (ids come from /aiCommand)
 
 function aiSetUI(stateText, disabled) {
   if (els.aiAskBtn) {
@@ -788,18 +852,31 @@ async function aiPollLoop(startedAt = Date.now()) {
 
   while (true) {
     try {
-      const st = await api("/aiStatus");
+      const st = await api("/aiStatus", aiJobId ? { id: aiJobId } : {});
       if (st.running) {
-        els.aiLog.textContent = `AI running… Prompt: "${st.prompt}"`;
+        els.aiLog.textContent =
+          st.state === "queued"
+            ? `AI queued… Prompt: "${st.prompt}"`
+            : `AI running… Prompt: "${st.prompt}"`;
       } else if (st.idle) {
         els.aiLog.textContent = "AI idle.";
         break;
       } else if (st.done) {
         if (st.ok)
-          els.aiLog.textContent = `AI OK\nApplied: ${st.applied || ""}`;
+          els.aiLog.textContent = `AI OK${st.local ? " (on-device)" : st.cached ? " (cached)" : ""}\nApplied: ${st.applied || ""}`;
+        else if (st.state === "superseded")
+          els.aiLog.textContent = `AI: replaced by a newer prompt (#${st.superseded_by})`;
         else els.aiLog.textContent = `AI Error: ${st.error || "unknown"}`;
         appendDebug(st.model_snippet || "");
         appendDebug(`Duration: ${st.duration_ms ?? 0} ms`);
+        const t = st.timing;
+        if (t)
+          appendDebug(
+            `dns ${t.dns_ms} / connect ${t.connect_ms} / tls ${t.tls_ms} / send ${t.send_ms} / ` +
+              `first byte ${t.first_byte_ms} / body ${t.body_ms} ms` +
+              (t.reused ? " (kept connection)" : "") +
+              (t.retries ? ` (${t.retries} retry)` : "")
+          );
         try {
           await forceRefreshAfterAI();
         } catch {}
@@ -850,6 +927,7 @@ async function askAI() {
       aiSetUI("Ask AI", false);
       return;
     }
+    aiJobId = start.id || 0;
     await aiPollLoop();
   } catch (e) {
     els.aiLog.textContent = "Start HTTP error: " + e.message;
@@ -860,13 +938,21 @@ async function askAI() {
   }
 }
 
+// Opening the connection to Gemini takes seconds (TLS); start it while the user types
+let aiWarmAt = 0;
+function warmAI() {
+  if (aiPolling || Date.now() - aiWarmAt < 30000) return;
+  aiWarmAt = Date.now();
+  fetch("/aiWarm", { method: "POST", cache: "no-store" }).catch(() => {});
+}
+
 async function cancelAI() {
   if (!aiPolling) {
     els.aiLog.textContent = "No running AI job to cancel.";
     return;
   }
   try {
-    const res = await api("/aiCancel", {});
+    const res = await api("/aiCancel", aiJobId ? { id: aiJobId } : {});
     els.aiLog.textContent = res.ok
       ? "Cancel requested. Waiting…"
       : "Cancel failed";
@@ -1038,7 +1124,7 @@ function bindEvents() {
   els.btnAP.addEventListener("click", async () => {
     try {
       const res = await setWiFiModeAP();
-      alert(res?.ok ? "Switched to AP" : "Failed");
+      alert(res?.ok ? `Switching to AP: join VOIDSTAR, then open ${res.host}` : "Failed");
     } catch {
       alert("Failed to switch to AP");
     }
@@ -1049,7 +1135,14 @@ function bindEvents() {
   els.btnSTA.addEventListener("click", async () => {
     try {
       const res = await setWiFiModeSTA();
-      alert(res?.ok ? "Switched to STA" : "Failed");
+      if (res?.ok) {
+        const st = await waitWifiSwitch();
+        if (st?.result === "ok") alert(`Connected to ${st.ssid} (${st.ip}), open ${res.host}`);
+        else if (st) alert(`Could not connect (reason ${st.reason}), staying in AP`);
+        else alert(`Still connecting; try ${res.host} or the VOIDSTAR AP`);
+      } else if (res) {
+        alert("Failed");
+      }
     } catch {
       alert("Failed to switch to STA");
     }
@@ -1059,6 +1152,8 @@ function bindEvents() {
 
   // AI
   els.aiAskBtn.addEventListener("click", askAI);
+  els.aiPrompt.addEventListener("focus", warmAI);
+  if (els.aiMicBtn) els.aiMicBtn.addEventListener("click", warmAI);
   if (els.aiCancelBtn) els.aiCancelBtn.addEventListener("click", cancelAI);
   if (els.aiDebugToggle)
     els.aiDebugToggle.addEventListener("click", () => {
@@ -1085,9 +1180,8 @@ function bindEvents() {
   await pollPresets();
   await refreshPcMode();
 
-  // Intervals
-  setInterval(pollStatus, 2000);
-  setInterval(pollWifiInfo, 5000);
-  setInterval(pollPresets, 4000);
+  // Lamp state is pushed over /events; presets live on the PC server
+  startLiveUpdates();
+  setInterval(pollPresets, PRESETS_POLL_MS);
   setInterval(refreshPcMode, 15000);
 })();
@@ -0,0 +1,98 @@
+#pragma once
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "fs_select.h"
+#include "metrics.h"
+
+/*
+  web_assets.h
+  Serves the UI built by tools/build_data.py: gzipped files listed in
+  /assets.txt ("url file mime etag immutable" per line). Hashed assets are
+  cached for a year as immutable; index.html is revalidated via its ETag.
+  Without a manifest (plain files uploaded from an older checkout) the
+  original uncompressed routes are registered instead.
+*/
+
+#ifndef WEB_ASSETS_MAX
+#define WEB_ASSETS_MAX 16
+#endif
+
+#define WEB_ASSETS_MANIFEST "/assets.txt"
+
+namespace WebAssets {
+
+struct Asset {
+  char url[48];
+  char file[56];
+  char mime[28];
+  char etag[20];  // quoted
+  bool immutable;
+};
+
+static Asset s_assets[WEB_ASSETS_MAX];
+static uint8_t s_count = 0;
+
+static void serve(AsyncWebServerRequest* r, const Asset& a) {
+  AsyncWebServerResponse* resp;
+  if (r->hasHeader("If-None-Match") && r->getHeader("If-None-Match")->value() == a.etag) {
+    resp = r->beginResponse(304);
+  } else {
+    resp = r->beginResponse(FSYS, a.file, a.mime);
+    resp->addHeader("Content-Encoding", "gzip");
+  }
+  resp->addHeader("ETag", a.etag);
+  resp->addHeader("Cache-Control", a.immutable ? "public, max-age=31536000, immutable" : "no-cache");
+  r->send(resp);
+}
+
+static bool parseLine(char* line, Asset& a) {
+  char* save = nullptr;
+  const char* url = strtok_r(line, " \r", &save);
+  const char* file = strtok_r(nullptr, " \r", &save);
+  const char* mime = strtok_r(nullptr, " \r", &save);
+  const char* etag = strtok_r(nullptr, " \r", &save);
+  const char* imm = strtok_r(nullptr, " \r", &save);
+  if (!url || !file || !mime || !etag || !imm) return false;
+  if (strlen(url) >= sizeof(a.url) || strlen(file) >= sizeof(a.file) || strlen(mime) >= sizeof(a.mime)) return false;
+  strlcpy(a.url, url, sizeof(a.url));
+  strlcpy(a.file, file, sizeof(a.file));
+  strlcpy(a.mime, mime, sizeof(a.mime));
+  snprintf(a.etag, sizeof(a.etag), "\"%s\"", etag);
+  a.immutable = imm[0] == '1';
+  return true;
+}
+
+static void loadManifest() {
+  s_count = 0;
+  File f = FSYS.open(WEB_ASSETS_MANIFEST, "r");
+  if (!f) return;
+  char line[192];
+  while (f.available() && s_count < WEB_ASSETS_MAX) {
+    size_t n = f.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[n] = '\0';
+    if (n && parseLine(line, s_assets[s_count])) s_count++;
+  }
+  f.close();
+}
+
+// Register UI routes; returns the number of manifest entries (0 = legacy plain files)
+uint8_t begin(AsyncWebServer& server) {
+  loadManifest();
+  if (!s_count) {
+    Serial.println("[Web] No " WEB_ASSETS_MANIFEST ", serving plain files (run tools/build_data.py)");
+    server.on("/", HTTP_GET, Metrics::timed("/", [](AsyncWebServerRequest* r) { r->send(FSYS, "/index.html", String(), false); }));
+    server.serveStatic("/script.js", FSYS, "/script.js").setCacheControl("max-age=60");
+    server.serveStatic("/bootstrap.min.css", FSYS, "/bootstrap.min.css").setCacheControl("max-age=31536000");
+    server.serveStatic("/bootstrap.bundle.min.js", FSYS, "/bootstrap.bundle.min.js").setCacheControl("max-age=31536000");
+    return 0;
+  }
+  for (uint8_t i = 0; i < s_count; ++i) {
+    const Asset* a = &s_assets[i];
+    // one histogram for all of them: "assets"
+    server.on(a->url, HTTP_GET, Metrics::timed("assets", [a](AsyncWebServerRequest* r) { serve(r, *a); }));
+  }
+  Serial.printf("[Web] %u gzipped assets from " WEB_ASSETS_MANIFEST "\n", s_count);
+  return s_count;
+}
+
+}
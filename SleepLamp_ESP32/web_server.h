@@ -7,13 +7,25 @@
 #include "fs_select.h"
 #include "config.h"
 #include "led_control.h"
-#include "ai_control.h"
+#include "action_engine.h"
+#include "render_task.h"
+#include "lux_input.h"
+#include "state_push.h"
+#include "preset_store.h"
+#include "status_cache.h"
+#include "web_assets.h"
+#include "ai_worker.h"
 #include "ai_state.h"
+#include "metrics.h"
+#if ENABLE_BENCH
+#include "bench.h"
+#endif
 
 // ---------------- CORS ----------------
 static void enableCORS() {
   DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
-  DefaultHeaders::Instance().addHeader("Access-Control-Allow-Headers", "Content-Type");
+  DefaultHeaders::Instance().addHeader("Access-Control-Allow-Headers", "Content-Type, If-None-Match");
+  DefaultHeaders::Instance().addHeader("Access-Control-Expose-Headers", "ETag");
   DefaultHeaders::Instance().addHeader("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
 }
 static void handleOptions(AsyncWebServerRequest* r) { r->send(204); }
@@ -25,113 +37,32 @@ extern volatile bool g_presenceEnabled;
 String wifiModeString();
 void wifiStartAP();
 bool wifiStartSTA(const String& ssid, const String& pass);
+const char* wifiModeName();
+String wifiStatusJson();
 void savePreferenceColor(uint32_t color);
 void savePreferenceBrightness(uint8_t b);
 void savePreferenceEffect(uint16_t e);
 void savePreferenceOn(bool on);
 void savePreferenceMimir(bool m);
-void savePreferenceWiFiMode(const String& mode);
-void savePreferenceSTA(const String& ssid, const String& pass);
 void savePreferenceMimirRange(uint8_t minB, uint8_t maxB);
+void savePreferenceMimirCurve(const MimirCurve::Point* pts, uint8_t n);
 void savePreferencePresence(bool p);
 int getStaChannel();
 
-// ---------------- Apply actions (shared schema) ----------------
-static bool applyActionsFromJsonText(const String& jsonText, String& appliedLog, String& err) {
-  StaticJsonDocument<8192> doc;
-  DeserializationError derr = deserializeJson(doc, jsonText);
-  if (derr) { err = String("JSON parse error: ") + derr.c_str(); return false; }
-
-  JsonArray actions = doc["actions"].as<JsonArray>();
-  if (actions.isNull()) { err = "Missing actions array"; return false; }
-
-  for (JsonObject obj : actions) {
-    const char* type = obj["type"] | "";
-    if (!*type) continue;
-
-    if (strcmp(type, "set_brightness") == 0) {
-      int v = obj["value"] | -1;
-      if (v >= 0 && v <= 255) {
-        LedControl::setTargetBrightness((uint8_t)v);
-        savePreferenceBrightness((uint8_t)v);
-        if (v == 0) { LedControl::setOn(false); savePreferenceOn(false); }
-        else { LedControl::setOn(true); savePreferenceOn(true); }
-        appliedLog += "brightness=" + String(v) + "; ";
-      }
-    } else if (strcmp(type, "set_color") == 0) {
-      const char* hex = obj["hex"] | "";
-      if (hex && strlen(hex) == 7 && hex[0] == '#') {
-        uint32_t c = (uint32_t)strtoul(hex + 1, nullptr, 16);
-        LedControl::setColor(c);
-        savePreferenceColor(c);
-        appliedLog += String("color=") + hex + "; ";
-      }
-    } else if (strcmp(type, "set_effect") == 0) {
-      int id = obj["id"] | -1;
-      if (id >= 0 && id <= 255) {
-        LedControl::setEffect((uint16_t)id);
-        savePreferenceEffect((uint16_t)id);
-        appliedLog += "effect=" + String(id) + "; ";
-      }
-    } else if (strcmp(type, "set_mimir") == 0) {
-      bool on = obj["on"] | false;
-      LedControl::setMimir(on);
-      savePreferenceMimir(on);
-      appliedLog += String("mimir=") + (on ? "on" : "off") + "; ";
-    } else if (strcmp(type, "set_power") == 0) {
-      bool on = obj["on"] | false;
-      LedControl::setOn(on);
-      savePreferenceOn(on);
-      appliedLog += String("power=") + (on ? "on" : "off") + "; ";
-    } else if (strcmp(type, "set_mimir_range") == 0) {
-      int minB = obj["min"] | -1;
-      int maxB = obj["max"] | -1;
-      if (minB >= 0 && maxB >= 0 && minB <= 255 && maxB <= 255) {
-        if (minB > maxB) { int t=minB; minB=maxB; maxB=t; }
-        LedControl::setMimirRange((uint8_t)minB, (uint8_t)maxB);
-        savePreferenceMimirRange((uint8_t)minB, (uint8_t)maxB);
-        appliedLog += "mimir_range=[" + String(minB) + "," + String(maxB) + "]; ";
-      }
-    }
-  }
-
-  if (!appliedLog.length()) { err = "No valid actions applied"; return false; }
-  return true;
-}
-
-// ---------------- Preset cache ----------------
-#ifndef PRESET_CACHE_MAX
-#define PRESET_CACHE_MAX 24
-#endif
-
-struct PresetCacheItem {
-  uint32_t ts = 0;
-  String source;
-  String note;
-  String actionsJson; // stored as compact JSON string
-};
-
-static PresetCacheItem g_presets[PRESET_CACHE_MAX];
-static uint8_t g_presetCount = 0;
-static uint8_t g_presetHead = 0; // next insert index
-
-static void cachePreset(uint32_t ts, const String& source, const String& note, const String& actionsJson) {
-  g_presets[g_presetHead].ts = ts;
-  g_presets[g_presetHead].source = source;
-  g_presets[g_presetHead].note = note;
-  g_presets[g_presetHead].actionsJson = actionsJson;
+// ---------------- Lamp REST handlers ----------------
 
-  g_presetHead = (uint8_t)((g_presetHead + 1) % PRESET_CACHE_MAX);
-  if (g_presetCount < PRESET_CACHE_MAX) g_presetCount++;
+// Optional ?transition_ms= (fade length), else dflt
+static uint32_t transitionParam(AsyncWebServerRequest* r, uint32_t dflt) {
+  if (!r->hasParam("transition_ms")) return dflt;
+  long ms = r->getParam("transition_ms")->value().toInt();
+  return ms > 0 ? (uint32_t)ms : 0;
 }
 
-// ---------------- Lamp REST handlers ----------------
-
 static void handleSetColor(AsyncWebServerRequest* r) {
   if (!r->hasParam("hex")) { r->send(400, "application/json", "{\"error\":\"missing hex\"}"); return; }
   String hex = r->getParam("hex")->value();
   uint32_t color = LedControl::hexToColor(hex);
-  LedControl::setColor(color);
+  LedControl::setColor(color, transitionParam(r, COLOR_FADE_MS));
   savePreferenceColor(color);
   r->send(200, "application/json", "{\"ok\":true}");
 }
@@ -140,8 +71,8 @@ static void handleSetBrightness(AsyncWebServerRequest* r) {
   if (!r->hasParam("value")) { r->send(400, "application/json", "{\"error\":\"missing value\"}"); return; }
   int v = r->getParam("value")->value().toInt();
   v = constrain(v, BRIGHTNESS_MIN, BRIGHTNESS_MAX);
-  LedControl::setTargetBrightness((uint8_t)v);
-  if (v == 0) { LedControl::setOn(false); savePreferenceOn(false); }
+  LedControl::setTargetBrightness((uint8_t)v, transitionParam(r, 0));
+  if (v == 0) { if (!LedControl::fadingOff()) LedControl::setOn(false); savePreferenceOn(false); }
   else { LedControl::setOn(true); savePreferenceOn(true); }
   savePreferenceBrightness((uint8_t)v);
   r->send(200, "application/json", "{\"ok\":true}");
@@ -191,25 +122,152 @@ static void handleMimirRange(AsyncWebServerRequest* r) {
   r->send(200, "application/json", buf);
 }
 
+// GET /mimirCurve?points=lux:level,lux:level,...  (level 0..255 within the Mimir range)
+// GET /mimirCurve?reset=1 restores the gamma curve; no params returns the active curve
+static void handleMimirCurve(AsyncWebServerRequest* r) {
+  if (r->hasParam("reset") && r->getParam("reset")->value().toInt() != 0) {
+    LedControl::setMimirCurve(nullptr, 0);
+    savePreferenceMimirCurve(nullptr, 0);
+  } else if (r->hasParam("points")) {
+    MimirCurve::Point pts[MIMIR_CURVE_MAX_POINTS];
+    uint8_t n = 0;
+    const char* p = r->getParam("points")->value().c_str();
+    while (*p) {
+      char* end;
+      long lux = strtol(p, &end, 10);
+      if (end == p || *end != ':' || n >= MIMIR_CURVE_MAX_POINTS) { n = 0; break; }
+      p = end + 1;
+      long level = strtol(p, &end, 10);
+      if (end == p || lux < 0 || lux > 65535 || level < 0 || level > 255) { n = 0; break; }
+      pts[n++] = { (uint16_t)lux, (uint8_t)level };
+      p = end;
+      if (*p == ',') p++;
+      else if (*p) { n = 0; break; }
+    }
+    if (n == 0 || !LedControl::setMimirCurve(pts, n)) {
+      r->send(400, "application/json", "{\"error\":\"points must be 2..8 lux:level pairs with distinct lux\"}");
+      return;
+    }
+    savePreferenceMimirCurve(MimirCurve::points(), MimirCurve::pointCount());
+  }
+
+  char buf[160];
+  int len = snprintf(buf, sizeof(buf), "{\"ok\":true,\"curve\":\"%s\",\"points\":[",
+                     MimirCurve::pointCount() ? "points" : "gamma");
+  for (uint8_t i = 0; i < MimirCurve::pointCount(); ++i) {
+    const MimirCurve::Point& pt = MimirCurve::points()[i];
+    len += snprintf(buf + len, sizeof(buf) - len, "%s[%u,%u]", i ? "," : "", pt.lux, pt.level);
+  }
+  snprintf(buf + len, sizeof(buf) - len, "]}");
+  r->send(200, "application/json", buf);
+}
+
 static void handleLux(AsyncWebServerRequest* r) {
   char buf[64];
   snprintf(buf, sizeof(buf), "{\"lux\":%.2f}", LedControl::getLux());
   r->send(200, "application/json", buf);
 }
 
+// Sends a status cache entry straight from its slot; the slot stays pinned
+// until the server deletes the response (sent or connection gone)
+class StatusResponse : public AsyncAbstractResponse {
+ public:
+  explicit StatusResponse(StatusCache::Pin&& pin) : pin_(std::move(pin)), at_(0) {
+    _code = 200;
+    _contentType = "application/json";
+    _contentLength = pin_->len;
+  }
+  bool _sourceValid() const override { return true; }
+  size_t _fillBuffer(uint8_t* buf, size_t maxLen) override {
+    size_t n = pin_->len - at_;
+    if (n > maxLen) n = maxLen;
+    memcpy(buf, pin_->json + at_, n);
+    at_ += n;
+    return n;
+  }
+  const char* etag() const { return pin_->etag; }
+
+ private:
+  StatusCache::Pin pin_;
+  size_t at_;
+};
+
+// GET /status -> cached JSON (see status_cache.h), 304 on a matching If-None-Match
 static void handleStatus(AsyncWebServerRequest* r) {
-  String base = LedControl::jsonStatus(wifiModeString(), (bool)g_lastMotion, (bool)g_presenceEnabled);
-  r->send(200, "application/json", base);
+  StatusCache::Pin pin;
+  AsyncWebServerResponse* resp;
+  if (r->hasHeader("If-None-Match") && r->getHeader("If-None-Match")->value() == pin->etag) {
+    resp = r->beginResponse(304);
+    resp->addHeader("ETag", pin->etag);
+  } else {
+    StatusResponse* sr = new StatusResponse(std::move(pin));
+    sr->addHeader("Cache-Control", "no-cache");
+    sr->addHeader("ETag", sr->etag());
+    resp = sr;
+  }
+  r->send(resp);
 }
 
+// GET /renderStats[?reset=1] -> frame timing of the render task (reset clears the max values)
+static void handleRenderStats(AsyncWebServerRequest* r) {
+  bool reset = r->hasParam("reset") && r->getParam("reset")->value().toInt() != 0;
+  r->send(200, "application/json", RenderTask::jsonStats(reset));
+}
+
+// GET /luxStats[?reset=1] -> ESP-NOW sample ring counters (drops, malformed, jitter)
+static void handleLuxStats(AsyncWebServerRequest* r) {
+  bool reset = r->hasParam("reset") && r->getParam("reset")->value().toInt() != 0;
+  r->send(200, "application/json", LuxInput::jsonStats(reset));
+}
+
+#if ENABLE_BENCH
+// GET /bench[?name=substring&iters=N] -> ns/op, allocations and retained heap per case (tools/bench.py)
+static void handleBench(AsyncWebServerRequest* r) {
+  String name = r->hasParam("name") ? r->getParam("name")->value() : String();
+  uint32_t iters = r->hasParam("iters") ? (uint32_t)r->getParam("iters")->value().toInt() : 0;
+  Bench::Result res[16];
+  size_t n = Bench::runAll(name.c_str(), iters, res, sizeof(res) / sizeof(res[0]));
+
+  DynamicJsonDocument doc(3072);
+  Bench::toJson(res, n, doc);
+  String out;
+  serializeJson(doc, out);
+  r->send(200, "application/json", out);
+}
+#endif
+
+// GET /fusion?mode=median|weighted|max&fallback=hold|fixed (both optional; no params = read)
+static void handleFusion(AsyncWebServerRequest* r) {
+  int mode = -1, fallback = -1;
+  if (r->hasParam("mode")) {
+    mode = LuxFusion::modeFromName(r->getParam("mode")->value().c_str());
+    if (mode < 0) { r->send(400, "application/json", "{\"error\":\"mode must be median, weighted or max\"}"); return; }
+  }
+  if (r->hasParam("fallback")) {
+    String fb = r->getParam("fallback")->value();
+    if (fb == "hold") fallback = LuxFusion::FALLBACK_HOLD;
+    else if (fb == "fixed") fallback = LuxFusion::FALLBACK_FIXED;
+    else { r->send(400, "application/json", "{\"error\":\"fallback must be hold or fixed\"}"); return; }
+  }
+  LuxInput::setFusion(mode, fallback);
+
+  char buf[1024];
+  buf[0] = '{';
+  size_t len = 1 + LuxInput::formatNodes(buf + 1, sizeof(buf) - 2);
+  buf[1] = ' ';  // formatNodes starts with a comma
+  snprintf(buf + len, sizeof(buf) - len, "}");
+  r->send(200, "application/json", buf);
+}
+
+// Mode switches only get queued (202); progress is at /wifiStatus. STA
+// credentials are saved once the connection works, else the lamp goes back to AP.
 static void handleWifi(AsyncWebServerRequest* r) {
   if (!r->hasParam("mode")) { r->send(400, "application/json", "{\"error\":\"missing mode\"}"); return; }
   String mode = r->getParam("mode")->value(); mode.toUpperCase();
 
   if (mode == "AP") {
-    savePreferenceWiFiMode("AP");
     wifiStartAP();
-    r->send(200, "application/json", "{\"ok\":true,\"mode\":\"AP\",\"host\":\"http://voidpointer.local/\"}");
+    r->send(202, "application/json", "{\"ok\":true,\"accepted\":true,\"mode\":\"AP\",\"host\":\"http://voidpointer.local/\",\"status\":\"/wifiStatus\"}");
     return;
   }
 
@@ -217,26 +275,19 @@ static void handleWifi(AsyncWebServerRequest* r) {
     String ssid = r->hasParam("ssid") ? r->getParam("ssid")->value() : "";
     String pass = r->hasParam("pass") ? r->getParam("pass")->value() : "";
     if (!ssid.length()) { r->send(400, "application/json", "{\"error\":\"missing ssid\"}"); return; }
-    bool ok = wifiStartSTA(ssid, pass);
-    if (ok) {
-      savePreferenceWiFiMode("STA");
-      savePreferenceSTA(ssid, pass);
-      r->send(200, "application/json", "{\"ok\":true,\"mode\":\"STA\",\"host\":\"http://voidstar.local/\"}");
-    } else {
-      r->send(500, "application/json", "{\"ok\":false,\"error\":\"connect failed, reverted to AP\"}");
-    }
+    if (!wifiStartSTA(ssid, pass)) { r->send(400, "application/json", "{\"error\":\"ssid/pass too long\"}"); return; }
+    r->send(202, "application/json", "{\"ok\":true,\"accepted\":true,\"mode\":\"STA\",\"host\":\"http://voidstar.local/\",\"status\":\"/wifiStatus\"}");
     return;
   }
 
   r->send(400, "application/json", "{\"error\":\"invalid mode\"}");
 }
 
-static void handleWifiInfo(AsyncWebServerRequest* r) {
-  String mode = wifiModeString();
-  if (mode != "STA" || WiFi.status() != WL_CONNECTED) {
-    String js = String("{\"mode\":\"") + mode + "\"}";
-    r->send(200, "application/json", js);
-    return;
+// Wi-Fi info JSON (shared by /wifiInfo and the /events push)
+String wifiInfoJson() {
+  const char* mode = wifiModeName();
+  if (WiFi.status() != WL_CONNECTED) {
+    return String("{\"mode\":\"") + mode + "\"}";
   }
 
   String ssid = WiFi.SSID();
@@ -249,128 +300,236 @@ static void handleWifiInfo(AsyncWebServerRequest* r) {
 
   char buf[384];
   snprintf(buf, sizeof(buf),
-    "{\"mode\":\"STA\",\"ssid\":\"%s\",\"rssi\":%ld,\"channel\":%d,"
+    "{\"mode\":\"%s\",\"ssid\":\"%s\",\"rssi\":%ld,\"channel\":%d,"
     "\"ip\":\"%u.%u.%u.%u\",\"gw\":\"%u.%u.%u.%u\",\"subnet\":\"%u.%u.%u.%u\",\"dns\":\"%u.%u.%u.%u\"}",
-    ssid.c_str(), (long)rssi, ch,
+    mode, ssid.c_str(), (long)rssi, ch,
     ip[0], ip[1], ip[2], ip[3],
     gw[0], gw[1], gw[2], gw[3],
     sn[0], sn[1], sn[2], sn[3],
     dns[0], dns[1], dns[2], dns[3]
   );
-  r->send(200, "application/json", buf);
+  return String(buf);
+}
+
+static void handleWifiInfo(AsyncWebServerRequest* r) {
+  r->send(200, "application/json", wifiInfoJson());
+}
+
+static void handleWifiStatus(AsyncWebServerRequest* r) {
+  r->send(200, "application/json", wifiStatusJson());
 }
 
 // ---- PC model integration endpoints ----
 
-// POST /applyPreset with JSON body { "actions":[...], "source":"...", "ts":..., "note":"..." }
-static void handleApplyPreset(AsyncWebServerRequest* r, uint8_t* data, size_t len, size_t index, size_t total) {
-  static String body;
-  if (index == 0) body = "";
-  for (size_t i = 0; i < len; i++) body += (char)data[i];
-  if (index + len != total) return;
-
-  uint32_t ts = (uint32_t)(millis() / 1000UL);
-  String source, note;
-
-  // Extract ts/source/note cheaply from JSON (we still parse actions below)
-  {
-    StaticJsonDocument<512> meta;
-    if (!deserializeJson(meta, body)) {
-      if (meta["ts"].is<uint32_t>()) ts = meta["ts"].as<uint32_t>();
-      source = (const char*)(meta["source"] | "");
-      note = (const char*)(meta["note"] | "");
-    }
-  }
+// ---- Request bodies: one buffer per request, sized from Content-Length ----
+#ifndef POST_BODY_MAX
+#define POST_BODY_MAX 4096
+#endif
 
-  String applied, err;
-  bool ok = applyActionsFromJsonText(body, applied, err);
+struct BodyBuf {
+  uint32_t len;
+  uint32_t cap;
+  uint16_t status;  // 0 = ok, else the HTTP error to answer with
+  char data[1];     // cap + 1 bytes (NUL-terminated)
+};
 
-  if (ok) cachePreset(ts, source, note, body);
+// Body callback: copies chunks straight into r->_tempObject (freed with the request)
+static void accumulateBody(AsyncWebServerRequest* r, uint8_t* data, size_t len, size_t index, size_t total) {
+  if (index == 0 && !r->_tempObject) {
+    size_t cap = total <= POST_BODY_MAX ? total : 0;
+    BodyBuf* b = (BodyBuf*)malloc(sizeof(BodyBuf) + cap);
+    if (!b) return;  // handler answers 503
+    b->len = 0;
+    b->cap = cap;
+    b->status = total > POST_BODY_MAX ? 413 : 0;
+    b->data[0] = '\0';
+    r->_tempObject = b;
+  }
+  BodyBuf* b = (BodyBuf*)r->_tempObject;
+  if (!b || b->status) return;
+  if (index + len > b->cap) { b->status = 413; return; }
+  memcpy(b->data + index, data, len);
+  if (index + len > b->len) b->len = index + len;
+  b->data[b->len] = '\0';
+}
 
+// Common checks once the body is complete; nullptr = response already sent
+static BodyBuf* completedBody(AsyncWebServerRequest* r) {
+  BodyBuf* b = (BodyBuf*)r->_tempObject;
+  if (!b) {
+    if (r->contentLength() > 0) r->send(503, "application/json", "{\"ok\":false,\"error\":\"out of memory\"}");
+    else r->send(400, "application/json", "{\"ok\":false,\"error\":\"missing body\"}");
+    return nullptr;
+  }
+  if (b->status == 413) {
+    char buf[80];
+    snprintf(buf, sizeof(buf), "{\"ok\":false,\"error\":\"body too large (max %u)\"}", (unsigned)POST_BODY_MAX);
+    r->send(413, "application/json", buf);
+    return nullptr;
+  }
+  return b;
+}
+
+static void sendApplyResult(AsyncWebServerRequest* r, int code, const String& applied, const String& err, uint32_t id) {
+  bool ok = code == 200;
   StaticJsonDocument<256> resp;
   resp["ok"] = ok;
   if (ok) resp["applied"] = applied;
   else resp["error"] = err;
+  if (id) resp["id"] = id;
 
   String out;
   serializeJson(resp, out);
-  r->send(ok ? 200 : 400, "application/json", out);
+  r->send(code, "application/json", out);
+}
+
+// POST|GET /applyPreset?id=N re-applies a stored preset (no body needed)
+static void handleApplyPresetId(AsyncWebServerRequest* r) {
+  uint32_t id = (uint32_t)strtoul(r->getParam("id")->value().c_str(), nullptr, 10);
+  Actions::Batch batch;
+  String applied;
+  bool ok = id && PresetStore::get(id, batch);
+  if (ok) {
+    Actions::apply(batch, applied);
+    StatePush::notifyPresets();
+  }
+  sendApplyResult(r, ok ? 200 : 404, applied, "unknown preset id", id);
+}
+
+// POST /applyPreset with JSON body { "actions":[...], "source":"...", "ts":..., "note":"..." }
+// Parsed once, in place (zero-copy strings point into the request buffer).
+static void handleApplyPreset(AsyncWebServerRequest* r) {
+  if (r->hasParam("id")) { handleApplyPresetId(r); return; }
+  BodyBuf* body = completedBody(r);
+  if (!body) return;
+
+  StaticJsonDocument<448> filter;
+  Actions::addSchemaFilter(filter);
+  filter["ts"] = true;
+  filter["source"] = true;
+  filter["note"] = true;
+
+  DynamicJsonDocument doc(Actions::docCapacityFor(body->len));
+  DeserializationError derr = deserializeJson(doc, body->data, body->len, DeserializationOption::Filter(filter));
+
+  String applied, err;
+  Actions::Batch batch;
+  bool ok = false;
+  uint32_t id = 0;
+  if (derr) {
+    err = String("JSON parse error: ") + derr.c_str();
+  } else if (Actions::compile(doc["actions"].as<JsonArrayConst>(), batch, err)) {
+    Actions::apply(batch, applied);
+    ok = true;
+
+    uint32_t ts = doc["ts"].is<uint32_t>() ? doc["ts"].as<uint32_t>() : (uint32_t)(millis() / 1000UL);
+    id = PresetStore::add(ts, doc["source"] | "", doc["note"] | "", batch);
+    StatePush::notifyPresets();
+  }
+  sendApplyResult(r, ok ? 200 : 400, applied, err, id);
 }
 
-// GET /presets -> cached presets (bounded)
+// GET /presets -> stored presets, newest first. The ETag is the next preset id,
+// so a poll with a matching If-None-Match costs a bodiless 304.
 static void handlePresets(AsyncWebServerRequest* r) {
-  StaticJsonDocument<4096> doc;
-  doc["ok"] = true;
-  JsonArray arr = doc.createNestedArray("presets");
-
-  // Return in newest->oldest order
-  for (int i = 0; i < g_presetCount; i++) {
-    int idx = (int)g_presetHead - 1 - i;
-    while (idx < 0) idx += PRESET_CACHE_MAX;
-    PresetCacheItem& it = g_presets[idx];
-
-    JsonObject o = arr.createNestedObject();
-    o["ts"] = it.ts;
-    o["source"] = it.source;
-    o["note"] = it.note;
-
-    // Provide compact "summary" fields for hover usage
-    o["actions_json"] = it.actionsJson;
+  char etag[16];
+  snprintf(etag, sizeof(etag), "\"p%lu\"", (unsigned long)PresetStore::version());
+
+  if (r->hasHeader("If-None-Match") && r->getHeader("If-None-Match")->value() == etag) {
+    AsyncWebServerResponse* resp = r->beginResponse(304);
+    resp->addHeader("ETag", etag);
+    r->send(resp);
+    return;
   }
 
-  String out;
-  serializeJson(doc, out);
-  r->send(200, "application/json", out);
+  AsyncResponseStream* resp = r->beginResponseStream("application/json");
+  resp->addHeader("ETag", etag);
+  resp->addHeader("Cache-Control", "no-cache");
+  PresetStore::writeJson(*resp);
+  r->send(resp);
 }
 
 // POST /logAction: just acknowledge (UI uses this for “lamp-side logging”)
-static void handleLogAction(AsyncWebServerRequest* r, uint8_t* data, size_t len, size_t index, size_t total) {
+static void handleLogAction(AsyncWebServerRequest* r) {
   // We don't persist on ESP32 to avoid flash wear; PC model will handle training storage.
-  if (index + len != total) return;
+  if (r->contentLength() > POST_BODY_MAX) { r->send(413, "application/json", "{\"ok\":false,\"error\":\"body too large\"}"); return; }
   r->send(200, "application/json", "{\"ok\":true}");
 }
 
+// Body is not kept; the handler only checks its declared size
+static void discardBody(AsyncWebServerRequest* r, uint8_t* data, size_t len, size_t index, size_t total) {}
+
 // ---------------- AI endpoints (existing) ----------------
 
+static uint32_t jobIdParam(AsyncWebServerRequest* r) {
+  if (r->hasParam("id", true)) return (uint32_t)strtoul(r->getParam("id", true)->value().c_str(), nullptr, 10);
+  if (r->hasParam("id")) return (uint32_t)strtoul(r->getParam("id")->value().c_str(), nullptr, 10);
+  return 0;
+}
+
+// Simple commands and prompts answered before are applied at once (also offline);
+// the rest is queued for the AI worker. nocache=1 always asks Gemini.
 static void handleAIStart(AsyncWebServerRequest* r) {
-  if (wifiModeString() != "STA") { r->send(400, "application/json", "{\"ok\":false,\"error\":\"Not in STA mode\"}"); return; }
   String prompt;
   if (r->hasParam("prompt", true)) prompt = r->getParam("prompt", true)->value();
   else if (r->hasParam("prompt")) prompt = r->getParam("prompt")->value();
   prompt.trim();
   if (!prompt.length()) { r->send(400, "application/json", "{\"ok\":false,\"error\":\"missing prompt\"}"); return; }
-  if (!canStartAIJob()) { r->send(429, "application/json", "{\"ok\":false,\"error\":\"rate limit or job running\"}"); return; }
-  if (!startAIJob(prompt)) { r->send(500, "application/json", "{\"ok\":false,\"error\":\"failed to create task\"}"); return; }
-  r->send(202, "application/json", "{\"ok\":true,\"status\":\"started\"}");
+  if (prompt.length() > AI_PROMPT_MAX) { r->send(413, "application/json", "{\"ok\":false,\"error\":\"prompt too long\"}"); return; }
+  bool nocache = r->hasParam("nocache", true) || r->hasParam("nocache");
+  bool local = false;
+  uint32_t id = nocache ? 0 : AiWorker::answerNow(prompt, local);
+  if (id) {
+    r->send(200, "application/json", String("{\"ok\":true,\"status\":\"done\",\"id\":") + id +
+            ",\"local\":" + (local ? "true" : "false") + ",\"cached\":" + (local ? "false" : "true") + "}");
+    return;
+  }
+  if (WiFi.status() != WL_CONNECTED) { r->send(400, "application/json", "{\"ok\":false,\"error\":\"Not in STA mode\"}"); return; }
+  id = AiWorker::submit(prompt);
+  if (!id) { r->send(503, "application/json", "{\"ok\":false,\"error\":\"AI worker not running\"}"); return; }
+  r->send(202, "application/json", String("{\"ok\":true,\"status\":\"queued\",\"id\":") + id + "}");
 }
 
+// GET /aiStatus[?id=N] -> that job (default: the newest) plus worker, transport and cache counters
 static void handleAIStatus(AsyncWebServerRequest* r) {
-  StaticJsonDocument<1024> doc;
-  if (g_aiJob.running) {
-    doc["running"] = true;
-    doc["prompt"] = g_aiJob.prompt;
-  } else if (!g_aiJob.done) {
-    doc["idle"] = true;
-  } else {
-    doc["done"] = true;
-    doc["ok"] = g_aiJob.ok;
-    doc["prompt"] = g_aiJob.prompt;
-    doc["applied"] = g_aiJob.appliedSummary;
-    doc["error"] = g_aiJob.error;
-    doc["model_snippet"] = g_aiJob.modelJsonSnippet;
-    doc["canceled"] = g_aiJob.canceled;
-    doc["duration_ms"] = (uint32_t)(millis() - g_aiJob.startedMs);
-  }
+  DynamicJsonDocument doc(2048);
+  if (!AiWorker::writeStatus(doc, jobIdParam(r))) { r->send(404, "application/json", "{\"ok\":false,\"error\":\"unknown job id\"}"); return; }
+  const AiTransport::Stats& ts = AiTransport::stats();
+  JsonObject tr = doc.createNestedObject("transport");
+  tr["open"] = AiTransport::open();
+  tr["idle_ms"] = AiTransport::idleMs();
+  tr["connects"] = ts.connects;
+  tr["reuses"] = ts.reuses;
+  tr["stale_retries"] = ts.staleRetries;
+  tr["idle_closes"] = ts.idleCloses;
+  tr["warmups"] = ts.warmups;
+  const AiCache::Stats& cs = AiCache::stats();
+  JsonObject ca = doc.createNestedObject("cache");
+  ca["entries"] = AiCache::size();
+  ca["hits"] = cs.hits;
+  ca["misses"] = cs.misses;
+  ca["stores"] = cs.stores;
+  ca["evictions"] = cs.evictions;
+  ca["expired"] = cs.expired;
   String out;
   serializeJson(doc, out);
   r->send(200, "application/json", out);
 }
 
+// UI opened the AI panel: have the AI worker get the connection to GEMINI_HOST ready
+static void handleAIWarm(AsyncWebServerRequest* r) {
+  if (WiFi.status() != WL_CONNECTED) { r->send(400, "application/json", "{\"ok\":false,\"error\":\"Not in STA mode\"}"); return; }
+  if (AiTransport::open()) { r->send(200, "application/json", "{\"ok\":true,\"open\":true}"); return; }
+  bool started = AiWorker::warm();
+  r->send(202, "application/json", String("{\"ok\":true,\"open\":false,\"warming\":") + (started ? "true" : "false") + "}");
+}
+
+// /aiCancel[?id=N]: drops a queued job or aborts the running request (default: the newest)
 static void handleAICancel(AsyncWebServerRequest* r) {
-  bool canceled = cancelAIJob();
+  bool canceled = AiWorker::cancel(jobIdParam(r));
   String js = String("{\"ok\":") + (canceled ? "true" : "false") +
               ",\"canceled\":" + (canceled ? "true" : "false") +
-              (canceled ? "" : ",\"error\":\"no running job\"") + "}";
+              (canceled ? "" : ",\"error\":\"no queued or running job\"") + "}";
   r->send(canceled ? 200 : 400, "application/json", js);
 }
 
@@ -383,51 +542,90 @@ static void handlePresence(AsyncWebServerRequest* r) {
   r->send(200, "application/json", js);
 }
 
+// GET /metrics -> Prometheus text, streamed; ?format=json -> compact view
+static void handleMetrics(AsyncWebServerRequest* r) {
+  if (r->hasParam("format") && r->getParam("format")->value() == "json") {
+    DynamicJsonDocument doc(6144);
+    Metrics::writeJson(doc);
+    String out;
+    serializeJson(doc, out);
+    r->send(200, "application/json", out);
+    return;
+  }
+  // the response keeps its own copy of the lambda, and with it the cursor
+  Metrics::PromCursor cur;
+  r->send(r->beginChunkedResponse("text/plain; version=0.0.4", [cur](uint8_t* buf, size_t maxLen, size_t) mutable {
+    return Metrics::promChunk(cur, buf, maxLen);
+  }));
+}
+
 // ---------------- Server bootstrap ----------------
 namespace WebServerWrap {
+// server.on with the handler timed per path (Metrics)
+static void on(AsyncWebServer& server, const char* path, WebRequestMethodComposite method, ArRequestHandlerFunction fn,
+               ArUploadHandlerFunction upload = nullptr, ArBodyHandlerFunction body = nullptr) {
+  server.on(path, method, Metrics::timed(path, fn), upload, body);
+}
+
 void begin(AsyncWebServer& server) {
   enableCORS();
+  PresetStore::begin();
+  AiCache::begin();
 
-  server.on("/", HTTP_GET, [](AsyncWebServerRequest* r) { r->send(FSYS, "/index.html", String(), false); });
-  server.serveStatic("/script.js", FSYS, "/script.js").setCacheControl("max-age=60");
-  server.serveStatic("/bootstrap.min.css", FSYS, "/bootstrap.min.css").setCacheControl("max-age=31536000");
-  server.serveStatic("/bootstrap.bundle.min.js", FSYS, "/bootstrap.bundle.min.js").setCacheControl("max-age=31536000");
+  // UI (gzipped, fingerprinted assets; see tools/build_data.py)
+  WebAssets::begin(server);
 
   // Lamp REST
-  server.on("/setColor", HTTP_GET, handleSetColor);
-  server.on("/setBrightness", HTTP_GET, handleSetBrightness);
-  server.on("/setEffect", HTTP_GET, handleSetEffect);
-  server.on("/toggle", HTTP_GET, handleToggle);
-  server.on("/power", HTTP_GET, handlePower);
-  server.on("/setMode", HTTP_GET, handleSetMode);
-  server.on("/mimirRange", HTTP_GET, handleMimirRange);
-  server.on("/presence", HTTP_GET, handlePresence);
-  server.on("/lux", HTTP_GET, handleLux);
-  server.on("/status", HTTP_GET, handleStatus);
-  server.on("/wifi", HTTP_GET, handleWifi);
-  server.on("/wifiInfo", HTTP_GET, handleWifiInfo);
+  on(server, "/setColor", HTTP_GET, handleSetColor);
+  on(server, "/setBrightness", HTTP_GET, handleSetBrightness);
+  on(server, "/setEffect", HTTP_GET, handleSetEffect);
+  on(server, "/toggle", HTTP_GET, handleToggle);
+  on(server, "/power", HTTP_GET, handlePower);
+  on(server, "/setMode", HTTP_GET, handleSetMode);
+  on(server, "/mimirRange", HTTP_GET, handleMimirRange);
+  on(server, "/mimirCurve", HTTP_GET, handleMimirCurve);
+  on(server, "/presence", HTTP_GET, handlePresence);
+  on(server, "/lux", HTTP_GET, handleLux);
+  on(server, "/status", HTTP_GET, handleStatus);
+  on(server, "/renderStats", HTTP_GET, handleRenderStats);
+  on(server, "/luxStats", HTTP_GET, handleLuxStats);
+  on(server, "/fusion", HTTP_GET, handleFusion);
+  on(server, "/wifi", HTTP_GET, handleWifi);
+  on(server, "/wifiInfo", HTTP_GET, handleWifiInfo);
+  on(server, "/wifiStatus", HTTP_GET, handleWifiStatus);
+  on(server, "/metrics", HTTP_GET, handleMetrics);
+#if ENABLE_BENCH
+  on(server, "/bench", HTTP_GET, handleBench);
+#endif
 
   // PC model integration
-  server.on("/applyPreset", HTTP_POST, [](AsyncWebServerRequest* r) {}, nullptr, handleApplyPreset);
-  server.on("/presets", HTTP_GET, handlePresets);
-  server.on("/logAction", HTTP_POST, [](AsyncWebServerRequest* r) {}, nullptr, handleLogAction);
+  on(server, "/applyPreset", HTTP_POST, handleApplyPreset, nullptr, accumulateBody);
+  on(server, "/applyPreset", HTTP_GET, handleApplyPreset);
+  on(server, "/presets", HTTP_GET, handlePresets);
+  on(server, "/logAction", HTTP_POST, handleLogAction, nullptr, discardBody);
 
   // AI
-  server.on("/aiCommand", HTTP_POST, handleAIStart);
-  server.on("/aiCommand", HTTP_GET, handleAIStart);
-  server.on("/aiStatus", HTTP_GET, handleAIStatus);
-  server.on("/aiCancel", HTTP_POST, handleAICancel);
-  server.on("/aiCancel", HTTP_GET, handleAICancel);
+  on(server, "/aiCommand", HTTP_POST, handleAIStart);
+  on(server, "/aiCommand", HTTP_GET, handleAIStart);
+  on(server, "/aiStatus", HTTP_GET, handleAIStatus);
+  on(server, "/aiWarm", HTTP_POST, handleAIWarm);
+  on(server, "/aiWarm", HTTP_GET, handleAIWarm);
+  on(server, "/aiCancel", HTTP_POST, handleAICancel);
+  on(server, "/aiCancel", HTTP_GET, handleAICancel);
 
 #ifdef HTTP_OPTIONS
-  server.on("/aiCommand", HTTP_OPTIONS, handleOptions);
-  server.on("/aiStatus", HTTP_OPTIONS, handleOptions);
-  server.on("/aiCancel", HTTP_OPTIONS, handleOptions);
-  server.on("/applyPreset", HTTP_OPTIONS, handleOptions);
-  server.on("/logAction", HTTP_OPTIONS, handleOptions);
-  server.on("/presets", HTTP_OPTIONS, handleOptions);
+  on(server, "/aiCommand", HTTP_OPTIONS, handleOptions);
+  on(server, "/aiStatus", HTTP_OPTIONS, handleOptions);
+  on(server, "/aiWarm", HTTP_OPTIONS, handleOptions);
+  on(server, "/aiCancel", HTTP_OPTIONS, handleOptions);
+  on(server, "/applyPreset", HTTP_OPTIONS, handleOptions);
+  on(server, "/logAction", HTTP_OPTIONS, handleOptions);
+  on(server, "/presets", HTTP_OPTIONS, handleOptions);
 #endif
 
+  // Live state push (replaces UI polling)
+  StatePush::begin(server);
+
   server.onNotFound([](AsyncWebServerRequest* r) { r->send(404, "application/json", "{\"error\":\"not found\"}"); });
 
   server.begin();
@@ -4,8 +4,12 @@
 
 // Implemented in SleepLamp_ESP32.ino (only there!)
 String wifiModeString();                         // "AP", "STA", etc.
-void   wifiStartAP();                            // start AP mode (old behavior)
-bool   wifiStartSTA(const String& ssid, const String& pass);
+const char* wifiModeName();                      // same, without a String
+void   wifiStartAP();                            // queue a switch to AP (returns at once)
+bool   wifiStartSTA(const String& ssid, const String& pass);  // queue a switch to STA
+void   wifiBegin(bool sta);                      // boot: start from the saved mode
+void   wifiService(uint32_t nowMs);              // loop(): events, retries, fallback AP
+String wifiStatusJson();                         // GET /wifiStatus
 int    getStaChannel();                          // STA channel (or -1 if unknown)
 
 // -----------------------------------------------------------------------------
@@ -32,4 +36,32 @@ int    getStaChannel();                          // STA channel (or -1 if unknow
 
 #ifndef WIFI_CONNECT_TIMEOUT_MS
   #define WIFI_CONNECT_TIMEOUT_MS 20000UL
-#endif
\ No newline at end of file
+#endif
+
+// Retry backoff after a failed attempt (doubles up to the max)
+#ifndef WIFI_BACKOFF_MIN_MS
+  #define WIFI_BACKOFF_MIN_MS 2000UL
+#endif
+
+#ifndef WIFI_BACKOFF_MAX_MS
+  #define WIFI_BACKOFF_MAX_MS 60000UL
+#endif
+
+// STA down this long -> AP comes up next to it (AP+STA) so the lamp stays reachable
+#ifndef WIFI_FALLBACK_AP_MS
+  #define WIFI_FALLBACK_AP_MS 15000UL
+#endif
+
+// Fallback AP kept this long after STA is back (and while nobody is on it)
+#ifndef WIFI_AP_LINGER_MS
+  #define WIFI_AP_LINGER_MS 60000UL
+#endif
+
+#ifndef WIFI_AP_CHANNEL
+  #define WIFI_AP_CHANNEL 1            // AP-only; with STA up the AP follows the router
+#endif
+
+// Mode switches from /wifi wait this long so the 202 reaches the browser first
+#ifndef WIFI_SWITCH_DELAY_MS
+  #define WIFI_SWITCH_DELAY_MS 300UL
+#endif
@@ -0,0 +1,189 @@
+#pragma once
+// Wi-Fi connection state machine (no Arduino deps, driven by any ms clock).
+// Requests, driver events and ticks go in; a bitmask of actions comes out
+// for the caller to perform with the real Wi-Fi API, so nothing here blocks.
+//
+//   startSta(saved)  connect in the background; a saved (boot) config is
+//                    retried forever with exponential backoff, a new one
+//                    from the UI reverts to AP on its first failure
+//   startAp          AP only
+//
+// While STA is wanted but not connected for fallbackApMs, the AP is brought
+// up next to it (AP+STA, no teardown) so the lamp stays reachable; once STA
+// is back and nobody uses the AP for apLingerMs, it is taken down again.
+
+#include <stdint.h>
+
+namespace WifiSm {
+
+enum State : uint8_t { S_AP = 0, S_CONNECTING, S_CONNECTED, S_WAIT_RETRY };
+
+enum Result : uint8_t { R_NONE = 0, R_PENDING, R_OK, R_FAILED };
+
+enum Action : uint8_t {
+  A_AP_UP = 1 << 0,
+  A_AP_DOWN = 1 << 1,
+  A_STA_BEGIN = 1 << 2,  // start one connection attempt
+  A_STA_STOP = 1 << 3,
+  A_SAVE = 1 << 4,       // persist the mode (and STA credentials) now in effect
+  A_MDNS = 1 << 5,       // hostname changes with the mode
+};
+
+struct Config {
+  uint32_t connectTimeoutMs;  // one attempt
+  uint32_t backoffMinMs;      // between attempts, doubling...
+  uint32_t backoffMaxMs;      // ...up to this
+  uint32_t fallbackApMs;      // STA down this long -> AP comes up too
+  uint32_t apLingerMs;        // AP kept after STA is back (while unused)
+};
+
+// Disconnects this soon after starting an attempt are leftovers of the previous one
+static const uint32_t kSettleMs = 250;
+
+inline const char* stateName(uint8_t s) {
+  switch (s) {
+    case S_AP: return "ap";
+    case S_CONNECTING: return "connecting";
+    case S_CONNECTED: return "connected";
+    case S_WAIT_RETRY: return "wait_retry";
+    default: return "?";
+  }
+}
+
+inline const char* resultName(uint8_t r) {
+  switch (r) {
+    case R_PENDING: return "pending";
+    case R_OK: return "ok";
+    case R_FAILED: return "failed";
+    default: return "none";
+  }
+}
+
+class Machine {
+ public:
+  explicit Machine(const Config& c) : cfg_(c) {}
+
+  uint8_t startAp(uint32_t nowMs, bool save) {
+    (void)nowMs;
+    uint8_t a = A_MDNS | (save ? A_SAVE : 0);
+    if (staWanted_) a |= A_STA_STOP;
+    if (!apUp_) a |= A_AP_UP;
+    staWanted_ = false;
+    apUp_ = true;
+    state_ = S_AP;
+    result_ = R_OK;
+    attempts_ = 0;
+    return a;
+  }
+
+  uint8_t startSta(uint32_t nowMs, bool saved) {
+    uint8_t a = staWanted_ ? A_STA_STOP : 0;  // drop the attempt for the old network
+    staWanted_ = true;
+    saved_ = saved;
+    result_ = R_PENDING;
+    attempts_ = 0;
+    backoffMs_ = 0;
+    lastReason_ = 0;
+    downSinceMs_ = nowMs;
+    return a | begin(nowMs);
+  }
+
+  uint8_t onGotIp(uint32_t nowMs) {
+    if (!staWanted_) return 0;
+    uint8_t a = A_MDNS;
+    state_ = S_CONNECTED;
+    connectedMs_ = nowMs;
+    attempts_ = 0;
+    backoffMs_ = 0;
+    if (result_ == R_PENDING) {
+      result_ = R_OK;
+      if (!saved_) {
+        saved_ = true;
+        a |= A_SAVE;
+      }
+    }
+    return a;
+  }
+
+  uint8_t onDisconnected(uint32_t nowMs, uint8_t reason) {
+    if (!staWanted_) return 0;
+    if (state_ == S_CONNECTED) {
+      lastReason_ = reason;
+      downSinceMs_ = nowMs;
+      return begin(nowMs);  // reconnect right away once, back off after that
+    }
+    if (state_ != S_CONNECTING || nowMs - attemptMs_ < kSettleMs) return 0;
+    lastReason_ = reason;
+    return fail(nowMs);
+  }
+
+  uint8_t tick(uint32_t nowMs, uint8_t apClients) {
+    uint8_t a = 0;
+    if (state_ == S_CONNECTING && nowMs - attemptMs_ >= cfg_.connectTimeoutMs) {
+      a |= fail(nowMs);
+    } else if (state_ == S_WAIT_RETRY && (int32_t)(nowMs - retryAtMs_) >= 0) {
+      a |= begin(nowMs);
+    }
+    if (staWanted_ && state_ != S_CONNECTED && !apUp_ && nowMs - downSinceMs_ >= cfg_.fallbackApMs) {
+      apUp_ = true;
+      a |= A_AP_UP | A_MDNS;
+    }
+    if (staWanted_ && state_ == S_CONNECTED && apUp_ && apClients == 0 && nowMs - connectedMs_ >= cfg_.apLingerMs) {
+      apUp_ = false;
+      a |= A_AP_DOWN;
+    }
+    return a;
+  }
+
+  State state() const { return state_; }
+  Result result() const { return result_; }
+  bool apUp() const { return apUp_; }
+  bool staWanted() const { return staWanted_; }
+  uint16_t attempts() const { return attempts_; }
+  uint8_t lastReason() const { return lastReason_; }
+  uint32_t retryInMs(uint32_t nowMs) const {
+    return state_ == S_WAIT_RETRY && (int32_t)(retryAtMs_ - nowMs) > 0 ? retryAtMs_ - nowMs : 0;
+  }
+
+ private:
+  Config cfg_;
+  State state_ = S_AP;
+  Result result_ = R_NONE;
+  bool apUp_ = false;
+  bool staWanted_ = false;
+  bool saved_ = false;
+  uint16_t attempts_ = 0;
+  uint8_t lastReason_ = 0;
+  uint32_t attemptMs_ = 0;
+  uint32_t retryAtMs_ = 0;
+  uint32_t backoffMs_ = 0;
+  uint32_t connectedMs_ = 0;
+  uint32_t downSinceMs_ = 0;
+
+  uint8_t begin(uint32_t nowMs) {
+    state_ = S_CONNECTING;
+    attemptMs_ = nowMs;
+    attempts_++;
+    return A_STA_BEGIN;
+  }
+
+  uint8_t fail(uint32_t nowMs) {
+    if (result_ == R_PENDING && !saved_) {
+      // new credentials from the UI did not work: back to AP, nothing saved
+      result_ = R_FAILED;
+      staWanted_ = false;
+      state_ = S_AP;
+      uint8_t a = A_STA_STOP | A_MDNS;
+      if (!apUp_) a |= A_AP_UP;
+      apUp_ = true;
+      return a;
+    }
+    backoffMs_ = backoffMs_ ? backoffMs_ * 2 : cfg_.backoffMinMs;
+    if (backoffMs_ > cfg_.backoffMaxMs) backoffMs_ = cfg_.backoffMaxMs;
+    retryAtMs_ = nowMs + backoffMs_;
+    state_ = S_WAIT_RETRY;
+    return A_STA_STOP;
+  }
+};
+
+}
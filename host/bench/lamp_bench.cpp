@@ -0,0 +1,135 @@
+// lamp_bench: the /bench cases (bench.h) on the host, printing the same JSON
+// document the lamp serves, so tools/bench.py --exe can record and compare
+// it like a device run.
+//
+// The C allocator is interposed (glibc's __libc_* entry points): every
+// malloc/calloc/realloc/aligned allocation is counted, operator new
+// included, and frees know their size, so each case also reports its
+// transient allocations and peak heap. Host ns/op only compare with runs on
+// the same machine; allocation counts and peaks are machine-independent,
+// which is what the checked-in baseline.json pins down. Cases that go
+// through ArduinoJson count the stand-in's allocations, which are not the
+// library's (one pool per document): there the numbers guard against
+// regressions rather than describe the lamp.
+//
+// Usage: lamp_bench [--name <substring>] [--iters <n>]
+
+#define BENCH_ALLOC_HOOKS 1
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "sketch_host.h"
+
+extern "C" {
+void* __libc_malloc(size_t n);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* p, size_t n);
+void* __libc_memalign(size_t align, size_t n);
+void __libc_free(void* p);
+}
+
+namespace HostAlloc {
+
+static void onAlloc(void* p) {
+  size_t n = malloc_usable_size(p);
+  HostHeap::liveBytes().fetch_add((int64_t)n, std::memory_order_relaxed);
+  HostHeap::liveBlocks().fetch_add(1, std::memory_order_relaxed);
+  Bench::noteAlloc(n);
+}
+
+static void onFree(void* p) {
+  size_t n = malloc_usable_size(p);
+  HostHeap::liveBytes().fetch_sub((int64_t)n, std::memory_order_relaxed);
+  HostHeap::liveBlocks().fetch_sub(1, std::memory_order_relaxed);
+  Bench::noteFree(n);
+}
+
+static void* track(void* p) {
+  if (p) onAlloc(p);
+  return p;
+}
+
+}
+
+extern "C" {
+
+void* malloc(size_t n) noexcept {
+  return HostAlloc::track(__libc_malloc(n));
+}
+
+void* calloc(size_t n, size_t size) noexcept {
+  return HostAlloc::track(__libc_calloc(n, size));
+}
+
+void* realloc(void* p, size_t n) noexcept {
+  if (!p) return malloc(n);
+  size_t old = malloc_usable_size(p);
+  HostAlloc::onFree(p);
+  void* q = __libc_realloc(p, n);
+  if (q) {
+    HostAlloc::onAlloc(q);
+  } else if (n) {
+    // failed: p is still ours
+    HostHeap::liveBytes().fetch_add((int64_t)old, std::memory_order_relaxed);
+    HostHeap::liveBlocks().fetch_add(1, std::memory_order_relaxed);
+    Bench::s_liveBytes.fetch_add((int32_t)old, std::memory_order_relaxed);
+  }
+  return q;
+}
+
+void* memalign(size_t align, size_t n) noexcept {
+  return HostAlloc::track(__libc_memalign(align, n));
+}
+
+void* aligned_alloc(size_t align, size_t n) noexcept {
+  return HostAlloc::track(__libc_memalign(align, n));
+}
+
+int posix_memalign(void** out, size_t align, size_t n) noexcept {
+  void* p = HostAlloc::track(__libc_memalign(align, n));
+  if (!p) return ENOMEM;
+  *out = p;
+  return 0;
+}
+
+void free(void* p) noexcept {
+  if (!p) return;
+  HostAlloc::onFree(p);
+  __libc_free(p);
+}
+
+}
+
+int main(int argc, char** argv) {
+  const char* name = "";
+  uint32_t iters = 0;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--name")) name = argv[i + 1];
+    else if (!strcmp(argv[i], "--iters")) iters = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+    else {
+      fprintf(stderr, "usage: lamp_bench [--name <substring>] [--iters <n>]\n");
+      return 2;
+    }
+  }
+  if (argc % 2 == 0) {
+    fprintf(stderr, "usage: lamp_bench [--name <substring>] [--iters <n>]\n");
+    return 2;
+  }
+
+  // what setup() does before the web server (and /bench) is up
+  LedControl::init();
+  LedControl::setOn(true);
+  LedControl::setTargetBrightness(128);
+  Bench::s_sizedFrees = true;
+
+  static Bench::Result res[16];
+  size_t n = Bench::runAll(name, iters, res, sizeof(res) / sizeof(res[0]));
+  DynamicJsonDocument doc(3072);
+  Bench::toJson(res, n, doc);
+  String out;
+  serializeJson(doc, out);
+  printf("%s\n", out.c_str());
+  return n ? 0 : 1;
+}
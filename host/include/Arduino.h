@@ -0,0 +1,89 @@
+#pragma once
+// Host stand-in for the ESP32 Arduino core: String, Serial, the simulated
+// clock (host_clock.h) and no-op pin I/O. Enough for the firmware headers
+// that only need the core for time, logging and locking.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "WString.h"
+#include "host_clock.h"
+#include "freertos/FreeRTOS.h"
+
+#define IRAM_ATTR
+#define PROGMEM
+#define F(s) ((const __FlashStringHelper*)(s))
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+
+// 32-bit like the ESP32's, so wrap-around maths behaves the same
+inline uint32_t millis() { return (uint32_t)(HostClock::us() / 1000); }
+inline uint32_t micros() { return (uint32_t)HostClock::us(); }
+inline void delay(uint32_t ms) { HostClock::advanceMs(ms); }
+inline void delayMicroseconds(uint32_t us) { HostClock::advanceUs(us); }
+inline void yield() {}
+
+inline void vTaskDelay(TickType_t ticks) { HostClock::advanceMs(ticks * portTICK_PERIOD_MS); }
+inline void vTaskDelayUntil(TickType_t* prev, TickType_t inc) {
+  *prev += inc;
+  uint64_t at = (uint64_t)*prev * portTICK_PERIOD_MS * 1000;
+  if (at > HostClock::us()) HostClock::set(at);
+}
+inline TickType_t xTaskGetTickCount() { return (TickType_t)(HostClock::us() / (portTICK_PERIOD_MS * 1000)); }
+
+inline uint32_t getCpuFrequencyMhz() { return 240; }
+
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+inline size_t strlcpy(char* dst, const char* src, size_t size) {
+  size_t n = strlen(src);
+  if (size) {
+    size_t k = n < size - 1 ? n : size - 1;
+    memcpy(dst, src, k);
+    dst[k] = '\0';
+  }
+  return n;
+}
+#endif
+
+// Logging goes to stderr so simulator output on stdout stays clean
+class HardwareSerial {
+ public:
+  void begin(unsigned long) {}
+  explicit operator bool() const { return true; }
+  size_t print(const String& s) { return fputs(s.c_str(), stderr) < 0 ? 0 : s.length(); }
+  size_t print(const char* s) { return fputs(s, stderr) < 0 ? 0 : strlen(s); }
+  template <typename T>
+  size_t print(T v) { return print(String(v)); }
+  size_t println() { return print("\n"); }
+  template <typename T>
+  size_t println(T v) { return print(v) + println(); }
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    return n < 0 ? 0 : (size_t)n;
+  }
+};
+
+inline HardwareSerial& hostSerial() {
+  static HardwareSerial s;
+  return s;
+}
+#define Serial hostSerial()
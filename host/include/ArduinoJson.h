@@ -0,0 +1,925 @@
+#pragma once
+// Host stand-in for the slice of ArduinoJson 6 the firmware uses:
+// documents, objects, arrays, `variant | default`, is<T>/as<T>, filters,
+// nesting limits and serializeJson. Semantics follow the library where the
+// firmware depends on them (is<int>() is false for strings and floats, a
+// filter drops keys it does not list, parsing stops after the first value).
+// Memory is charged like ArduinoJson on a 32-bit MCU, 16 bytes per value
+// plus every copied string, so a document overflows (NoMemory) at about
+// the same size as on the lamp.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "WString.h"
+
+#ifndef ARDUINOJSON_DEFAULT_NESTING_LIMIT
+#define ARDUINOJSON_DEFAULT_NESTING_LIMIT 10
+#endif
+
+namespace ArduinoJsonHost {
+
+struct Node {
+  enum Kind : uint8_t { NUL, BOOL, INT, FLOAT, STR, ARR, OBJ };
+  Kind kind = NUL;
+  bool b = false;
+  int64_t i = 0;
+  double f = 0;
+  std::string s;
+  std::vector<std::string> keys;  // OBJ: keys[k] names items[k]
+  std::vector<Node*> items;       // ARR and OBJ children
+};
+
+static const size_t kSlotSize = 16;
+
+struct Pool {
+  size_t capacity;
+  size_t used = 0;
+  bool overflowed = false;
+  std::deque<Node> nodes;
+
+  explicit Pool(size_t cap) : capacity(cap) {}
+  bool charge(size_t n) {
+    if (used + n > capacity) { overflowed = true; return false; }
+    used += n;
+    return true;
+  }
+  Node* node() {
+    if (!charge(kSlotSize)) return nullptr;
+    nodes.emplace_back();
+    return &nodes.back();
+  }
+  void clear() {
+    used = 0;
+    overflowed = false;
+    nodes.clear();
+  }
+};
+
+inline const Node* member(const Node* n, const char* key) {
+  if (!n || n->kind != Node::OBJ || !key) return nullptr;
+  for (size_t k = 0; k < n->keys.size(); ++k) {
+    if (n->keys[k] == key) return n->items[k];
+  }
+  return nullptr;
+}
+
+inline const Node* element(const Node* n, size_t i) {
+  return n && n->kind == Node::ARR && i < n->items.size() ? n->items[i] : nullptr;
+}
+
+inline void reset(Node* n, Node::Kind k) {
+  n->kind = k;
+  n->s.clear();
+  n->keys.clear();
+  n->items.clear();
+}
+
+// ---- serializer ----
+
+inline void writeString(std::string& out, const std::string& s) {
+  out += '"';
+  for (unsigned char c : s) {
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\b': out += "\\b"; break;
+      case '\f': out += "\\f"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if (c < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", c);
+          out += buf;
+        } else {
+          out += (char)c;
+        }
+    }
+  }
+  out += '"';
+}
+
+inline void write(std::string& out, const Node* n) {
+  char buf[32];
+  if (!n) { out += "null"; return; }
+  switch (n->kind) {
+    case Node::NUL: out += "null"; break;
+    case Node::BOOL: out += n->b ? "true" : "false"; break;
+    case Node::INT: snprintf(buf, sizeof(buf), "%lld", (long long)n->i); out += buf; break;
+    case Node::FLOAT: snprintf(buf, sizeof(buf), "%.9g", n->f); out += buf; break;
+    case Node::STR: writeString(out, n->s); break;
+    case Node::ARR:
+      out += '[';
+      for (size_t k = 0; k < n->items.size(); ++k) {
+        if (k) out += ',';
+        write(out, n->items[k]);
+      }
+      out += ']';
+      break;
+    case Node::OBJ:
+      out += '{';
+      for (size_t k = 0; k < n->items.size(); ++k) {
+        if (k) out += ',';
+        writeString(out, n->keys[k]);
+        out += ':';
+        write(out, n->items[k]);
+      }
+      out += '}';
+      break;
+  }
+}
+
+template <typename T, typename Enable = void>
+struct Conv;
+
+}  // namespace ArduinoJsonHost
+
+class JsonVariantConst;
+class JsonObjectConst;
+class JsonArrayConst;
+
+class JsonVariantConst {
+ public:
+  JsonVariantConst() {}
+  explicit JsonVariantConst(const ArduinoJsonHost::Node* n) : node_(n) {}
+
+  bool isNull() const { return !node_ || node_->kind == ArduinoJsonHost::Node::NUL; }
+  template <typename T>
+  bool is() const { return ArduinoJsonHost::Conv<T>::is(node_); }
+  template <typename T>
+  T as() const { return ArduinoJsonHost::Conv<T>::as(node_); }
+  template <typename T>
+  operator T() const { return as<T>(); }
+
+  JsonVariantConst operator[](const char* key) const { return JsonVariantConst(ArduinoJsonHost::member(node_, key)); }
+  JsonVariantConst operator[](const String& key) const { return (*this)[key.c_str()]; }
+  JsonVariantConst operator[](int i) const { return JsonVariantConst(ArduinoJsonHost::element(node_, (size_t)i)); }
+  bool containsKey(const char* key) const { return ArduinoJsonHost::member(node_, key) != nullptr; }
+  size_t size() const { return node_ && node_->kind >= ArduinoJsonHost::Node::ARR ? node_->items.size() : 0; }
+
+  const ArduinoJsonHost::Node* node() const { return node_; }
+
+ private:
+  const ArduinoJsonHost::Node* node_ = nullptr;
+};
+
+// `variant | default`: the value if it has the default's type, else the default
+template <typename T>
+typename std::enable_if<std::is_arithmetic<T>::value, T>::type operator|(const JsonVariantConst& v, const T& dflt) {
+  return v.is<T>() ? v.as<T>() : dflt;
+}
+inline const char* operator|(const JsonVariantConst& v, const char* dflt) {
+  return v.is<const char*>() ? v.as<const char*>() : dflt;
+}
+
+class JsonObjectConst {
+ public:
+  JsonObjectConst() {}
+  explicit JsonObjectConst(const ArduinoJsonHost::Node* n) : node_(n) {}
+
+  bool isNull() const { return !node_; }
+  JsonVariantConst operator[](const char* key) const { return JsonVariantConst(ArduinoJsonHost::member(node_, key)); }
+  JsonVariantConst operator[](const String& key) const { return (*this)[key.c_str()]; }
+  bool containsKey(const char* key) const { return ArduinoJsonHost::member(node_, key) != nullptr; }
+  size_t size() const { return node_ ? node_->items.size() : 0; }
+  const ArduinoJsonHost::Node* node() const { return node_; }
+
+ private:
+  const ArduinoJsonHost::Node* node_ = nullptr;
+};
+
+class JsonArrayConst {
+ public:
+  class iterator {
+   public:
+    iterator(const ArduinoJsonHost::Node* const* p) : p_(p) {}
+    JsonVariantConst operator*() const { return JsonVariantConst(*p_); }
+    iterator& operator++() { ++p_; return *this; }
+    bool operator!=(const iterator& o) const { return p_ != o.p_; }
+
+   private:
+    const ArduinoJsonHost::Node* const* p_;
+  };
+
+  JsonArrayConst() {}
+  explicit JsonArrayConst(const ArduinoJsonHost::Node* n) : node_(n) {}
+
+  bool isNull() const { return !node_; }
+  size_t size() const { return node_ ? node_->items.size() : 0; }
+  JsonVariantConst operator[](size_t i) const { return JsonVariantConst(ArduinoJsonHost::element(node_, i)); }
+  iterator begin() const { return iterator(node_ && !node_->items.empty() ? &node_->items[0] : nullptr); }
+  iterator end() const { return iterator(node_ && !node_->items.empty() ? &node_->items[0] + node_->items.size() : nullptr); }
+  const ArduinoJsonHost::Node* node() const { return node_; }
+
+ private:
+  const ArduinoJsonHost::Node* node_ = nullptr;
+};
+
+class JsonObject;
+class JsonArray;
+
+// Writable value. As a member proxy (obj["key"]) it only creates the
+// member when something is written to it.
+class JsonVariant {
+ public:
+  JsonVariant() {}
+  JsonVariant(ArduinoJsonHost::Pool* pool, ArduinoJsonHost::Node* n) : pool_(pool), node_(n) {}
+  JsonVariant(ArduinoJsonHost::Pool* pool, ArduinoJsonHost::Node* parent, const char* key)
+    : pool_(pool), parent_(parent), key_(key ? key : "") {
+    node_ = const_cast<ArduinoJsonHost::Node*>(ArduinoJsonHost::member(parent, key));
+  }
+
+  operator JsonVariantConst() const { return JsonVariantConst(node_); }
+  bool isNull() const { return JsonVariantConst(node_).isNull(); }
+  template <typename T>
+  bool is() const { return JsonVariantConst(node_).is<T>(); }
+  template <typename T>
+  typename std::enable_if<!std::is_same<T, JsonObject>::value && !std::is_same<T, JsonArray>::value, T>::type as() const {
+    return JsonVariantConst(node_).as<T>();
+  }
+  template <typename T>
+  typename std::enable_if<std::is_same<T, JsonObject>::value || std::is_same<T, JsonArray>::value, T>::type as() const;
+  template <typename T>
+  T to();
+
+  template <typename T>
+  typename std::enable_if<std::is_arithmetic<T>::value, JsonVariant&>::type operator=(T v) {
+    ArduinoJsonHost::Node* n = resolve();
+    if (!n) return *this;
+    if (std::is_same<T, bool>::value) {
+      ArduinoJsonHost::reset(n, ArduinoJsonHost::Node::BOOL);
+      n->b = v != 0;
+    } else if (std::is_floating_point<T>::value) {
+      ArduinoJsonHost::reset(n, ArduinoJsonHost::Node::FLOAT);
+      n->f = (double)v;
+    } else {
+      ArduinoJsonHost::reset(n, ArduinoJsonHost::Node::INT);
+      n->i = (int64_t)v;
+    }
+    return *this;
+  }
+  JsonVariant& operator=(const char* s) {
+    ArduinoJsonHost::Node* n = resolve();
+    if (!n) return *this;
+    if (!s) { ArduinoJsonHost::reset(n, ArduinoJsonHost::Node::NUL); return *this; }
+    if (!pool_->charge(strlen(s) + 1)) return *this;
+    ArduinoJsonHost::reset(n, ArduinoJsonHost::Node::STR);
+    n->s = s;
+    return *this;
+  }
+  JsonVariant& operator=(char* s) { return *this = (const char*)s; }
+  JsonVariant& operator=(const String& s) { return *this = s.c_str(); }
+  JsonVariant& operator=(const JsonVariant& o) { return *this = JsonVariantConst(o.node_); }
+  JsonVariant& operator=(JsonVariantConst src) {
+    ArduinoJsonHost::Node* n = resolve();
+    if (n) copy(n, src.node());
+    return *this;
+  }
+
+  JsonVariant operator[](const char* key) {
+    ArduinoJsonHost::Node* n = node_ && node_->kind == ArduinoJsonHost::Node::OBJ ? node_ : resolve();
+    return JsonVariant(pool_, n, key);
+  }
+  JsonVariant operator[](const String& key) { return (*this)[key.c_str()]; }
+  JsonVariantConst operator[](const char* key) const { return JsonVariantConst(node_)[key]; }
+
+  JsonObject createNestedObject();
+  JsonArray createNestedArray();
+  JsonObject createNestedObject(const char* key);
+  JsonArray createNestedArray(const char* key);
+  bool add(JsonVariantConst v);
+  size_t size() const { return JsonVariantConst(node_).size(); }
+
+ private:
+  ArduinoJsonHost::Pool* pool_ = nullptr;
+  ArduinoJsonHost::Node* node_ = nullptr;
+  ArduinoJsonHost::Node* parent_ = nullptr;
+  std::string key_;
+
+  ArduinoJsonHost::Node* resolve() {
+    if (node_ || !parent_ || !pool_) return node_;
+    if (parent_->kind == ArduinoJsonHost::Node::NUL) ArduinoJsonHost::reset(parent_, ArduinoJsonHost::Node::OBJ);
+    if (parent_->kind != ArduinoJsonHost::Node::OBJ || !pool_->charge(key_.size() + 1)) return nullptr;
+    ArduinoJsonHost::Node* n = pool_->node();
+    if (!n) return nullptr;
+    parent_->keys.push_back(key_);
+    parent_->items.push_back(n);
+    node_ = n;
+    return n;
+  }
+
+  bool copy(ArduinoJsonHost::Node* dst, const ArduinoJsonHost::Node* src) {
+    if (!src) { ArduinoJsonHost::reset(dst, ArduinoJsonHost::Node::NUL); return true; }
+    if (src->kind == ArduinoJsonHost::Node::STR && !pool_->charge(src->s.size() + 1)) return false;
+    ArduinoJsonHost::reset(dst, src->kind);
+    dst->b = src->b;
+    dst->i = src->i;
+    dst->f = src->f;
+    dst->s = src->s;
+    for (size_t k = 0; k < src->items.size(); ++k) {
+      if (src->kind == ArduinoJsonHost::Node::OBJ && !pool_->charge(src->keys[k].size() + 1)) return false;
+      ArduinoJsonHost::Node* c = pool_->node();
+      if (!c || !copy(c, src->items[k])) return false;
+      if (src->kind == ArduinoJsonHost::Node::OBJ) dst->keys.push_back(src->keys[k]);
+      dst->items.push_back(c);
+    }
+    return true;
+  }
+
+  friend class JsonArray;
+};
+
+class JsonObject {
+ public:
+  JsonObject() {}
+  JsonObject(ArduinoJsonHost::Pool* pool, ArduinoJsonHost::Node* n) : pool_(pool), node_(n) {}
+
+  operator JsonObjectConst() const { return JsonObjectConst(node_); }
+  operator JsonVariantConst() const { return JsonVariantConst(node_); }
+  bool isNull() const { return !node_; }
+  JsonVariant operator[](const char* key) const { return JsonVariant(pool_, node_, key); }
+  JsonVariant operator[](const String& key) const { return (*this)[key.c_str()]; }
+  bool containsKey(const char* key) const { return ArduinoJsonHost::member(node_, key) != nullptr; }
+  size_t size() const { return node_ ? node_->items.size() : 0; }
+  JsonObject createNestedObject(const char* key) const { return (*this)[key].to<JsonObject>(); }
+  JsonArray createNestedArray(const char* key) const;
+
+ private:
+  ArduinoJsonHost::Pool* pool_ = nullptr;
+  ArduinoJsonHost::Node* node_ = nullptr;
+};
+
+class JsonArray {
+ public:
+  JsonArray() {}
+  JsonArray(ArduinoJsonHost::Pool* pool, ArduinoJsonHost::Node* n) : pool_(pool), node_(n) {}
+
+  operator JsonArrayConst() const { return JsonArrayConst(node_); }
+  operator JsonVariantConst() const { return JsonVariantConst(node_); }
+  bool isNull() const { return !node_; }
+  size_t size() const { return node_ ? node_->items.size() : 0; }
+  JsonVariant operator[](size_t i) const {
+    return JsonVariant(pool_, const_cast<ArduinoJsonHost::Node*>(ArduinoJsonHost::element(node_, i)));
+  }
+  JsonArrayConst::iterator begin() const { return JsonArrayConst(node_).begin(); }
+  JsonArrayConst::iterator end() const { return JsonArrayConst(node_).end(); }
+
+  JsonVariant add() const {
+    if (!node_) return JsonVariant();
+    ArduinoJsonHost::Node* n = pool_->node();
+    if (!n) return JsonVariant();
+    node_->items.push_back(n);
+    return JsonVariant(pool_, n);
+  }
+  template <typename T>
+  bool add(const T& v) const {
+    JsonVariant e = add();
+    if (e.node_ == nullptr) return false;
+    e = v;
+    return true;
+  }
+  JsonObject createNestedObject() const { return add().to<JsonObject>(); }
+  JsonArray createNestedArray() const { return add().to<JsonArray>(); }
+
+ private:
+  ArduinoJsonHost::Pool* pool_ = nullptr;
+  ArduinoJsonHost::Node* node_ = nullptr;
+};
+
+template <typename T>
+T JsonVariant::to() {
+  ArduinoJsonHost::Node* n = resolve();
+  if (!n) return T();
+  ArduinoJsonHost::reset(n, std::is_same<T, JsonObject>::value ? ArduinoJsonHost::Node::OBJ : ArduinoJsonHost::Node::ARR);
+  return T(pool_, n);
+}
+
+template <typename T>
+typename std::enable_if<std::is_same<T, JsonObject>::value || std::is_same<T, JsonArray>::value, T>::type JsonVariant::as() const {
+  ArduinoJsonHost::Node::Kind k = std::is_same<T, JsonObject>::value ? ArduinoJsonHost::Node::OBJ : ArduinoJsonHost::Node::ARR;
+  return node_ && node_->kind == k ? T(pool_, node_) : T();
+}
+
+inline JsonObject JsonVariant::createNestedObject() {
+  ArduinoJsonHost::Node* n = resolve();
+  if (!n) return JsonObject();
+  if (n->kind == ArduinoJsonHost::Node::NUL) ArduinoJsonHost::reset(n, ArduinoJsonHost::Node::ARR);
+  return n->kind == ArduinoJsonHost::Node::ARR ? JsonArray(pool_, n).createNestedObject() : JsonObject();
+}
+inline JsonArray JsonVariant::createNestedArray() {
+  ArduinoJsonHost::Node* n = resolve();
+  if (!n) return JsonArray();
+  if (n->kind == ArduinoJsonHost::Node::NUL) ArduinoJsonHost::reset(n, ArduinoJsonHost::Node::ARR);
+  return n->kind == ArduinoJsonHost::Node::ARR ? JsonArray(pool_, n).createNestedArray() : JsonArray();
+}
+inline JsonObject JsonVariant::createNestedObject(const char* key) { return (*this)[key].to<JsonObject>(); }
+inline JsonArray JsonVariant::createNestedArray(const char* key) { return (*this)[key].to<JsonArray>(); }
+inline bool JsonVariant::add(JsonVariantConst v) {
+  ArduinoJsonHost::Node* n = resolve();
+  if (!n) return false;
+  if (n->kind == ArduinoJsonHost::Node::NUL) ArduinoJsonHost::reset(n, ArduinoJsonHost::Node::ARR);
+  return n->kind == ArduinoJsonHost::Node::ARR && JsonArray(pool_, n).add(v);
+}
+inline JsonArray JsonObject::createNestedArray(const char* key) const { return (*this)[key].to<JsonArray>(); }
+
+class JsonDocument {
+ public:
+  JsonDocument(const JsonDocument&) = delete;
+  JsonDocument& operator=(const JsonDocument&) = delete;
+
+  JsonVariant operator[](const char* key) { return JsonVariant(&pool_, &root_, key); }
+  JsonVariant operator[](const String& key) { return (*this)[key.c_str()]; }
+  JsonVariantConst operator[](const char* key) const { return JsonVariantConst(&root_)[key]; }
+  JsonVariantConst operator[](const String& key) const { return (*this)[key.c_str()]; }
+  operator JsonVariantConst() const { return JsonVariantConst(&root_); }
+
+  template <typename T>
+  T as() const { return JsonVariantConst(&root_).as<T>(); }
+  template <typename T>
+  bool is() const { return JsonVariantConst(&root_).is<T>(); }
+  template <typename T>
+  T to() {
+    clear();
+    return JsonVariant(&pool_, &root_).to<T>();
+  }
+  bool isNull() const { return root_.kind == ArduinoJsonHost::Node::NUL; }
+  bool containsKey(const char* key) const { return ArduinoJsonHost::member(&root_, key) != nullptr; }
+
+  JsonObject createNestedObject(const char* key) { return (*this)[key].to<JsonObject>(); }
+  JsonArray createNestedArray(const char* key) { return (*this)[key].to<JsonArray>(); }
+  JsonObject createNestedObject() { return JsonVariant(&pool_, &root_).createNestedObject(); }
+  JsonArray createNestedArray() { return JsonVariant(&pool_, &root_).createNestedArray(); }
+
+  void clear() {
+    pool_.clear();
+    ArduinoJsonHost::reset(&root_, ArduinoJsonHost::Node::NUL);
+  }
+  size_t capacity() const { return pool_.capacity; }
+  size_t memoryUsage() const { return pool_.used; }
+  bool overflowed() const { return pool_.overflowed; }
+
+  ArduinoJsonHost::Pool& pool() { return pool_; }
+  ArduinoJsonHost::Node& root() { return root_; }
+  const ArduinoJsonHost::Node& root() const { return root_; }
+
+ protected:
+  explicit JsonDocument(size_t cap) : pool_(cap) {}
+
+ private:
+  ArduinoJsonHost::Pool pool_;
+  ArduinoJsonHost::Node root_;
+};
+
+template <size_t N>
+class StaticJsonDocument : public JsonDocument {
+ public:
+  StaticJsonDocument() : JsonDocument(N) {}
+};
+
+class DynamicJsonDocument : public JsonDocument {
+ public:
+  explicit DynamicJsonDocument(size_t cap) : JsonDocument(cap) {}
+};
+
+namespace ArduinoJsonHost {
+
+template <typename T>
+struct Conv<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+  static bool is(const Node* n) {
+    if (!n || n->kind != Node::INT) return false;
+    if (std::is_signed<T>::value) {
+      return n->i >= (int64_t)std::numeric_limits<T>::min() && n->i <= (int64_t)std::numeric_limits<T>::max();
+    }
+    return n->i >= 0 && (uint64_t)n->i <= (uint64_t)std::numeric_limits<T>::max();
+  }
+  static T as(const Node* n) {
+    if (!n) return 0;
+    switch (n->kind) {
+      case Node::INT: return (T)n->i;
+      case Node::FLOAT: return (T)n->f;
+      case Node::BOOL: return (T)n->b;
+      case Node::STR: return (T)strtoll(n->s.c_str(), nullptr, 10);
+      default: return 0;
+    }
+  }
+};
+
+template <typename T>
+struct Conv<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+  static bool is(const Node* n) { return n && (n->kind == Node::INT || n->kind == Node::FLOAT); }
+  static T as(const Node* n) {
+    if (!n) return 0;
+    switch (n->kind) {
+      case Node::INT: return (T)n->i;
+      case Node::FLOAT: return (T)n->f;
+      case Node::BOOL: return (T)n->b;
+      case Node::STR: return (T)strtod(n->s.c_str(), nullptr);
+      default: return 0;
+    }
+  }
+};
+
+template <>
+struct Conv<bool> {
+  static bool is(const Node* n) { return n && n->kind == Node::BOOL; }
+  static bool as(const Node* n) {
+    if (!n) return false;
+    switch (n->kind) {
+      case Node::BOOL: return n->b;
+      case Node::INT: return n->i != 0;
+      case Node::FLOAT: return n->f != 0;
+      default: return false;
+    }
+  }
+};
+
+template <>
+struct Conv<const char*> {
+  static bool is(const Node* n) { return n && n->kind == Node::STR; }
+  static const char* as(const Node* n) { return is(n) ? n->s.c_str() : nullptr; }
+};
+
+template <>
+struct Conv<String> {
+  static bool is(const Node* n) { return n && n->kind == Node::STR; }
+  static String as(const Node* n) {
+    if (is(n)) return String(n->s.c_str());
+    std::string out;
+    write(out, n);
+    return String(out.c_str());
+  }
+};
+
+template <>
+struct Conv<JsonVariantConst> {
+  static bool is(const Node*) { return true; }
+  static JsonVariantConst as(const Node* n) { return JsonVariantConst(n); }
+};
+
+template <>
+struct Conv<JsonObjectConst> {
+  static bool is(const Node* n) { return n && n->kind == Node::OBJ; }
+  static JsonObjectConst as(const Node* n) { return JsonObjectConst(is(n) ? n : nullptr); }
+};
+
+template <>
+struct Conv<JsonArrayConst> {
+  static bool is(const Node* n) { return n && n->kind == Node::ARR; }
+  static JsonArrayConst as(const Node* n) { return JsonArrayConst(is(n) ? n : nullptr); }
+};
+
+}  // namespace ArduinoJsonHost
+
+class DeserializationError {
+ public:
+  enum Code { Ok, EmptyInput, IncompleteInput, InvalidInput, NoMemory, TooDeep };
+
+  DeserializationError() {}
+  DeserializationError(Code c) : code_(c) {}
+
+  explicit operator bool() const { return code_ != Ok; }
+  bool operator==(Code c) const { return code_ == c; }
+  bool operator!=(Code c) const { return code_ != c; }
+  Code code() const { return code_; }
+  const char* c_str() const {
+    static const char* const kNames[] = { "Ok", "EmptyInput", "IncompleteInput", "InvalidInput", "NoMemory", "TooDeep" };
+    return kNames[code_];
+  }
+
+ private:
+  Code code_ = Ok;
+};
+
+namespace DeserializationOption {
+
+class Filter {
+ public:
+  explicit Filter(const JsonDocument& doc) : node_(&doc.root()) {}
+  const ArduinoJsonHost::Node* node() const { return node_; }
+
+ private:
+  const ArduinoJsonHost::Node* node_;
+};
+
+class NestingLimit {
+ public:
+  explicit NestingLimit(uint8_t n = ARDUINOJSON_DEFAULT_NESTING_LIMIT) : n_(n) {}
+  uint8_t value() const { return n_; }
+
+ private:
+  uint8_t n_;
+};
+
+}  // namespace DeserializationOption
+
+namespace ArduinoJsonHost {
+
+// Filter node that lets everything through
+inline const Node* allowAll() {
+  static Node n;
+  n.kind = Node::BOOL;
+  n.b = true;
+  return &n;
+}
+
+class Parser {
+ public:
+  Parser(const char* p, size_t n, Pool& pool) : p_(p), end_(p + n), pool_(pool) {}
+
+  DeserializationError::Code parse(Node* root, const Node* filter, uint8_t nesting) {
+    skipSpace();
+    if (p_ == end_) return DeserializationError::EmptyInput;
+    if (!value(root, filter, nesting)) return err_;
+    return DeserializationError::Ok;
+  }
+
+ private:
+  const char* p_;
+  const char* end_;
+  Pool& pool_;
+  DeserializationError::Code err_ = DeserializationError::Ok;
+
+  bool fail(DeserializationError::Code c) {
+    err_ = c;
+    return false;
+  }
+  bool incomplete() { return fail(DeserializationError::IncompleteInput); }
+  bool invalid() { return fail(DeserializationError::InvalidInput); }
+
+  void skipSpace() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r' || *p_ == '\n')) ++p_;
+  }
+
+  static bool allows(const Node* f) { return f && (f->kind == Node::OBJ || f->kind == Node::ARR || (f->kind == Node::BOOL && f->b)); }
+  static bool allowsAll(const Node* f) { return f && f->kind == Node::BOOL && f->b; }
+
+  // out == nullptr: syntax-check and skip the value
+  bool value(Node* out, const Node* filter, uint8_t nesting) {
+    skipSpace();
+    if (p_ == end_) return incomplete();
+    if (!allows(filter)) out = nullptr;
+    switch (*p_) {
+      case '{': return object(out, filter, nesting);
+      case '[': return array(out, filter, nesting);
+      case '"': return string(out, !allowsAll(filter));
+      default: return scalar(out, !allowsAll(filter));
+    }
+  }
+
+  bool object(Node* out, const Node* filter, uint8_t nesting) {
+    if (!nesting) return fail(DeserializationError::TooDeep);
+    ++p_;
+    bool keep = out && (allowsAll(filter) || filter->kind == Node::OBJ);
+    if (keep) reset(out, Node::OBJ);
+    skipSpace();
+    if (p_ < end_ && *p_ == '}') { ++p_; return true; }
+    for (;;) {
+      skipSpace();
+      if (p_ == end_) return incomplete();
+      if (*p_ != '"') return invalid();
+      std::string key;
+      if (!readString(key)) return false;
+      skipSpace();
+      if (p_ == end_) return incomplete();
+      if (*p_++ != ':') return invalid();
+
+      const Node* sub = nullptr;
+      if (keep) {
+        sub = allowsAll(filter) ? filter : member(filter, key.c_str());
+        if (!sub && !allowsAll(filter)) sub = member(filter, "*");
+      }
+      Node* child = nullptr;
+      if (keep && allows(sub)) {
+        if (!pool_.charge(key.size() + 1) || !(child = pool_.node())) return fail(DeserializationError::NoMemory);
+        out->keys.push_back(key);
+        out->items.push_back(child);
+      }
+      if (!value(child, sub, (uint8_t)(nesting - 1))) return false;
+
+      skipSpace();
+      if (p_ == end_) return incomplete();
+      char c = *p_++;
+      if (c == '}') return true;
+      if (c != ',') return invalid();
+    }
+  }
+
+  bool array(Node* out, const Node* filter, uint8_t nesting) {
+    if (!nesting) return fail(DeserializationError::TooDeep);
+    ++p_;
+    const Node* sub = nullptr;
+    bool keep = out && (allowsAll(filter) || filter->kind == Node::ARR);
+    if (keep) {
+      reset(out, Node::ARR);
+      sub = allowsAll(filter) ? filter : element(filter, 0);
+    }
+    skipSpace();
+    if (p_ < end_ && *p_ == ']') { ++p_; return true; }
+    for (;;) {
+      Node* child = nullptr;
+      if (keep && allows(sub)) {
+        if (!(child = pool_.node())) return fail(DeserializationError::NoMemory);
+        out->items.push_back(child);
+      }
+      if (!value(child, sub, (uint8_t)(nesting - 1))) return false;
+      skipSpace();
+      if (p_ == end_) return incomplete();
+      char c = *p_++;
+      if (c == ']') return true;
+      if (c != ',') return invalid();
+    }
+  }
+
+  bool string(Node* out, bool skip) {
+    std::string s;
+    if (!readString(s)) return false;
+    if (out && !skip) {
+      if (!pool_.charge(s.size() + 1)) return fail(DeserializationError::NoMemory);
+      reset(out, Node::STR);
+      out->s = s;
+    }
+    return true;
+  }
+
+  static int hex(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+
+  bool readHex4(uint32_t& v) {
+    v = 0;
+    for (int k = 0; k < 4; ++k) {
+      if (p_ == end_) return incomplete();
+      int d = hex(*p_++);
+      if (d < 0) return invalid();
+      v = (v << 4) | (uint32_t)d;
+    }
+    return true;
+  }
+
+  static void utf8(std::string& s, uint32_t cp) {
+    if (cp < 0x80) {
+      s += (char)cp;
+    } else if (cp < 0x800) {
+      s += (char)(0xC0 | (cp >> 6));
+      s += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+      s += (char)(0xE0 | (cp >> 12));
+      s += (char)(0x80 | ((cp >> 6) & 0x3F));
+      s += (char)(0x80 | (cp & 0x3F));
+    } else {
+      s += (char)(0xF0 | (cp >> 18));
+      s += (char)(0x80 | ((cp >> 12) & 0x3F));
+      s += (char)(0x80 | ((cp >> 6) & 0x3F));
+      s += (char)(0x80 | (cp & 0x3F));
+    }
+  }
+
+  bool readString(std::string& s) {
+    ++p_;  // opening quote
+    for (;;) {
+      if (p_ == end_) return incomplete();
+      char c = *p_++;
+      if (c == '"') return true;
+      if (c != '\\') { s += c; continue; }
+      if (p_ == end_) return incomplete();
+      char e = *p_++;
+      switch (e) {
+        case '"': case '\\': case '/': s += e; break;
+        case 'b': s += '\b'; break;
+        case 'f': s += '\f'; break;
+        case 'n': s += '\n'; break;
+        case 'r': s += '\r'; break;
+        case 't': s += '\t'; break;
+        case 'u': {
+          uint32_t cp;
+          if (!readHex4(cp)) return false;
+          if (cp >= 0xD800 && cp < 0xDC00 && end_ - p_ >= 6 && p_[0] == '\\' && p_[1] == 'u') {
+            p_ += 2;
+            uint32_t lo;
+            if (!readHex4(lo)) return false;
+            if (lo >= 0xDC00 && lo < 0xE000) cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+          }
+          utf8(s, cp);
+          break;
+        }
+        default: return invalid();
+      }
+    }
+  }
+
+  bool scalar(Node* out, bool skip) {
+    const char* start = p_;
+    while (p_ < end_ && (isalnum((unsigned char)*p_) || *p_ == '-' || *p_ == '+' || *p_ == '.')) ++p_;
+    std::string tok(start, p_);
+    if (tok.empty()) return invalid();
+    Node v;
+    if (tok == "true" || tok == "false") {
+      v.kind = Node::BOOL;
+      v.b = tok == "true";
+    } else if (tok == "null") {
+      v.kind = Node::NUL;
+    } else if (!number(tok, v)) {
+      // a literal cut off by the end of the input
+      if (p_ == end_ && (std::string("true").compare(0, tok.size(), tok) == 0 ||
+                         std::string("false").compare(0, tok.size(), tok) == 0 ||
+                         std::string("null").compare(0, tok.size(), tok) == 0)) {
+        return incomplete();
+      }
+      return invalid();
+    }
+    if (out && !skip) *out = v;
+    return true;
+  }
+
+  static bool number(const std::string& tok, Node& v) {
+    const char* s = tok.c_str();
+    char* end = nullptr;
+    bool integral = tok.find_first_of(".eE") == std::string::npos;
+    if (integral) {
+      errno = 0;
+      long long i = strtoll(s, &end, 10);
+      if (*end == '\0' && end != s && errno == 0) {
+        v.kind = Node::INT;
+        v.i = i;
+        return true;
+      }
+    }
+    double d = strtod(s, &end);
+    if (end == s || *end != '\0' || !(s[0] == '-' || isdigit((unsigned char)s[0]))) return false;
+    v.kind = Node::FLOAT;
+    v.f = d;
+    return true;
+  }
+};
+
+inline DeserializationError deserialize(JsonDocument& doc, const char* json, size_t len, const Node* filter, uint8_t nesting) {
+  doc.clear();
+  if (!json) return DeserializationError::EmptyInput;
+  Parser p(json, len, doc.pool());
+  DeserializationError::Code c = p.parse(&doc.root(), filter, nesting);
+  if (c != DeserializationError::Ok) doc.clear();
+  return c;
+}
+
+}  // namespace ArduinoJsonHost
+
+inline DeserializationError deserializeJson(JsonDocument& doc, const char* json, size_t len,
+                                            DeserializationOption::Filter f,
+                                            DeserializationOption::NestingLimit n = DeserializationOption::NestingLimit()) {
+  return ArduinoJsonHost::deserialize(doc, json, len, f.node(), n.value());
+}
+inline DeserializationError deserializeJson(JsonDocument& doc, const char* json, size_t len,
+                                            DeserializationOption::NestingLimit n = DeserializationOption::NestingLimit()) {
+  return ArduinoJsonHost::deserialize(doc, json, len, ArduinoJsonHost::allowAll(), n.value());
+}
+inline DeserializationError deserializeJson(JsonDocument& doc, const char* json,
+                                            DeserializationOption::NestingLimit n = DeserializationOption::NestingLimit()) {
+  return deserializeJson(doc, json, json ? strlen(json) : 0, n);
+}
+inline DeserializationError deserializeJson(JsonDocument& doc, const char* json, DeserializationOption::Filter f,
+                                            DeserializationOption::NestingLimit n = DeserializationOption::NestingLimit()) {
+  return deserializeJson(doc, json, json ? strlen(json) : 0, f, n);
+}
+inline DeserializationError deserializeJson(JsonDocument& doc, const String& json,
+                                            DeserializationOption::NestingLimit n = DeserializationOption::NestingLimit()) {
+  return deserializeJson(doc, json.c_str(), json.length(), n);
+}
+inline DeserializationError deserializeJson(JsonDocument& doc, const String& json, DeserializationOption::Filter f,
+                                            DeserializationOption::NestingLimit n = DeserializationOption::NestingLimit()) {
+  return deserializeJson(doc, json.c_str(), json.length(), f, n);
+}
+
+inline size_t serializeJson(JsonVariantConst v, String& out) {
+  std::string s;
+  ArduinoJsonHost::write(s, v.node());
+  out += s.c_str();
+  return s.size();
+}
+inline size_t serializeJson(JsonVariantConst v, char* buf, size_t cap) {
+  std::string s;
+  ArduinoJsonHost::write(s, v.node());
+  if (!cap) return 0;
+  size_t n = s.size() < cap - 1 ? s.size() : cap - 1;
+  memcpy(buf, s.data(), n);
+  buf[n] = '\0';
+  return n;
+}
+inline size_t measureJson(JsonVariantConst v) {
+  std::string s;
+  ArduinoJsonHost::write(s, v.node());
+  return s.size();
+}
@@ -0,0 +1,146 @@
+#pragma once
+// Host stand-in for the ESP32 Preferences (NVS) library. Keys live in an
+// in-memory store shared by every Preferences object, like the NVS
+// partition, and survive a simulated reboot. Keys are typed as in NVS: a
+// get of the wrong type returns the default. HostNvs counts the writes
+// (every put/remove/clear that reaches "flash") so tests can assert how
+// often settings are written, and can make writes fail.
+
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "WString.h"
+
+namespace HostNvs {
+
+enum Type : uint8_t { T_U8, T_U16, T_U32, T_I32, T_BOOL, T_STR, T_BLOB };
+
+struct Value {
+  Type type;
+  std::vector<uint8_t> bytes;
+};
+
+struct Store {
+  std::map<std::string, std::map<std::string, Value>> ns;
+  uint32_t writes = 0;        // successful puts / removes / clears
+  uint32_t bytesWritten = 0;
+  uint32_t failedWrites = 0;
+  bool failWrites = false;    // make every write fail (flash full, worn out)
+};
+
+inline Store& store() {
+  static Store s;
+  return s;
+}
+
+// Wipe everything (a fresh chip)
+inline void erase() {
+  store() = Store();
+}
+
+}
+
+class Preferences {
+ public:
+  bool begin(const char* name, bool readOnly = false, const char* = nullptr) {
+    ns_ = name;
+    open_ = true;
+    readOnly_ = readOnly;
+    return true;
+  }
+  void end() { open_ = false; }
+
+  bool clear() {
+    if (!writable()) return false;
+    HostNvs::store().ns[ns_].clear();
+    HostNvs::store().writes++;
+    return true;
+  }
+  bool remove(const char* key) {
+    if (!writable() || !keys().count(key)) return false;
+    keys().erase(key);
+    HostNvs::store().writes++;
+    return true;
+  }
+  bool isKey(const char* key) { return open_ && keys().count(key) != 0; }
+
+  size_t putUChar(const char* key, uint8_t v) { return put(key, HostNvs::T_U8, &v, sizeof(v)); }
+  size_t putUShort(const char* key, uint16_t v) { return put(key, HostNvs::T_U16, &v, sizeof(v)); }
+  size_t putUInt(const char* key, uint32_t v) { return put(key, HostNvs::T_U32, &v, sizeof(v)); }
+  size_t putULong(const char* key, uint32_t v) { return putUInt(key, v); }
+  size_t putInt(const char* key, int32_t v) { return put(key, HostNvs::T_I32, &v, sizeof(v)); }
+  size_t putBool(const char* key, bool v) {
+    uint8_t b = v ? 1 : 0;
+    return put(key, HostNvs::T_BOOL, &b, 1) ? 1 : 0;
+  }
+  size_t putString(const char* key, const char* v) { return put(key, HostNvs::T_STR, v, strlen(v) + 1) ? strlen(v) : 0; }
+  size_t putString(const char* key, const String& v) { return putString(key, v.c_str()); }
+  size_t putBytes(const char* key, const void* v, size_t n) { return put(key, HostNvs::T_BLOB, v, n); }
+
+  uint8_t getUChar(const char* key, uint8_t d = 0) { return get(key, HostNvs::T_U8, d); }
+  uint16_t getUShort(const char* key, uint16_t d = 0) { return get(key, HostNvs::T_U16, d); }
+  uint32_t getUInt(const char* key, uint32_t d = 0) { return get(key, HostNvs::T_U32, d); }
+  uint32_t getULong(const char* key, uint32_t d = 0) { return getUInt(key, d); }
+  int32_t getInt(const char* key, int32_t d = 0) { return get(key, HostNvs::T_I32, d); }
+  bool getBool(const char* key, bool d = false) { return get(key, HostNvs::T_BOOL, (uint8_t)d) != 0; }
+
+  String getString(const char* key, const String& d = String()) {
+    const HostNvs::Value* v = find(key, HostNvs::T_STR);
+    return v ? String((const char*)v->bytes.data()) : d;
+  }
+  size_t getString(const char* key, char* buf, size_t max) {
+    const HostNvs::Value* v = find(key, HostNvs::T_STR);
+    if (!v || !buf || v->bytes.size() > max) return 0;
+    memcpy(buf, v->bytes.data(), v->bytes.size());
+    return v->bytes.size();
+  }
+
+  size_t getBytesLength(const char* key) {
+    const HostNvs::Value* v = find(key, HostNvs::T_BLOB);
+    return v ? v->bytes.size() : 0;
+  }
+  size_t getBytes(const char* key, void* buf, size_t max) {
+    const HostNvs::Value* v = find(key, HostNvs::T_BLOB);
+    if (!v || !buf || v->bytes.size() > max) return 0;
+    memcpy(buf, v->bytes.data(), v->bytes.size());
+    return v->bytes.size();
+  }
+
+ private:
+  std::string ns_;
+  bool open_ = false;
+  bool readOnly_ = true;
+
+  std::map<std::string, HostNvs::Value>& keys() { return HostNvs::store().ns[ns_]; }
+  bool writable() { return open_ && !readOnly_; }
+
+  size_t put(const char* key, HostNvs::Type t, const void* data, size_t n) {
+    HostNvs::Store& s = HostNvs::store();
+    if (!writable()) return 0;
+    if (s.failWrites) { s.failedWrites++; return 0; }
+    HostNvs::Value& v = keys()[key];
+    v.type = t;
+    v.bytes.assign((const uint8_t*)data, (const uint8_t*)data + n);
+    s.writes++;
+    s.bytesWritten += (uint32_t)n;
+    return n;
+  }
+
+  const HostNvs::Value* find(const char* key, HostNvs::Type t) {
+    if (!open_) return nullptr;
+    std::map<std::string, HostNvs::Value>& k = keys();
+    std::map<std::string, HostNvs::Value>::const_iterator it = k.find(key);
+    return it != k.end() && it->second.type == t ? &it->second : nullptr;
+  }
+
+  template <typename T>
+  T get(const char* key, HostNvs::Type t, T d) {
+    const HostNvs::Value* v = find(key, t);
+    if (!v || v->bytes.size() != sizeof(T)) return d;
+    T out;
+    memcpy(&out, v->bytes.data(), sizeof(T));
+    return out;
+  }
+};
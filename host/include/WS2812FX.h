@@ -0,0 +1,82 @@
+#pragma once
+// Host stand-in for WS2812FX that records the frame instead of driving a
+// strip. service() "shows" a frame while running: every pixel gets the
+// current color scaled by the brightness the way Adafruit_NeoPixel does,
+// whatever the effect (animations are the library's business, not the
+// lamp's). stop() blanks the strip. pixel() and shows() expose the result.
+
+#include <stdint.h>
+#include <vector>
+#include "Arduino.h"
+
+typedef uint16_t neoPixelType;
+#define NEO_GRB ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_KHZ800 0x0000
+
+#define FX_MODE_STATIC 0
+#define MODE_COUNT 56
+
+class WS2812FX {
+ public:
+  WS2812FX(uint16_t n, int16_t pin, neoPixelType type) : pixels_(n, 0) { (void)pin; (void)type; }
+
+  void init() { show(); }
+  void start() { running_ = true; }
+  void stop() {
+    running_ = false;
+    for (uint32_t& p : pixels_) p = 0;
+    shows_++;
+  }
+  bool isRunning() const { return running_; }
+  void service() {
+    if (running_) show();
+  }
+
+  void setMode(uint8_t m) { mode_ = m < MODE_COUNT ? m : MODE_COUNT - 1; }
+  uint8_t getMode() const { return mode_; }
+  void setColor(uint32_t c) { color_ = c & 0xFFFFFF; }
+  uint32_t getColor() const { return color_; }
+  void setBrightness(uint8_t b) {
+    brightness_ = b;
+    if (running_) show();
+  }
+  uint8_t getBrightness() const { return brightness_; }
+  uint8_t getModeCount() const { return MODE_COUNT; }
+
+  const __FlashStringHelper* getModeName(uint8_t m) const {
+    static const char* const kNames[MODE_COUNT] = {
+      "Static", "Blink", "Breath", "Color Wipe", "Color Wipe Inverse", "Color Wipe Reverse",
+      "Color Wipe Reverse Inverse", "Color Wipe Random", "Random Color", "Single Dynamic", "Multi Dynamic",
+      "Rainbow", "Rainbow Cycle", "Scan", "Dual Scan", "Fade", "Theater Chase", "Theater Chase Rainbow",
+      "Running Lights", "Twinkle", "Twinkle Random", "Twinkle Fade", "Twinkle Fade Random", "Sparkle",
+      "Flash Sparkle", "Hyper Sparkle", "Strobe", "Strobe Rainbow", "Multi Strobe", "Blink Rainbow",
+      "Chase White", "Chase Color", "Chase Random", "Chase Rainbow", "Chase Flash", "Chase Flash Random",
+      "Chase Rainbow White", "Chase Blackout", "Chase Blackout Rainbow", "Color Sweep Random",
+      "Running Color", "Running Red Blue", "Running Random", "Larson Scanner", "Comet", "Fireworks",
+      "Fireworks Random", "Merry Christmas", "Fire Flicker", "Fire Flicker (soft)",
+      "Fire Flicker (intense)", "Circus Combustus", "Halloween", "Bicolor Chase", "Tricolor Chase", "ICU"
+    };
+    return m < MODE_COUNT ? (const __FlashStringHelper*)kNames[m] : nullptr;
+  }
+
+  // What went out with the last frame (0xRRGGBB after brightness)
+  uint16_t numPixels() const { return (uint16_t)pixels_.size(); }
+  uint32_t pixel(uint16_t i) const { return i < pixels_.size() ? pixels_[i] : 0; }
+  uint32_t shows() const { return shows_; }
+
+ private:
+  std::vector<uint32_t> pixels_;
+  uint32_t color_ = 0;
+  uint8_t brightness_ = 50;
+  uint8_t mode_ = FX_MODE_STATIC;
+  bool running_ = false;
+  uint32_t shows_ = 0;
+
+  void show() {
+    uint32_t scale = (uint32_t)brightness_ + 1;
+    uint32_t c = ((((color_ >> 16) & 0xFF) * scale >> 8) << 16) | ((((color_ >> 8) & 0xFF) * scale >> 8) << 8) |
+                 ((color_ & 0xFF) * scale >> 8);
+    for (uint32_t& p : pixels_) p = c;
+    shows_++;
+  }
+};
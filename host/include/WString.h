@@ -0,0 +1,117 @@
+#pragma once
+// Host stand-in for the Arduino String class, on top of std::string.
+// Covers the members the firmware calls; numbers format like the core
+// (floats with 2 decimals unless told otherwise).
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+
+class __FlashStringHelper;
+
+class String {
+ public:
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  String(const String& o) : s_(o.s_) {}
+  String(const __FlashStringHelper* s) : s_(s ? (const char*)s : "") {}
+  explicit String(char c) : s_(1, c) {}
+  explicit String(unsigned char v, unsigned char base = 10) { fmtU(v, base); }
+  explicit String(int v, unsigned char base = 10) { fmtS(v, base); }
+  explicit String(unsigned int v, unsigned char base = 10) { fmtU(v, base); }
+  explicit String(long v, unsigned char base = 10) { fmtS(v, base); }
+  explicit String(unsigned long v, unsigned char base = 10) { fmtU(v, base); }
+  explicit String(long long v, unsigned char base = 10) { fmtS(v, base); }
+  explicit String(unsigned long long v, unsigned char base = 10) { fmtU(v, base); }
+  explicit String(float v, unsigned int decimals = 2) { fmtF(v, decimals); }
+  explicit String(double v, unsigned int decimals = 2) { fmtF(v, decimals); }
+
+  String& operator=(const String& o) { s_ = o.s_; return *this; }
+  String& operator=(const char* s) { s_ = s ? s : ""; return *this; }
+
+  const char* c_str() const { return s_.c_str(); }
+  unsigned int length() const { return (unsigned int)s_.size(); }
+  bool isEmpty() const { return s_.empty(); }
+  bool reserve(unsigned int n) { s_.reserve(n); return true; }
+  char charAt(unsigned int i) const { return i < s_.size() ? s_[i] : '\0'; }
+  char operator[](unsigned int i) const { return charAt(i); }
+  char& operator[](unsigned int i) { return s_[i]; }
+
+  bool concat(const String& o) { s_ += o.s_; return true; }
+  bool concat(const char* s) { if (s) s_ += s; return true; }
+  bool concat(const char* s, unsigned int n) { if (s) s_.append(s, n); return true; }
+  bool concat(char c) { s_ += c; return true; }
+  String& operator+=(const String& o) { s_ += o.s_; return *this; }
+  String& operator+=(const char* s) { if (s) s_ += s; return *this; }
+  String& operator+=(char c) { s_ += c; return *this; }
+  template <typename T>
+  String& operator+=(T v) { s_ += String(v).s_; return *this; }
+
+  bool equals(const String& o) const { return s_ == o.s_; }
+  bool equals(const char* s) const { return s_ == (s ? s : ""); }
+  bool equalsIgnoreCase(const String& o) const { return strcasecmp(c_str(), o.c_str()) == 0; }
+  bool operator==(const String& o) const { return s_ == o.s_; }
+  bool operator==(const char* s) const { return equals(s); }
+  bool operator!=(const String& o) const { return s_ != o.s_; }
+  bool operator!=(const char* s) const { return !equals(s); }
+  bool operator<(const String& o) const { return s_ < o.s_; }
+
+  bool startsWith(const String& p) const { return s_.compare(0, p.s_.size(), p.s_) == 0; }
+  bool endsWith(const String& p) const {
+    return s_.size() >= p.s_.size() && s_.compare(s_.size() - p.s_.size(), p.s_.size(), p.s_) == 0;
+  }
+  int indexOf(char c, unsigned int from = 0) const { return pos(s_.find(c, from)); }
+  int indexOf(const String& t, unsigned int from = 0) const { return pos(s_.find(t.s_, from)); }
+  int lastIndexOf(char c) const { return pos(s_.rfind(c)); }
+  String substring(unsigned int from) const { return from < s_.size() ? String(s_.substr(from).c_str()) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) { unsigned int t = from; from = to; to = t; }
+    if (from >= s_.size()) return String();
+    return String(s_.substr(from, to - from).c_str());
+  }
+  void remove(unsigned int index) { if (index < s_.size()) s_.erase(index); }
+  void remove(unsigned int index, unsigned int count) { if (index < s_.size()) s_.erase(index, count); }
+  void replace(const String& a, const String& b) {
+    if (a.s_.empty()) return;
+    for (size_t p = s_.find(a.s_); p != std::string::npos; p = s_.find(a.s_, p + b.s_.size())) s_.replace(p, a.s_.size(), b.s_);
+  }
+  void toLowerCase() { for (char& c : s_) c = (char)tolower((unsigned char)c); }
+  void toUpperCase() { for (char& c : s_) c = (char)toupper((unsigned char)c); }
+  void trim() {
+    size_t a = s_.find_first_not_of(" \t\r\n");
+    if (a == std::string::npos) { s_.clear(); return; }
+    s_ = s_.substr(a, s_.find_last_not_of(" \t\r\n") - a + 1);
+  }
+  long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(s_.c_str(), nullptr); }
+
+ private:
+  std::string s_;
+
+  static int pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+  void fmtU(unsigned long long v, unsigned char base) {
+    char buf[72];
+    int i = sizeof(buf) - 1;
+    buf[i] = '\0';
+    if (base < 2) base = 10;
+    do { buf[--i] = "0123456789abcdefghijklmnopqrstuvwxyz"[v % base]; v /= base; } while (v && i > 0);
+    s_ = buf + i;
+  }
+  void fmtS(long long v, unsigned char base) {
+    if (v < 0 && base == 10) { fmtU((unsigned long long)(-(v + 1)) + 1, base); s_.insert(0, 1, '-'); }
+    else fmtU((unsigned long long)v, base);
+  }
+  void fmtF(double v, unsigned int decimals) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    s_ = buf;
+  }
+};
+
+inline String operator+(const String& a, const String& b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, const char* b) { String r(a); r += b; return r; }
+inline String operator+(const char* a, const String& b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, char c) { String r(a); r += c; return r; }
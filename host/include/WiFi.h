@@ -0,0 +1,18 @@
+#pragma once
+// Host stand-in for WiFi.h: only the mode type the lamp's state carries.
+// The radio itself is not simulated (wifi_sm.h holds the logic and is
+// tested on its own).
+
+typedef enum {
+  WIFI_MODE_NULL = 0,
+  WIFI_MODE_STA,
+  WIFI_MODE_AP,
+  WIFI_MODE_APSTA,
+} wifi_mode_t;
+
+typedef wifi_mode_t WiFiMode_t;
+
+#define WIFI_OFF WIFI_MODE_NULL
+#define WIFI_STA WIFI_MODE_STA
+#define WIFI_AP WIFI_MODE_AP
+#define WIFI_AP_STA WIFI_MODE_APSTA
@@ -0,0 +1,40 @@
+#pragma once
+// Host stand-in for esp_heap_caps.h: heap_caps_get_info() reports the live
+// bytes and blocks in HostHeap. Those are kept by whoever interposes the C
+// allocator (host/bench does); without that they stay at zero.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+
+typedef struct multi_heap_info {
+  size_t total_free_bytes;
+  size_t total_allocated_bytes;
+  size_t largest_free_block;
+  size_t minimum_free_bytes;
+  size_t allocated_blocks;
+  size_t free_blocks;
+  size_t total_blocks;
+} multi_heap_info_t;
+
+namespace HostHeap {
+
+inline std::atomic<int64_t>& liveBytes() {
+  static std::atomic<int64_t> n{ 0 };
+  return n;
+}
+inline std::atomic<int64_t>& liveBlocks() {
+  static std::atomic<int64_t> n{ 0 };
+  return n;
+}
+
+}
+
+inline void heap_caps_get_info(multi_heap_info_t* info, uint32_t) {
+  memset(info, 0, sizeof(*info));
+  info->total_allocated_bytes = (size_t)HostHeap::liveBytes().load(std::memory_order_relaxed);
+  info->allocated_blocks = (size_t)HostHeap::liveBlocks().load(std::memory_order_relaxed);
+}
@@ -0,0 +1,35 @@
+#pragma once
+// Host stand-in for esp_now.h. Nothing is transmitted: esp_now_send()
+// appends the frame to HostAir::sent() so tests and the simulator can see
+// what the lamp put on the air (beacons, ACKs).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "esp_system.h"
+
+#define ESP_NOW_ETH_ALEN 6
+#define ESP_NOW_MAX_DATA_LEN 250
+
+namespace HostAir {
+
+struct Frame {
+  uint8_t peer[ESP_NOW_ETH_ALEN];
+  std::vector<uint8_t> data;
+};
+
+inline std::vector<Frame>& sent() {
+  static std::vector<Frame> frames;
+  return frames;
+}
+
+}
+
+inline esp_err_t esp_now_send(const uint8_t* peer, const uint8_t* data, size_t len) {
+  if (!data || !len || len > ESP_NOW_MAX_DATA_LEN) return ESP_FAIL;
+  HostAir::Frame f;
+  for (int i = 0; i < ESP_NOW_ETH_ALEN; ++i) f.peer[i] = peer ? peer[i] : 0xFF;
+  f.data.assign(data, data + len);
+  HostAir::sent().push_back(f);
+  return ESP_OK;
+}
@@ -0,0 +1,46 @@
+#pragma once
+// Host stand-in for esp_system.h: shutdown handlers are kept so a
+// simulated reboot (HostSystem::restart) runs them like esp_restart().
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_STATE 0x103
+
+typedef void (*shutdown_handler_t)(void);
+
+namespace HostSystem {
+
+static const int kMaxHandlers = 5;
+
+struct Handlers {
+  shutdown_handler_t fn[kMaxHandlers];
+  int count;
+};
+
+inline Handlers& handlers() {
+  static Handlers h = {};
+  return h;
+}
+
+// Run the registered handlers, as esp_restart() does before resetting
+inline void restart() {
+  Handlers& h = handlers();
+  for (int i = h.count - 1; i >= 0; --i) h.fn[i]();
+  h.count = 0;
+}
+
+}
+
+inline esp_err_t esp_register_shutdown_handler(shutdown_handler_t fn) {
+  HostSystem::Handlers& h = HostSystem::handlers();
+  for (int i = 0; i < h.count; ++i) {
+    if (h.fn[i] == fn) return ESP_ERR_INVALID_STATE;
+  }
+  if (h.count == HostSystem::kMaxHandlers) return ESP_ERR_NO_MEM;
+  h.fn[h.count++] = fn;
+  return ESP_OK;
+}
@@ -0,0 +1,12 @@
+#pragma once
+// Host stand-in for esp_timer.h. Unlike millis()/micros(), which follow the
+// simulated clock, this is the host's real monotonic time: it is what the
+// benchmarks measure with.
+
+#include <stdint.h>
+#include <chrono>
+
+inline int64_t esp_timer_get_time() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
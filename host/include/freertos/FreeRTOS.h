@@ -0,0 +1,47 @@
+#pragma once
+// Host stand-in for the FreeRTOS calls the firmware makes: recursive
+// mutexes and portMUX critical sections map to std::recursive_mutex, task
+// delays to the simulated clock (Arduino.h). No tasks are created here;
+// the simulator and tests drive each task's loop body themselves.
+
+#include <stdint.h>
+#include <mutex>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFu)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+// Critical sections nest on the ESP32, so the stand-in is recursive too
+struct portMUX_TYPE {
+  std::recursive_mutex m;
+};
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) (mux)->m.lock()
+#define portEXIT_CRITICAL(mux) (mux)->m.unlock()
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
+
+struct HostSemaphore {
+  std::recursive_mutex m;
+};
+typedef HostSemaphore* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return new HostSemaphore(); }
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new HostSemaphore(); }
+inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t s, TickType_t) { s->m.lock(); return pdTRUE; }
+inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t s) { s->m.unlock(); return pdTRUE; }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait) {
+  if (wait) { s->m.lock(); return pdTRUE; }
+  return s->m.try_lock() ? pdTRUE : pdFALSE;
+}
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) { s->m.unlock(); return pdTRUE; }
+inline void vSemaphoreDelete(SemaphoreHandle_t s) { delete s; }
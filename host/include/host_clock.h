@@ -0,0 +1,21 @@
+#pragma once
+// Simulated time for host builds. millis()/micros()/delay() and the task
+// delays read and move this clock, so a test or the simulator decides when
+// time passes and every run is repeatable. It starts at 0, like a fresh boot.
+
+#include <stdint.h>
+#include <atomic>
+
+namespace HostClock {
+
+inline std::atomic<uint64_t>& nowRef() {
+  static std::atomic<uint64_t> us{ 0 };
+  return us;
+}
+
+inline uint64_t us() { return nowRef().load(std::memory_order_relaxed); }
+inline void set(uint64_t us) { nowRef().store(us, std::memory_order_relaxed); }
+inline void advanceUs(uint64_t d) { nowRef().fetch_add(d, std::memory_order_relaxed); }
+inline void advanceMs(uint64_t d) { advanceUs(d * 1000); }
+
+}
@@ -0,0 +1,330 @@
+// lamp_sim: the lamp's firmware logic on the host, driven by a script on
+// simulated time. The real headers run unchanged against the stand-ins in
+// host/include: LedControl renders into a recorded framebuffer, LuxInput
+// receives ESP-NOW frames built with LuxWire, Persist writes to an
+// in-memory NVS that survives `reboot`, and actions/prompts go through
+// Actions and Intent exactly as the web handlers pass them on.
+//
+// The render task and loop() are stepped 1 ms at a time: a frame runs when
+// the FrameScheduler deadline is reached, loop() work (presence, channel
+// beacons, Persist::service) every step. The HTTP layer, Wi-Fi and the
+// Gemini transport are not simulated.
+//
+// Script: one command per line; lines starting with '#' are comments.
+//   advance <ms>                        let time pass
+//   lux <node> <lux|-> [motion 0|1] [seq <n>] [lowpower] [ack]   v2 frame from node
+//   legacy <node> <lux> [motion 0|1]    pre-v2 payload (8-byte struct / ASCII)
+//   probe <node>                        channel probe (expects an ACK)
+//   actions <json>                      {"actions":[...]} as /applyPreset takes it
+//   prompt <text>                       local intent parser; fails if not confident
+//   color <#RRGGBB> [ms] | brightness <0-255> [ms] | power on|off
+//   mimir on|off | range <min> <max> | presence on|off
+//   reboot                              esp_restart(): shutdown hooks, then boot
+//   nvs erase | nvs fail on|off
+//   status | leds                       print the /status JSON / first pixel
+//   expect <field> <value>              compare a /status field or a sim counter
+// Exit code: number of failed expectations (or 1 for a script error).
+
+#include "config.h"
+#include "frame_scheduler.h"
+#include "led_control.h"
+#include "lux_input.h"
+#include "persist.h"
+#include "action_engine.h"
+#include "intent_parser.h"
+#include "status_cache.h"
+#include "sketch_host.h"
+
+#include <string>
+#include <vector>
+
+namespace Sim {
+
+static Preferences s_prefs;
+static FrameScheduler s_sched;
+static uint32_t s_lastChannelCheck = 0;
+static uint16_t s_seq[256];
+static int s_failures = 0;
+static const char* s_file = "";
+static int s_line = 0;
+
+// loadPreferences() from the sketch
+static void boot() {
+  Persist::begin(s_prefs);
+  const Persist::State& st = Persist::state();
+  g_presenceEnabled = st.presence;
+  LedControl::init();
+  LedControl::setColor(st.color, 0);
+  LedControl::setEffect(st.effect);
+  LedControl::setOn(st.on);
+  LedControl::setMimir(st.mimir);
+  LedControl::setMimirRange(st.mimirMin, st.mimirMax);
+  if (st.curveCount) LedControl::setMimirCurve(st.curve, st.curveCount);
+  LedControl::setTargetBrightness(st.brightness);
+  s_sched.begin(micros(), RENDER_FPS);
+}
+
+// RenderTask::taskMain, one iteration (the frame's work takes no simulated time)
+static void frame() {
+  uint32_t dt = s_sched.frameStart(micros());
+  LuxInput::drain();
+  LedControl::tick(dt);
+  s_sched.frameEnd(micros());
+}
+
+// The parts of loop() that do not need the network
+static void loopOnce() {
+  if (g_presenceEnabled && LuxInput::presenceKnown()) {
+    bool motion = (bool)g_lastMotion;
+    if (motion != LedControl::getOn()) {
+      LedControl::setOn(motion);
+      savePreferenceOn(motion);
+    }
+  }
+  uint32_t now = millis();
+  if (now - s_lastChannelCheck >= 1000) {
+    s_lastChannelCheck = now;
+    LuxInput::announce(1, now);
+  }
+  Persist::service(now);
+}
+
+static void advance(uint32_t ms) {
+  for (uint32_t i = 0; i < ms; ++i) {
+    HostClock::advanceMs(1);
+    if ((int32_t)(micros() - s_sched.deadlineUs) >= 0) frame();
+    loopOnce();
+  }
+}
+
+static void nodeMac(int node, uint8_t mac[6]) {
+  static const uint8_t base[6] = { 0x5E, 0x1A, 0x00, 0x00, 0x00, 0x00 };
+  memcpy(mac, base, 6);
+  mac[5] = (uint8_t)node;
+}
+
+static void receive(int node, const uint8_t* data, size_t len) {
+  uint8_t mac[6];
+  nodeMac(node, mac);
+  LuxInput::onReceive(mac, -60, data, (int)len);
+}
+
+static void sendFrame(int node, uint8_t type, float lux, int motion, uint8_t flags) {
+  LuxWire::Frame f = {};
+  f.type = type;
+  f.flags = (uint8_t)(LuxWire::F_CRC | flags);
+  f.nodeId = (uint16_t)(0x100 + node);
+  f.seq = ++s_seq[node & 0xFF];
+  f.count = type == LuxWire::T_SAMPLES ? 1 : 0;
+  f.samples[0].lux = lux;
+  f.samples[0].motion = motion < 0 ? 0 : (uint8_t)(LuxWire::M_VALID | (motion ? LuxWire::M_MOTION : 0));
+  uint8_t buf[LuxWire::kMaxFrame];
+  size_t n = LuxWire::encode(f, buf, sizeof(buf));
+  receive(node, buf, n);
+}
+
+static void sendLegacy(int node, float lux, int motion) {
+  if (motion >= 0) {
+    uint8_t buf[8] = {};
+    memcpy(buf, &lux, 4);
+    buf[4] = (uint8_t)motion;
+    receive(node, buf, sizeof(buf));
+  } else {
+    char buf[16];
+    int n = snprintf(buf, sizeof(buf), "%.1f", lux);
+    receive(node, (const uint8_t*)buf, (size_t)n);
+  }
+}
+
+static bool runActions(const String& json) {
+  String log, err;
+  if (Actions::run(json, log, err)) return true;
+  fprintf(stderr, "%s:%d: actions rejected: %s\n", s_file, s_line, err.c_str());
+  return false;
+}
+
+static bool onOff(const std::string& w, bool& out) {
+  if (w == "on") { out = true; return true; }
+  if (w == "off") { out = false; return true; }
+  return false;
+}
+
+// Value of a /status field or a simulator counter, as text
+static bool lookup(const std::string& field, std::string& out) {
+  char buf[32];
+  if (field == "pixel") {
+    snprintf(buf, sizeof(buf), "%06lX", (unsigned long)LedControl::ws.pixel(0));
+  } else if (field == "nvs_writes") {
+    snprintf(buf, sizeof(buf), "%lu", (unsigned long)HostNvs::store().writes);
+  } else if (field == "persist_pending") {
+    snprintf(buf, sizeof(buf), "%s", Persist::pending() ? "true" : "false");
+  } else if (field == "acks") {
+    snprintf(buf, sizeof(buf), "%lu", (unsigned long)LuxInput::stats().acksSent);
+  } else if (field == "dup_frames") {
+    snprintf(buf, sizeof(buf), "%lu", (unsigned long)LuxInput::stats().dupFrames);
+  } else if (field == "status_renders") {
+    snprintf(buf, sizeof(buf), "%lu", (unsigned long)StatusCache::stats().renders);
+  } else if (field == "overruns") {
+    snprintf(buf, sizeof(buf), "%lu", (unsigned long)s_sched.stats.overruns);
+  } else {
+    const StatusCache::Entry& e = StatusCache::get();
+    DynamicJsonDocument doc(4096);
+    if (deserializeJson(doc, e.json, e.len)) {
+      fprintf(stderr, "%s:%d: /status is not valid JSON: %s\n", s_file, s_line, e.json);
+      return false;
+    }
+    JsonVariantConst v = doc[field.c_str()];
+    if (field == "nodes") {
+      snprintf(buf, sizeof(buf), "%u", (unsigned)v.size());
+    } else if (v.isNull()) {
+      return false;
+    } else if (v.is<const char*>()) {
+      out = v.as<const char*>();
+      return true;
+    } else {
+      out = v.as<String>().c_str();
+      return true;
+    }
+  }
+  out = buf;
+  return true;
+}
+
+static void expect(const std::string& field, const std::string& want) {
+  std::string got;
+  bool ok = lookup(field, got);
+  if (ok && got != want) {
+    // numbers compare by value ("12.5" == "12.50")
+    char* e1;
+    char* e2;
+    double a = strtod(got.c_str(), &e1);
+    double b = strtod(want.c_str(), &e2);
+    ok = *e1 == '\0' && *e2 == '\0' && e1 != got.c_str() && fabs(a - b) < 0.005;
+  }
+  if (!ok) {
+    fprintf(stderr, "%s:%d: expected %s = %s, got %s\n", s_file, s_line, field.c_str(), want.c_str(),
+            got.empty() ? "(missing)" : got.c_str());
+    s_failures++;
+  }
+}
+
+static std::vector<std::string> split(const std::string& line) {
+  std::vector<std::string> w;
+  size_t i = 0;
+  while (i < line.size()) {
+    while (i < line.size() && isspace((unsigned char)line[i])) ++i;
+    size_t j = i;
+    while (j < line.size() && !isspace((unsigned char)line[j])) ++j;
+    if (j > i) w.push_back(line.substr(i, j - i));
+    i = j;
+  }
+  return w;
+}
+
+// false = script error
+static bool run(const std::string& line) {
+  std::vector<std::string> w = split(line);
+  if (w.empty()) return true;
+  const std::string& cmd = w[0];
+  size_t argc = w.size() - 1;
+  std::string rest = line.substr(line.find(cmd) + cmd.size());
+  while (!rest.empty() && isspace((unsigned char)rest[0])) rest.erase(0, 1);
+  bool b;
+
+  if (cmd == "advance" && argc == 1) {
+    advance((uint32_t)strtoul(w[1].c_str(), nullptr, 10));
+  } else if ((cmd == "lux" || cmd == "legacy") && argc >= 2) {
+    int node = atoi(w[1].c_str());
+    float lux = w[2] == "-" ? -1.0f : strtof(w[2].c_str(), nullptr);
+    int motion = -1;
+    uint8_t flags = 0;
+    for (size_t i = 3; i <= argc; ++i) {
+      if (w[i] == "motion" && i < argc) motion = atoi(w[++i].c_str());
+      else if (w[i] == "seq" && i < argc) s_seq[node & 0xFF] = (uint16_t)(atoi(w[++i].c_str()) - 1);
+      else if (w[i] == "lowpower") flags |= LuxWire::F_LOW_POWER;
+      else if (w[i] == "ack") flags |= LuxWire::F_ACK_REQ;
+      else return false;
+    }
+    if (cmd == "lux") sendFrame(node, LuxWire::T_SAMPLES, lux, motion, flags);
+    else sendLegacy(node, lux, motion);
+  } else if (cmd == "probe" && argc == 1) {
+    sendFrame(atoi(w[1].c_str()), LuxWire::T_PROBE, 0, -1, 0);
+  } else if (cmd == "actions" && argc >= 1) {
+    if (!runActions(rest.c_str())) s_failures++;
+  } else if (cmd == "prompt" && argc >= 1) {
+    Actions::Batch batch;
+    if (!Intent::parse(rest.c_str(), rest.size(), batch)) {
+      fprintf(stderr, "%s:%d: prompt not understood: %s\n", s_file, s_line, rest.c_str());
+      s_failures++;
+    } else {
+      String log;
+      Actions::apply(batch, log);
+    }
+  } else if (cmd == "color" && (argc == 1 || argc == 2)) {
+    String json = String("{\"actions\":[{\"type\":\"set_color\",\"hex\":\"") + w[1].c_str() + "\"";
+    if (argc == 2) json += String(",\"transition_ms\":") + w[2].c_str();
+    if (!runActions(json + "}]}")) s_failures++;
+  } else if (cmd == "brightness" && (argc == 1 || argc == 2)) {
+    String json = String("{\"actions\":[{\"type\":\"set_brightness\",\"value\":") + w[1].c_str();
+    if (argc == 2) json += String(",\"transition_ms\":") + w[2].c_str();
+    if (!runActions(json + "}]}")) s_failures++;
+  } else if ((cmd == "power" || cmd == "mimir") && argc == 1 && onOff(w[1], b)) {
+    String json = String("{\"actions\":[{\"type\":\"set_") + cmd.c_str() + "\",\"on\":" + (b ? "true" : "false") + "}]}";
+    if (!runActions(json)) s_failures++;
+  } else if (cmd == "range" && argc == 2) {
+    String json = String("{\"actions\":[{\"type\":\"set_mimir_range\",\"min\":") + w[1].c_str() + ",\"max\":" + w[2].c_str() + "}]}";
+    if (!runActions(json)) s_failures++;
+  } else if (cmd == "presence" && argc == 1 && onOff(w[1], b)) {
+    g_presenceEnabled = b;
+    savePreferencePresence(b);
+  } else if (cmd == "reboot" && argc == 0) {
+    HostSystem::restart();
+    boot();
+  } else if (cmd == "nvs" && argc == 1 && w[1] == "erase") {
+    HostNvs::erase();
+  } else if (cmd == "nvs" && argc == 2 && w[1] == "fail" && onOff(w[2], b)) {
+    HostNvs::store().failWrites = b;
+  } else if (cmd == "status" && argc == 0) {
+    printf("%s\n", StatusCache::get().json);
+  } else if (cmd == "leds" && argc == 0) {
+    printf("pixel=%06lX shows=%lu\n", (unsigned long)LedControl::ws.pixel(0), (unsigned long)LedControl::ws.shows());
+  } else if (cmd == "expect" && argc == 2) {
+    expect(w[1], w[2]);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+  FILE* in = stdin;
+  if (argc > 1) {
+    Sim::s_file = argv[1];
+    in = fopen(argv[1], "r");
+    if (!in) {
+      fprintf(stderr, "lamp_sim: cannot open %s\n", argv[1]);
+      return 1;
+    }
+  } else {
+    Sim::s_file = "<stdin>";
+  }
+
+  Sim::boot();
+  char buf[1024];
+  while (fgets(buf, sizeof(buf), in)) {
+    Sim::s_line++;
+    std::string line(buf);
+    size_t start = line.find_first_not_of(" \t");
+    if (start != std::string::npos && line[start] == '#') continue;
+    while (!line.empty() && isspace((unsigned char)line.back())) line.pop_back();
+    if (!Sim::run(line)) {
+      fprintf(stderr, "%s:%d: bad command: %s\n", Sim::s_file, Sim::s_line, line.c_str());
+      return 1;
+    }
+  }
+  if (in != stdin) fclose(in);
+  if (Sim::s_failures) fprintf(stderr, "%s: %d expectation(s) failed\n", Sim::s_file, Sim::s_failures);
+  return Sim::s_failures;
+}
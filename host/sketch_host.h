@@ -0,0 +1,37 @@
+#pragma once
+#include <Arduino.h>
+#include <WiFi.h>
+#include "persist.h"
+
+/*
+  sketch_host.h
+  What SleepLamp_ESP32.ino provides to the firmware headers, for host
+  builds: the shared globals, wifiModeName() and the savePreference*
+  forwarders to Persist (without the /metrics counters; metrics.h needs
+  the web server). It defines rather than declares, so include it once per
+  program, like the sketch.
+*/
+
+volatile WiFiMode_t g_wifiMode = WIFI_MODE_AP;
+volatile float g_lastLux = 0.0f;
+volatile uint32_t g_lastLuxMillis = 0;
+volatile bool g_lastMotion = false;
+volatile bool g_presenceEnabled = false;
+
+const char* wifiModeName() {
+  if (g_wifiMode == WIFI_MODE_STA) return "STA";
+  if (g_wifiMode == WIFI_MODE_AP) return "AP";
+  if (g_wifiMode == WIFI_MODE_APSTA) return "AP_STA";
+  return "UNKNOWN";
+}
+
+void savePreferenceColor(uint32_t color) { Persist::setColor(color); }
+void savePreferenceBrightness(uint8_t b) { Persist::setBrightness(b); }
+void savePreferenceEffect(uint16_t e) { Persist::setEffect(e); }
+void savePreferenceOn(bool on) { Persist::setOn(on); }
+void savePreferenceMimir(bool m) { Persist::setMimir(m); }
+void savePreferenceWiFiMode(const String& mode) { Persist::setWifiMode(mode); }
+void savePreferenceSTA(const String& ssid, const String& pass) { Persist::setSta(ssid, pass); }
+void savePreferenceMimirRange(uint8_t minB, uint8_t maxB) { Persist::setMimirRange(minB, maxB); }
+void savePreferenceMimirCurve(const MimirCurve::Point* pts, uint8_t n) { Persist::setMimirCurve(pts, n); }
+void savePreferencePresence(bool p) { Persist::setPresence(p); }
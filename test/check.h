@@ -0,0 +1,80 @@
+#pragma once
+// Minimal assertions for the host tests. A failed CHECK prints file:line
+// and the values, then the test carries on; main() returns
+// Check::result(), so ctest sees a non-zero exit if anything failed.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <type_traits>
+#include <WString.h>
+
+#pragma GCC diagnostic ignored "-Wsign-compare"
+
+namespace Check {
+
+inline int& failures() {
+  static int n = 0;
+  return n;
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type show(T v) {
+  if (std::is_signed<T>::value) fprintf(stderr, "%lld", (long long)v);
+  else fprintf(stderr, "%llu", (unsigned long long)v);
+}
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type show(T v) {
+  fprintf(stderr, "%.9g", (double)v);
+}
+inline void show(const char* s) { fprintf(stderr, "\"%s\"", s ? s : "(null)"); }
+inline void show(const String& s) { show(s.c_str()); }
+
+inline bool fail(const char* file, int line, const char* what) {
+  fprintf(stderr, "%s:%d: %s", file, line, what);
+  failures()++;
+  return false;
+}
+
+template <typename A, typename B>
+bool eq(const A& a, const B& b, const char* ea, const char* eb, const char* file, int line) {
+  if (a == b) return true;
+  fail(file, line, "");
+  fprintf(stderr, "%s == %s: ", ea, eb);
+  show(a);
+  fprintf(stderr, " vs ");
+  show(b);
+  fprintf(stderr, "\n");
+  return false;
+}
+
+inline bool streq(const char* a, const char* b, const char* ea, const char* eb, const char* file, int line) {
+  if (a && b && strcmp(a, b) == 0) return true;
+  fail(file, line, "");
+  fprintf(stderr, "%s == %s: ", ea, eb);
+  show(a);
+  fprintf(stderr, " vs ");
+  show(b);
+  fprintf(stderr, "\n");
+  return false;
+}
+
+inline bool near(double a, double b, double tol, const char* ea, const char* eb, const char* file, int line) {
+  if (fabs(a - b) <= tol) return true;
+  fail(file, line, "");
+  fprintf(stderr, "%s ~= %s: %.9g vs %.9g (tol %.3g)\n", ea, eb, a, b, tol);
+  return false;
+}
+
+inline int result(const char* name) {
+  if (failures()) fprintf(stderr, "%s: %d check(s) failed\n", name, failures());
+  else fprintf(stderr, "%s: ok\n", name);
+  return failures() ? 1 : 0;
+}
+
+}
+
+#define CHECK(cond) ((cond) ? true : (Check::fail(__FILE__, __LINE__, "CHECK(" #cond ") failed\n")))
+#define CHECK_EQ(a, b) Check::eq((a), (b), #a, #b, __FILE__, __LINE__)
+#define CHECK_STREQ(a, b) Check::streq((a), (b), #a, #b, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, tol) Check::near((a), (b), (tol), #a, #b, __FILE__, __LINE__)
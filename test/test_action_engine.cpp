@@ -0,0 +1,175 @@
+// action_engine.h: every way compileOne/compile reject input, the
+// transition_ms encoding at its edges, toJson round trips and apply.
+
+#include "check.h"
+#include "action_engine.h"
+#include "sketch_host.h"
+
+// Compile one action object given as JSON text
+static bool one(const char* json, Actions::Command& c, long fadeDflt = -1) {
+  DynamicJsonDocument doc(1024);
+  if (deserializeJson(doc, json)) return false;
+  return Actions::compileOne(doc.as<JsonObjectConst>(), c, fadeDflt);
+}
+
+static bool one(const char* json) {
+  Actions::Command c;
+  return one(json, c);
+}
+
+static void testRejects() {
+  CHECK(!one("{}"));                                                // no type
+  CHECK(!one("{\"type\":\"set_sparkles\"}"));                        // unknown type
+  CHECK(!one("{\"type\":7}"));                                       // type not a string
+  CHECK(!one("{\"type\":\"set_brightness\"}"));                      // no value
+  CHECK(!one("{\"type\":\"set_brightness\",\"value\":-1}"));
+  CHECK(!one("{\"type\":\"set_brightness\",\"value\":256}"));
+  CHECK(!one("{\"type\":\"set_brightness\",\"value\":\"128\"}"));    // string, not a number
+  CHECK(!one("{\"type\":\"set_brightness\",\"value\":12.5}"));       // not an integer
+  CHECK(!one("{\"type\":\"set_color\"}"));                           // no hex
+  CHECK(!one("{\"type\":\"set_color\",\"hex\":\"FF8800\"}"));        // no '#'
+  CHECK(!one("{\"type\":\"set_color\",\"hex\":\"#FFF\"}"));          // short form
+  CHECK(!one("{\"type\":\"set_color\",\"hex\":\"#FF88001\"}"));      // too long
+  CHECK(!one("{\"type\":\"set_color\",\"hex\":\"#GG8800\"}"));       // not hex
+  CHECK(!one("{\"type\":\"set_color\",\"hex\":\"#-F8800\"}"));       // strtoul would take a sign
+  CHECK(!one("{\"type\":\"set_color\",\"hex\":16746496}"));          // number, not text
+  CHECK(!one("{\"type\":\"set_effect\"}"));                          // neither id nor name
+  CHECK(!one("{\"type\":\"set_effect\",\"name\":\"Disco Inferno\"}"));  // unknown name
+  CHECK(!one("{\"type\":\"set_effect\",\"id\":256}"));
+  CHECK(!one("{\"type\":\"set_mimir_range\",\"min\":10}"));          // no max
+  CHECK(!one("{\"type\":\"set_mimir_range\",\"min\":10,\"max\":300}"));
+  CHECK(!one("{\"type\":\"set_mimir_range\",\"min\":-5,\"max\":100}"));
+}
+
+static void testAccepts() {
+  Actions::Command c;
+  CHECK(one("{\"type\":\"set_brightness\",\"value\":0}", c));
+  CHECK_EQ(c.type, Actions::CMD_BRIGHTNESS);
+  CHECK_EQ(c.a, 0);
+  CHECK(one("{\"type\":\"set_color\",\"hex\":\"#ff8800\"}", c));
+  CHECK_EQ(c.value, 0xFF8800u);
+  CHECK(one("{\"type\":\"set_effect\",\"label\":\"fire flicker (soft)\"}", c));
+  CHECK_EQ(c.value, (uint32_t)effectIdFromName("Fire Flicker (soft)"));
+  CHECK(one("{\"type\":\"set_effect\",\"id\":3,\"name\":\"Static\"}", c));  // id wins
+  CHECK_EQ(c.value, 3u);
+  CHECK(one("{\"type\":\"set_mimir_range\",\"min\":200,\"max\":20}", c));  // swapped into order
+  CHECK_EQ(c.a, 20);
+  CHECK_EQ(c.b, 200);
+  CHECK(one("{\"type\":\"set_power\"}", c));  // on defaults to false
+  CHECK_EQ(c.a, 0);
+}
+
+// transition_ms -> fade -> ms
+static uint32_t fadeFor(const char* ms, long dflt = -1) {
+  char json[128];
+  snprintf(json, sizeof(json), "{\"type\":\"set_brightness\",\"value\":9,\"transition_ms\":%s}", ms);
+  Actions::Command c;
+  if (!one(json, c, dflt)) return 0xDEAD;
+  return Actions::fadeMs(c, 0xFFFF);
+}
+
+static void testFadeEncoding() {
+  CHECK_EQ(fadeFor("0"), 0u);  // instant, not "default"
+  CHECK_EQ(fadeFor("49"), 0u);
+  CHECK_EQ(fadeFor("50"), 100u);
+  CHECK_EQ(fadeFor("99"), 100u);
+  CHECK_EQ(fadeFor("1234"), 1200u);
+  CHECK_EQ(fadeFor("25400"), 25400u);
+  CHECK_EQ(fadeFor("25449"), 25400u);
+  CHECK_EQ(fadeFor("600000"), 25400u);
+  CHECK_EQ(fadeFor("4294967396"), 25400u);  // 2^32 + 100: must not wrap to 100
+  CHECK_EQ(fadeFor("99999999999999"), 25400u);
+  CHECK_EQ(fadeFor("-1"), 0xFFFFu);    // negative: no fade given
+  CHECK_EQ(fadeFor("150.5"), 0xFFFFu); // not an integer: ignored
+  CHECK_EQ(fadeFor("\"300\""), 0xFFFFu);
+
+  CHECK_EQ(Actions::encodeFade(0), 1);
+  CHECK_EQ(Actions::encodeFade(Actions::kFadeMaxMs), 255);
+  CHECK_EQ(Actions::encodeFade(0xFFFFFFFFu), 255);
+
+  // the batch default applies unless the action has its own
+  Actions::Command c;
+  CHECK(one("{\"type\":\"set_color\",\"hex\":\"#000000\"}", c, 800));
+  CHECK_EQ(Actions::fadeMs(c, 0), 800u);
+  CHECK(one("{\"type\":\"set_color\",\"hex\":\"#000000\",\"transition_ms\":0}", c, 800));
+  CHECK_EQ(Actions::fadeMs(c, 77), 0u);
+  // only brightness and color fade
+  CHECK(one("{\"type\":\"set_effect\",\"id\":2,\"transition_ms\":500}", c));
+  CHECK_EQ(c.fade, 0);
+}
+
+static void testBatch() {
+  Actions::Batch b;
+  String err;
+  CHECK(!Actions::compileText(String("{\"actions\":"), b, err));
+  CHECK(err.startsWith("JSON parse error"));
+  CHECK(!Actions::compileText(String("{\"acts\":[]}"), b, err));
+  CHECK_STREQ(err.c_str(), "Missing actions array");
+  CHECK(!Actions::compileText(String("{\"actions\":[{\"type\":\"nope\"},5,\"x\"]}"), b, err));
+  CHECK_STREQ(err.c_str(), "No valid actions applied");
+  CHECK_EQ(b.skipped, 3);
+
+  String many = "{\"actions\":[";
+  for (int i = 0; i <= ACTION_BATCH_MAX; ++i) many += String(i ? "," : "") + "{\"type\":\"set_power\",\"on\":true}";
+  many += "]}";
+  CHECK(!Actions::compileText(many, b, err));
+  CHECK(err.startsWith("Too many actions"));
+
+  // partial batches go through, with the bad entries counted
+  err = "";
+  CHECK(Actions::compileText(String("{\"transition_ms\":300,\"actions\":[{\"type\":\"set_brightness\",\"value\":40},"
+                                    "{\"type\":\"set_color\",\"hex\":\"#12\"},{\"type\":\"set_mimir\",\"on\":true}],"
+                                    "\"junk\":{\"deep\":[1,2,3]}}"),
+                             b, err));
+  CHECK_EQ(b.count, 2);
+  CHECK_EQ(b.skipped, 1);
+  CHECK_EQ(Actions::fadeMs(b.cmds[0], 0), 300u);
+}
+
+static void testRoundTrip() {
+  const char* in[] = {
+    "{\"type\":\"set_brightness\",\"value\":200,\"transition_ms\":1500}",
+    "{\"type\":\"set_color\",\"hex\":\"#0A0B0C\"}",
+    "{\"type\":\"set_effect\",\"id\":12}",
+    "{\"type\":\"set_mimir\",\"on\":true}",
+    "{\"type\":\"set_power\",\"on\":false}",
+    "{\"type\":\"set_mimir_range\",\"min\":5,\"max\":250}",
+  };
+  for (const char* json : in) {
+    Actions::Command a, b;
+    CHECK(one(json, a));
+    DynamicJsonDocument doc(512);
+    Actions::toJson(a, doc.to<JsonObject>());
+    String out;
+    serializeJson(doc, out);
+    CHECK(one(out.c_str(), b));
+    CHECK(memcmp(&a, &b, sizeof(a)) == 0);
+  }
+}
+
+static void testApply() {
+  LedControl::init();
+  Actions::Batch b;
+  String err, log;
+  CHECK(Actions::compileText(String("{\"actions\":[{\"type\":\"set_color\",\"hex\":\"#102030\",\"transition_ms\":0},"
+                                    "{\"type\":\"set_brightness\",\"value\":90},{\"type\":\"set_effect\",\"id\":2}]}"),
+                             b, err));
+  Actions::apply(b, log);
+  CHECK_EQ(LedControl::getColor(), 0x102030u);
+  CHECK_EQ(LedControl::getTargetBrightness(), 90);
+  CHECK_EQ(LedControl::getEffect(), 2);
+  CHECK(LedControl::getOn());
+  CHECK_STREQ(log.c_str(), "color=#102030; brightness=90; effect=2; ");
+  CHECK_EQ(Persist::state().color, 0x102030u);
+  CHECK_EQ(Persist::state().brightness, 90);
+}
+
+int main() {
+  testRejects();
+  testAccepts();
+  testFadeEncoding();
+  testBatch();
+  testRoundTrip();
+  testApply();
+  return Check::result("test_action_engine");
+}
@@ -0,0 +1,207 @@
+// channel_scan.h: a node and a simulated lamp on a 5 ms virtual clock. The
+// node sends an ACK-requesting frame every 2 s like the sketch does; the
+// lamp answers 5 ms later, and the node only hears it if it is still tuned
+// to the lamp's channel by then.
+
+#include "check.h"
+#include "channel_scan.h"
+
+#include <vector>
+
+using namespace ChannelScan;
+
+static const Config kCfg = { 1, 13, 40, 10000, 300000 };  // the sketch's settings
+static const uint32_t kSendMs = 2000;
+static const uint32_t kStepMs = 5;
+static const uint32_t kReplyMs = 5;
+
+struct Sim {
+  Scanner s{ kCfg };
+  uint8_t lampCh = 6;
+  bool lampUp = true;
+  int dropAcks = 0;   // lamp replies to lose before the next one gets through
+  uint32_t now = 0;
+  uint32_t lastSend = 0;
+  bool replyDue = false;
+  uint32_t replyAt = 0;
+  std::vector<uint8_t> probed;  // channels in probe order
+  int locked = 0, gaveUp = 0;
+
+  explicit Sim(uint8_t home) { s.begin(home, 0); }
+
+  // The lamp answers whatever it heard, if it was on the same channel
+  void transmitted() {
+    if (!lampUp || s.channel() != lampCh) return;
+    if (dropAcks > 0) { dropAcks--; return; }
+    replyDue = true;
+    replyAt = now + kReplyMs;
+  }
+
+  void handle(Action a) {
+    switch (a) {
+      case A_PROBE:
+        probed.push_back(s.channel());
+        transmitted();
+        break;
+      case A_LOCKED: locked++; break;
+      case A_GAVE_UP: gaveUp++; break;
+      default: break;
+    }
+  }
+
+  void step() {
+    now += kStepMs;
+    Action a = A_NONE;
+    if (replyDue && now >= replyAt) {
+      replyDue = false;
+      if (s.channel() == lampCh) a = s.onLamp(lampCh, now);
+    }
+    if (a == A_NONE) a = s.poll(now);
+    handle(a);
+    if (!s.scanning() && now - lastSend >= kSendMs) {
+      lastSend = now;
+      s.onSent(now);
+      transmitted();
+    }
+  }
+
+  void run(uint32_t ms) {
+    for (uint32_t end = now + ms; now < end;) step();
+  }
+};
+
+static void testSteady() {
+  Sim sim(6);
+  sim.run(61000);  // sends at 2 s ... 60 s
+  CHECK_EQ(sim.s.channel(), 6);
+  CHECK_EQ(sim.s.stats().acks, 30u);
+  CHECK_EQ(sim.s.stats().misses, 0u);
+  CHECK_EQ(sim.s.stats().scans, 0u);
+  CHECK(sim.probed.empty());
+  CHECK(!sim.s.awaiting());
+}
+
+// One lost ACK costs one probe on the same channel, not a scan
+static void testSingleLoss() {
+  Sim sim(6);
+  sim.run(3000);
+  sim.dropAcks = 1;
+  sim.run(5000);
+  CHECK_EQ(sim.s.stats().misses, 1u);
+  CHECK_EQ(sim.s.stats().scans, 0u);
+  CHECK_EQ(sim.probed.size(), 1u);
+  CHECK_EQ(sim.probed[0], 6);
+  CHECK_EQ(sim.s.channel(), 6);
+  CHECK_EQ(sim.locked, 0);
+}
+
+// The router moves the lamp: home first, then 1/6/11, then the rest
+static void testLampMoves() {
+  Sim sim(6);
+  sim.run(3000);
+  sim.lampCh = 9;
+  sim.probed.clear();
+  sim.run(5000);
+  const uint8_t want[] = { 6, 6, 1, 11, 2, 3, 4, 5, 7, 8, 9 };  // retry, then the scan
+  CHECK_EQ(sim.probed.size(), sizeof(want));
+  for (size_t i = 0; i < sizeof(want) && i < sim.probed.size(); ++i) CHECK_EQ(sim.probed[i], want[i]);
+  CHECK_EQ(sim.locked, 1);
+  CHECK_EQ(sim.s.channel(), 9);
+  CHECK(!sim.s.scanning());
+  CHECK_EQ(sim.s.stats().scans, 1u);
+  // nine probes timed out before the tenth was answered
+  CHECK(sim.s.stats().lastScanMs >= 9 * kCfg.probeWaitMs);
+  CHECK(sim.s.stats().lastScanMs <= 9 * kCfg.probeWaitMs + kReplyMs + 2 * kStepMs);
+
+  // 9 is home now: the next scan starts there
+  sim.lampCh = 1;
+  sim.probed.clear();
+  sim.run(5000);
+  const uint8_t again[] = { 9, 9, 1 };
+  CHECK_EQ(sim.probed.size(), sizeof(again));
+  for (size_t i = 0; i < sizeof(again) && i < sim.probed.size(); ++i) CHECK_EQ(sim.probed[i], again[i]);
+  CHECK_EQ(sim.s.channel(), 1);
+  CHECK_EQ(sim.locked, 2);
+}
+
+// A beacon heard on a new channel locks without a scan
+static void testBeacon() {
+  Sim sim(3);
+  CHECK_EQ(sim.s.onLamp(3, 10), A_NONE);
+  CHECK_EQ(sim.s.onLamp(0, 20), A_NONE);   // out of range: taken as the current channel
+  CHECK_EQ(sim.s.onLamp(11, 30), A_LOCKED);
+  CHECK_EQ(sim.s.channel(), 11);
+  CHECK_EQ(sim.s.stats().scans, 0u);
+}
+
+// No lamp at all: scans fail, back off doubling to the cap, and the node
+// stays on its home channel in between
+static void testLampGone() {
+  Sim sim(6);
+  sim.run(3000);
+  sim.lampUp = false;
+  std::vector<uint32_t> gaveUpAt, scanAt;
+  uint32_t scans = sim.s.stats().scans;
+  int gaveUp = sim.gaveUp;
+  for (uint32_t end = sim.now + 1200000; sim.now < end;) {
+    sim.step();
+    if (sim.s.stats().scans != scans) { scans = sim.s.stats().scans; scanAt.push_back(sim.now); }
+    if (sim.gaveUp != gaveUp) {
+      gaveUp = sim.gaveUp;
+      gaveUpAt.push_back(sim.now);
+      CHECK_EQ(sim.s.channel(), 6);
+    }
+    if (!sim.s.scanning()) CHECK_EQ(sim.s.channel(), 6);  // retries stay on home too
+  }
+  CHECK(scanAt.size() >= 6);
+  CHECK_EQ(sim.s.stats().failedScans, (uint32_t)gaveUpAt.size());
+  uint32_t backoff = kCfg.backoffMinMs;
+  for (size_t i = 0; i + 1 < scanAt.size() && i < gaveUpAt.size(); ++i) {
+    uint32_t gap = scanAt[i + 1] - gaveUpAt[i];
+    CHECK(gap >= backoff);
+    CHECK(gap <= backoff + kSendMs + 2 * kCfg.probeWaitMs + kStepMs);
+    // a full scan: every channel once
+    CHECK(gaveUpAt[i] - scanAt[i] >= 13 * kCfg.probeWaitMs);
+    backoff = backoff * 2 > kCfg.backoffMaxMs ? kCfg.backoffMaxMs : backoff * 2;
+  }
+
+  // the lamp comes back elsewhere: a scan within the capped backoff finds it
+  sim.lampUp = true;
+  sim.lampCh = 13;
+  sim.run(kCfg.backoffMaxMs + 10000);
+  CHECK_EQ(sim.s.channel(), 13);
+  CHECK_EQ(sim.locked, 1);
+}
+
+// A narrower band never probes outside it, and never twice per scan
+static void testBand() {
+  Config cfg = { 1, 11, 40, 10000, 300000 };
+  Scanner s(cfg);
+  s.begin(14, 0);  // stored home out of range
+  CHECK_EQ(s.channel(), 11);
+  s.onSent(0);
+  CHECK_EQ(s.poll(40), A_PROBE);  // retry
+  uint32_t t = 80;
+  bool seen[16] = {};
+  int probes = 0;
+  for (Action a = s.poll(t); a != A_GAVE_UP; a = s.poll(t += 40)) {
+    CHECK_EQ(a, A_PROBE);
+    uint8_t c = s.channel();
+    CHECK(c >= 1 && c <= 11);
+    CHECK(!seen[c]);
+    seen[c] = true;
+    probes++;
+  }
+  CHECK_EQ(probes, 11);
+  CHECK_EQ(s.channel(), 11);
+}
+
+int main() {
+  testSteady();
+  testSingleLoss();
+  testLampMoves();
+  testBeacon();
+  testLampGone();
+  testBand();
+  return Check::result("test_channel_scan");
+}
@@ -0,0 +1,158 @@
+// color_fade.h: the compile-time L* tables against the formulas in double,
+// interpolation endpoints, monotonicity and accuracy over every channel
+// pair, and Ramp progress at real frame rates.
+
+#include "check.h"
+#include "color_fade.h"
+
+using namespace ColorFade;
+
+// Reference mix: interpolate L* in double, back to duty
+static double s_refL[256];
+
+static double refMix(uint8_t a, uint8_t b, double t) {
+  return linear(s_refL[a] + (s_refL[b] - s_refL[a]) * t) * 255.0;
+}
+
+static void testTables() {
+  int worstTo = 0;
+  for (int v = 0; v < 256; ++v) {
+    int exact = (int)lround(lightness(v / 255.0) * kLMax);
+    int d = abs((int)toL((uint8_t)v) - exact);
+    if (d > worstTo) worstTo = d;
+    CHECK_EQ(fromL(toL((uint8_t)v)), v);  // a fade that has not moved yet shows the start
+  }
+  CHECK(worstTo <= 1);
+  for (int v = 1; v < 256; ++v) CHECK(toL((uint8_t)v) > toL((uint8_t)(v - 1)));
+
+  double worstFrom = 0;
+  uint8_t prev = 0;
+  for (uint32_t l = 0; l <= kLMax + 10; ++l) {
+    uint8_t d = fromL((uint16_t)l);
+    double exact = linear((l > kLMax ? kLMax : l) / (double)kLMax) * 255.0;
+    if (fabs(d - exact) > worstFrom) worstFrom = fabs(d - exact);
+    CHECK(d >= prev);
+    prev = d;
+  }
+  CHECK(worstFrom <= 1.0);
+  CHECK_EQ(fromL(0), 0);
+  CHECK_EQ(fromL(0xFFFF), 255);
+}
+
+static void testEndpoints() {
+  int bad = 0;
+  for (int a = 0; a < 256; ++a) {
+    for (int b = 0; b < 256; ++b) {
+      if (mix((uint8_t)a, (uint8_t)b, 0) != a) bad++;
+      if (mix((uint8_t)a, (uint8_t)b, 65536) != b) bad++;
+      if (mix((uint8_t)a, (uint8_t)b, 70000) != b) bad++;
+    }
+  }
+  CHECK_EQ(bad, 0);
+}
+
+// Every pair, 257 steps: never moves backwards, stays within one level
+// (plus rounding) of the unrounded double L* mix, symmetric in direction
+static void testAllPairs() {
+  int backwards = 0, symmetry = 0;
+  double worst = 0;
+  for (int a = 0; a < 256; ++a) {
+    for (int b = 0; b < 256; ++b) {
+      int prev = a;
+      for (uint32_t t = 0; t <= 65536; t += 256) {
+        int v = mix((uint8_t)a, (uint8_t)b, t);
+        if (b >= a ? v < prev : v > prev) backwards++;
+        prev = v;
+        double err = fabs(v - refMix((uint8_t)a, (uint8_t)b, t / 65536.0));
+        if (err > worst) worst = err;
+        if (abs(v - (int)mix((uint8_t)b, (uint8_t)a, 65536 - t)) > 1) symmetry++;
+      }
+    }
+  }
+  CHECK_EQ(backwards, 0);
+  CHECK(worst <= 1.5);
+  CHECK_EQ(symmetry, 0);
+}
+
+// Half way in lightness is far below half the duty (L* 50 = 18.4 % light)
+static void testPerceptual() {
+  uint8_t mid = mix(0, 255, 32768);
+  CHECK_NEAR(mid, 0.1842 * 255.0, 1.0);
+  CHECK(mix(255, 0, 32768) == mid);
+  // the first step out of black is small, not a jump
+  CHECK(mix(0, 255, 65536 / 100) <= 2);
+
+  // channels are mixed independently
+  uint32_t c = mixRgb(0xFF0000, 0x00FF00, 32768);
+  CHECK_EQ(c >> 16, mix(255, 0, 32768));
+  CHECK_EQ((c >> 8) & 0xFF, mid);
+  CHECK_EQ(c & 0xFF, 0u);
+  CHECK_EQ(mixRgb(0x123456, 0xABCDEF, 0), 0x123456u);
+  CHECK_EQ(mixRgb(0x123456, 0xABCDEF, 65536), 0xABCDEFu);
+}
+
+// Frames of dtUs until the ramp ends; progress never goes backwards
+static uint32_t runRamp(uint16_t ms, uint32_t dtUs, uint32_t& frames) {
+  Ramp r;
+  r.start(ms);
+  uint32_t prev = 0, elapsed = 0;
+  frames = 0;
+  bool ok = true;
+  while (r.active() && frames < 1000000) {
+    uint32_t t = r.advance(dtUs);
+    ok &= t >= prev && t <= 65536u;
+    prev = t;
+    elapsed += dtUs;
+    frames++;
+  }
+  CHECK(ok);
+  CHECK_EQ(prev, 65536u);
+  return elapsed;
+}
+
+static void testRamp() {
+  Ramp idle;
+  CHECK(!idle.active());
+  CHECK_EQ(idle.advance(1000), 65536u);
+  idle.start(0);
+  CHECK(!idle.active());
+
+  const uint32_t fps[] = { 20, 30, 60, 120, 240 };
+  const uint16_t durs[] = { 1, 100, 1500, 25400, 65535 };
+  for (uint32_t f : fps) {
+    uint32_t dt = 1000000 / f;
+    for (uint16_t d : durs) {
+      uint32_t frames;
+      uint32_t us = runRamp(d, dt, frames);
+      CHECK(us >= d * 1000u);  // never early...
+      CHECK(us < d * 1000u + dt);  // ...and at most one frame late
+    }
+  }
+
+  // progress tracks time, not frame count
+  Ramp r;
+  r.start(1000);
+  CHECK_EQ(r.advance(250000), 65536u / 4);
+  CHECK_EQ(r.advance(1000), (251u << 16) / 1000);
+  CHECK_EQ(r.advance(999), (251u << 16) / 1000);
+  CHECK_EQ(r.advance(100), (252u << 16) / 1000);  // sub-ms carried, not lost
+  CHECK_EQ(r.advance(900), (252u << 16) / 1000);
+  CHECK_EQ(r.advance(1), (253u << 16) / 1000);
+  r.stop();
+  CHECK(!r.active());
+
+  // a stalled frame jumps straight to the end
+  r.start(500);
+  CHECK_EQ(r.advance(10000000), 65536u);
+  CHECK(!r.active());
+}
+
+int main() {
+  for (int v = 0; v < 256; ++v) s_refL[v] = lightness(v / 255.0);
+  testTables();
+  testEndpoints();
+  testAllPairs();
+  testPerceptual();
+  testRamp();
+  return Check::result("test_color_fade");
+}
@@ -0,0 +1,61 @@
+// ct_math.h: the constexpr ln/exp/pow against <math.h>, and the index pack
+// used to bake tables.
+
+#include "check.h"
+#include "ct_math.h"
+
+template <uint16_t... I>
+struct Squares {
+  static constexpr uint16_t values[sizeof...(I)] = { (uint16_t)(I * I)... };
+};
+template <uint16_t... I>
+constexpr uint16_t Squares<I...>::values[sizeof...(I)];
+
+template <uint16_t... I>
+static const uint16_t* squares(CtMath::Seq<I...>) {
+  return Squares<I...>::values;
+}
+
+// Usable in constant expressions, which is the whole point
+static_assert(CtMath::toQ16(1.0) == 65535, "toQ16 saturates at 1");
+static_assert(CtMath::toQ16(-0.5) == 0, "toQ16 clamps negatives");
+static_assert(CtMath::pow(0.0, 2.2) == 0.0, "pow(0) is 0");
+static constexpr double kGammaHalf = CtMath::pow(0.5, 2.2);
+
+static void testLn() {
+  const double xs[] = { 1e-6, 0.001, 0.1, 0.5, 0.999, 1.0, 1.5, 2.0, 3.0, 10.0, 400.0, 65535.0, 1e6 };
+  for (double x : xs) CHECK_NEAR(CtMath::ln(x), log(x), 1e-12 * (1.0 + fabs(log(x))));
+}
+
+static void testExp() {
+  for (double y = -8.0; y <= 8.0; y += 0.25) CHECK_NEAR(CtMath::exp(y), exp(y), 1e-9 * exp(y));
+}
+
+static void testPow() {
+  // the gamma range the Mimir tables use
+  for (double p = 0.3; p <= 3.0; p += 0.1) {
+    for (double x = 0.0; x <= 1.0; x += 1.0 / 64) CHECK_NEAR(CtMath::pow(x, p), pow(x, p), 1e-9);
+  }
+  CHECK_NEAR(kGammaHalf, pow(0.5, 2.2), 1e-9);
+}
+
+static void testQ16() {
+  CHECK_EQ(CtMath::toQ16(0.0), 0);
+  CHECK_EQ(CtMath::toQ16(0.5), 32768);
+  CHECK_EQ(CtMath::toQ16(1.0 / 65535), 1);
+  CHECK_EQ(CtMath::toQ16(2.0), 65535);
+}
+
+static void testSeq() {
+  const uint16_t* sq = squares(CtMath::MakeSeq<16>::type());
+  for (uint16_t i = 0; i < 16; ++i) CHECK_EQ(sq[i], i * i);
+}
+
+int main() {
+  testLn();
+  testExp();
+  testPow();
+  testQ16();
+  testSeq();
+  return Check::result("test_ct_math");
+}
@@ -0,0 +1,122 @@
+// frame_scheduler.h on a virtual clock: the render task's pacing loop
+// (vTaskDelayUntil on a TickPacer grid) keeps the exact frame rate with
+// no drift, whatever the frame work costs, and restarts cleanly after an
+// overrun.
+
+#include "check.h"
+#include <Arduino.h>
+#include "frame_scheduler.h"
+#include <vector>
+
+struct Run {
+  FrameScheduler sched;
+  std::vector<uint64_t> startsUs;
+};
+
+// RenderTask::taskMain with the frame work replaced by advancing the clock
+static void renderLoop(Run& r, uint32_t frames, uint32_t (*workUs)(uint32_t frame), uint16_t fps = 60) {
+  vTaskDelay(1);
+  TickType_t lastWake = xTaskGetTickCount();
+  TickPacer pacer;
+  pacer.tickUs = portTICK_PERIOD_MS * 1000UL;
+  r.sched.begin(micros(), fps);
+
+  for (uint32_t i = 0; i < frames; ++i) {
+    r.startsUs.push_back(HostClock::us());
+    r.sched.frameStart(micros());
+    HostClock::advanceUs(workUs(i));
+    uint32_t waitUs = r.sched.frameEnd(micros());
+    if (waitUs) {
+      vTaskDelayUntil(&lastWake, (TickType_t)pacer.next(r.sched.periodUs));
+    } else {
+      vTaskDelay(1);
+      lastWake = xTaskGetTickCount();
+      pacer.reset();
+      r.sched.restart(micros());
+    }
+  }
+}
+
+static uint32_t work3ms(uint32_t) { return 3000; }
+static uint32_t workVaries(uint32_t i) { return (i * 7919u) % 15000u; }  // 0..15 ms, under the period
+static uint32_t workSpikes(uint32_t i) { return i >= 100 && i < 103 ? 40000 : 2000; }
+
+static void testPacer() {
+  TickPacer p;
+  CHECK_EQ(p.next(16666), 16u);  // 666 us carried
+  CHECK_EQ(p.next(16666), 17u);  // 332
+  CHECK_EQ(p.next(16666), 16u);  // 998
+  CHECK_EQ(p.next(16666), 17u);  // 664
+  p.reset();
+  uint32_t ticks = 0;
+  for (int i = 0; i < 600; ++i) ticks += p.next(16666);
+  CHECK(ticks >= 9999 && ticks <= 10000);  // 600 frames = 9.9996 s
+
+  TickPacer coarse;  // 100 Hz tick
+  coarse.tickUs = 10000;
+  CHECK_EQ(coarse.next(16666), 1u);
+  CHECK_EQ(coarse.next(16666), 2u);
+}
+
+static void testNoDrift(uint32_t (*work)(uint32_t)) {
+  Run r;
+  renderLoop(r, 6000, work);
+  CHECK_EQ(r.sched.stats.overruns, 0u);
+  uint64_t t0 = r.startsUs[0];
+  for (size_t k = 0; k < r.startsUs.size(); ++k) {
+    uint64_t ideal = t0 + (uint64_t)k * r.sched.periodUs;
+    // wakes are whole ticks, so within one tick of the ideal time, and never late
+    if (!CHECK(r.startsUs[k] <= ideal && ideal - r.startsUs[k] < 1000)) break;
+  }
+  // 100 s of frames end within a tick of 100 s
+  uint64_t span = r.startsUs.back() - t0;
+  CHECK(span + 1000 > 5999ull * r.sched.periodUs && span <= 5999ull * r.sched.periodUs + 1000);
+  CHECK(r.sched.stats.maxJitterUs < 1000);
+}
+
+static void testOverrun() {
+  Run r;
+  renderLoop(r, 400, workSpikes);
+  CHECK_EQ(r.sched.stats.overruns, 3u);
+  // no catch-up burst after the spike: frames stay a period apart (minus tick rounding)
+  for (size_t k = 104; k < r.startsUs.size(); ++k) {
+    uint64_t dt = r.startsUs[k] - r.startsUs[k - 1];
+    if (!CHECK(dt >= 16000 && dt <= 17000)) break;
+  }
+  // and the new grid is drift-free again
+  uint64_t t0 = r.startsUs[103];  // first frame after the restart
+  for (size_t k = 103; k < r.startsUs.size(); ++k) {
+    uint64_t ideal = t0 + (uint64_t)(k - 103) * r.sched.periodUs;
+    if (!CHECK(r.startsUs[k] <= ideal && ideal - r.startsUs[k] < 1000)) break;
+  }
+}
+
+static void testSchedulerStats() {
+  FrameScheduler s;
+  s.begin(1000, 50);
+  CHECK_EQ(s.periodUs, 20000u);
+  CHECK_EQ(s.frameStart(1000), 20000u);  // first dt = one period
+  CHECK_EQ(s.frameEnd(6000), 15000u);
+  CHECK_EQ(s.stats.lastWorkUs, 5000u);
+  CHECK_EQ(s.frameStart(21500), 20500u);
+  CHECK_EQ(s.stats.lastJitterUs, 500u);
+  CHECK_EQ(s.frameEnd(45000), 0u);       // ran past the 41000 deadline
+  CHECK_EQ(s.stats.overruns, 1u);
+  CHECK_EQ(s.deadlineUs, 45000u);
+
+  // wraps with micros()
+  s.begin(0xFFFFF000u, 60);
+  s.frameStart(0xFFFFF000u);
+  CHECK_EQ(s.frameEnd(0xFFFFF000u + 1000), s.periodUs - 1000);
+  CHECK_EQ(s.frameStart(0xFFFFF000u + s.periodUs), s.periodUs);
+  CHECK_EQ(s.stats.lastJitterUs, 0u);
+}
+
+int main() {
+  testPacer();
+  testNoDrift(work3ms);
+  testNoDrift(workVaries);
+  testOverrun();
+  testSchedulerStats();
+  return Check::result("test_frame_scheduler");
+}
@@ -0,0 +1,156 @@
+// gemini_stream.h: recorded chunked generateContent answers (test/data/*.chunked,
+// the expected model text next to them in *.txt) fed through ChunkedDecoder and
+// TextExtractor in socket-sized reads, from 1 byte to the whole body, then
+// compiled like runGeminiJob() does. Also damaged and cut-off streams.
+
+#include "check.h"
+#include "gemini_stream.h"
+#include "action_engine.h"
+#include "ai_state.h"
+#include "sketch_host.h"
+
+#include <string>
+
+static std::string load(const char* name) {
+  std::string path = std::string("data/") + name;
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) {
+    Check::fail(__FILE__, __LINE__, "");
+    fprintf(stderr, "cannot open %s\n", path.c_str());
+    return std::string();
+  }
+  std::string s;
+  char buf[1024];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) s.append(buf, n);
+  fclose(f);
+  return s;
+}
+
+struct Streamed {
+  bool done, failed, complete, truncated;
+  uint16_t parts;
+  uint32_t payload;
+  std::string text;
+};
+
+// What streamGeminiBody() does with each read
+static Streamed stream(const std::string& raw, size_t readLen, size_t cap = AI_TEXT_MAX + 1) {
+  std::string text(cap, '\0');
+  GeminiStream::ChunkedDecoder dec;
+  GeminiStream::TextExtractor ext(&text[0], cap);
+  uint8_t buf[AI_READ_CHUNK];
+  if (readLen > sizeof(buf)) readLen = sizeof(buf);
+  for (size_t i = 0; i < raw.size() && !dec.done() && !dec.failed(); i += readLen) {
+    size_t n = raw.size() - i < readLen ? raw.size() - i : readLen;
+    memcpy(buf, raw.data() + i, n);
+    size_t m = dec.feed(buf, n);
+    if (!ext.complete() && !ext.failed()) ext.feed(buf, m);
+  }
+  return { dec.done(), dec.failed(), ext.complete(), ext.truncated(), ext.parts(), dec.payloadBytes(),
+           std::string(text.c_str(), ext.length()) };
+}
+
+static const size_t kReads[] = { 1, 2, 7, 64, 511, AI_READ_CHUNK };
+
+static void testRecorded(const char* name, uint16_t parts, uint8_t actions) {
+  std::string raw = load((std::string(name) + ".chunked").c_str());
+  std::string want = load((std::string(name) + ".txt").c_str());
+  if (raw.empty() || want.empty()) return;
+  for (size_t r : kReads) {
+    Streamed s = stream(raw, r);
+    CHECK(s.done);
+    CHECK(s.complete);
+    CHECK(!s.truncated);
+    CHECK_EQ(s.parts, parts);
+    if (!CHECK(s.text == want)) fprintf(stderr, "  %s, %u-byte reads: got \"%s\"\n", name, (unsigned)r, s.text.c_str());
+  }
+
+  // the model text holds the actions object, maybe fenced or with prose around it
+  Streamed s = stream(raw, AI_READ_CHUNK);
+  size_t off = 0, len = 0;
+  CHECK(GeminiStream::objectSpan(s.text.c_str(), s.text.size(), off, len));
+  Actions::Batch b;
+  String err;
+  CHECK(Actions::compileText(s.text.c_str() + off, len, b, err));
+  CHECK_EQ(b.count, actions);
+  CHECK_EQ(b.skipped, 0);
+}
+
+static void testCutOff() {
+  std::string raw = load("gemini_actions.chunked");
+  std::string want = load("gemini_actions.txt");
+  if (raw.empty()) return;
+  for (size_t cut = 0; cut < raw.size(); cut += 17) {
+    Streamed s = stream(raw.substr(0, cut), 64);
+    CHECK(!s.done);
+    CHECK(!s.failed);
+    CHECK(want.compare(0, s.text.size(), s.text) == 0);  // a prefix of the text, nothing else
+  }
+  // the JSON root closes before the final chunk: the text is already whole
+  Streamed s = stream(raw.substr(0, raw.size() - 5), 64);
+  CHECK(!s.done);
+  CHECK(s.complete);
+  CHECK(s.text == want);
+}
+
+static void testDamaged() {
+  std::string raw = load("gemini_actions.chunked");
+  if (raw.empty()) return;
+
+  std::string bad = raw;
+  bad[0] = 'z';  // chunk size is not hex
+  Streamed s = stream(bad, 64);
+  CHECK(s.failed);
+  CHECK(s.text.empty());
+
+  bad = raw;
+  size_t crlf = bad.find("\r\n", bad.find("\r\n") + 2);  // end of the first chunk's data
+  bad[crlf] = 'x';
+  s = stream(bad, 64);
+  CHECK(s.failed);
+
+  std::string huge = "fffffffff\r\n" + raw;  // does not fit 32 bits
+  CHECK(stream(huge, 64).failed);
+  CHECK(stream("\r\n" + raw, 64).failed);  // empty size line
+}
+
+// Trailers after the last chunk, and the next answer on a kept connection
+static void testTrailersAndPipelined() {
+  std::string raw = load("gemini_unicode.chunked");
+  std::string want = load("gemini_unicode.txt");
+  if (raw.size() < 5) return;
+  std::string withTrailer = raw.substr(0, raw.size() - 2) + "X-Server-Timing: 812\r\nX-Other: 1\r\n\r\n";
+  Streamed s = stream(withTrailer, 7);
+  CHECK(s.done);
+  CHECK(s.text == want);
+
+  GeminiStream::ChunkedDecoder dec;
+  std::string buf = raw + raw;
+  size_t m = dec.feed((uint8_t*)&buf[0], buf.size());
+  CHECK(dec.done());
+  CHECK_EQ(m, dec.payloadBytes());  // stops at the end of the first body
+  CHECK_EQ(stream(raw, 64).payload, dec.payloadBytes());
+}
+
+static void testSmallBuffer() {
+  std::string raw = load("gemini_parts.chunked");
+  std::string want = load("gemini_parts.txt");
+  if (raw.empty()) return;
+  Streamed s = stream(raw, 64, 32);
+  CHECK(s.truncated);
+  CHECK(s.complete);
+  CHECK_EQ(s.text.size(), 31u);
+  CHECK(want.compare(0, 31, s.text) == 0);
+}
+
+int main() {
+  testRecorded("gemini_actions", 1, 2);
+  testRecorded("gemini_parts", 3, 2);
+  testRecorded("gemini_unicode", 1, 2);
+  testCutOff();
+  testDamaged();
+  testTrailersAndPipelined();
+  testSmallBuffer();
+  return Check::result("test_gemini_stream");
+}
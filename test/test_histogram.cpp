@@ -0,0 +1,52 @@
+// histogram.h: bucket edges, quantiles capped at the max, sums.
+
+#include "check.h"
+#include "histogram.h"
+
+static void testBuckets() {
+  CHECK_EQ(Histogram::bucketOf(0), 0);
+  CHECK_EQ(Histogram::bucketOf(4), 0);
+  CHECK_EQ(Histogram::bucketOf(5), 1);
+  for (uint8_t i = 0; i < Histogram::kBounds; ++i) {
+    uint32_t b = Histogram::boundUs(i);
+    CHECK_EQ(Histogram::bucketOf(b), i);  // bounds are inclusive
+    CHECK_EQ(Histogram::bucketOf(b + 1), i + 1);
+  }
+  CHECK_EQ(Histogram::bucketOf(0xFFFFFFFFu), +Histogram::kBounds);
+}
+
+static void testQuantiles() {
+  Histogram h;
+  CHECK_EQ(h.quantileUs(0.5f), 0u);
+  CHECK_EQ(h.avgUs(), 0u);
+
+  for (int i = 0; i < 90; ++i) h.record(10);    // bucket <= 16
+  for (int i = 0; i < 9; ++i) h.record(1000);   // bucket <= 1024
+  h.record(50000);                              // bucket <= 65536
+  CHECK_EQ(h.count, 100u);
+  CHECK_EQ(h.maxUs, 50000u);
+  CHECK_EQ(h.sumUs, 90u * 10 + 9u * 1000 + 50000);
+  CHECK_EQ(h.quantileUs(0.5f), 16u);
+  CHECK_EQ(h.quantileUs(0.9f), 16u);
+  CHECK_EQ(h.quantileUs(0.95f), 1024u);
+  CHECK_EQ(h.quantileUs(1.0f), 50000u);  // capped at the max, not the bucket bound
+  CHECK_EQ(h.avgUs(), (90u * 10 + 9u * 1000 + 50000) / 100);
+
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < Histogram::kBuckets; ++i) total += h.counts[i];
+  CHECK_EQ(total, h.count);
+}
+
+static void testOverflowBucket() {
+  Histogram h;
+  h.record(0xFFFFFFFFu);
+  CHECK_EQ(h.counts[+Histogram::kBounds], 1u);
+  CHECK_EQ(h.quantileUs(0.5f), 0xFFFFFFFFu);
+}
+
+int main() {
+  testBuckets();
+  testQuantiles();
+  testOverflowBucket();
+  return Check::result("test_histogram");
+}
@@ -0,0 +1,146 @@
+// intent_parser.h: the prompt corpus in test/data/intents.txt, edge cases that
+// do not fit a text line, and how long a parse takes on the host.
+
+#include "check.h"
+#include "intent_parser.h"
+#include "sketch_host.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct Case {
+  std::string prompt;
+  std::string want;
+  int line;
+};
+
+static std::vector<Case> loadCorpus() {
+  std::vector<Case> out;
+  FILE* f = fopen("data/intents.txt", "rb");
+  if (!f) {
+    Check::fail(__FILE__, __LINE__, "cannot open data/intents.txt\n");
+    return out;
+  }
+  char line[256];
+  for (int no = 1; fgets(line, sizeof(line), f); ++no) {
+    std::string s(line);
+    while (!s.empty() && (s.back() == '\n' || s.back() == '\r')) s.pop_back();
+    if (s.empty() || s.compare(0, 2, "//") == 0) continue;
+    size_t arrow = s.find(" => ");
+    if (arrow == std::string::npos) {
+      Check::fail(__FILE__, __LINE__, "");
+      fprintf(stderr, "intents.txt:%d: no \" => \"\n", no);
+      continue;
+    }
+    out.push_back({ s.substr(0, arrow), s.substr(arrow + 4), no });
+  }
+  fclose(f);
+  return out;
+}
+
+// Effect ids back to their first (canonical) name
+static const char* effectName(uint32_t id) {
+  for (const NameHash::Entry& e : EFFECT_KV) {
+    if (e.value == id) return e.key;
+  }
+  return "?";
+}
+
+static std::string describe(bool ok, const Actions::Batch& b) {
+  if (!ok) return "gemini";
+  std::string s;
+  char tmp[48];
+  for (uint8_t i = 0; i < b.count; ++i) {
+    const Actions::Command& c = b.cmds[i];
+    switch (c.type) {
+      case Actions::CMD_MIMIR: snprintf(tmp, sizeof(tmp), "mimir=%s", c.a ? "on" : "off"); break;
+      case Actions::CMD_COLOR: snprintf(tmp, sizeof(tmp), "color=#%06X", (unsigned)c.value); break;
+      case Actions::CMD_EFFECT: snprintf(tmp, sizeof(tmp), "effect=%s", effectName(c.value)); break;
+      case Actions::CMD_BRIGHTNESS: snprintf(tmp, sizeof(tmp), "brightness=%u", (unsigned)c.a); break;
+      case Actions::CMD_POWER: snprintf(tmp, sizeof(tmp), "power=%s", c.a ? "on" : "off"); break;
+      default: snprintf(tmp, sizeof(tmp), "type%u", (unsigned)c.type); break;
+    }
+    if (!s.empty()) s += ' ';
+    s += tmp;
+  }
+  return s;
+}
+
+static std::string run(const std::string& prompt) {
+  Actions::Batch b;
+  bool ok = Intent::parse(prompt.c_str(), prompt.size(), b);
+  if (ok) {
+    CHECK(b.count > 0);
+    CHECK_EQ(b.skipped, 0);
+    for (uint8_t i = 0; i < b.count; ++i) CHECK_EQ(b.cmds[i].fade, 0);  // fades are the caller's
+  }
+  return describe(ok, b);
+}
+
+static void testCorpus(const std::vector<Case>& corpus) {
+  CHECK(corpus.size() >= 50);
+  for (const Case& c : corpus) {
+    std::string got = run(c.prompt);
+    if (got != c.want) {
+      Check::fail(__FILE__, __LINE__, "");
+      fprintf(stderr, "intents.txt:%d: \"%s\" gave \"%s\", want \"%s\"\n", c.line, c.prompt.c_str(), got.c_str(),
+              c.want.c_str());
+    }
+  }
+}
+
+static void testEdges() {
+  CHECK(run("") == "gemini");
+  CHECK(run("   ") == "gemini");
+  CHECK(run("!?") == "gemini");
+  std::string longest = "red" + std::string(INTENT_TEXT_MAX - 3, ' ');
+  CHECK(run(longest) == "color=#FF0000 power=on");
+  CHECK(run(longest + " ") == "gemini");  // over INTENT_TEXT_MAX: not even looked at
+  CHECK(run(std::string("red\0blue", 8)) == "gemini");  // nothing after a NUL is silently dropped
+
+  // the String overload and non-terminated input
+  Actions::Batch b;
+  CHECK(Intent::parse(String("rainbow"), b));
+  const char buf[] = { 'o', 'f', 'f', 'x' };
+  CHECK(Intent::parse(buf, 3, b));
+  CHECK_EQ(b.cmds[0].type, Actions::CMD_POWER);
+
+  // what the parser emits is what /applyPreset would compile
+  CHECK(Intent::parse(String("warm white at 30%"), b));
+  for (uint8_t i = 0; i < b.count; ++i) {
+    DynamicJsonDocument doc(256);
+    Actions::toJson(b.cmds[i], doc.to<JsonObject>());
+    Actions::Command again;
+    CHECK(Actions::compileOne(doc.as<JsonObjectConst>(), again));
+    CHECK(memcmp(&again, &b.cmds[i], sizeof(again)) == 0);
+  }
+}
+
+// "Microseconds instead of a round trip": the whole corpus, many times over.
+// The bound is loose enough for sanitizer builds; the /bench intent_parse
+// case has the device number.
+static void testLatency(const std::vector<Case>& corpus) {
+  if (corpus.empty()) return;
+  const int kRounds = 2000;
+  uint32_t sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < kRounds; ++r) {
+    for (const Case& c : corpus) {
+      Actions::Batch b;
+      sink += Intent::parse(c.prompt.c_str(), c.prompt.size(), b) ? b.count : 0;
+    }
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  double perParse = ns / ((double)kRounds * corpus.size());
+  fprintf(stderr, "intent parse: %.0f ns/prompt (%u)\n", perParse, (unsigned)(sink & 1));
+  CHECK(perParse < 20000.0);
+}
+
+int main() {
+  std::vector<Case> corpus = loadCorpus();
+  testCorpus(corpus);
+  testEdges();
+  testLatency(corpus);
+  return Check::result("test_intent_parser");
+}
@@ -0,0 +1,50 @@
+// led_control.h on a virtual clock: brightness smoothing depends on
+// elapsed time, not on how often tick() runs.
+
+#include "check.h"
+#include "led_control.h"
+#include "sketch_host.h"
+
+// Settle at `from`, then head for `to` for about `ms` at `fps`; returns the
+// brightness reached and the exact time it took
+static uint8_t smoothFor(uint8_t from, uint8_t to, uint32_t ms, uint16_t fps, double& elapsedMs) {
+  LedControl::setTargetBrightness(from);
+  for (int i = 0; i < 400; ++i) LedControl::tick(10000);
+  CHECK_EQ(LedControl::getCurrentBrightness(), from);
+
+  LedControl::setTargetBrightness(to);
+  uint32_t periodUs = 1000000UL / fps;
+  uint32_t frames = ms * 1000UL / periodUs;
+  for (uint32_t i = 0; i < frames; ++i) LedControl::tick(periodUs);
+  elapsedMs = frames * periodUs / 1000.0;
+  return LedControl::getCurrentBrightness();
+}
+
+static void testRateIndependent() {
+  LedControl::init();
+  LedControl::setOn(true);
+  // exponential approach with tau = SMOOTHING_TAU_MS whatever the frame rate
+  const uint16_t rates[] = { 20, 30, 60, 120, 240 };
+  for (uint16_t fps : rates) {
+    double t;
+    uint8_t got = smoothFor(10, 200, 240, fps, t);
+    CHECK_NEAR(got, 10 + 190 * (1 - exp(-t / SMOOTHING_TAU_MS)), 1.0);
+    got = smoothFor(200, 10, 120, fps, t);
+    CHECK_NEAR(got, 200 - 190 * (1 - exp(-t / SMOOTHING_TAU_MS)), 1.0);
+  }
+}
+
+static void testOffStaysOff() {
+  LedControl::setOn(false);
+  for (int i = 0; i < 100; ++i) LedControl::tick(16666);
+  CHECK_EQ(LedControl::getCurrentBrightness(), 0);
+  CHECK_EQ(LedControl::ws.pixel(0), 0u);
+  LedControl::setOn(true);
+  CHECK(LedControl::getCurrentBrightness() > 0);
+}
+
+int main() {
+  testRateIndependent();
+  testOffStaysOff();
+  return Check::result("test_led_control");
+}
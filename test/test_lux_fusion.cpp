@@ -0,0 +1,152 @@
+// lux_fusion.h: fusion modes, staleness and fallback, presence leases,
+// slot reuse and the change counter that keys the /status cache.
+
+#include "check.h"
+#include "lux_fusion.h"
+
+static const uint8_t kMacA[6] = { 0xA, 0, 0, 0, 0, 1 };
+static const uint8_t kMacB[6] = { 0xA, 0, 0, 0, 0, 2 };
+static const uint8_t kMacC[6] = { 0xA, 0, 0, 0, 0, 3 };
+
+static void testModes() {
+  LuxFusion::Table t;
+  t.update(kMacA, 10.0f, LuxFusion::kNoMotion, -50, 1000);
+  t.update(kMacB, 30.0f, LuxFusion::kNoMotion, -50, 1000);
+  t.update(kMacC, 200.0f, LuxFusion::kNoMotion, -50, 1000);
+
+  t.mode = LuxFusion::FUSE_MEDIAN;
+  LuxFusion::Result r = t.fuse(1000);
+  CHECK(r.luxFresh);
+  CHECK_EQ(r.fresh, 3);
+  CHECK_EQ(r.total, 3);
+  CHECK_NEAR(r.lux, 30.0f, 1e-6);
+
+  t.mode = LuxFusion::FUSE_MAX;
+  CHECK_NEAR(t.fuse(1000).lux, 200.0f, 1e-6);
+
+  // equal ages: the weighted mean is the plain mean
+  t.mode = LuxFusion::FUSE_WEIGHTED;
+  CHECK_NEAR(t.fuse(1000).lux, 80.0f, 1e-3);
+
+  // an older reading weighs less
+  t.update(kMacC, 200.0f, LuxFusion::kNoMotion, -50, 1000);
+  t.update(kMacA, 10.0f, LuxFusion::kNoMotion, -50, 6000);
+  t.update(kMacB, 30.0f, LuxFusion::kNoMotion, -50, 6000);
+  CHECK(t.fuse(6000).lux < 80.0f);
+
+  // even count: median of the middle pair
+  LuxFusion::Table t2;
+  t2.update(kMacA, 10.0f, LuxFusion::kNoMotion, 0, 0);
+  t2.update(kMacB, 20.0f, LuxFusion::kNoMotion, 0, 0);
+  CHECK_NEAR(t2.fuse(0).lux, 15.0f, 1e-6);
+
+  CHECK_EQ(LuxFusion::modeFromName("weighted"), LuxFusion::FUSE_WEIGHTED);
+  CHECK_EQ(LuxFusion::modeFromName("bogus"), -1);
+  CHECK_STREQ(LuxFusion::modeName(LuxFusion::FUSE_MAX), "max");
+}
+
+static void testStaleFallback() {
+  LuxFusion::Table t;
+  t.update(kMacA, 123.0f, LuxFusion::kNoMotion, 0, 0);
+  CHECK_NEAR(t.fuse(LUX_NODE_TIMEOUT_MS - 1).lux, 123.0f, 1e-6);
+
+  t.fallback = LuxFusion::FALLBACK_FIXED;
+  LuxFusion::Result r = t.fuse(LUX_NODE_TIMEOUT_MS);
+  CHECK(!r.luxFresh);
+  CHECK_EQ(r.fresh, 0);
+  CHECK_EQ(r.total, 1);
+  CHECK(t.isStale(0, LUX_NODE_TIMEOUT_MS));
+  CHECK_NEAR(r.lux, LUX_FALLBACK_LUX, 1e-6);
+
+  t.fallback = LuxFusion::FALLBACK_HOLD;
+  CHECK_NEAR(t.fuse(LUX_NODE_TIMEOUT_MS).lux, 123.0f, 1e-6);
+
+  // forgotten after LUX_NODE_FORGET_MS
+  CHECK_EQ(t.fuse(LUX_NODE_FORGET_MS).total, 0);
+  CHECK(!t.node(0).used);
+}
+
+static void testLowPowerTimeout() {
+  LuxFusion::Table t;
+  t.acceptSeq(kMacA, 7, 1, true, 0);
+  t.update(kMacA, 40.0f, LuxFusion::kNoMotion, 0, 0);
+  CHECK(t.fuse(LUX_NODE_TIMEOUT_MS + 1000).luxFresh);
+  CHECK(!t.fuse(LUX_LP_NODE_TIMEOUT_MS).luxFresh);
+  CHECK_EQ(t.node(0).nodeId, 7);
+}
+
+static void testPresenceLease() {
+  LuxFusion::Table t;
+  LuxFusion::Result r = t.fuse(0);
+  CHECK(!r.presenceKnown);
+
+  t.update(kMacA, -1.0f, 1, 0, 1000);  // motion only, no lux reading
+  r = t.fuse(1000);
+  CHECK(r.presenceKnown);
+  CHECK(r.occupied);
+  CHECK_EQ(r.fresh, 0);
+
+  // "no motion" refreshes the node but not the lease
+  t.update(kMacA, -1.0f, 0, 0, 5000);
+  CHECK(!t.fuse(5000).occupied);
+  // a motion report holds for the lease while the node keeps sending lux only
+  t.update(kMacA, -1.0f, 1, 0, 6000);
+  for (uint32_t ms = 8000; ms < 6000 + PRESENCE_LEASE_MS; ms += 2000) {
+    t.update(kMacA, 20.0f, LuxFusion::kNoMotion, 0, ms);
+    CHECK(t.fuse(ms).occupied);
+  }
+  t.update(kMacA, 20.0f, LuxFusion::kNoMotion, 0, 6000 + PRESENCE_LEASE_MS);
+  r = t.fuse(6000 + PRESENCE_LEASE_MS);
+  CHECK(r.presenceKnown);
+  CHECK(!r.occupied);
+}
+
+static void testClaimAndFull() {
+  LuxFusion::Table t;
+  uint8_t mac[6] = { 0xB, 0, 0, 0, 0, 0 };
+  for (uint8_t i = 0; i < LuxFusion::Table::capacity(); ++i) {
+    mac[5] = i;
+    CHECK(t.update(mac, i, LuxFusion::kNoMotion, 0, 100));
+  }
+  mac[5] = 0xEE;
+  CHECK(!t.update(mac, 1.0f, LuxFusion::kNoMotion, 0, 200));  // all live
+
+  // the longest-silent stale node gives up its slot
+  for (uint8_t i = 1; i < LuxFusion::Table::capacity(); ++i) {
+    uint8_t m[6] = { 0xB, 0, 0, 0, 0, i };
+    t.update(m, i, LuxFusion::kNoMotion, 0, 5000);
+  }
+  CHECK(t.update(mac, 1.0f, LuxFusion::kNoMotion, 0, 100 + LUX_NODE_TIMEOUT_MS));
+  CHECK_EQ(t.node(0).mac[5], 0xEE);
+}
+
+static void testSeqAndChanges() {
+  LuxFusion::Table t;
+  uint32_t c0 = t.changes();
+  CHECK(t.acceptSeq(kMacA, 1, 10, false, 0));
+  CHECK(!t.acceptSeq(kMacA, 1, 10, false, 0));  // duplicate
+  CHECK(t.acceptSeq(kMacA, 1, 13, false, 0));   // two lost
+  CHECK_EQ(t.node(0).seq.lost, 2u);
+  CHECK_EQ(t.node(0).seq.dups, 1u);
+  uint32_t c1 = t.changes();
+  CHECK(c1 > c0);
+
+  t.update(kMacA, 5.0f, LuxFusion::kNoMotion, 0, 0);
+  t.fuse(0);
+  uint32_t c2 = t.changes();
+  CHECK(c2 > c1);
+  t.fuse(1);
+  CHECK_EQ(t.changes(), c2);  // nothing happened
+  t.fuse(LUX_NODE_TIMEOUT_MS);
+  CHECK(t.changes() > c2);    // went stale
+}
+
+int main() {
+  testModes();
+  testStaleFallback();
+  testLowPowerTimeout();
+  testPresenceLease();
+  testClaimAndFull();
+  testSeqAndChanges();
+  return Check::result("test_lux_fusion");
+}
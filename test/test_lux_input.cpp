@@ -0,0 +1,76 @@
+// lux_input.h / status_cache.h: the node table in /status. The formatters
+// must cope with any buffer size (down to 0), and a table that does not
+// fit is dropped instead of leaving /status as broken JSON. The status
+// buffer is shrunk here so the overflow path is reachable.
+
+#define STATUS_JSON_MAX 420
+
+#include "check.h"
+#include "led_control.h"
+#include "lux_input.h"
+#include "status_cache.h"
+#include "sketch_host.h"
+#include <ArduinoJson.h>
+
+static void addNode(uint8_t i, float lux) {
+  uint8_t mac[6] = { 0x5E, 0x1A, 0, 0, 0, i };
+  LuxWire::Frame f = {};
+  f.type = LuxWire::T_SAMPLES;
+  f.flags = LuxWire::F_CRC;
+  f.nodeId = i;
+  f.seq = 1;
+  f.count = 1;
+  f.samples[0].lux = lux;
+  uint8_t buf[LuxWire::kMaxFrame];
+  size_t n = LuxWire::encode(f, buf, sizeof(buf));
+  LuxInput::onReceive(mac, -60, buf, (int)n);
+}
+
+static bool validJson(const char* s, size_t len) {
+  DynamicJsonDocument doc(4096);
+  return !deserializeJson(doc, s, len) && doc.is<JsonObjectConst>();
+}
+
+static void testTinyBuffers() {
+  char buf[16];
+  memset(buf, 'x', sizeof(buf));
+  CHECK_EQ(LedControl::formatStatus(buf, 0, "AP"), 0u);
+  CHECK_EQ(buf[0], 'x');
+  CHECK_EQ(LedControl::formatStatus(buf, 1, "AP"), 0u);
+  CHECK_EQ(buf[0], '\0');
+  CHECK_EQ(LedControl::formatStatus(buf, sizeof(buf), "AP"), sizeof(buf) - 1);
+  CHECK_EQ(strlen(buf), sizeof(buf) - 1);
+
+  memset(buf, 'x', sizeof(buf));
+  CHECK_EQ(LuxInput::formatNodes(buf, 0), 0u);
+  CHECK_EQ(buf[0], 'x');
+  CHECK_EQ(LuxInput::formatNodes(buf, 1), 0u);
+  CHECK_EQ(LuxInput::formatNodes(buf, 8), 7u);
+}
+
+static void testSplice() {
+  const StatusCache::Entry& e = StatusCache::get();
+  CHECK_EQ(e.len, strlen(e.json));
+  CHECK(validJson(e.json, e.len));
+  CHECK(strstr(e.json, "\"nodes\":[]") != nullptr);
+
+  // eight nodes do not fit in 420 bytes: /status goes out without the table
+  for (uint8_t i = 0; i < LUX_NODES_MAX; ++i) addNode(i, 10.0f * i);
+  HostClock::advanceMs(10);
+  LuxInput::drain();
+  LuxInput::drain();
+  const StatusCache::Entry& full = StatusCache::get();
+  CHECK(full.version != e.version || full.nodes != e.nodes);
+  CHECK_EQ(full.len, strlen(full.json));
+  CHECK(full.len < sizeof(full.json));
+  CHECK(validJson(full.json, full.len));
+  CHECK(strstr(full.json, "\"nodes\"") == nullptr);
+  CHECK(strstr(full.json, "\"color\"") != nullptr);
+}
+
+int main() {
+  LedControl::init();
+  testTinyBuffers();
+  testSplice();
+  return Check::result("test_lux_input");
+}
@@ -0,0 +1,201 @@
+// lux_packet.h: v2 and legacy round trips, then decode fuzzing. Random
+// bytes and damaged copies of valid frames must never be accepted as
+// something they are not. Each input sits in an exact-size heap buffer,
+// so a HOST_SANITIZE build also catches any read past the end.
+
+#include "check.h"
+#include "lux_packet.h"
+
+#include <vector>
+
+using namespace LuxWire;
+
+// xorshift32: fixed seed, same inputs every run
+static uint32_t s_rng = 0x2545F491u;
+static uint32_t rnd() {
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 17;
+  s_rng ^= s_rng << 5;
+  return s_rng;
+}
+
+static Status decodeExact(const uint8_t* buf, size_t len, Frame& f) {
+  std::vector<uint8_t> copy(buf, buf + len);
+  return decode(copy.data(), len, f);
+}
+
+static Frame samplesFrame(uint8_t count, uint8_t flags) {
+  Frame f;
+  memset(&f, 0, sizeof(f));
+  f.type = T_SAMPLES;
+  f.flags = flags;
+  f.nodeId = 0xBEEF;
+  f.seq = 0xFFFE;
+  f.count = count;
+  for (uint8_t i = 0; i < count; ++i) {
+    f.samples[i].lux = i == 1 ? -1.0f : (float)(rnd() % 100000) / 100.0f;
+    f.samples[i].motion = (uint8_t)(i & 3);
+    f.samples[i].ageMs = (uint16_t)(i * 1000 + 7);
+  }
+  return f;
+}
+
+static bool sameSamples(const Frame& a, const Frame& b) {
+  if (a.count != b.count) return false;
+  for (uint8_t i = 0; i < a.count; ++i) {
+    if (luxToCenti(a.samples[i].lux) != luxToCenti(b.samples[i].lux)) return false;
+    if (a.samples[i].motion != b.samples[i].motion || a.samples[i].ageMs != b.samples[i].ageMs) return false;
+  }
+  return true;
+}
+
+static void testRoundTrip() {
+  uint8_t buf[kMaxFrame];
+  for (uint8_t count = 1; count <= LUXW_MAX_SAMPLES; ++count) {
+    for (uint8_t flags : { (uint8_t)0, (uint8_t)F_CRC, (uint8_t)(F_CRC | F_LOW_POWER | F_ACK_REQ) }) {
+      Frame in = samplesFrame(count, flags), out;
+      size_t len = encode(in, buf, sizeof(buf));
+      CHECK_EQ(len, frameLen(T_SAMPLES, count, (flags & F_CRC) != 0));
+      CHECK_EQ(decodeExact(buf, len, out), OK);
+      CHECK(!out.legacy);
+      CHECK_EQ(out.flags, flags);
+      CHECK_EQ(out.nodeId, 0xBEEF);
+      CHECK_EQ(out.seq, 0xFFFE);
+      CHECK(sameSamples(in, out));
+      if (count > 1) CHECK(out.samples[1].lux < 0);  // no reading survives as such
+    }
+  }
+
+  Frame c;
+  memset(&c, 0, sizeof(c));
+  c.type = T_ACK;
+  c.flags = F_CRC;
+  c.nodeId = 12;
+  c.seq = 345;
+  c.channel = 11;
+  c.count = 9;  // ignored for control frames
+  size_t len = encode(c, buf, sizeof(buf));
+  CHECK_EQ(len, kHeaderLen + kControlLen + kCrcLen);
+  Frame out;
+  CHECK_EQ(decodeExact(buf, len, out), OK);
+  CHECK_EQ(out.type, T_ACK);
+  CHECK_EQ(out.channel, 11);
+  CHECK_EQ(out.count, 0);
+
+  // encode refuses what decode would refuse
+  Frame bad = samplesFrame(1, 0);
+  bad.count = 0;
+  CHECK_EQ(encode(bad, buf, sizeof(buf)), 0u);
+  bad.count = LUXW_MAX_SAMPLES + 1;
+  CHECK_EQ(encode(bad, buf, sizeof(buf)), 0u);
+  bad = samplesFrame(1, 0);
+  bad.type = 9;
+  CHECK_EQ(encode(bad, buf, sizeof(buf)), 0u);
+  bad.type = T_SAMPLES;
+  CHECK_EQ(encode(bad, buf, kHeaderLen + kSampleLen - 1), 0u);
+
+  // lux saturates below the "no reading" marker
+  CHECK_EQ(luxToCenti(1e9f), kNoLux - 1);
+  CHECK_EQ(luxToCenti(NAN), kNoLux);
+}
+
+static void testLegacy() {
+  Frame f;
+  struct { float lux; uint8_t motion; uint8_t pad[3]; } old = { 42.5f, 1, {0, 0, 0} };
+  CHECK_EQ(decodeExact((const uint8_t*)&old, 8, f), OK);
+  CHECK(f.legacy);
+  CHECK_NEAR(f.samples[0].lux, 42.5, 1e-6);
+  CHECK_EQ(f.samples[0].motion, M_VALID | M_MOTION);
+  float bare = 3.25f;
+  CHECK_EQ(decodeExact((const uint8_t*)&bare, 4, f), OK);
+  CHECK_NEAR(f.samples[0].lux, 3.25, 1e-6);
+  CHECK_EQ(f.samples[0].motion, 0);
+  CHECK_EQ(decodeExact((const uint8_t*)"123.5", 5, f), OK);
+  CHECK_NEAR(f.samples[0].lux, 123.5, 1e-4);
+  CHECK_EQ(decodeExact((const uint8_t*)"12a", 3, f), E_LEGACY);
+  CHECK_EQ(decodeExact((const uint8_t*)"-", 1, f), E_LEGACY);
+  CHECK_EQ(decodeExact((const uint8_t*)"", 0, f), E_LEGACY);
+  CHECK_EQ(decodeExact((const uint8_t*)"1234567890123456", 16, f), E_LEGACY);
+}
+
+// Every prefix of a valid frame is rejected
+static void testTruncated() {
+  uint8_t buf[kMaxFrame];
+  Frame in = samplesFrame(LUXW_MAX_SAMPLES, F_CRC), out;
+  size_t len = encode(in, buf, sizeof(buf));
+  int accepted = 0;
+  for (size_t n = 0; n < len; ++n) {
+    if (decodeExact(buf, n, out) == OK) accepted++;
+  }
+  CHECK_EQ(accepted, 0);
+}
+
+// Any single bit flipped in a CRC frame is caught. The one exception is
+// clearing F_CRC itself: the frame then reads as an unchecked one with the
+// CRC as trailing bytes, and its samples are unchanged.
+static void testBitFlips() {
+  uint8_t buf[kMaxFrame];
+  int accepted = 0, wrong = 0;
+  for (uint8_t count = 1; count <= LUXW_MAX_SAMPLES; count += 5) {
+    Frame in = samplesFrame(count, F_CRC), out;
+    size_t len = encode(in, buf, sizeof(buf));
+    for (size_t i = 0; i < len; ++i) {
+      for (int bit = 0; bit < 8; ++bit) {
+        buf[i] ^= (uint8_t)(1 << bit);
+        if (decodeExact(buf, len, out) == OK) {
+          accepted++;
+          if (i != 4 || (1 << bit) != F_CRC || !sameSamples(in, out)) wrong++;
+        }
+        buf[i] ^= (uint8_t)(1 << bit);
+      }
+    }
+  }
+  CHECK_EQ(accepted, 4);  // one per frame size
+  CHECK_EQ(wrong, 0);
+}
+
+// Random payloads, half with a valid-looking header. Whatever decodes must
+// be self-consistent; random bytes do not get past the CRC.
+static void testRandom() {
+  uint8_t buf[kMaxFrame + 8];
+  int v2ok = 0, crcOk = 0;
+  for (int iter = 0; iter < 200000; ++iter) {
+    size_t len = rnd() % (sizeof(buf) + 1);
+    for (size_t i = 0; i < len; ++i) buf[i] = (uint8_t)rnd();
+    if (len >= kHeaderLen && (iter & 1)) {
+      buf[0] = kMagic0;
+      buf[1] = kMagic1;
+      buf[2] = kVersion;
+      buf[3] = (uint8_t)(1 + rnd() % 5);
+      buf[5] = (uint8_t)(rnd() % (LUXW_MAX_SAMPLES + 2));
+      if (iter & 2) buf[4] &= (uint8_t)~F_CRC;
+    }
+    Frame f;
+    Status st = decodeExact(buf, len, f);
+    if (st != OK) continue;
+    if (f.legacy) {
+      CHECK_EQ(f.count, 1);
+      continue;
+    }
+    v2ok++;
+    CHECK(f.type == T_SAMPLES || isControl(f.type));
+    CHECK(isControl(f.type) ? f.count == 0 : (f.count >= 1 && f.count <= LUXW_MAX_SAMPLES));
+    size_t need = frameLen(f.type, f.count, (f.flags & F_CRC) != 0);
+    CHECK(need <= len);
+    if (f.flags & F_CRC) {
+      crcOk++;
+      CHECK_EQ(get16(buf + need - kCrcLen), crc16(buf, need - kCrcLen));
+    }
+  }
+  CHECK(v2ok > 0);  // the fuzz did reach the v2 decoder
+  CHECK_EQ(crcOk, 0);  // 1 in 65536 per frame by chance; none with this seed
+}
+
+int main() {
+  testRoundTrip();
+  testLegacy();
+  testTruncated();
+  testBitFlips();
+  testRandom();
+  return Check::result("test_lux_packet");
+}
@@ -0,0 +1,95 @@
+// mimir_curve.h: the baked gamma table and the LUT mapping against the float
+// formula they replaced, plus user piecewise curves.
+
+#include "check.h"
+#include "mimir_curve.h"
+
+// What the lamp computed per lux sample before the tables
+static int floatMap(float lux, uint8_t minB, uint8_t maxB) {
+  float cl = lux < LUX_MIN ? LUX_MIN : lux > LUX_MAX ? LUX_MAX : lux;
+  float t = (cl - LUX_MIN) / (float)(LUX_MAX - LUX_MIN);
+  t = powf(t, MIMIR_GAMMA);
+  int mapped = (int)roundf((float)minB + t * (float)(maxB - minB));
+  return mapped < 0 ? 0 : mapped > 255 ? 255 : mapped;
+}
+
+static void testGammaTable() {
+  for (uint16_t i = 0; i <= MimirCurve::kBins; ++i) {
+    double want = pow((double)i / MimirCurve::kBins, (double)MIMIR_GAMMA) * 65535.0;
+    CHECK_NEAR(MimirCurve::kGamma.q16[i], want, 1.0);
+  }
+}
+
+// Every lux the sensor can report, in steps finer than a bin, within one
+// brightness step of the float formula
+static void testParity() {
+  const uint8_t ranges[][2] = { { 0, 255 }, { 10, 200 }, { 60, 120 }, { 128, 128 }, { 0, 1 }, { 254, 255 } };
+  for (const auto& r : ranges) {
+    MimirCurve::rebuild(r[0], r[1]);
+    int worst = 0;
+    for (float lux = -5.0f; lux <= LUX_MAX + 5.0f; lux += 0.05f) {
+      int d = abs((int)MimirCurve::map(lux) - floatMap(lux, r[0], r[1]));
+      if (d > worst) worst = d;
+    }
+    CHECK(worst <= 1);
+    // the ends are exact
+    CHECK_EQ(MimirCurve::map(LUX_MIN), r[0]);
+    CHECK_EQ(MimirCurve::map(LUX_MAX), r[1]);
+  }
+}
+
+static void testOddInputs() {
+  MimirCurve::rebuild(20, 220);
+  CHECK_EQ(MimirCurve::map(NAN), 20);
+  CHECK_EQ(MimirCurve::map(-INFINITY), 20);
+  CHECK_EQ(MimirCurve::map(INFINITY), 220);
+  CHECK_EQ(MimirCurve::map(1e9f), 220);
+}
+
+static void testMonotonic() {
+  MimirCurve::rebuild(0, 255);
+  uint8_t prev = 0;
+  for (float lux = LUX_MIN; lux <= LUX_MAX; lux += 0.1f) {
+    uint8_t b = MimirCurve::map(lux);
+    CHECK(b >= prev);
+    prev = b;
+  }
+}
+
+static void testPoints() {
+  // out of order on purpose; flat beyond the ends, linear in between
+  const MimirCurve::Point pts[] = { { 300, 255 }, { 0, 0 }, { 100, 51 } };
+  CHECK(MimirCurve::setPoints(pts, 3));
+  CHECK_EQ(MimirCurve::pointCount(), 3);
+  CHECK_EQ(MimirCurve::points()[0].lux, 0);
+  CHECK_EQ(MimirCurve::points()[2].lux, 300);
+  MimirCurve::rebuild(0, 255);
+  for (float lux = 0.0f; lux <= LUX_MAX; lux += 0.5f) {
+    float lv = lux <= 100 ? lux * 51 / 100 : lux <= 300 ? 51 + (lux - 100) * 204 / 200 : 255;
+    CHECK_NEAR(MimirCurve::map(lux), lv, 1.0);
+  }
+  // scaled into the range
+  MimirCurve::rebuild(100, 200);
+  CHECK_EQ(MimirCurve::map(0), 100);
+  CHECK_EQ(MimirCurve::map(LUX_MAX), 200);
+  CHECK_NEAR(MimirCurve::map(100), 100 + 100 * 51 / 255.0, 1.0);
+
+  const MimirCurve::Point dup[] = { { 50, 0 }, { 50, 10 } };
+  CHECK(!MimirCurve::setPoints(dup, 2));
+  CHECK(!MimirCurve::setPoints(pts, 1));
+  CHECK(!MimirCurve::setPoints(nullptr, 2));
+  CHECK_EQ(MimirCurve::pointCount(), 3);
+
+  MimirCurve::clearPoints();
+  MimirCurve::rebuild(0, 255);
+  CHECK_EQ(MimirCurve::map(200), floatMap(200, 0, 255));
+}
+
+int main() {
+  testGammaTable();
+  testParity();
+  testOddInputs();
+  testMonotonic();
+  testPoints();
+  return Check::result("test_mimir_curve");
+}
@@ -0,0 +1,130 @@
+// occupancy.h: debounce, hold, retriggers and glitches, fed with PIR traces
+// and ticked like loop() does, including across the millis() wrap.
+
+#include "check.h"
+#include "occupancy.h"
+
+static const uint32_t kHold = 60000;
+static const uint32_t kDebounce = 100;
+
+struct Edge {
+  uint32_t ms;  // relative to the trace start
+  bool level;
+};
+
+// Plays a PIR trace from t0, ticking every 10 ms up to t0 + endMs.
+// Returns how often occupied() changed; *offAt gets the last fall to
+// unoccupied (relative), or stays untouched.
+static int play(Occupancy& o, uint32_t t0, const Edge* edges, size_t n, uint32_t endMs, uint32_t* offAt = nullptr) {
+  int changes = 0;
+  size_t e = 0;
+  for (uint32_t t = 0; t <= endMs; t += 10) {
+    bool changed = false;
+    while (e < n && edges[e].ms <= t) {
+      changed |= o.input(edges[e].level, t0 + edges[e].ms);
+      e++;
+    }
+    changed |= o.tick(t0 + t);
+    if (changed) {
+      changes++;
+      if (!o.occupied() && offAt) *offAt = t;
+    }
+  }
+  return changes;
+}
+
+static void testBoot() {
+  Occupancy o(kHold, kDebounce);
+  CHECK(!o.tick(0));
+  CHECK(!o.tick(10));  // lastMotion 0 is not a motion at 0
+  CHECK(!o.occupied());
+}
+
+static void testGlitch() {
+  Occupancy o(kHold, kDebounce);
+  CHECK(!o.input(true, 1000));
+  CHECK(o.pending());
+  CHECK(!o.tick(1099));
+  CHECK(!o.input(false, 1099));  // one ms short
+  CHECK(!o.pending());
+  CHECK(!o.occupied());
+  CHECK_EQ(o.glitches(), 1u);
+  CHECK(!o.tick(5000));
+}
+
+static void testDebounceHold() {
+  Occupancy o(kHold, kDebounce);
+  CHECK(!o.input(true, 2000));
+  CHECK(!o.tick(2099));
+  CHECK(o.tick(2100));
+  CHECK(o.occupied());
+  CHECK(!o.pending());
+  CHECK(!o.tick(50000));  // level still high: stays occupied however long
+  CHECK(!o.input(false, 50000));
+  CHECK(!o.level());
+  CHECK(!o.tick(50000 + kHold - 1));
+  CHECK(o.tick(50000 + kHold));
+  CHECK(!o.occupied());
+  CHECK_EQ(o.glitches(), 0u);
+  CHECK_EQ(o.retriggers(), 0u);
+}
+
+// A confirmed rise during the hold extends it; a glitch does not
+static void testRetrigger() {
+  Occupancy o(kHold, kDebounce);
+  const Edge trace[] = {
+    { 1000, true }, { 3000, false },     // occupied from 1100, hold runs from 3000
+    { 20000, true }, { 20050, false },   // glitch: hold unchanged
+    { 40000, true }, { 42000, false },   // retrigger: hold now runs from 42000
+  };
+  uint32_t off = 0;
+  int changes = play(o, 0, trace, sizeof(trace) / sizeof(trace[0]), 200000, &off);
+  CHECK_EQ(changes, 2);  // on once, off once
+  CHECK_EQ(off, 42000 + kHold);
+  CHECK_EQ(o.glitches(), 1u);
+  CHECK_EQ(o.retriggers(), 1u);
+
+  // the same glitch alone would have let it expire on the first hold
+  Occupancy g(kHold, kDebounce);
+  const Edge short_[] = { { 1000, true }, { 3000, false }, { 20000, true }, { 20050, false } };
+  off = 0;
+  play(g, 0, short_, 4, 200000, &off);
+  CHECK_EQ(off, 3000 + kHold);
+}
+
+// Bouncy edges inside one debounce window never confirm
+static void testChatter() {
+  Occupancy o(kHold, kDebounce);
+  Edge trace[40];
+  for (int i = 0; i < 40; ++i) trace[i] = { (uint32_t)(1000 + i * 40), (i & 1) == 0 };
+  CHECK_EQ(play(o, 0, trace, 40, 10000), 0);
+  CHECK_EQ(o.glitches(), 20u);
+  CHECK(!o.occupied());
+}
+
+// millis() wraps after ~49.7 days; every interval is an unsigned difference
+static void testWrap() {
+  Occupancy o(kHold, kDebounce);
+  const uint32_t t0 = 0xFFFFFFFFu - 30000;
+  const Edge trace[] = { { 0, true }, { 20000, false } };  // hold ends 40 s past the wrap
+  uint32_t off = 0;
+  CHECK_EQ(play(o, t0, trace, 2, 120000, &off), 2);
+  CHECK_EQ(off, 20000 + kHold);
+
+  Occupancy p(kHold, kDebounce);
+  const uint32_t t1 = 0xFFFFFFFFu - 50;  // the rise itself straddles the wrap
+  CHECK(!p.input(true, t1));
+  CHECK(!p.tick(t1 + kDebounce - 1));
+  CHECK(p.tick(t1 + kDebounce));
+  CHECK(p.occupied());
+}
+
+int main() {
+  testBoot();
+  testGlitch();
+  testDebounceHold();
+  testRetrigger();
+  testChatter();
+  testWrap();
+  return Check::result("test_occupancy");
+}
@@ -0,0 +1,252 @@
+// persist.h: write-behind timing against the NVS write counter, legacy key
+// migration and what happens to a damaged blob.
+
+#include "check.h"
+#include "persist.h"
+
+static Preferences s_prefs;
+
+// Reboot onto whatever is in the store (the shutdown hook flushes first)
+static void reboot() {
+  HostSystem::restart();
+  Persist::begin(s_prefs);
+}
+
+static void freshChip() {
+  HostSystem::restart();
+  HostNvs::erase();
+  Persist::begin(s_prefs);
+}
+
+// Let time pass in 10 ms loop() iterations
+static void run(uint32_t ms) {
+  for (uint32_t t = 0; t < ms; t += 10) {
+    delay(10);
+    Persist::service(millis());
+  }
+}
+
+static uint32_t writes() {
+  return HostNvs::store().writes;
+}
+
+static void testFreshChip() {
+  freshChip();
+  CHECK_EQ(writes(), 1u);  // defaults written once
+  CHECK(!Persist::pending());
+  CHECK_EQ(Persist::state().brightness, DEFAULT_BRIGHTNESS);
+  CHECK_EQ(Persist::state().color, (uint32_t)DEFAULT_COLOR_HEX);
+  reboot();
+  CHECK_EQ(writes(), 1u);  // a clean boot reads, never writes
+}
+
+static void testDebounce() {
+  freshChip();
+  uint32_t w = writes();
+  Persist::setBrightness(10);
+  run(PERSIST_DEBOUNCE_MS - 10);
+  CHECK_EQ(writes(), w);
+  run(10);
+  CHECK_EQ(writes(), w + 1);
+  CHECK(!Persist::pending());
+
+  // setting what is already stored costs nothing
+  Persist::setBrightness(10);
+  Persist::setOn(DEFAULT_ON);
+  run(PERSIST_MAX_DELAY_MS);
+  CHECK_EQ(writes(), w + 1);
+}
+
+// A slider dragged for 5 s (a change every 20 ms): one write, debounce after the last
+static void testSliderSpam() {
+  freshChip();
+  uint32_t w = writes();
+  uint32_t marks = Persist::stats().marks;
+  for (int i = 0; i < 250; ++i) {
+    Persist::setBrightness((uint8_t)(i % 200 + 1));
+    run(20);
+  }
+  CHECK_EQ(writes(), w);
+  CHECK_EQ(Persist::stats().marks - marks, 250u);
+  run(PERSIST_DEBOUNCE_MS);
+  CHECK_EQ(writes(), w + 1);
+  reboot();
+  CHECK_EQ(Persist::state().brightness, 249 % 200 + 1);
+}
+
+// Dragged without pause: the max delay forces a write every 10 s
+static void testEndlessSpam() {
+  freshChip();
+  uint32_t w = writes();
+  uint32_t start = millis();
+  uint32_t firstAt = 0;
+  for (int i = 0; i < 1250; ++i) {  // 25 s
+    Persist::setBrightness((uint8_t)(i & 1 ? 100 : 101));
+    run(20);
+    if (!firstAt && writes() != w) firstAt = millis() - start;
+  }
+  CHECK_EQ(writes(), w + 2);
+  CHECK(firstAt >= PERSIST_MAX_DELAY_MS && firstAt < PERSIST_MAX_DELAY_MS + 30);
+  run(PERSIST_DEBOUNCE_MS);
+  CHECK_EQ(writes(), w + 3);
+}
+
+// loop() samples millis() first; a setter on another task can mark after
+// that, so the mark is newer than the time service() is given
+static void testMarkAfterLoopNow() {
+  freshChip();
+  uint32_t w = writes();
+  uint32_t now = millis();
+  delay(3);
+  Persist::setBrightness(42);
+  Persist::service(now);
+  CHECK_EQ(writes(), w);
+  CHECK(Persist::pending());
+
+  // the same race on every loop pass of a slider drag: still one write
+  for (int i = 0; i < 250; ++i) {
+    now = millis();
+    delay(3);
+    Persist::setBrightness((uint8_t)(i % 200 + 1));
+    Persist::service(now);
+    delay(17);
+  }
+  CHECK_EQ(writes(), w);
+  run(PERSIST_DEBOUNCE_MS);
+  CHECK_EQ(writes(), w + 1);
+}
+
+static void testShutdownFlush() {
+  freshChip();
+  uint32_t w = writes();
+  Persist::setColor(0x123456);
+  run(100);
+  CHECK(Persist::pending());
+  reboot();
+  CHECK_EQ(writes(), w + 1);
+  CHECK_EQ(Persist::state().color, 0x123456u);
+}
+
+static void testWriteFailure() {
+  freshChip();
+  Persist::setEffect(7);
+  HostNvs::store().failWrites = true;
+  run(PERSIST_DEBOUNCE_MS);
+  CHECK(Persist::pending());
+  CHECK_EQ(Persist::stats().failed, 1u);
+  HostNvs::store().failWrites = false;
+  run(PERSIST_DEBOUNCE_MS);
+  CHECK(!Persist::pending());
+  reboot();
+  CHECK_EQ(Persist::state().effect, 7);
+}
+
+static void putLegacyKeys() {
+  Preferences p;
+  p.begin(PREF_NAMESPACE, false);
+  p.putUInt(PREF_KEY_COLOR, 0x00FF00);
+  p.putUChar(PREF_KEY_BRIGHTNESS, 33);
+  p.putUShort(PREF_KEY_EFFECT, 5);
+  p.putBool(PREF_KEY_MIMIR, true);
+  p.putUChar(PREF_KEY_MIMIR_MIN, 20);
+  p.putUChar(PREF_KEY_MIMIR_MAX, 90);
+  p.putString(PREF_KEY_WIFI_MODE, "STA");
+  p.putString(PREF_KEY_STA_SSID, "home");
+  p.end();
+}
+
+static bool anyLegacyKey() {
+  Preferences p;
+  p.begin(PREF_NAMESPACE, true);
+  bool any = false;
+  for (const char* key : Persist::kLegacyKeys) any = any || p.isKey(key);
+  p.end();
+  return any;
+}
+
+static void testMigration() {
+  HostSystem::restart();
+  HostNvs::erase();
+  putLegacyKeys();
+  uint32_t w = writes();
+  Persist::begin(s_prefs);
+  CHECK_EQ(Persist::state().color, 0x00FF00u);
+  CHECK_EQ(Persist::state().brightness, 33);
+  CHECK_EQ(Persist::state().effect, 5);
+  CHECK_EQ(Persist::state().mimir, 1);
+  CHECK_EQ(Persist::state().mimirMin, 20);
+  CHECK_EQ(Persist::state().mimirMax, 90);
+  CHECK_EQ(Persist::state().wifiMode, Persist::WIFI_PREF_STA);
+  CHECK_STREQ(Persist::state().staSsid, "home");
+  CHECK(!anyLegacyKey());
+  CHECK_EQ(writes(), w + 1 + 8);  // the blob, then one remove per old key
+
+  Persist::setBrightness(50);
+  reboot();
+  CHECK_EQ(Persist::state().brightness, 50);
+  CHECK_EQ(Persist::state().color, 0x00FF00u);
+}
+
+// The old keys stay until the blob that replaces them is on flash
+static void testMigrationWriteFails() {
+  HostSystem::restart();
+  HostNvs::erase();
+  putLegacyKeys();
+  HostNvs::store().failWrites = true;
+  Persist::begin(s_prefs);
+  CHECK_EQ(Persist::state().brightness, 33);
+  CHECK(Persist::pending());
+  CHECK(anyLegacyKey());
+  HostNvs::store().failWrites = false;
+  run(PERSIST_DEBOUNCE_MS);
+  CHECK(!Persist::pending());
+  CHECK(!anyLegacyKey());
+  reboot();
+  CHECK_EQ(Persist::state().brightness, 33);
+}
+
+// A damaged blob means defaults: the legacy keys predate it and are stale
+static void testCorruptBlob() {
+  freshChip();
+  Persist::setBrightness(77);
+  reboot();
+  putLegacyKeys();  // e.g. left behind by an older build
+
+  Preferences p;
+  p.begin(PREF_NAMESPACE, false);
+  Persist::State st;
+  p.getBytes(PREF_KEY_STATE, &st, sizeof(st));
+  st.brightness ^= 0x40;  // CRC no longer matches
+  p.putBytes(PREF_KEY_STATE, &st, sizeof(st));
+  p.end();
+
+  uint32_t w = writes();
+  reboot();
+  CHECK_EQ(Persist::state().brightness, DEFAULT_BRIGHTNESS);
+  CHECK_EQ(Persist::state().color, (uint32_t)DEFAULT_COLOR_HEX);
+  CHECK_EQ(writes(), w + 1);  // defaults rewritten, legacy keys untouched
+  reboot();
+  CHECK_EQ(Persist::state().brightness, DEFAULT_BRIGHTNESS);
+
+  // truncated blob: same
+  p.begin(PREF_NAMESPACE, false);
+  p.putBytes(PREF_KEY_STATE, &st, sizeof(st) / 2);
+  p.end();
+  reboot();
+  CHECK_EQ(Persist::state().brightness, DEFAULT_BRIGHTNESS);
+  CHECK_EQ(Persist::state().effect, DEFAULT_EFFECT_ID);
+}
+
+int main() {
+  testFreshChip();
+  testDebounce();
+  testSliderSpam();
+  testEndlessSpam();
+  testMarkAfterLoopNow();
+  testShutdownFlush();
+  testWriteFailure();
+  testMigration();
+  testMigrationWriteFails();
+  testCorruptBlob();
+  return Check::result("test_persist");
+}
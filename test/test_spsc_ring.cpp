@@ -0,0 +1,92 @@
+// spsc_ring.h: full/empty edges on one thread, then a producer and a
+// consumer thread hammering the ring past the 16-bit index wrap.
+
+#include "check.h"
+#include "spsc_ring.h"
+
+#include <thread>
+
+struct Item {
+  uint32_t seq;
+  uint32_t check;  // ~seq: a torn copy shows up as a mismatch
+  uint8_t pad[24];
+};
+
+static void testEdges() {
+  SpscRing<uint32_t, 4> r;
+  uint32_t v = 0;
+  CHECK(!r.pop(v));
+  CHECK_EQ(r.capacity(), 4);
+  for (uint32_t i = 0; i < 4; ++i) CHECK(r.push(i));
+  CHECK(!r.push(99));  // full rejects, nothing overwritten
+  CHECK_EQ(r.size(), 4);
+  CHECK(r.pop(v));
+  CHECK_EQ(v, 0u);
+  CHECK(r.push(4));
+  uint32_t out[8];
+  CHECK_EQ(r.popBatch(out, 2), 2u);
+  CHECK_EQ(out[0], 1u);
+  CHECK_EQ(out[1], 2u);
+  CHECK_EQ(r.popBatch(out, 8), 2u);
+  CHECK_EQ(out[0], 3u);
+  CHECK_EQ(out[1], 4u);
+  CHECK_EQ(r.popBatch(out, 8), 0u);
+  CHECK_EQ(r.size(), 0);
+
+  // indices are free-running uint16: keep going around well past 65535
+  SpscRing<uint32_t, 8> w;
+  bool ok = true;
+  for (uint32_t i = 0; i < 200000 && ok; ++i) {
+    ok = w.push(i) && w.pop(v) && v == i;
+  }
+  CHECK(ok);
+  CHECK_EQ(w.size(), 0);
+}
+
+// One producer, one consumer, every item in order exactly once
+static void testTwoThreads(bool batch) {
+  static SpscRing<Item, 64> ring;
+  const uint32_t kItems = 1000000;
+
+  std::thread producer([&] {
+    for (uint32_t i = 0; i < kItems; ++i) {
+      Item it;
+      it.seq = i;
+      it.check = ~i;
+      memset(it.pad, (int)(i & 0xFF), sizeof(it.pad));
+      while (!ring.push(it)) std::this_thread::yield();
+    }
+  });
+
+  uint32_t next = 0, bad = 0;
+  Item got[16];
+  while (next < kItems) {
+    size_t n;
+    if (batch) {
+      n = ring.popBatch(got, 1 + next % 16);
+    } else {
+      n = ring.pop(got[0]) ? 1 : 0;
+    }
+    if (!n) {
+      std::this_thread::yield();
+      continue;
+    }
+    for (size_t k = 0; k < n; ++k) {
+      const Item& it = got[k];
+      bool padOk = it.pad[0] == (uint8_t)(it.seq & 0xFF) && it.pad[sizeof(it.pad) - 1] == it.pad[0];
+      if (it.seq != next || it.check != ~it.seq || !padOk) bad++;
+      next++;
+    }
+  }
+  producer.join();
+  CHECK_EQ(bad, 0u);
+  CHECK_EQ(next, kItems);
+  CHECK_EQ(ring.size(), 0);
+}
+
+int main() {
+  testEdges();
+  testTwoThreads(false);
+  testTwoThreads(true);
+  return Check::result("test_spsc_ring");
+}
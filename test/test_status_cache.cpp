@@ -0,0 +1,106 @@
+// status_cache.h: one render per state version, and pinned slots that stay
+// intact while later renders rotate around them.
+
+#include "check.h"
+#include "status_cache.h"
+#include "sketch_host.h"
+
+#include <string>
+#include <vector>
+
+static uint8_t s_level = 10;
+
+// Any setter moves the state on
+static void change() {
+  LedControl::setTargetBrightness(++s_level, 0);
+}
+
+static void testHits() {
+  const StatusCache::Entry* a = &StatusCache::get();
+  uint32_t renders = StatusCache::stats().renders;
+  const StatusCache::Entry* b = &StatusCache::get();
+  CHECK(a == b);
+  CHECK_EQ(StatusCache::stats().renders, renders);
+  change();
+  const StatusCache::Entry& c = StatusCache::get();
+  CHECK(&c != a);
+  CHECK(strcmp(c.etag, a->etag) != 0);
+  CHECK_EQ(StatusCache::stats().renders, renders + 1);
+  g_lastMotion = true;  // sketch-owned fields count too
+  CHECK(&StatusCache::get() != &c);
+  g_lastMotion = false;
+}
+
+// A pinned slot keeps its bytes however often the state changes meanwhile
+static void testPinnedSurvivesRotation() {
+  StatusCache::Pin pin;
+  std::string json(pin->json, pin->len);
+  std::string etag(pin->etag);
+  for (int i = 0; i < 3 * STATUS_CACHE_SLOTS; ++i) {
+    change();
+    const StatusCache::Entry& e = StatusCache::get();
+    CHECK(&e != &*pin);
+  }
+  CHECK_EQ(pin->len, json.size());
+  CHECK(json == std::string(pin->json, pin->len));
+  CHECK(etag == pin->etag);
+  CHECK_EQ(pin->pins, 1);
+}
+
+static void testAllPinned() {
+  uint32_t spares = StatusCache::stats().spares;
+  std::vector<StatusCache::Pin> pins;
+  pins.reserve(STATUS_CACHE_SLOTS + 2);
+  for (int i = 0; i < STATUS_CACHE_SLOTS; ++i) {
+    change();
+    pins.push_back(StatusCache::Pin());
+  }
+  for (int i = 0; i < STATUS_CACHE_SLOTS; ++i) {
+    for (int j = 0; j < i; ++j) CHECK(&*pins[i] != &*pins[j]);
+  }
+  CHECK_EQ(StatusCache::stats().spares, spares);
+
+  // nowhere left: the render goes to the spare and a Pin gets a copy
+  std::vector<std::string> before;
+  for (const StatusCache::Pin& p : pins) before.push_back(p->json);
+  change();
+  StatusCache::Pin extra;
+  CHECK_EQ(StatusCache::stats().spares, spares + 1);
+  for (int i = 0; i < STATUS_CACHE_SLOTS; ++i) CHECK(&*extra != &*pins[i]);
+  std::string copy(extra->json, extra->len);
+  change();
+  StatusCache::get();  // rewrites the spare
+  CHECK(copy == std::string(extra->json, extra->len));
+  for (size_t i = 0; i < pins.size(); ++i) CHECK(before[i] == pins[i]->json);
+
+  // released slots are used again
+  pins.clear();
+  change();
+  StatusCache::Pin again;
+  CHECK_EQ(StatusCache::stats().spares, spares + 2);  // only the two renders above
+  CHECK_EQ(again->pins, 1);
+}
+
+static void testMove() {
+  change();
+  StatusCache::Pin a;
+  const StatusCache::Entry* e = &*a;
+  StatusCache::Pin b(std::move(a));
+  CHECK(&*b == e);
+  CHECK_EQ(b->pins, 1);
+  {
+    StatusCache::Pin c;
+    CHECK(&*c == e);  // same version: same slot, pinned twice
+    CHECK_EQ(e->pins, 2);
+  }
+  CHECK_EQ(e->pins, 1);
+}
+
+int main() {
+  LedControl::init();
+  testHits();
+  testPinnedSurvivesRotation();
+  testAllPinned();
+  testMove();
+  return Check::result("test_status_cache");
+}
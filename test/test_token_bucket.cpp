@@ -0,0 +1,62 @@
+// token_bucket.h: burst, refill rate, waitMs and millis() wrap.
+
+#include "check.h"
+#include "token_bucket.h"
+
+static void testBurstThenRate() {
+  TokenBucket tb(3, 1000);
+  CHECK(tb.take(0));
+  CHECK(tb.take(0));
+  CHECK(tb.take(0));
+  CHECK(!tb.take(0));
+  CHECK_EQ(tb.waitMs(400), 600u);
+  CHECK(!tb.take(999));
+  CHECK(tb.take(1000));
+  CHECK(!tb.take(1500));
+  CHECK(tb.take(2000));
+
+  // a long idle spell refills to the burst, no further
+  CHECK_EQ(tb.tokens(60000), 3);
+  CHECK_EQ(tb.waitMs(60000), 0u);
+}
+
+static void testLongRunRate() {
+  // polled every 10 ms for a minute: one token per interval after the burst
+  TokenBucket tb(2, 500);
+  int taken = 0;
+  for (uint32_t t = 0; t < 60000; t += 10) taken += tb.take(t);
+  CHECK_EQ(taken, 2 + 60000 / 500 - 1);
+}
+
+static void testPartialRefillKeepsPhase() {
+  TokenBucket tb(4, 100);
+  for (int i = 0; i < 4; ++i) tb.take(0);
+  CHECK_EQ(tb.tokens(250), 2);  // 2 earned, 50 ms carried over
+  CHECK_EQ(tb.tokens(299), 2);
+  CHECK_EQ(tb.tokens(300), 3);
+}
+
+static void testWrap() {
+  uint32_t t0 = 0xFFFFFF00u;
+  TokenBucket tb(1, 1000);
+  CHECK(tb.take(t0));
+  CHECK(!tb.take(t0 + 500));
+  CHECK(tb.take(t0 + 1000));  // wrapped past 0
+}
+
+static void testDegenerate() {
+  TokenBucket tb(0, 0);  // clamped to burst 1, 1 ms
+  CHECK_EQ(tb.burst(), 1);
+  CHECK(tb.take(5));
+  CHECK(!tb.take(5));
+  CHECK(tb.take(6));
+}
+
+int main() {
+  testBurstThenRate();
+  testLongRunRate();
+  testPartialRefillKeepsPhase();
+  testWrap();
+  testDegenerate();
+  return Check::result("test_token_bucket");
+}
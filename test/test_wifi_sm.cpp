@@ -0,0 +1,272 @@
+// wifi_sm.h: the machine against a simulated driver and router. Actions are
+// carried out the way wifiApply() does; the driver answers a connection
+// attempt with GOT_IP or a disconnect after a delay, and may deliver a
+// stale disconnect from the attempt before. Time runs in 50 ms steps from
+// an arbitrary start, so the same scenario also runs across the millis()
+// wrap.
+
+#include "check.h"
+#include "wifi_sm.h"
+
+#include <vector>
+
+using namespace WifiSm;
+
+static const Config kCfg = { 20000, 2000, 60000, 15000, 60000 };  // wifi_manager.h defaults
+static const uint32_t kStepMs = 50;
+static const uint8_t kNoApFound = 201;
+static const uint8_t kBeaconTimeout = 200;
+
+struct Sim {
+  Machine m{ kCfg };
+  uint32_t t0;
+  uint32_t now;  // relative to t0
+
+  // router and driver
+  bool routerUp = true;
+  bool answers = true;        // false: attempts just hang (timeout path)
+  bool staleOnBegin = false;  // a disconnect from the previous attempt arrives 50 ms in
+  uint32_t connectMs = 3000;
+  uint32_t failMs = 2000;
+  uint8_t apClients = 0;
+  bool linked = false;
+  bool eventDue = false, eventOk = false;
+  uint32_t eventAt = 0;
+  bool staleDue = false;
+  uint32_t staleAt = 0;
+
+  // what the lamp did
+  std::vector<uint32_t> begins, apUps, apDowns, saves;
+  int stops = 0, mdns = 0;
+
+  explicit Sim(uint32_t start = 1000) : t0(start), now(0) {}
+
+  uint32_t abs() const { return t0 + now; }
+
+  void apply(uint8_t a) {
+    if (a & A_STA_STOP) {
+      stops++;
+      eventDue = staleDue = linked = false;
+    }
+    if (a & A_AP_UP) apUps.push_back(now);
+    if (a & A_AP_DOWN) apDowns.push_back(now);
+    if (a & A_MDNS) mdns++;
+    if (a & A_SAVE) saves.push_back(now);
+    if (a & A_STA_BEGIN) {
+      begins.push_back(now);
+      linked = false;
+      staleDue = staleOnBegin;
+      staleAt = now + 50;
+      eventDue = answers;
+      eventOk = routerUp;
+      eventAt = now + (routerUp ? connectMs : failMs);
+    }
+  }
+
+  // The router goes away under a connected STA
+  void dropLink() {
+    routerUp = false;
+    if (linked) {
+      linked = false;
+      apply(m.onDisconnected(abs(), kBeaconTimeout));
+    }
+  }
+
+  void step() {
+    now += kStepMs;
+    if (staleDue && now >= staleAt) {
+      staleDue = false;
+      apply(m.onDisconnected(abs(), kBeaconTimeout));
+    }
+    if (eventDue && now >= eventAt) {
+      eventDue = false;
+      if (eventOk && routerUp) {
+        linked = true;
+        apply(m.onGotIp(abs()));
+      } else {
+        apply(m.onDisconnected(abs(), kNoApFound));
+      }
+    }
+    apply(m.tick(abs(), apClients));
+  }
+
+  void runTo(uint32_t rel) {
+    while (now < rel) step();
+  }
+};
+
+static void testBootConnects() {
+  Sim s;
+  s.apply(s.m.startSta(s.abs(), true));
+  s.runTo(10000);
+  CHECK_EQ(s.m.state(), S_CONNECTED);
+  CHECK_EQ(s.m.result(), R_OK);
+  CHECK_EQ(s.begins.size(), 1u);
+  CHECK(s.apUps.empty());
+  CHECK(s.saves.empty());  // already saved
+  CHECK_EQ(s.mdns, 1);
+  CHECK(!s.m.apUp());
+}
+
+// Saved network missing at boot: backoff doubles to the cap, the AP joins
+// after fallbackApMs, and leaves again once STA is back and the AP unused
+static void runRouterDown(uint32_t t0) {
+  Sim s(t0);
+  s.routerUp = false;
+  s.apply(s.m.startSta(s.abs(), true));
+  s.runTo(200000);
+  // attempt fails 2 s in, then waits 2, 4, 8 ... 60 s
+  const uint32_t want[] = { 0, 4000, 10000, 20000, 38000, 72000, 134000, 196000 };
+  CHECK_EQ(s.begins.size(), sizeof(want) / sizeof(want[0]));
+  for (size_t i = 0; i < s.begins.size() && i < sizeof(want) / sizeof(want[0]); ++i) CHECK_EQ(s.begins[i], want[i]);
+  CHECK_EQ(s.m.lastReason(), kNoApFound);
+  CHECK_EQ(s.apUps.size(), 1u);
+  if (!s.apUps.empty()) CHECK_EQ(s.apUps[0], kCfg.fallbackApMs);
+  CHECK(s.m.staWanted());  // AP+STA: nothing was torn down
+  CHECK_EQ(s.m.result(), R_PENDING);
+  CHECK(s.saves.empty());
+
+  // router back; the attempt at 196 s has failed, the next is at 258 s
+  s.routerUp = true;
+  s.apClients = 1;
+  s.runTo(262000);
+  CHECK_EQ(s.m.state(), S_CONNECTED);
+  CHECK_EQ(s.begins.back(), 258000u);
+  CHECK_EQ(s.m.result(), R_OK);
+  CHECK(s.saves.empty());
+  s.runTo(400000);
+  CHECK(s.apDowns.empty());  // somebody is still on the AP
+  s.apClients = 0;
+  s.runTo(400000 + kStepMs);
+  CHECK_EQ(s.apDowns.size(), 1u);
+  CHECK(!s.m.apUp());
+}
+
+static void testRouterDown() {
+  runRouterDown(1000);
+  runRouterDown(0xFFFFFFFFu - 30000);  // millis() wraps during the backoff
+}
+
+static void testLingerUnused() {
+  Sim s;
+  s.routerUp = false;
+  s.apply(s.m.startSta(s.abs(), true));
+  s.runTo(16000);
+  CHECK(s.m.apUp());
+  s.routerUp = true;
+  s.runTo(30000);
+  CHECK_EQ(s.m.state(), S_CONNECTED);
+  uint32_t upAt = s.begins.back() + s.connectMs;
+  s.runTo(upAt + kCfg.apLingerMs - kStepMs);
+  CHECK(s.apDowns.empty());
+  s.runTo(upAt + kCfg.apLingerMs);
+  CHECK_EQ(s.apDowns.size(), 1u);
+}
+
+// New credentials from the UI: saved once on success, AP again on failure
+static void testUiCredentials() {
+  Sim ok;
+  ok.apply(ok.m.startAp(ok.abs(), false));
+  CHECK_EQ(ok.apUps.size(), 1u);
+  ok.runTo(1000);
+  ok.apply(ok.m.startSta(ok.abs(), false));
+  ok.runTo(5000);
+  CHECK_EQ(ok.m.state(), S_CONNECTED);
+  CHECK_EQ(ok.saves.size(), 1u);
+  ok.dropLink();
+  ok.routerUp = true;
+  ok.runTo(20000);
+  CHECK_EQ(ok.m.state(), S_CONNECTED);
+  CHECK_EQ(ok.saves.size(), 1u);  // reconnects save nothing
+
+  Sim bad;
+  bad.apply(bad.m.startAp(bad.abs(), false));
+  bad.runTo(1000);
+  bad.routerUp = false;
+  bad.apply(bad.m.startSta(bad.abs(), false));
+  bad.runTo(4000);
+  CHECK_EQ(bad.m.state(), S_AP);
+  CHECK_EQ(bad.m.result(), R_FAILED);
+  CHECK(!bad.m.staWanted());
+  CHECK(bad.m.apUp());
+  CHECK_EQ(bad.apUps.size(), 1u);  // it never went down
+  CHECK_EQ(bad.begins.size(), 1u);  // no retries for unsaved credentials
+  CHECK(bad.saves.empty());
+  bad.runTo(120000);
+  CHECK_EQ(bad.begins.size(), 1u);
+
+  // the driver never answers: the connect timeout fails it
+  Sim hang;
+  hang.answers = false;
+  hang.apply(hang.m.startSta(hang.abs(), false));
+  hang.runTo(kCfg.connectTimeoutMs - kStepMs);
+  CHECK_EQ(hang.m.state(), S_CONNECTING);
+  hang.runTo(kCfg.connectTimeoutMs);
+  CHECK_EQ(hang.m.result(), R_FAILED);
+  CHECK_EQ(hang.apUps.size(), 1u);
+}
+
+// A connected STA that drops reconnects at once, then backs off
+static void testDrop() {
+  Sim s;
+  s.apply(s.m.startSta(s.abs(), true));
+  s.runTo(10000);
+  s.dropLink();
+  CHECK_EQ(s.m.state(), S_CONNECTING);
+  CHECK_EQ(s.begins.back(), 10000u);
+  CHECK_EQ(s.m.lastReason(), kBeaconTimeout);
+  s.runTo(12000);
+  CHECK_EQ(s.m.state(), S_WAIT_RETRY);
+  CHECK_EQ(s.m.retryInMs(s.abs()), kCfg.backoffMinMs);
+  s.runTo(10000 + kCfg.fallbackApMs);
+  CHECK_EQ(s.apUps.size(), 1u);  // counted from the drop, not from boot
+  if (!s.apUps.empty()) CHECK_EQ(s.apUps[0], 10000 + kCfg.fallbackApMs);
+}
+
+// A disconnect left over from the previous attempt does not fail the new one
+static void testStaleDisconnect() {
+  Sim s;
+  s.staleOnBegin = true;
+  s.apply(s.m.startSta(s.abs(), false));
+  s.runTo(5000);
+  CHECK_EQ(s.m.state(), S_CONNECTED);
+  CHECK_EQ(s.m.result(), R_OK);
+  CHECK_EQ(s.begins.size(), 1u);
+  CHECK_EQ(s.m.lastReason(), 0);
+
+  // after the settle time the same event is a real failure
+  Sim late;
+  late.routerUp = false;
+  late.apply(late.m.startSta(late.abs(), true));
+  late.runTo(kSettleMs);
+  late.apply(late.m.onDisconnected(late.abs(), kNoApFound));
+  CHECK_EQ(late.m.state(), S_WAIT_RETRY);
+}
+
+// Switching to AP drops the attempt; driver events after that are ignored
+static void testSwitchToAp() {
+  Sim s;
+  s.apply(s.m.startSta(s.abs(), true));
+  s.runTo(1000);
+  int stops = s.stops;
+  s.apply(s.m.startAp(s.abs(), true));
+  CHECK_EQ(s.stops, stops + 1);
+  CHECK_EQ(s.saves.size(), 1u);
+  CHECK_EQ(s.m.state(), S_AP);
+  CHECK_EQ(s.m.onGotIp(s.abs()), 0);
+  CHECK_EQ(s.m.onDisconnected(s.abs(), kNoApFound), 0);
+  s.runTo(60000);
+  CHECK_EQ(s.begins.size(), 1u);
+  CHECK_EQ(s.m.state(), S_AP);
+}
+
+int main() {
+  testBootConnects();
+  testRouterDown();
+  testLingerUnused();
+  testUiCredentials();
+  testDrop();
+  testStaleDisconnect();
+  testSwitchToAp();
+  return Check::result("test_wifi_sm");
+}